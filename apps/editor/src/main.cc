@@ -1,21 +1,32 @@
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <bifrost/core/core.h>
 
-int main(void) {
-    bifrost::core::Window window = bifrost::core::Window(
-        640,
-        480,
-        "Window Name 1"
-    );
-
-    window.show();
-
-    while (!window.should_close()) {
+int main(int argc, char** argv) {
+    bifrost::core::ApplicationConfig config;
+    config.width = 640;
+    config.height = 480;
+    config.title = "Window Name 1";
 
+    // --record <file> captures the session's input, and --replay <file>
+    // plays a capture back headless as fast as it can
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            std::cerr << "Missing a file after " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        } else if (std::strcmp(argv[i], "--record") == 0) {
+            config.input_record_path = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--replay") == 0) {
+            config.input_replay_path = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
     }
-    
-    window.shutdown();
+
+    bifrost::core::Application app(config);
+    app.run();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,53 @@
+/// BIFROST GAME ENGINE
+/// Helpers shared by the engine benchmarks. Every file in bench/ builds
+/// into its own executable that prints what it measured. They are not run
+/// by ctest: their numbers only mean something in a release build on an
+/// otherwise idle machine.
+
+#pragma once
+#include <core/clock.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace bifrost::core::types;
+
+// Keep the compiler from dropping work whose result is never read
+template<typename T>
+inline void bench_keep(const T& value) {
+#if defined(_MSC_VER)
+    static const void* volatile sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+// Run body the given number of times and return the fastest run in
+// nanoseconds. The fastest run is the one least disturbed by the rest
+// of the machine.
+template<typename F>
+u64 bench_best_ns(u32 runs, F&& body) {
+    u64 best = ~0ull;
+    for (u32 run = 0; run < runs; run++) {
+        u64 start = bifrost::core::platform_time_ns();
+        body();
+        u64 elapsed = bifrost::core::platform_time_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+// Millions of items per second
+inline double bench_rate(u64 items, u64 ns) {
+    return ns > 0 ? static_cast<double>(items) * 1e3 / static_cast<double>(ns) : 0.0;
+}
+
+// Stop a benchmark whose work gave a wrong result
+#define BENCH_CHECK(condition)                                                                   \
+    do {                                                                                         \
+        if (!(condition)) {                                                                      \
+            std::fprintf(stderr, "%s:%d: result check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(EXIT_FAILURE);                                                             \
+        }                                                                                        \
+    } while (0)
@@ -0,0 +1,169 @@
+#include "bench.h"
+
+#include <core/ecs.h>
+#include <core/jobs.h>
+
+#include <vector>
+
+using namespace bifrost::core;
+
+constexpr usize ENTITY_COUNT = 1000000;
+constexpr usize CHURN_COUNT = 100000;
+constexpr u32 RUNS = 10;
+
+struct Position { f32 x, y, z; };
+struct Velocity { f32 x, y, z; };
+struct Health { f32 value; };
+struct Tint { u32 color; };
+
+// What the engine hand-rolled before: one struct per object, with every
+// field whether the object uses it or not
+struct GameObject {
+    Position position;
+    Velocity velocity;
+    Health health;
+    Tint tint;
+    bool has_velocity;
+    u8 padding[31]; // the rest of a typical object, such as a name and flags
+};
+static_assert(sizeof(GameObject) == 64, "Baseline objects fill a cache line");
+
+static void report(const char* name, u64 ns, usize items) {
+    std::printf("%-34s %10.3f ms %10.2f ns/entity\n", name, static_cast<double>(ns) / 1e6, static_cast<double>(ns) / items);
+}
+
+int main() {
+    World world;
+    std::vector<Entity> entities(ENTITY_COUNT);
+    std::vector<GameObject> objects(ENTITY_COUNT);
+
+    // Four archetypes: every entity moves, some also have health or a tint
+    for (usize i = 0; i < ENTITY_COUNT; i++) {
+        Entity entity = world.create();
+        entities[i] = entity;
+        world.add(entity, Position{ 0.0f, 0.0f, 0.0f });
+        world.add(entity, Velocity{ 1.0f, 2.0f, 3.0f });
+        if (i % 2 == 0) {
+            world.add(entity, Health{ 100.0f });
+        }
+        if (i % 3 == 0) {
+            world.add(entity, Tint{ 0xFFFFFFFF });
+        }
+
+        objects[i] = {};
+        objects[i].velocity = { 1.0f, 2.0f, 3.0f };
+        objects[i].has_velocity = true;
+    }
+
+    std::printf("%zu entities in %zu archetypes, best of %u runs\n", ENTITY_COUNT, world.archetype_count(), RUNS);
+
+    // Iteration
+    const f32 dt = 1.0f / 60.0f;
+    Query<Position, Velocity> movers = world.query<Position, Velocity>();
+    BENCH_CHECK(movers.count(world) == ENTITY_COUNT);
+
+    u64 query_ns = bench_best_ns(RUNS, [&] {
+        movers.each(world, [dt](Position& position, Velocity& velocity) {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+            position.z += velocity.z * dt;
+        });
+    });
+
+    u64 chunk_ns = bench_best_ns(RUNS, [&] {
+        movers.each_chunk(world, [dt](usize count, Entity*, Position* positions, Velocity* velocities) {
+            for (usize i = 0; i < count; i++) {
+                positions[i].x += velocities[i].x * dt;
+                positions[i].y += velocities[i].y * dt;
+                positions[i].z += velocities[i].z * dt;
+            }
+        });
+    });
+
+    u64 aos_ns = bench_best_ns(RUNS, [&] {
+        for (GameObject& object : objects) {
+            if (object.has_velocity) {
+                object.position.x += object.velocity.x * dt;
+                object.position.y += object.velocity.y * dt;
+                object.position.z += object.velocity.z * dt;
+            }
+        }
+    });
+
+    JobSystem* jobs = JobSystem::get_reference();
+    jobs->init();
+    u64 parallel_ns = bench_best_ns(RUNS, [&] {
+        movers.parallel_each(world, [dt](Position& position, Velocity& velocity) {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+            position.z += velocity.z * dt;
+        }, 4);
+    });
+    u32 threads = jobs->get_thread_count();
+    jobs->shutdown();
+
+    bench_keep(objects[0]);
+    report("query each", query_ns, ENTITY_COUNT);
+    report("query each_chunk", chunk_ns, ENTITY_COUNT);
+    report("AoS baseline", aos_ns, ENTITY_COUNT);
+    std::printf("%-34s %10.3f ms %10.2f ns/entity (%u threads)\n", "query parallel_each",
+        static_cast<double>(parallel_ns) / 1e6, static_cast<double>(parallel_ns) / ENTITY_COUNT, threads);
+
+    // A query kept between frames only tests archetypes created since its
+    // last use; a new one tests them all
+    u64 cached_ns = bench_best_ns(RUNS, [&] {
+        for (u32 i = 0; i < 1000; i++) {
+            bench_keep(movers.count(world));
+        }
+    });
+    u64 uncached_ns = bench_best_ns(RUNS, [&] {
+        for (u32 i = 0; i < 1000; i++) {
+            Query<Position, Velocity> fresh = world.query<Position, Velocity>();
+            bench_keep(fresh.count(world));
+        }
+    });
+    std::printf("%-34s %10.1f ns\n", "cached query lookup", static_cast<double>(cached_ns) / 1000);
+    std::printf("%-34s %10.1f ns\n", "new query lookup", static_cast<double>(uncached_ns) / 1000);
+
+    // Structural churn: entities move to another archetype and back
+    u64 add_ns = ~0ull;
+    u64 remove_ns = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        u64 ns = bench_best_ns(1, [&] {
+            for (usize i = 1; i < CHURN_COUNT * 2; i += 2) {
+                world.add(entities[i], Health{ 50.0f });
+            }
+        });
+        add_ns = ns < add_ns ? ns : add_ns;
+        ns = bench_best_ns(1, [&] {
+            for (usize i = 1; i < CHURN_COUNT * 2; i += 2) {
+                world.remove<Health>(entities[i]);
+            }
+        });
+        remove_ns = ns < remove_ns ? ns : remove_ns;
+    }
+    report("add component", add_ns, CHURN_COUNT);
+    report("remove component", remove_ns, CHURN_COUNT);
+
+    // Deferred changes: record creates and adds, then apply them
+    CommandBuffer commands;
+    u64 record_ns = ~0ull;
+    u64 apply_ns = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        u64 ns = bench_best_ns(1, [&] {
+            for (usize i = 0; i < CHURN_COUNT; i++) {
+                Entity entity = commands.create();
+                commands.add(entity, Position{ 0.0f, 0.0f, 0.0f });
+                commands.add(entity, Velocity{ 1.0f, 0.0f, 0.0f });
+            }
+        });
+        record_ns = ns < record_ns ? ns : record_ns;
+        ns = bench_best_ns(1, [&] { world.apply(commands); });
+        apply_ns = ns < apply_ns ? ns : apply_ns;
+    }
+    BENCH_CHECK(world.entity_count() == ENTITY_COUNT + CHURN_COUNT * RUNS);
+    report("record create + 2 adds", record_ns, CHURN_COUNT);
+    report("apply create + 2 adds", apply_ns, CHURN_COUNT);
+
+    return EXIT_SUCCESS;
+}
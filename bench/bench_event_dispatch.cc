@@ -0,0 +1,120 @@
+#include "bench.h"
+
+#include <core/events.h>
+
+#include <functional>
+#include <vector>
+
+using namespace bifrost::core;
+
+// Listener calls per measurement, whatever the listener count
+constexpr u64 CALLS_PER_RUN = 4000000;
+constexpr u32 RUNS = 5;
+
+struct Listener {
+    u64 count = 0;
+
+    bool on_key(EventCode code, void* sender, void* listener, EventData data) {
+        (void)code;
+        (void)sender;
+        (void)listener;
+        count += data.u16[0];
+        return false;
+    }
+};
+
+// The dispatch this replaced: a std::function per listener in a std::vector
+struct FunctionDispatch {
+    struct Registered {
+        void* listener;
+        std::function<bool (EventCode, void*, void*, EventData)> callback;
+    };
+    std::vector<Registered> listeners;
+
+    bool fire(EventCode code, void* sender, EventData data) {
+        for (Registered& registered : listeners) {
+            if (registered.callback(code, sender, registered.listener, data)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static void run(usize listener_count) {
+    std::vector<Listener> listeners(listener_count);
+    u64 fires = CALLS_PER_RUN / listener_count;
+    EventData data = {};
+    data.u16[0] = 1;
+
+    // Delegate through the EventHandler
+    EventHandler* handler = EventHandler::get_reference();
+    std::vector<ListenerHandle> handles(listener_count);
+    u64 register_ns = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        for (ListenerHandle handle : handles) {
+            handler->unregister_event(handle);
+        }
+        u64 ns = bench_best_ns(1, [&] {
+            for (usize i = 0; i < listener_count; i++) {
+                handles[i] = handler->register_event(EventCode::KEY_PRESSED, &listeners[i], event_callback::bind<&Listener::on_key>(&listeners[i]));
+            }
+        });
+        register_ns = ns < register_ns ? ns : register_ns;
+    }
+    u64 fire_ns = bench_best_ns(RUNS, [&] {
+        for (u64 i = 0; i < fires; i++) {
+            handler->fire_event(EventCode::KEY_PRESSED, nullptr, data);
+        }
+    });
+    for (ListenerHandle handle : handles) {
+        handler->unregister_event(handle);
+    }
+
+    // std::function baseline, bound the way callers bound member functions
+    FunctionDispatch baseline;
+    u64 baseline_register_ns = bench_best_ns(RUNS, [&] {
+        baseline.listeners.clear();
+        baseline.listeners.shrink_to_fit();
+        for (usize i = 0; i < listener_count; i++) {
+            Listener* listener = &listeners[i];
+            baseline.listeners.push_back({ listener, [listener](EventCode code, void* sender, void* context, EventData event) {
+                return listener->on_key(code, sender, context, event);
+            } });
+        }
+    });
+    u64 baseline_fire_ns = bench_best_ns(RUNS, [&] {
+        for (u64 i = 0; i < fires; i++) {
+            baseline.fire(EventCode::KEY_PRESSED, nullptr, data);
+        }
+    });
+
+    u64 calls = fires * listener_count;
+    std::printf(
+        "%9zu  %12.2f %12.2f  %12.2f %12.2f\n",
+        listener_count,
+        static_cast<double>(register_ns) / static_cast<double>(listener_count),
+        static_cast<double>(baseline_register_ns) / static_cast<double>(listener_count),
+        static_cast<double>(fire_ns) / static_cast<double>(calls),
+        static_cast<double>(baseline_fire_ns) / static_cast<double>(calls)
+    );
+
+    u64 total = 0;
+    for (const Listener& listener : listeners) {
+        total += listener.count;
+    }
+    bench_keep(total);
+}
+
+int main() {
+#ifdef BIFROST_PROFILE
+    std::printf("Event dispatch, ns per listener, best of %u runs. fire_event includes its PROFILE_SCOPE.\n", RUNS);
+#else
+    std::printf("Event dispatch, ns per listener, best of %u runs\n", RUNS);
+#endif
+    std::printf("%9s  %12s %12s  %12s %12s\n", "listeners", "register", "std::func", "fire", "std::func");
+    run(1);
+    run(100);
+    run(10000);
+    return EXIT_SUCCESS;
+}
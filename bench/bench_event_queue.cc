@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#include <core/events.h>
+
+#include <vector>
+
+using namespace bifrost::core;
+
+constexpr usize EVENTS_PER_FRAME = 100000;
+constexpr u32 FRAMES = 20;
+
+// Codes the frame's events cycle through, MOUSE_MOVED being coalesced
+static const EventCode g_codes[] = {
+    EventCode::KEY_PRESSED,
+    EventCode::MOUSE_MOVED,
+    EventCode::KEY_RELEASED,
+    EventCode::MOUSE_MOVED,
+    EventCode::BUTTON_PRESSED,
+    EventCode::MOUSE_MOVED,
+    EventCode::BUTTON_RELEASED,
+    EventCode::MOUSE_WHEEL
+};
+constexpr usize CODE_COUNT = sizeof(g_codes) / sizeof(g_codes[0]);
+
+// A few listeners on every code, as input, UI and gameplay would register
+constexpr usize LISTENERS_PER_CODE = 4;
+
+struct Listener {
+    u64 count = 0;
+
+    bool on_event(EventCode code, void* sender, void* listener, EventData data) {
+        (void)code;
+        (void)sender;
+        (void)listener;
+        count += data.u32[0] & 1;
+        return false;
+    }
+};
+
+int main() {
+    EventHandler* handler = EventHandler::get_reference();
+
+    std::vector<Listener> listeners(CODE_COUNT * LISTENERS_PER_CODE);
+    std::vector<ListenerHandle> handles;
+    for (usize i = 0; i < listeners.size(); i++) {
+        handles.push_back(handler->register_event(g_codes[i % CODE_COUNT], &listeners[i], event_callback::bind<&Listener::on_event>(&listeners[i])));
+    }
+
+    std::vector<QueuedEvent> frame(EVENTS_PER_FRAME);
+    for (usize i = 0; i < EVENTS_PER_FRAME; i++) {
+        frame[i].code = g_codes[i % CODE_COUNT];
+        frame[i].sender = nullptr;
+        frame[i].data = {};
+        frame[i].data.u32[0] = static_cast<u32>(i);
+    }
+
+    // Every event fired as it arrives
+    u64 immediate_ns = bench_best_ns(FRAMES, [&] {
+        for (const QueuedEvent& event : frame) {
+            handler->fire_event(event.code, event.sender, event.data);
+        }
+    });
+
+    // Queued as they arrive, then flushed once
+    u64 queue_ns = ~0ull;
+    u64 flush_ns = ~0ull;
+    for (u32 run = 0; run < FRAMES; run++) {
+        u64 queued = bench_best_ns(1, [&] {
+            for (const QueuedEvent& event : frame) {
+                handler->queue_event(event.code, event.sender, event.data);
+            }
+        });
+        u64 flushed = bench_best_ns(1, [&] { handler->flush(); });
+        queue_ns = queued < queue_ns ? queued : queue_ns;
+        flush_ns = flushed < flush_ns ? flushed : flush_ns;
+    }
+
+    // Same again with MOUSE_MOVED dispatched one by one
+    handler->set_coalesce(EventCode::MOUSE_MOVED, EventCoalesce::NONE);
+    u64 uncoalesced_ns = bench_best_ns(FRAMES, [&] {
+        for (const QueuedEvent& event : frame) {
+            handler->queue_event(event.code, event.sender, event.data);
+        }
+        handler->flush();
+    });
+    handler->set_coalesce(EventCode::MOUSE_MOVED, EventCoalesce::LAST);
+
+    u64 total = 0;
+    for (const Listener& listener : listeners) {
+        total += listener.count;
+    }
+    bench_keep(total);
+
+    std::printf(
+        "%zu events per frame over %zu codes, %zu listeners each, best of %u frames\n",
+        EVENTS_PER_FRAME, CODE_COUNT, LISTENERS_PER_CODE, FRAMES
+    );
+    std::printf("%-32s %10s %12s\n", "", "ms/frame", "ns/event");
+    auto report = [](const char* name, u64 ns) {
+        std::printf("%-32s %10.3f %12.2f\n", name, static_cast<double>(ns) / 1e6, static_cast<double>(ns) / EVENTS_PER_FRAME);
+    };
+    report("fire_event each", immediate_ns);
+    report("queue_event", queue_ns);
+    report("flush, MOUSE_MOVED coalesced", flush_ns);
+    report("queue + flush", queue_ns + flush_ns);
+    report("queue + flush, no coalescing", uncoalesced_ns);
+
+    for (ListenerHandle handle : handles) {
+        handler->unregister_event(handle);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "bench_heap.h"
+
+#include <core/application.h>
+#include <core/ecs.h>
+#include <core/events.h>
+#include <core/key.h>
+
+#include <vector>
+
+using namespace bifrost::core;
+
+// Frames before this one warm up: containers reach their steady size
+constexpr u64 WARMUP_FRAMES = 60;
+constexpr u64 MEASURED_FRAMES = 600;
+constexpr usize ENTITY_COUNT = 10000;
+constexpr usize SCRATCH_PER_FRAME = 4096;
+
+struct Position { f32 x, y; };
+struct Velocity { f32 x, y; };
+
+// Does what a game frame does: takes input, queues events, fills frame
+// scratch memory, iterates the ECS and runs a task graph system
+class FrameApp : public Application {
+public:
+    FrameApp(const ApplicationConfig& config) : Application(config) {
+        for (usize i = 0; i < ENTITY_COUNT; i++) {
+            Entity entity = m_world.create();
+            m_world.add(entity, Position{ 0.0f, 0.0f });
+            m_world.add(entity, Velocity{ 1.0f, 1.0f });
+        }
+
+        get_window().set_event_source(window_event_source::bind<&FrameApp::next_event>(this));
+        EventHandler::get_reference()->register_event(EventCode::KEY_PRESSED, this, event_callback::bind<&FrameApp::on_event>(this));
+        EventHandler::get_reference()->register_event(EventCode::MOUSE_MOVED, this, event_callback::bind<&FrameApp::on_event>(this));
+
+        ResourceMask positions = get_task_graph().add_resource("positions");
+        get_task_graph().add_system("move", system_function::bind<&FrameApp::move>(this), 0, positions);
+    }
+
+    u64 heap_calls = 0;
+    u64 frame_ns = 0;
+    u64 event_count = 0;
+
+private:
+    World m_world;
+    Query<Position, Velocity> m_movers = m_world.query<Position, Velocity>();
+    u64 m_frame = 0;
+    u64 m_events_this_frame = 0;
+    u64 m_start_calls = 0;
+    u64 m_start_ns = 0;
+
+    // Two key presses and a few mouse moves per frame
+    bool next_event(WindowEvent& event) {
+        if (m_events_this_frame == 6) {
+            m_events_this_frame = 0;
+            return false;
+        }
+        event = {};
+        if (m_events_this_frame < 2) {
+            event.type = WindowEventType::KEY;
+            event.pressed = (m_frame + m_events_this_frame) % 2 == 0;
+            event.code = static_cast<u16>(bifrost::KEY_A);
+        } else {
+            event.type = WindowEventType::MOUSE_MOVE;
+            event.x = static_cast<i32>(m_frame + m_events_this_frame);
+            event.y = 10;
+        }
+        m_events_this_frame++;
+        return true;
+    }
+
+    bool on_event(EventCode code, void* sender, void* listener, EventData data) {
+        (void)code;
+        (void)sender;
+        (void)listener;
+        (void)data;
+        event_count++;
+        return false;
+    }
+
+    void move(u64 frame) {
+        (void)frame;
+        m_movers.each(m_world, [](Position& position, Velocity& velocity) {
+            position.x += velocity.x;
+            position.y += velocity.y;
+        });
+    }
+
+    void on_update(f64 delta_time) override {
+        (void)delta_time;
+        if (m_frame == WARMUP_FRAMES) {
+            m_start_calls = bench_heap_calls();
+            m_start_ns = platform_time_ns();
+        } else if (m_frame == WARMUP_FRAMES + MEASURED_FRAMES) {
+            heap_calls = bench_heap_calls() - m_start_calls;
+            frame_ns = (platform_time_ns() - m_start_ns) / MEASURED_FRAMES;
+            quit();
+        }
+
+        std::pmr::vector<u32> scratch(&get_frame_arena());
+        for (usize i = 0; i < SCRATCH_PER_FRAME; i++) {
+            scratch.push_back(static_cast<u32>(i));
+        }
+        bench_keep(scratch.back());
+
+        EventData data = {};
+        data.u64[0] = m_frame;
+        EventHandler::get_reference()->queue_event(EventCode::MOUSE_WHEEL, this, data);
+        m_frame++;
+    }
+};
+
+int main() {
+    ApplicationConfig config;
+    config.backend = WindowBackend::HEADLESS;
+    config.target_frame_time = 0.0;
+    config.worker_count = 2;
+
+    FrameApp app(config);
+    app.run();
+
+    BENCH_CHECK(app.event_count > 0);
+    std::printf("%llu frames after %llu warmup frames, %.1f us per frame\n",
+        static_cast<unsigned long long>(MEASURED_FRAMES), static_cast<unsigned long long>(WARMUP_FRAMES),
+        static_cast<double>(app.frame_ns) / 1e3);
+    std::printf("heap calls: %llu total, %.2f per frame\n",
+        static_cast<unsigned long long>(app.heap_calls), static_cast<double>(app.heap_calls) / MEASURED_FRAMES);
+
+    return app.heap_calls == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
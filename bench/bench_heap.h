@@ -0,0 +1,56 @@
+/// BIFROST GAME ENGINE
+/// Replaces the global operator new and delete with versions that count
+/// every call. The engine library's allocations resolve to them too, so
+/// a benchmark sees the heap calls of the whole process. Include it from
+/// a single file of the benchmark.
+
+#pragma once
+#include <core/types.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace bifrost::core::types;
+
+// Calls to operator new and to operator delete with a pointer
+inline std::atomic<u64> g_bench_heap_calls{ 0 };
+
+inline u64 bench_heap_calls() {
+    return g_bench_heap_calls.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    g_bench_heap_calls.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size > 0 ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    g_bench_heap_calls.fetch_add(1, std::memory_order_relaxed);
+    usize align = static_cast<usize>(alignment);
+    if (void* pointer = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void* pointer) noexcept {
+    if (pointer != nullptr) {
+        g_bench_heap_calls.fetch_add(1, std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+void operator delete(void* pointer, std::size_t) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { operator delete(pointer); }
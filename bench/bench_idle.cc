@@ -0,0 +1,109 @@
+#include "bench.h"
+
+#include <core/application.h>
+#include <core/defines.h>
+#include <core/window.h>
+
+#ifdef Q_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif // Q_PLATFORM_WINDOWS
+
+using namespace bifrost::core;
+
+constexpr f64 DEFAULT_IDLE_SECONDS = 5.0;
+
+// CPU time of every thread of the process so far, user and kernel
+static u64 process_cpu_ns() {
+#ifdef Q_PLATFORM_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto to_ns = [](const FILETIME& time) {
+        return ((static_cast<u64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+    };
+    return to_ns(kernel) + to_ns(user);
+#else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    auto to_ns = [](const timeval& time) {
+        return static_cast<u64>(time.tv_sec) * 1000000000ull + static_cast<u64>(time.tv_usec) * 1000ull;
+    };
+    return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+#endif // Q_PLATFORM_WINDOWS
+}
+
+static const char* backend_name(WindowBackend backend) {
+    return backend == WindowBackend::HEADLESS ? "headless" : "platform";
+}
+
+static void report(const char* name, WindowBackend backend, u64 wall_ns, u64 cpu_ns) {
+    std::printf(
+        "%-22s %-10s %8.2f %8.3f %7.1f%%\n",
+        name, backend_name(backend),
+        static_cast<f64>(wall_ns) / 1e9,
+        static_cast<f64>(cpu_ns) / 1e9,
+        static_cast<f64>(cpu_ns) / static_cast<f64>(wall_ns) * 100.0
+    );
+}
+
+// Does nothing but keep the loop running at 60 frames a second, as an
+// editor with nothing to do
+class IdleApp : public Application {
+public:
+    IdleApp(const ApplicationConfig& config, u64 duration_ns)
+        : Application(config)
+        , m_duration_ns(duration_ns)
+        , m_start_ns(platform_time_ns())
+    {}
+
+private:
+    u64 m_duration_ns;
+    u64 m_start_ns;
+
+    void on_update(f64 delta_time) override {
+        (void)delta_time;
+        if (platform_time_ns() - m_start_ns >= m_duration_ns) {
+            quit();
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    f64 seconds = argc > 1 ? std::atof(argv[1]) : DEFAULT_IDLE_SECONDS;
+    if (seconds <= 0.0) {
+        seconds = DEFAULT_IDLE_SECONDS;
+    }
+    u64 duration_ns = static_cast<u64>(seconds * 1e9);
+
+    std::printf("Idle for %.1fs each, CPU time from every thread of the process\n", seconds);
+    std::printf("%-22s %-10s %8s %8s %8s\n", "", "backend", "wall s", "cpu s", "cpu");
+
+    // The loop the editor had: pump the window as fast as it goes
+    {
+        Window window(640, 480, "Idle benchmark", WindowBackend::AUTO);
+        window.show();
+        u64 cpu_start = process_cpu_ns();
+        u64 start = platform_time_ns();
+        while (platform_time_ns() - start < duration_ns && !window.should_close()) {
+        }
+        u64 wall_ns = platform_time_ns() - start;
+        report("spinning pump", window.get_backend(), wall_ns, process_cpu_ns() - cpu_start);
+        window.shutdown();
+    }
+
+    // The application loop, which waits on the window between frames
+    {
+        ApplicationConfig config;
+        config.title = "Idle benchmark";
+        IdleApp app(config, duration_ns);
+        WindowBackend backend = app.get_window().get_backend();
+        u64 cpu_start = process_cpu_ns();
+        u64 start = platform_time_ns();
+        app.run();
+        u64 wall_ns = platform_time_ns() - start;
+        report("application at 60Hz", backend, wall_ns, process_cpu_ns() - cpu_start);
+    }
+
+    return EXIT_SUCCESS;
+}
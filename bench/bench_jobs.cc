@@ -0,0 +1,89 @@
+#include "bench.h"
+
+#include <core/jobs.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace bifrost::core;
+
+constexpr usize FOR_ITEMS = 10000000;
+constexpr usize FOR_BATCH = 16384;
+
+// Layers of jobs that each wait for the one before, as a frame of
+// dependent systems would
+constexpr u32 GRAPH_LAYERS = 1000;
+constexpr u32 GRAPH_WIDTH = 64;
+
+constexpr u32 RUNS = 5;
+
+static std::vector<f32> g_items(FOR_ITEMS, 1.0f);
+static std::atomic<u64> g_graph_work = 0;
+
+static void graph_job() {
+    // A few hundred nanoseconds of work, small enough that scheduling shows
+    u64 value = 0;
+    for (u32 i = 0; i < 256; i++) {
+        value = value * 6364136223846793005ull + i;
+    }
+    g_graph_work.fetch_add(value & 1, std::memory_order_relaxed);
+}
+
+static void run(u32 threads) {
+    JobSystem* jobs = JobSystem::get_reference();
+    // One thread means no workers: jobs then run on the caller as they are submitted
+    if (threads > 1) {
+        jobs->init(threads - 1);
+    }
+
+    u64 for_ns = bench_best_ns(RUNS, [&] {
+        jobs->parallel_for(FOR_ITEMS, FOR_BATCH, [](usize begin, usize end) {
+            f32* items = g_items.data();
+            for (usize i = begin; i < end; i++) {
+                items[i] = std::sqrt(items[i] + 1.0f);
+            }
+        });
+    });
+
+    u64 graph_ns = bench_best_ns(RUNS, [&] {
+        for (u32 layer = 0; layer < GRAPH_LAYERS; layer++) {
+            JobCounter counter;
+            for (u32 i = 0; i < GRAPH_WIDTH; i++) {
+                jobs->submit(&graph_job, &counter);
+            }
+            jobs->wait(counter);
+        }
+    });
+
+    jobs->shutdown();
+
+    std::printf(
+        "%7u %12.2f %12.1f %14.2f\n",
+        threads,
+        static_cast<double>(for_ns) / 1e6,
+        bench_rate(FOR_ITEMS, for_ns),
+        bench_rate(static_cast<u64>(GRAPH_LAYERS) * GRAPH_WIDTH, graph_ns)
+    );
+}
+
+int main(int argc, char** argv) {
+    // Threads to go up to, every core by default
+    u32 max_threads = argc > 1 ? static_cast<u32>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+    max_threads = max_threads > 0 ? max_threads : 1;
+
+    std::printf(
+        "parallel_for over %zu items, %u layers of %u dependent jobs, best of %u runs\n",
+        FOR_ITEMS, GRAPH_LAYERS, GRAPH_WIDTH, RUNS
+    );
+    std::printf("%7s %12s %12s %14s\n", "threads", "for ms", "for M/s", "graph M jobs/s");
+    for (u32 threads = 1; threads <= max_threads; threads++) {
+        run(threads);
+    }
+
+    bench_keep(g_items[0]);
+    bench_keep(g_graph_work);
+    return EXIT_SUCCESS;
+}
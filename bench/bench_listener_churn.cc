@@ -0,0 +1,78 @@
+#include "bench.h"
+
+#include <core/events.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace bifrost::core;
+
+// Listeners registered and then unregistered per cycle, as a level load
+// and unload would churn them
+constexpr usize LISTENER_COUNT = 50000;
+constexpr u32 RUNS = 5;
+
+static bool on_event(EventCode code, void* sender, void* listener, EventData data) {
+    (void)code;
+    (void)sender;
+    (void)listener;
+    (void)data;
+    return false;
+}
+
+int main() {
+    EventHandler* handler = EventHandler::get_reference();
+    std::vector<u32> listeners(LISTENER_COUNT);
+    std::vector<ListenerHandle> handles(LISTENER_COUNT);
+
+    // Unregistered in a shuffled order, so removal is not always of the last listener
+    std::vector<usize> order(LISTENER_COUNT);
+    for (usize i = 0; i < LISTENER_COUNT; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    u64 register_ns = ~0ull;
+    u64 unregister_ns = ~0ull;
+    u64 by_pointer_ns = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        u64 ns = bench_best_ns(1, [&] {
+            for (usize i = 0; i < LISTENER_COUNT; i++) {
+                handles[i] = handler->register_event(EventCode::KEY_PRESSED, &listeners[i], &on_event);
+            }
+        });
+        register_ns = std::min(register_ns, ns);
+
+        ns = bench_best_ns(1, [&] {
+            for (usize i : order) {
+                BENCH_CHECK(handler->unregister_event(handles[i]));
+            }
+        });
+        unregister_ns = std::min(unregister_ns, ns);
+    }
+
+    // The older overload that searches the code's listeners for the pointer
+    for (u32 run = 0; run < 2; run++) {
+        for (usize i = 0; i < LISTENER_COUNT; i++) {
+            handler->register_event(EventCode::KEY_PRESSED, &listeners[i], &on_event);
+        }
+        u64 ns = bench_best_ns(1, [&] {
+            for (usize i : order) {
+                BENCH_CHECK(handler->unregister_event(EventCode::KEY_PRESSED, &listeners[i]));
+            }
+        });
+        by_pointer_ns = std::min(by_pointer_ns, ns);
+    }
+
+    std::printf("%zu listeners, shuffled unregister order\n", LISTENER_COUNT);
+    std::printf("%-28s %10s %10s\n", "", "ms total", "ns each");
+    auto report = [](const char* name, u64 ns) {
+        std::printf("%-28s %10.3f %10.2f\n", name, static_cast<double>(ns) / 1e6, static_cast<double>(ns) / LISTENER_COUNT);
+    };
+    report("register", register_ns);
+    report("unregister by handle", unregister_ns);
+    report("register + unregister", register_ns + unregister_ns);
+    report("unregister by pointer", by_pointer_ns);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "bench.h"
+
+#include <core/defines.h>
+#include <core/log.h>
+
+#include <qlogger/qlogger.h>
+
+#include <fcntl.h>
+#ifdef Q_PLATFORM_WINDOWS
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define open _open
+#define close _close
+#define O_WRONLY _O_WRONLY
+#define STDOUT_FILENO 1
+#define NULL_DEVICE "NUL"
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif // Q_PLATFORM_WINDOWS
+
+using namespace bifrost::core;
+
+// Calls per timed batch. The messages of a batch fit in the thread's log
+// buffer, so none are dropped, which would make them look cheaper.
+constexpr u32 BATCH = 1000;
+constexpr u32 RUNS = 200;
+
+// Messages go to the console; send them to the null device while timing,
+// so the numbers are not those of the terminal
+struct QuietStdout {
+    int saved = -1;
+
+    QuietStdout() {
+        std::fflush(stdout);
+        saved = dup(STDOUT_FILENO);
+        int null = open(NULL_DEVICE, O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+
+    ~QuietStdout() {
+        std::fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+};
+
+// Time a batch of calls on the calling thread, printing what it logged
+// between batches so every batch starts with an empty buffer
+template<typename F>
+static u64 time_calls(F&& body) {
+    u64 best = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        log_flush();
+        u64 ns = bench_best_ns(1, [&] {
+            for (u32 i = 0; i < BATCH; i++) {
+                body(i);
+            }
+        });
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+static void report(const char* name, u64 ns) {
+    std::printf("%-36s %8.1f ns/call\n", name, static_cast<double>(ns) / BATCH);
+}
+
+int main() {
+    const char* key_name = "KEY_SPACE";
+    f64 now = 12.5;
+
+    u64 async_ns, async_string_ns, discarded_ns, direct_ns;
+    {
+        QuietStdout quiet;
+
+        // Start the writer and claim this thread's buffer before timing
+        Q_LOG_INFO("warming up");
+        log_flush();
+
+        async_ns = time_calls([&](u32 i) { Q_LOG_INFO("key %u pressed at %.3f", i, now); });
+        async_string_ns = time_calls([&](u32 i) { Q_LOG_INFO("key %s (%u) pressed at %.3f", key_name, i, now); });
+        discarded_ns = time_calls([&](u32 i) { Q_LOG_TRACE("key %u pressed at %.3f", i, now); });
+
+        // What InputHandler and Window did before: format and print on the
+        // calling thread through their own qlogger
+        qlogger::Logger logger;
+        direct_ns = time_calls([&](u32 i) { logger.info("key %u pressed at %.3f", i, now); });
+    }
+
+    std::printf("BIFROST_LOG_LEVEL %d, batches of %u calls, best of %u\n", BIFROST_LOG_LEVEL, BATCH, RUNS);
+    report("Q_LOG_INFO, number args", async_ns);
+    report("Q_LOG_INFO, string arg", async_string_ns);
+    report("Q_LOG_TRACE, compiled out", discarded_ns);
+    report("qlogger info, synchronous", direct_ns);
+
+    return EXIT_SUCCESS;
+}
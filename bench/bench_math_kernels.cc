@@ -0,0 +1,141 @@
+#include "bench.h"
+
+#include <math/kernels.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace bifrost::math;
+
+// Items per call, enough to leave the caches for the larger kernels
+constexpr usize ITEM_COUNT = 100000;
+constexpr u32 RUNS = 50;
+
+static u32 g_random = 2463534242u;
+
+static f32 random_range(f32 low, f32 high) {
+    g_random ^= g_random << 13;
+    g_random ^= g_random >> 17;
+    g_random ^= g_random << 5;
+    return low + (high - low) * static_cast<f32>(g_random >> 8) / static_cast<f32>(1u << 24);
+}
+
+static vec3 random_vec3(f32 range) {
+    return vec3(random_range(-range, range), random_range(-range, range), random_range(-range, range));
+}
+
+static mat4 random_transform() {
+    quat rotation = quat::from_axis_angle(normalize(random_vec3(1.0f) + vec3(0.01f)), random_range(0.0f, 6.28f));
+    return mat4::trs(random_vec3(100.0f), rotation, vec3(random_range(0.5f, 2.0f)));
+}
+
+static bool nearly_equal(f32 a, f32 b) {
+    return std::fabs(a - b) <= 1e-4f * std::fmax(1.0f, std::fabs(b));
+}
+
+// Whether every float of two arrays matches, relative to its size
+static bool all_nearly_equal(const f32* a, const f32* b, usize count) {
+    for (usize i = 0; i < count; i++) {
+        if (!nearly_equal(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void report(const char* kernel, u64 scalar_ns, u64 simd_ns) {
+    std::printf(
+        "%-18s %10.1f %10.1f %8.2fx\n",
+        kernel,
+        bench_rate(ITEM_COUNT, scalar_ns),
+        bench_rate(ITEM_COUNT, simd_ns),
+        simd_ns > 0 ? static_cast<double>(scalar_ns) / static_cast<double>(simd_ns) : 0.0
+    );
+}
+
+int main() {
+    std::printf("Batch kernels built for %s, %zu items per call, best of %u runs\n", simd_isa_name(), ITEM_COUNT, RUNS);
+    std::printf("%-18s %10s %10s %9s\n", "kernel", "scalar M/s", "simd M/s", "speedup");
+
+    mat4 m = random_transform();
+
+    {
+        std::vector<vec3> in(ITEM_COUNT), out(ITEM_COUNT), expected(ITEM_COUNT);
+        for (vec3& p : in) {
+            p = random_vec3(1000.0f);
+        }
+        u64 scalar = bench_best_ns(RUNS, [&] { transform_points_scalar(m, in.data(), expected.data(), ITEM_COUNT); bench_keep(expected); });
+        u64 simd = bench_best_ns(RUNS, [&] { transform_points(m, in.data(), out.data(), ITEM_COUNT); bench_keep(out); });
+        BENCH_CHECK(all_nearly_equal(&out[0].x, &expected[0].x, ITEM_COUNT * 4));
+        report("transform_points", scalar, simd);
+    }
+
+    {
+        std::vector<vec4> in(ITEM_COUNT), out(ITEM_COUNT), expected(ITEM_COUNT);
+        for (vec4& v : in) {
+            v = vec4(random_vec3(1000.0f), random_range(0.0f, 1.0f));
+        }
+        u64 scalar = bench_best_ns(RUNS, [&] { transform_vectors_scalar(m, in.data(), expected.data(), ITEM_COUNT); bench_keep(expected); });
+        u64 simd = bench_best_ns(RUNS, [&] { transform_vectors(m, in.data(), out.data(), ITEM_COUNT); bench_keep(out); });
+        BENCH_CHECK(all_nearly_equal(&out[0].x, &expected[0].x, ITEM_COUNT * 4));
+        report("transform_vectors", scalar, simd);
+    }
+
+    {
+        std::vector<mat4> a(ITEM_COUNT), b(ITEM_COUNT), out(ITEM_COUNT), expected(ITEM_COUNT);
+        for (usize i = 0; i < ITEM_COUNT; i++) {
+            a[i] = random_transform();
+            b[i] = random_transform();
+        }
+        u64 scalar = bench_best_ns(RUNS, [&] { multiply_matrices_scalar(a.data(), b.data(), expected.data(), ITEM_COUNT); bench_keep(expected); });
+        u64 simd = bench_best_ns(RUNS, [&] { multiply_matrices(a.data(), b.data(), out.data(), ITEM_COUNT); bench_keep(out); });
+        BENCH_CHECK(all_nearly_equal(&out[0][0].x, &expected[0][0].x, ITEM_COUNT * 16));
+        report("multiply_matrices", scalar, simd);
+    }
+
+    {
+        std::vector<aabb> in(ITEM_COUNT), out(ITEM_COUNT), expected(ITEM_COUNT);
+        for (aabb& box : in) {
+            box = aabb::from_center_extents(random_vec3(1000.0f), abs(random_vec3(10.0f)));
+        }
+        u64 scalar = bench_best_ns(RUNS, [&] { transform_aabbs_scalar(m, in.data(), expected.data(), ITEM_COUNT); bench_keep(expected); });
+        u64 simd = bench_best_ns(RUNS, [&] { transform_aabbs(m, in.data(), out.data(), ITEM_COUNT); bench_keep(out); });
+        BENCH_CHECK(all_nearly_equal(&out[0].min.x, &expected[0].min.x, ITEM_COUNT * 8));
+        report("transform_aabbs", scalar, simd);
+    }
+
+    mat4 projection = mat4::perspective(1.2f, 16.0f / 9.0f, 0.1f, 500.0f);
+    mat4 view = mat4::look_at(vec3(0.0f, 20.0f, 50.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+    frustum camera = frustum::from_matrix(projection * view);
+
+    {
+        std::vector<f32> x(ITEM_COUNT), y(ITEM_COUNT), z(ITEM_COUNT), radius(ITEM_COUNT);
+        for (usize i = 0; i < ITEM_COUNT; i++) {
+            x[i] = random_range(-300.0f, 300.0f);
+            y[i] = random_range(-300.0f, 300.0f);
+            z[i] = random_range(-300.0f, 300.0f);
+            radius[i] = random_range(0.1f, 5.0f);
+        }
+        std::vector<u8> visible(ITEM_COUNT), expected(ITEM_COUNT);
+        usize found = 0, expected_found = 0;
+        u64 scalar = bench_best_ns(RUNS, [&] { expected_found = cull_spheres_scalar(camera, x.data(), y.data(), z.data(), radius.data(), expected.data(), ITEM_COUNT); });
+        u64 simd = bench_best_ns(RUNS, [&] { found = cull_spheres(camera, x.data(), y.data(), z.data(), radius.data(), visible.data(), ITEM_COUNT); });
+        BENCH_CHECK(found == expected_found && visible == expected);
+        report("cull_spheres", scalar, simd);
+    }
+
+    {
+        std::vector<aabb> boxes(ITEM_COUNT);
+        for (aabb& box : boxes) {
+            box = aabb::from_center_extents(random_vec3(300.0f), abs(random_vec3(5.0f)));
+        }
+        std::vector<u8> visible(ITEM_COUNT), expected(ITEM_COUNT);
+        usize found = 0, expected_found = 0;
+        u64 scalar = bench_best_ns(RUNS, [&] { expected_found = cull_aabbs_scalar(camera, boxes.data(), expected.data(), ITEM_COUNT); });
+        u64 simd = bench_best_ns(RUNS, [&] { found = cull_aabbs(camera, boxes.data(), visible.data(), ITEM_COUNT); });
+        BENCH_CHECK(found == expected_found && visible == expected);
+        report("cull_aabbs", scalar, simd);
+    }
+
+    return EXIT_SUCCESS;
+}
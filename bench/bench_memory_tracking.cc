@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <core/memory.h>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace bifrost::core;
+
+// Build this benchmark with BIFROST_TRACK_ALLOCATIONS on and off and
+// compare the lines: the operator new route goes through the tracking
+// hooks when they are compiled in, the malloc route never does
+
+constexpr u32 RUNS = 20;
+constexpr u32 FRAMES = 60;
+constexpr u32 ALLOCATIONS_PER_FRAME = 2048;
+constexpr usize PARTICLE_COUNT = 16384;
+
+// Same as a frame of the engine: some math over a particle array and a
+// burst of short lived allocations of mixed sizes
+struct Frame {
+    std::vector<f32> positions = std::vector<f32>(PARTICLE_COUNT, 0.0f);
+    std::vector<f32> velocities = std::vector<f32>(PARTICLE_COUNT, 1.0f);
+    std::vector<void*> blocks = std::vector<void*>(ALLOCATIONS_PER_FRAME);
+};
+
+static usize block_size(u32 index) {
+    return 16 + (index * 37) % 1009;
+}
+
+template<typename Allocate, typename Free>
+static u64 run_frames(Frame& frame, Allocate&& allocate, Free&& free) {
+    u64 start = platform_time_ns();
+    for (u32 i = 0; i < FRAMES; i++) {
+        for (usize p = 0; p < PARTICLE_COUNT; p++) {
+            frame.positions[p] += frame.velocities[p] * (1.0f / 60.0f);
+        }
+        bench_keep(frame.positions[i]);
+
+        for (u32 a = 0; a < ALLOCATIONS_PER_FRAME; a++) {
+            u8* block = static_cast<u8*>(allocate(block_size(a)));
+            block[0] = static_cast<u8>(a);
+            frame.blocks[a] = block;
+        }
+        for (u32 a = 0; a < ALLOCATIONS_PER_FRAME; a++) {
+            free(frame.blocks[a], block_size(a));
+        }
+    }
+    return platform_time_ns() - start;
+}
+
+int main() {
+#ifdef BIFROST_TRACK_ALLOCATIONS
+    std::printf("BIFROST_TRACK_ALLOCATIONS on\n");
+#else
+    std::printf("BIFROST_TRACK_ALLOCATIONS off\n");
+#endif // BIFROST_TRACK_ALLOCATIONS
+
+    // The routes take turns so both see the same state of the machine
+    Frame frame;
+    u64 new_ns = ~0ull;
+    u64 malloc_ns = ~0ull;
+    for (u32 run = 0; run < RUNS; run++) {
+        u64 elapsed = 0;
+        {
+            MemoryTagScope scope(MemoryTag::RENDER);
+            elapsed = run_frames(
+                frame,
+                [](usize bytes) { return ::operator new(bytes); },
+                [](void* block, usize bytes) { ::operator delete(block, bytes); }
+            );
+        }
+        new_ns = elapsed < new_ns ? elapsed : new_ns;
+
+        elapsed = run_frames(
+            frame,
+            [](usize bytes) { return std::malloc(bytes); },
+            [](void* block, usize bytes) { (void)bytes; std::free(block); }
+        );
+        malloc_ns = elapsed < malloc_ns ? elapsed : malloc_ns;
+    }
+
+    u64 pairs = static_cast<u64>(FRAMES) * ALLOCATIONS_PER_FRAME;
+    std::printf("%u frames of %u allocations, best of %u runs\n", FRAMES, ALLOCATIONS_PER_FRAME, RUNS);
+    std::printf("%-12s %10s %14s\n", "", "us/frame", "ns/alloc+free");
+    std::printf("%-12s %10.1f %14.1f\n", "operator new", static_cast<f64>(new_ns) / FRAMES / 1e3, static_cast<f64>(new_ns) / pairs);
+    std::printf("%-12s %10.1f %14.1f\n", "malloc", static_cast<f64>(malloc_ns) / FRAMES / 1e3, static_cast<f64>(malloc_ns) / pairs);
+    std::printf("operator new over malloc: %+.1f%% per frame\n", (static_cast<f64>(new_ns) / static_cast<f64>(malloc_ns) - 1.0) * 100.0);
+
+    return EXIT_SUCCESS;
+}
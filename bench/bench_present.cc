@@ -0,0 +1,136 @@
+#include "bench.h"
+
+#include <core/defines.h>
+#include <core/window.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace bifrost::core;
+
+#ifdef Q_PLATFORM_LINUX
+
+constexpr u32 WARMUP_FRAMES = 10;
+constexpr u32 FRAMES = 120;
+
+struct FrameSize {
+    const char* name;
+    u32 width, height;
+};
+
+static const FrameSize SIZES[] = {
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 },
+};
+
+// The same drawing for both paths, so only presenting differs
+static void draw(u32* pixels, usize count, u32 frame) {
+    std::fill(pixels, pixels + count, 0x00101010u * (frame & 0x0F));
+}
+
+static void report(const FrameSize& size, const char* path, u64 total_ns, u64 present_ns) {
+    f64 frame_bytes = static_cast<f64>(size.width) * size.height * sizeof(u32);
+    std::printf(
+        "%-6s %-14s %10.3f %13.3f %10.0f\n",
+        size.name, path,
+        static_cast<f64>(total_ns) / FRAMES / 1e6,
+        static_cast<f64>(present_ns) / FRAMES / 1e6,
+        frame_bytes * FRAMES / (static_cast<f64>(total_ns) / 1e9) / (1024.0 * 1024.0)
+    );
+}
+
+// Every frame is copied into the request stream with xcb_put_image
+static void bench_put_image(Window& window, const FrameSize& size) {
+    usize count = static_cast<usize>(size.width) * size.height;
+    std::vector<u32> pixels(count);
+
+    for (u32 frame = 0; frame < WARMUP_FRAMES; frame++) {
+        draw(pixels.data(), count, frame);
+        BENCH_CHECK(window.present(pixels.data(), size.width, size.height));
+    }
+    window.sync();
+
+    u64 present_ns = 0;
+    u64 start = platform_time_ns();
+    for (u32 frame = 0; frame < FRAMES; frame++) {
+        draw(pixels.data(), count, frame);
+        u64 present_start = platform_time_ns();
+        BENCH_CHECK(window.present(pixels.data(), size.width, size.height));
+        present_ns += platform_time_ns() - present_start;
+    }
+    window.sync();
+    u64 total_ns = platform_time_ns() - start;
+
+    report(size, "xcb_put_image", total_ns, present_ns);
+}
+
+// Frames are drawn into segments the server reads in place. Waiting for
+// the server to release a segment counts as presenting.
+static void bench_shm(Window& window, const FrameSize& size) {
+    usize count = static_cast<usize>(size.width) * size.height;
+    WindowFramebuffer framebuffer;
+
+    BENCH_CHECK(window.acquire_framebuffer(size.width, size.height, framebuffer));
+    if (!window.has_shared_framebuffers()) {
+        std::printf("%-6s %-14s not available on this server\n", size.name, "MIT-SHM");
+        return;
+    }
+
+    for (u32 frame = 0; frame < WARMUP_FRAMES; frame++) {
+        BENCH_CHECK(window.acquire_framebuffer(size.width, size.height, framebuffer));
+        draw(framebuffer.pixels, count, frame);
+        BENCH_CHECK(window.present_framebuffer());
+    }
+    window.sync();
+
+    u64 present_ns = 0;
+    u64 start = platform_time_ns();
+    for (u32 frame = 0; frame < FRAMES; frame++) {
+        u64 acquire_start = platform_time_ns();
+        BENCH_CHECK(window.acquire_framebuffer(size.width, size.height, framebuffer));
+        present_ns += platform_time_ns() - acquire_start;
+
+        draw(framebuffer.pixels, count, frame);
+
+        u64 present_start = platform_time_ns();
+        BENCH_CHECK(window.present_framebuffer());
+        present_ns += platform_time_ns() - present_start;
+    }
+    window.sync();
+    u64 total_ns = platform_time_ns() - start;
+
+    report(size, "MIT-SHM", total_ns, present_ns);
+}
+
+int main() {
+    for (const FrameSize& size : SIZES) {
+        Window window(size.width, size.height, "Present benchmark", WindowBackend::AUTO);
+        if (window.get_backend() == WindowBackend::HEADLESS) {
+            window.shutdown();
+            std::printf("No X server to present to, set DISPLAY to run this benchmark\n");
+            return EXIT_SUCCESS;
+        }
+
+        if (&size == &SIZES[0]) {
+            std::printf("%u frames, drawn then presented, synced with the server at the end\n", FRAMES);
+            std::printf("%-6s %-14s %10s %13s %10s\n", "", "", "ms/frame", "ms presenting", "MB/s");
+        }
+        window.show();
+        window.pump_messages();
+
+        bench_put_image(window, size);
+        bench_shm(window, size);
+        window.shutdown();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int main() {
+    std::printf("MIT-SHM and xcb_put_image are X11 paths, so this benchmark only runs on Linux\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // Q_PLATFORM_LINUX
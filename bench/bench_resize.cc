@@ -0,0 +1,142 @@
+#include "bench.h"
+#include "bench_heap.h"
+
+#include <core/events.h>
+#include <core/input.h>
+#include <core/memory.h>
+#include <core/window.h>
+#include <render/rasterizer.h>
+
+#include <vector>
+
+using namespace bifrost;
+using namespace bifrost::core;
+
+// A drag from 800x600 to 1920x1080, with the size reported 20 times
+// between two frames as a window manager does while an edge is dragged
+constexpr u32 START_WIDTH = 800;
+constexpr u32 START_HEIGHT = 600;
+constexpr u32 END_WIDTH = 1920;
+constexpr u32 END_HEIGHT = 1080;
+constexpr u32 DRAG_FRAMES = 120;
+constexpr u32 EVENTS_PER_FRAME = 20;
+
+struct ResizeListener {
+    u64 count = 0;
+
+    bool on_resized(EventCode code, void* sender, void* listener, EventData data) {
+        (void)code;
+        (void)sender;
+        (void)listener;
+        (void)data;
+        count++;
+        return false;
+    }
+};
+
+// Render targets sized exactly to the window, as before size classes:
+// the same buffers as the rasterizer and the framebuffer, each resized
+// to the new size
+struct ExactTargets {
+    std::vector<u32> color;
+    std::vector<f32> depth;
+    std::vector<f32> block_depth;
+    std::vector<render::RasterStats> tile_stats;
+    std::vector<u32> framebuffer;
+
+    void resize(u32 width, u32 height) {
+        usize pixels = static_cast<usize>(width) * height;
+        usize blocks = static_cast<usize>((width + render::RASTER_BLOCK_SIZE - 1) / render::RASTER_BLOCK_SIZE)
+            * ((height + render::RASTER_BLOCK_SIZE - 1) / render::RASTER_BLOCK_SIZE);
+        usize tiles = static_cast<usize>((width + render::RASTER_TILE_SIZE - 1) / render::RASTER_TILE_SIZE)
+            * ((height + render::RASTER_TILE_SIZE - 1) / render::RASTER_TILE_SIZE);
+        color.assign(pixels, 0);
+        depth.assign(pixels, 1.0f);
+        block_depth.assign(blocks, 1.0f);
+        tile_stats.resize(tiles);
+        framebuffer.resize(pixels);
+    }
+};
+
+// Size reported by the event-th resize of the drag
+static void drag_size(u32 event, u32& width, u32& height) {
+    u32 total = DRAG_FRAMES * EVENTS_PER_FRAME;
+    width = START_WIDTH + static_cast<u32>(static_cast<u64>(END_WIDTH - START_WIDTH) * (event + 1) / total);
+    height = START_HEIGHT + static_cast<u32>(static_cast<u64>(END_HEIGHT - START_HEIGHT) * (event + 1) / total);
+}
+
+int main() {
+    Window window(START_WIDTH, START_HEIGHT, "Resize benchmark", WindowBackend::HEADLESS);
+    window.show();
+    EventHandler* events = EventHandler::get_reference();
+    InputHandler::get_reference();
+
+    ResizeListener listener;
+    events->register_event(EventCode::RESIZED, &listener, event_callback::bind<&ResizeListener::on_resized>(&listener));
+
+    render::Rasterizer rasterizer(START_WIDTH, START_HEIGHT);
+    WindowFramebuffer framebuffer;
+    BENCH_CHECK(window.acquire_framebuffer(START_WIDTH, START_HEIGHT, framebuffer));
+    window.present_framebuffer();
+    events->flush();
+
+    // Engine: resizes are coalesced per pump and targets sized by class
+    MemoryTagStats render_start = get_memory_stats(MemoryTag::RENDER);
+    u64 heap_start = bench_heap_calls();
+    u32 event_index = 0;
+    for (u32 frame = 0; frame < DRAG_FRAMES; frame++) {
+        for (u32 i = 0; i < EVENTS_PER_FRAME; i++) {
+            WindowEvent event = {};
+            event.type = WindowEventType::RESIZE;
+            drag_size(event_index++, reinterpret_cast<u32&>(event.x), reinterpret_cast<u32&>(event.y));
+            window.inject_event(event);
+        }
+        window.pump_messages();
+        events->flush();
+
+        rasterizer.resize(window.get_width(), window.get_height());
+        BENCH_CHECK(window.acquire_framebuffer(window.get_width(), window.get_height(), framebuffer));
+        window.present_framebuffer();
+    }
+    u64 engine_heap = bench_heap_calls() - heap_start;
+    MemoryTagStats render_end = get_memory_stats(MemoryTag::RENDER);
+
+    BENCH_CHECK(window.get_width() == END_WIDTH && window.get_height() == END_HEIGHT);
+    BENCH_CHECK(listener.count == DRAG_FRAMES);
+
+    // Baseline: every reported size resizes the targets
+    ExactTargets exact;
+    exact.resize(START_WIDTH, START_HEIGHT);
+    heap_start = bench_heap_calls();
+    for (u32 event = 0; event < DRAG_FRAMES * EVENTS_PER_FRAME; event++) {
+        u32 width, height;
+        drag_size(event, width, height);
+        exact.resize(width, height);
+    }
+    u64 exact_heap = bench_heap_calls() - heap_start;
+
+    // Baseline: coalesced to one resize per frame, sized exactly
+    ExactTargets coalesced;
+    coalesced.resize(START_WIDTH, START_HEIGHT);
+    heap_start = bench_heap_calls();
+    for (u32 frame = 0; frame < DRAG_FRAMES; frame++) {
+        u32 width, height;
+        drag_size((frame + 1) * EVENTS_PER_FRAME - 1, width, height);
+        coalesced.resize(width, height);
+    }
+    u64 coalesced_heap = bench_heap_calls() - heap_start;
+
+    std::printf("Drag %ux%u -> %ux%u, %u frames of %u resize events\n",
+        START_WIDTH, START_HEIGHT, END_WIDTH, END_HEIGHT, DRAG_FRAMES, EVENTS_PER_FRAME);
+    std::printf("%-34s %10s\n", "", "heap calls");
+    std::printf("%-34s %10llu  (%llu RESIZED, %llu RENDER allocations, peak %.1f MB)\n", "engine",
+        static_cast<unsigned long long>(engine_heap),
+        static_cast<unsigned long long>(listener.count),
+        static_cast<unsigned long long>(render_end.allocations - render_start.allocations),
+        static_cast<double>(render_end.peak_bytes) / (1024.0 * 1024.0));
+    std::printf("%-34s %10llu\n", "exact size, every event", static_cast<unsigned long long>(exact_heap));
+    std::printf("%-34s %10llu\n", "exact size, once per frame", static_cast<unsigned long long>(coalesced_heap));
+
+    window.shutdown();
+    return EXIT_SUCCESS;
+}
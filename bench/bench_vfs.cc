@@ -0,0 +1,145 @@
+#include "bench.h"
+
+#include <core/defines.h>
+#include <core/vfs.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef Q_PLATFORM_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif // Q_PLATFORM_LINUX
+
+using namespace bifrost::core;
+
+// Small assets, such as materials, scripts and little textures
+constexpr u32 FILE_COUNT = 10000;
+constexpr u32 FILES_PER_DIRECTORY = 100;
+constexpr usize MIN_FILE_SIZE = 256;
+constexpr usize MAX_FILE_SIZE = 4096;
+constexpr u32 WARM_RUNS = 5;
+
+namespace fs = std::filesystem;
+
+// Sum of every byte, so each load really reads the contents
+static u64 checksum(const u8* data, usize size) {
+    u64 sum = 0;
+    for (usize i = 0; i < size; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Drop a file's pages from the page cache, so the next read goes to the
+// disk. Returns false where that is not possible.
+static bool evict(const fs::path& path) {
+#ifdef Q_PLATFORM_LINUX
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    fdatasync(file);
+    bool evicted = posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(file);
+    return evicted;
+#else
+    (void)path;
+    return false;
+#endif // Q_PLATFORM_LINUX
+}
+
+int main(int argc, char** argv) {
+    fs::path root = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path() / "bifrost_bench_vfs";
+    fs::path loose = root / "loose";
+    fs::path pak = root / "assets.pak";
+    fs::remove_all(root);
+    fs::create_directories(loose);
+
+    std::vector<std::string> paths(FILE_COUNT);
+    std::vector<u8> contents(MAX_FILE_SIZE);
+    u64 expected = 0;
+    for (u32 i = 0; i < FILE_COUNT; i++) {
+        paths[i] = "dir" + std::to_string(i / FILES_PER_DIRECTORY) + "/asset" + std::to_string(i) + ".bin";
+        usize size = MIN_FILE_SIZE + (static_cast<usize>(i) * 2654435761u) % (MAX_FILE_SIZE - MIN_FILE_SIZE);
+        for (usize j = 0; j < size; j++) {
+            contents[j] = static_cast<u8>(i + j);
+        }
+        expected += checksum(contents.data(), size);
+
+        fs::path file = loose / paths[i];
+        fs::create_directories(file.parent_path());
+        std::FILE* out = std::fopen(file.string().c_str(), "wb");
+        BENCH_CHECK(out != nullptr && std::fwrite(contents.data(), 1, size, out) == size);
+        std::fclose(out);
+    }
+    BENCH_CHECK(pak_build(loose.string().c_str(), pak.string().c_str()));
+
+    // What the engine did before: fopen and fread every file
+    std::vector<u8> buffer(MAX_FILE_SIZE);
+    auto load_fopen = [&] {
+        u64 sum = 0;
+        for (const std::string& path : paths) {
+            std::FILE* in = std::fopen((loose / path).string().c_str(), "rb");
+            usize size = std::fread(buffer.data(), 1, buffer.size(), in);
+            std::fclose(in);
+            sum += checksum(buffer.data(), size);
+        }
+        BENCH_CHECK(sum == expected);
+    };
+
+    VirtualFileSystem* vfs = VirtualFileSystem::get_reference();
+    auto load_vfs = [&] {
+        u64 sum = 0;
+        for (const std::string& path : paths) {
+            FileView view = vfs->read(path.c_str());
+            sum += checksum(view.data(), view.size());
+        }
+        BENCH_CHECK(sum == expected);
+    };
+
+    auto evict_loose = [&] {
+        bool evicted = true;
+        for (const std::string& path : paths) {
+            evicted = evict(loose / path) && evicted;
+        }
+        return evicted;
+    };
+
+    // Cold loads start with nothing cached. A pak is mounted after its
+    // pages are dropped, so the mapping faults them in again.
+    bool cold = evict_loose();
+    u64 fopen_cold_ns = bench_best_ns(1, load_fopen);
+
+    evict_loose();
+    BENCH_CHECK(vfs->mount(loose.string().c_str()));
+    u64 loose_cold_ns = bench_best_ns(1, load_vfs);
+    u64 loose_warm_ns = bench_best_ns(WARM_RUNS, load_vfs);
+    vfs->unmount(loose.string().c_str());
+
+    cold = evict(pak) && cold;
+    BENCH_CHECK(vfs->mount(pak.string().c_str()));
+    u64 pak_cold_ns = bench_best_ns(1, load_vfs);
+    u64 pak_warm_ns = bench_best_ns(WARM_RUNS, load_vfs);
+    vfs->unmount(pak.string().c_str());
+
+    u64 fopen_warm_ns = bench_best_ns(WARM_RUNS, load_fopen);
+
+    std::printf("%u files of %zu to %zu bytes in %s\n", FILE_COUNT, MIN_FILE_SIZE, MAX_FILE_SIZE, root.string().c_str());
+    if (!cold) {
+        std::printf("page cache could not be dropped, cold loads are warm\n");
+    }
+    std::printf("%-20s %10s %10s %14s\n", "", "cold ms", "warm ms", "warm us/file");
+    auto report = [](const char* name, u64 cold_ns, u64 warm_ns) {
+        std::printf("%-20s %10.2f %10.2f %14.2f\n", name, static_cast<double>(cold_ns) / 1e6,
+            static_cast<double>(warm_ns) / 1e6, static_cast<double>(warm_ns) / 1e3 / FILE_COUNT);
+    };
+    report("fopen + fread", fopen_cold_ns, fopen_warm_ns);
+    report("vfs, directory", loose_cold_ns, loose_warm_ns);
+    report("vfs, pak", pak_cold_ns, pak_warm_ns);
+
+    vfs->shutdown();
+    fs::remove_all(root);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "bench.h"
+
+#include <core/defines.h>
+#include <core/input.h>
+#include <core/window.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace bifrost::core;
+
+// Events handled per pump, within what the input ring holds
+constexpr u32 EVENT_BATCH = 512;
+constexpr u32 BATCHES = 40;
+constexpr u32 CREATE_RUNS = 20;
+
+// Alternate moves with presses and releases of the left button, which
+// every backend reports the same way whatever the keyboard layout
+static WindowEvent batch_event(u32 i) {
+    WindowEvent event = {};
+    if (i % 2 == 0) {
+        event.type = WindowEventType::MOUSE_MOVE;
+        event.x = static_cast<i32>(i % 640);
+        event.y = static_cast<i32>(i % 480);
+    } else {
+        event.type = WindowEventType::BUTTON;
+        event.code = bifrost::LEFT;
+        event.pressed = (i / 2) % 2 == 0;
+    }
+    return event;
+}
+
+// Pump until the whole batch has reached the input handler
+static u64 pump_batch(Window& window, InputHandler* input) {
+    u64 start = platform_time_ns();
+    u64 deadline = start + 5000000000ull;
+    usize received = 0;
+    while (received < EVENT_BATCH) {
+        window.pump_messages();
+        input->update(0.0);
+        received += input->frame_events().size();
+        BENCH_CHECK(platform_time_ns() < deadline);
+    }
+    BENCH_CHECK(received == EVENT_BATCH);
+    return platform_time_ns() - start;
+}
+
+static void bench_headless(InputHandler* input) {
+    u64 create_ns = bench_best_ns(CREATE_RUNS, [] {
+        Window window(640, 480, "Window benchmark", WindowBackend::HEADLESS);
+        window.shutdown();
+    });
+
+    Window window(640, 480, "Window benchmark", WindowBackend::HEADLESS);
+    window.show();
+    u64 pump_ns = ~0ull;
+    for (u32 batch = 0; batch < BATCHES; batch++) {
+        for (u32 i = 0; i < EVENT_BATCH; i++) {
+            window.inject_event(batch_event(i));
+        }
+        u64 ns = pump_batch(window, input);
+        pump_ns = ns < pump_ns ? ns : pump_ns;
+    }
+    window.shutdown();
+
+    std::printf("%-10s %12.3f %12s %12.1f\n", "headless",
+        static_cast<f64>(create_ns) / 1e3, "-", static_cast<f64>(pump_ns) / EVENT_BATCH);
+}
+
+#ifdef Q_PLATFORM_LINUX
+
+// One request and its reply, the unit the cost of creating a window is
+// counted in
+static void round_trip(xcb_connection_t* connection) {
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+// Events are sent to the window from a second connection, as the server
+// would send input, and pumped once the server has queued all of them
+static bool bench_x11(InputHandler* input) {
+    int screen_number = 0;
+    xcb_connection_t* sender = xcb_connect(nullptr, &screen_number);
+    if (xcb_connection_has_error(sender)) {
+        xcb_disconnect(sender);
+        return false;
+    }
+
+    u64 round_trip_ns = bench_best_ns(100, [sender] { round_trip(sender); });
+
+    // A window is ready once the server has handled its requests
+    u64 create_ns = bench_best_ns(CREATE_RUNS, [] {
+        Window window(640, 480, "Window benchmark", WindowBackend::PLATFORM);
+        BENCH_CHECK(window.get_backend() == WindowBackend::PLATFORM);
+        window.sync();
+        window.shutdown();
+    });
+
+    Window window(640, 480, "Window benchmark", WindowBackend::PLATFORM);
+    window.show();
+    window.sync();
+    window.pump_messages();
+    input->update(0.0);
+
+    u64 pump_ns = ~0ull;
+    for (u32 batch = 0; batch < BATCHES; batch++) {
+        for (u32 i = 0; i < EVENT_BATCH; i++) {
+            WindowEvent event = batch_event(i);
+            char bytes[32] = {};
+            if (event.type == WindowEventType::MOUSE_MOVE) {
+                xcb_motion_notify_event_t* motion = reinterpret_cast<xcb_motion_notify_event_t*>(bytes);
+                motion->response_type = XCB_MOTION_NOTIFY;
+                motion->event = window.get_xcb_window();
+                motion->event_x = static_cast<i16>(event.x);
+                motion->event_y = static_cast<i16>(event.y);
+                motion->same_screen = 1;
+            } else {
+                xcb_button_press_event_t* button = reinterpret_cast<xcb_button_press_event_t*>(bytes);
+                button->response_type = event.pressed ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE;
+                button->detail = XCB_BUTTON_INDEX_1;
+                button->event = window.get_xcb_window();
+                button->same_screen = 1;
+            }
+
+            // With no event mask the server sends the event to the
+            // client that created the window
+            xcb_send_event(sender, 0, window.get_xcb_window(), 0, bytes);
+        }
+        round_trip(sender);
+
+        u64 ns = pump_batch(window, input);
+        pump_ns = ns < pump_ns ? ns : pump_ns;
+    }
+    window.shutdown();
+    xcb_disconnect(sender);
+
+    std::printf("%-10s %12.3f %12.1f %12.1f\n", "X11",
+        static_cast<f64>(create_ns) / 1e3,
+        static_cast<f64>(create_ns) / static_cast<f64>(round_trip_ns),
+        static_cast<f64>(pump_ns) / EVENT_BATCH);
+    std::printf("one round trip to the server takes %.1fus\n", static_cast<f64>(round_trip_ns) / 1e3);
+    return true;
+}
+
+#endif // Q_PLATFORM_LINUX
+
+int main() {
+    InputHandler* input = InputHandler::get_reference();
+
+    std::printf("create: best of %u, pump: best batch of %u events\n", CREATE_RUNS, EVENT_BATCH);
+    std::printf("%-10s %12s %12s %12s\n", "", "create us", "round trips", "ns/event");
+    bench_headless(input);
+
+#ifdef Q_PLATFORM_LINUX
+    if (!bench_x11(input)) {
+        std::printf("No X server to connect to, set DISPLAY to measure the X11 backend\n");
+    }
+#endif // Q_PLATFORM_LINUX
+
+    return EXIT_SUCCESS;
+}
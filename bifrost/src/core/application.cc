@@ -0,0 +1,238 @@
+#include "core/application.h"
+#include "core/clock.h"
+#include "core/events.h"
+#include "core/input.h"
+#include "core/jobs.h"
+#include "core/log.h"
+#include "core/profiler.h"
+#include "core/vfs.h"
+
+#include <cstdlib>
+
+namespace bifrost {
+namespace core {
+
+// Waits shorter than this sleep on the clock instead of the window,
+// since waking up from poll is not precise enough to hit the deadline
+constexpr u64 FRAME_PACING_SLACK_NS = 2000000ull;
+
+// The environment can ask any application to record or replay its input
+static ApplicationConfig apply_environment(const ApplicationConfig& config) {
+    ApplicationConfig result = config;
+
+    const char* record_path = std::getenv("BIFROST_INPUT_RECORD");
+    if (record_path != nullptr && record_path[0] != '\0') {
+        result.input_record_path = record_path;
+    }
+
+    const char* replay_path = std::getenv("BIFROST_INPUT_REPLAY");
+    if (replay_path != nullptr && replay_path[0] != '\0') {
+        result.input_replay_path = replay_path;
+    }
+
+    // A replay needs no display, and live input would mix with it
+    if (!result.input_replay_path.empty()) {
+        result.backend = WindowBackend::HEADLESS;
+    }
+
+    return result;
+}
+
+Application::Application(const ApplicationConfig& config)
+    : m_config(apply_environment(config))
+    , m_window(m_config.width, m_config.height, m_config.title, m_config.backend)
+    , m_frame_arena(m_config.frame_arena_size, get_tagged_heap(MemoryTag::FRAME))
+    , m_running(false)
+    , m_frame_index(0)
+    , m_timestep(static_cast<u64>(m_config.fixed_step * 1e9), m_config.max_fixed_steps)
+    , m_frame_ns(static_cast<u64>(m_config.target_frame_time * 1e9))
+    , m_replaying(false)
+{
+    if (m_timestep.get_step_ns() == 0) {
+        Q_LOG_WARN("Application: fixed step must be positive, using 60Hz");
+        m_timestep = FixedTimestep(1000000000ull / 60, m_config.max_fixed_steps);
+    }
+
+    if (!m_config.input_replay_path.empty() && m_config.input_replay_timing == ReplayTiming::AS_FAST_AS_POSSIBLE) {
+        m_frame_ns = 0;
+    }
+}
+
+// Run the main loop
+void Application::run() {
+    EventHandler* events = EventHandler::get_reference();
+    InputHandler* input = InputHandler::get_reference();
+    JobSystem* jobs = JobSystem::get_reference();
+
+    PROFILE_THREAD("Main");
+    jobs->init(m_config.worker_count);
+    m_window.show();
+
+    if (!m_config.input_record_path.empty()) {
+        if (m_recorder.open(m_config.input_record_path.c_str())) {
+            input->set_recorder(&m_recorder);
+            Q_LOG_INFO("Application: recording input to %s", m_config.input_record_path.c_str());
+        } else {
+            Q_LOG_WARN("Application: could not record input to %s", m_config.input_record_path.c_str());
+        }
+    }
+
+    if (!m_config.input_replay_path.empty()) {
+        m_replaying = m_replayer.open(m_config.input_replay_path.c_str());
+        if (m_replaying) {
+            Q_LOG_INFO("Application: replaying input from %s", m_config.input_replay_path.c_str());
+        } else {
+            Q_LOG_WARN("Application: could not replay input from %s", m_config.input_replay_path.c_str());
+        }
+    }
+
+    m_running = true;
+    m_timestep.reset();
+
+    u64 frame_start = platform_time_ns();
+    u64 frame_deadline = frame_start + m_frame_ns;
+    u64 last_frame_start = frame_start;
+
+    while (m_running) {
+        u64 delta_ns = frame_start - last_frame_start;
+        last_frame_start = frame_start;
+        f64 delta_time = static_cast<f64>(delta_ns) / 1e9;
+        PROFILE_FRAME(m_frame_index);
+        m_frame_arena.reset();
+
+        // Pump
+        u64 phase_start = frame_start;
+        bool should_close;
+        {
+            PROFILE_SCOPE("Application::pump");
+            // The replay's inputs for this frame go through the pump
+            bool replay_over = m_replaying && !m_replayer.replay_frame(m_window, m_config.input_replay_timing);
+            should_close = m_window.should_close() || replay_over;
+            jobs->run_main_jobs();
+        }
+        u64 phase_end = platform_time_ns();
+        m_frame_stats.record(FramePhase::PUMP, phase_end - phase_start);
+        if (should_close) {
+            break;
+        }
+
+        // Input
+        phase_start = phase_end;
+        {
+            PROFILE_SCOPE("Application::input");
+            input->update(delta_time);
+            events->flush();
+        }
+        phase_end = platform_time_ns();
+        m_frame_stats.record(FramePhase::INPUT, phase_end - phase_start);
+
+        // Update
+        phase_start = phase_end;
+        {
+            PROFILE_SCOPE("Application::update");
+            u32 steps = m_timestep.advance(delta_ns);
+            f64 step = static_cast<f64>(m_timestep.get_step_ns()) / 1e9;
+            for (u32 i = 0; i < steps; i++) {
+                on_fixed_update(step);
+            }
+
+            on_update(delta_time);
+            m_task_graph.execute(m_frame_index);
+        }
+        phase_end = platform_time_ns();
+        m_frame_stats.record(FramePhase::UPDATE, phase_end - phase_start);
+
+        // Render
+        phase_start = phase_end;
+        {
+            PROFILE_SCOPE("Application::render");
+            on_render(m_timestep.get_alpha());
+        }
+        phase_end = platform_time_ns();
+        m_frame_stats.record(FramePhase::RENDER, phase_end - phase_start);
+
+        // Idle
+        phase_start = phase_end;
+        if (m_frame_ns > 0) {
+            PROFILE_SCOPE("Application::idle");
+            _wait_until(frame_deadline);
+
+            // After a long stall start pacing again from now instead of
+            // rushing through frames to catch up with the old deadlines
+            u64 now = platform_time_ns();
+            frame_deadline += m_frame_ns;
+            if (frame_deadline < now) {
+                frame_deadline = now + m_frame_ns;
+            }
+        }
+        phase_end = platform_time_ns();
+        m_frame_stats.record(FramePhase::IDLE, phase_end - phase_start);
+        m_frame_stats.record(FramePhase::FRAME, phase_end - frame_start);
+
+        frame_start = phase_end;
+        m_frame_index++;
+    }
+
+    m_task_graph.wait_all();
+    log_allocation_report();
+
+    if (m_replaying) {
+        Q_LOG_INFO("Application: replayed %llu frames", static_cast<unsigned long long>(m_frame_index));
+        m_replayer.close();
+        m_replaying = false;
+    }
+    if (m_recorder.is_recording()) {
+        input->set_recorder(nullptr);
+        m_recorder.close();
+    }
+
+#ifdef BIFROST_PROFILE
+    if (!m_config.trace_path.empty()) {
+        if (profile_export_chrome_trace(m_config.trace_path.c_str(), m_config.trace_first_frame, m_config.trace_last_frame)) {
+            Q_LOG_INFO("Application: wrote trace to %s", m_config.trace_path.c_str());
+        } else {
+            Q_LOG_WARN("Application: could not write trace to %s", m_config.trace_path.c_str());
+        }
+    }
+#endif // BIFROST_PROFILE
+
+    FrameTimeSummary frame = m_frame_stats.summarize(FramePhase::FRAME);
+    Q_LOG_INFO(
+        "Frame time: p50 %.3fms, p99 %.3fms, max %.3fms over %llu frames",
+        static_cast<f64>(frame.p50_ns) / 1e6,
+        static_cast<f64>(frame.p99_ns) / 1e6,
+        static_cast<f64>(frame.max_ns) / 1e6,
+        static_cast<unsigned long long>(frame.sample_count)
+    );
+
+    m_running = false;
+    // Only stop the file system if something used it, rather than
+    // creating it to shut it down
+    if (VirtualFileSystem::vfs_instance != nullptr) {
+        VirtualFileSystem::vfs_instance->shutdown();
+    }
+    jobs->shutdown();
+    m_window.shutdown();
+}
+
+// Sleep until the deadline. Most of the wait is spent blocked on the
+// window so input that arrives meanwhile is pumped, and timestamped, as
+// it comes in. The last stretch sleeps on the clock to hit the deadline.
+void Application::_wait_until(u64 deadline_ns) {
+    // A headless window has nothing to block on
+    if (m_window.get_backend() != WindowBackend::HEADLESS) {
+        u64 now = platform_time_ns();
+        while (now + FRAME_PACING_SLACK_NS < deadline_ns) {
+            i32 timeout_ms = static_cast<i32>((deadline_ns - now - FRAME_PACING_SLACK_NS + 999999ull) / 1000000ull);
+            if (m_window.wait_events(timeout_ms)) {
+                m_window.pump_messages();
+            }
+            now = platform_time_ns();
+        }
+    }
+
+    platform_sleep_until_ns(deadline_ns);
+}
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,66 @@
+#include "core/clock.h"
+#include "core/defines.h"
+
+#ifdef Q_PLATFORM_LINUX
+#include <cerrno>
+#include <time.h>
+#elif Q_PLATFORM_WINDOWS
+#include <windows.h>
+#endif // Platform Detection macros
+
+namespace bifrost {
+namespace core {
+
+#ifdef Q_PLATFORM_LINUX
+
+u64 platform_time_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<u64>(now.tv_sec) * 1000000000ull + static_cast<u64>(now.tv_nsec);
+}
+
+// Sleeping to an absolute time does not drift when the sleep is interrupted
+void platform_sleep_until_ns(u64 deadline_ns) {
+    timespec deadline;
+    deadline.tv_sec = static_cast<time_t>(deadline_ns / 1000000000ull);
+    deadline.tv_nsec = static_cast<long>(deadline_ns % 1000000000ull);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+}
+
+#elif Q_PLATFORM_WINDOWS
+
+u64 platform_time_ns() {
+    static LARGE_INTEGER frequency = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f;
+    }();
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    // Split the conversion to avoid overflowing 64 bits
+    u64 seconds = static_cast<u64>(now.QuadPart / frequency.QuadPart);
+    u64 remainder = static_cast<u64>(now.QuadPart % frequency.QuadPart);
+    return seconds * 1000000000ull + remainder * 1000000000ull / static_cast<u64>(frequency.QuadPart);
+}
+
+// Sleep only has millisecond resolution, so sleep for the whole
+// milliseconds and yield for the rest
+void platform_sleep_until_ns(u64 deadline_ns) {
+    u64 now = platform_time_ns();
+    if (deadline_ns > now + 1000000ull) {
+        Sleep(static_cast<DWORD>((deadline_ns - now) / 1000000ull - 1));
+    }
+
+    while (platform_time_ns() < deadline_ns) {
+        SwitchToThread();
+    }
+}
+
+#endif // Platform Detection macros
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,371 @@
+#include "core/ecs.h"
+#include "core/log.h"
+
+#include <cstdlib>
+
+namespace bifrost {
+namespace core {
+
+struct ComponentInfo {
+    u32 size;
+    u32 alignment;
+};
+
+static ComponentInfo component_infos[ECS_MAX_COMPONENTS];
+static std::atomic<u32> component_count = 0;
+
+// Register a component type
+ComponentId register_component(u32 size, u32 alignment) {
+    u32 id = component_count.fetch_add(1, std::memory_order_relaxed);
+    if (id >= ECS_MAX_COMPONENTS) {
+        Q_LOG_FATAL("ECS: more than %u component types", ECS_MAX_COMPONENTS);
+        std::abort();
+    }
+
+    component_infos[id] = { size, alignment };
+    return id;
+}
+
+static u32 align_up(u32 value, u32 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/// CommandBuffer ///
+
+// Ids of the buffers' pending handles. Every buffer, and every clear,
+// takes a new one, so old handles are not mistaken for new ones.
+static std::atomic<u32> command_buffer_ids = 0;
+
+static u32 next_pending_generation() {
+    return ECS_PENDING_FLAG | (command_buffer_ids.fetch_add(1, std::memory_order_relaxed) & ~ECS_PENDING_FLAG);
+}
+
+CommandBuffer::CommandBuffer()
+    : m_pending_generation(next_pending_generation())
+{
+}
+
+Entity CommandBuffer::create() {
+    Entity entity = { m_created++, m_pending_generation };
+    _record(COMMAND_CREATE, entity, 0, nullptr, 0);
+    return entity;
+}
+
+void CommandBuffer::destroy(Entity entity) {
+    _record(COMMAND_DESTROY, entity, 0, nullptr, 0);
+}
+
+void CommandBuffer::clear() {
+    m_commands.clear();
+    m_created = 0;
+    m_pending_generation = next_pending_generation();
+}
+
+// Append a command, padded so the next header stays aligned
+void CommandBuffer::_record(CommandType type, Entity entity, ComponentId component, const void* data, u32 size) {
+    CommandHeader header = { type, component, entity, size };
+
+    usize offset = m_commands.size();
+    usize padded = align_up(size, alignof(CommandHeader));
+    m_commands.resize(offset + sizeof(CommandHeader) + padded);
+
+    std::memcpy(m_commands.data() + offset, &header, sizeof(CommandHeader));
+    if (size > 0) {
+        std::memcpy(m_commands.data() + offset + sizeof(CommandHeader), data, size);
+    }
+}
+
+/// World ///
+
+World::World()
+    : m_chunk_pool(ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT, ECS_CHUNKS_PER_PAGE, get_tagged_heap(MemoryTag::ECS))
+    , m_records(get_tagged_heap(MemoryTag::ECS))
+    , m_free_indices(get_tagged_heap(MemoryTag::ECS))
+    , m_alive_count(0)
+{
+    // Archetype 0 holds entities without components
+    _get_archetype(0);
+}
+
+World::~World() {
+    for (Archetype& archetype : m_archetypes) {
+        for (u8* chunk : archetype.chunks) {
+            m_chunk_pool.deallocate(chunk, ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT);
+        }
+    }
+}
+
+Entity World::create() {
+    u32 index;
+    if (!m_free_indices.empty()) {
+        index = m_free_indices.back();
+        m_free_indices.pop_back();
+    } else {
+        index = static_cast<u32>(m_records.size());
+        m_records.push_back({ 0, ECS_NONE, 0 });
+    }
+
+    EntityRecord& record = m_records[index];
+    Entity entity = { index, record.generation };
+
+    record.archetype = 0;
+    record.row = _allocate_row(m_archetypes[0]);
+    m_archetypes[0].entities(record.row / m_archetypes[0].chunk_capacity)[record.row % m_archetypes[0].chunk_capacity] = entity;
+
+    m_alive_count++;
+    return entity;
+}
+
+bool World::destroy(Entity entity) {
+    if (!is_alive(entity)) {
+        return false;
+    }
+
+    EntityRecord& record = m_records[entity.index];
+    _remove_row(m_archetypes[record.archetype], record.row);
+
+    record.archetype = ECS_NONE;
+    record.generation = (record.generation + 1) & ~ECS_PENDING_FLAG;
+    m_free_indices.push_back(entity.index);
+    m_alive_count--;
+    return true;
+}
+
+bool World::is_alive(Entity entity) const {
+    return entity.index < m_records.size()
+        && m_records[entity.index].generation == entity.generation
+        && m_records[entity.index].archetype != ECS_NONE;
+}
+
+// Make the changes recorded in the buffer
+void World::apply(CommandBuffer& commands) {
+    std::vector<Entity> created;
+    created.reserve(commands.m_created);
+
+    usize offset = 0;
+    while (offset < commands.m_commands.size()) {
+        CommandBuffer::CommandHeader header;
+        std::memcpy(&header, commands.m_commands.data() + offset, sizeof(header));
+        const u8* data = commands.m_commands.data() + offset + sizeof(header);
+        offset += sizeof(header) + align_up(header.size, alignof(CommandBuffer::CommandHeader));
+
+        // Pending handles are looked up among the entities created so far,
+        // and only if they came from this buffer since it was last cleared
+        Entity entity = header.entity;
+        if ((entity.generation & ECS_PENDING_FLAG) != 0 && header.type != CommandBuffer::COMMAND_CREATE) {
+            if (entity.generation != commands.m_pending_generation || entity.index >= created.size()) {
+                Q_LOG_WARN("ECS: skipped a command for pending entity %u of another command buffer", entity.index);
+                continue;
+            }
+            entity = created[entity.index];
+        }
+
+        switch (header.type) {
+            case CommandBuffer::COMMAND_CREATE:
+                created.push_back(create());
+                break;
+
+            case CommandBuffer::COMMAND_DESTROY:
+                destroy(entity);
+                break;
+
+            case CommandBuffer::COMMAND_ADD:
+                _add_component(entity, header.component, data);
+                break;
+
+            case CommandBuffer::COMMAND_REMOVE:
+                _remove_component(entity, header.component);
+                break;
+        }
+    }
+
+    commands.clear();
+}
+
+bool World::_add_component(Entity entity, ComponentId component, const void* value) {
+    if (!is_alive(entity)) {
+        return false;
+    }
+
+    u32 source = m_records[entity.index].archetype;
+    if (m_archetypes[source].column_of[component] == ECS_NONE) {
+        u32 destination = m_archetypes[source].add_edge[component];
+        if (destination == ECS_NONE) {
+            destination = _get_archetype(m_archetypes[source].mask | (ComponentMask(1) << component));
+            m_archetypes[source].add_edge[component] = destination;
+        }
+        _move_entity(entity, destination);
+    }
+
+    std::memcpy(_get_component(entity, component), value, component_infos[component].size);
+    return true;
+}
+
+bool World::_remove_component(Entity entity, ComponentId component) {
+    if (!is_alive(entity)) {
+        return false;
+    }
+
+    u32 source = m_records[entity.index].archetype;
+    if (m_archetypes[source].column_of[component] == ECS_NONE) {
+        return false;
+    }
+
+    u32 destination = m_archetypes[source].remove_edge[component];
+    if (destination == ECS_NONE) {
+        destination = _get_archetype(m_archetypes[source].mask & ~(ComponentMask(1) << component));
+        m_archetypes[source].remove_edge[component] = destination;
+    }
+
+    _move_entity(entity, destination);
+    return true;
+}
+
+void* World::_get_component(Entity entity, ComponentId component) {
+    if (!is_alive(entity)) {
+        return nullptr;
+    }
+
+    const EntityRecord& record = m_records[entity.index];
+    const Archetype& archetype = m_archetypes[record.archetype];
+    u32 column = archetype.column_of[component];
+    if (column == ECS_NONE) {
+        return nullptr;
+    }
+
+    u32 chunk = record.row / archetype.chunk_capacity;
+    u32 row = record.row % archetype.chunk_capacity;
+    return static_cast<u8*>(archetype.column(chunk, column)) + static_cast<usize>(row) * archetype.column_sizes[column];
+}
+
+// Find or create the archetype for a set of components
+u32 World::_get_archetype(ComponentMask mask) {
+    auto found = m_archetype_lookup.find(mask);
+    if (found != m_archetype_lookup.end()) {
+        return found->second;
+    }
+
+    Archetype archetype = {};
+    archetype.mask = mask;
+    for (u32 i = 0; i < ECS_MAX_COMPONENTS; i++) {
+        archetype.column_of[i] = ECS_NONE;
+        archetype.add_edge[i] = ECS_NONE;
+        archetype.remove_edge[i] = ECS_NONE;
+    }
+
+    u32 row_size = sizeof(Entity);
+    for (u32 id = 0; id < ECS_MAX_COMPONENTS; id++) {
+        if (mask & (ComponentMask(1) << id)) {
+            archetype.column_of[id] = static_cast<u32>(archetype.components.size());
+            archetype.components.push_back(id);
+            archetype.column_sizes.push_back(component_infos[id].size);
+            row_size += component_infos[id].size;
+        }
+    }
+
+    // Fit as many rows as possible, leaving room to align every column
+    u32 capacity = static_cast<u32>(ECS_CHUNK_SIZE / row_size);
+    for (;;) {
+        u32 offset = capacity * sizeof(Entity);
+        archetype.column_offsets.clear();
+        for (ComponentId id : archetype.components) {
+            offset = align_up(offset, component_infos[id].alignment);
+            archetype.column_offsets.push_back(offset);
+            offset += capacity * component_infos[id].size;
+        }
+
+        if (offset <= ECS_CHUNK_SIZE) {
+            break;
+        }
+        capacity--;
+    }
+
+    if (capacity == 0) {
+        Q_LOG_FATAL("ECS: a single entity with these components does not fit in a chunk");
+        std::abort();
+    }
+    archetype.chunk_capacity = capacity;
+
+    u32 index = static_cast<u32>(m_archetypes.size());
+    m_archetypes.push_back(std::move(archetype));
+    m_archetype_lookup[mask] = index;
+    return index;
+}
+
+// Reserve the row after the last one
+u32 World::_allocate_row(Archetype& archetype) {
+    u32 row = archetype.entity_count;
+    if (row / archetype.chunk_capacity >= archetype.chunks.size()) {
+        archetype.chunks.push_back(static_cast<u8*>(m_chunk_pool.allocate(ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT)));
+    }
+
+    archetype.entity_count++;
+    return row;
+}
+
+// Fill the row with the last row, keeping the chunks dense
+void World::_remove_row(Archetype& archetype, u32 row) {
+    u32 last = archetype.entity_count - 1;
+    u32 capacity = archetype.chunk_capacity;
+
+    if (row != last) {
+        u32 chunk = row / capacity, index = row % capacity;
+        u32 last_chunk = last / capacity, last_index = last % capacity;
+
+        Entity moved = archetype.entities(last_chunk)[last_index];
+        archetype.entities(chunk)[index] = moved;
+        for (u32 column = 0; column < archetype.components.size(); column++) {
+            u32 size = archetype.column_sizes[column];
+            std::memcpy(
+                static_cast<u8*>(archetype.column(chunk, column)) + static_cast<usize>(index) * size,
+                static_cast<u8*>(archetype.column(last_chunk, column)) + static_cast<usize>(last_index) * size,
+                size
+            );
+        }
+        m_records[moved.index].row = row;
+    }
+
+    archetype.entity_count--;
+
+    // Keep one empty chunk around so churn at a chunk boundary does not
+    // allocate and free every time
+    while (archetype.chunks.size() > archetype.chunk_count() + 1) {
+        m_chunk_pool.deallocate(archetype.chunks.back(), ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT);
+        archetype.chunks.pop_back();
+    }
+}
+
+// Move an entity to another archetype, keeping the components both share
+void World::_move_entity(Entity entity, u32 destination) {
+    EntityRecord& record = m_records[entity.index];
+    Archetype& from = m_archetypes[record.archetype];
+    Archetype& to = m_archetypes[destination];
+
+    u32 source_row = record.row;
+    u32 row = _allocate_row(to);
+
+    u32 from_chunk = source_row / from.chunk_capacity, from_index = source_row % from.chunk_capacity;
+    u32 to_chunk = row / to.chunk_capacity, to_index = row % to.chunk_capacity;
+
+    to.entities(to_chunk)[to_index] = entity;
+    for (u32 column = 0; column < to.components.size(); column++) {
+        u32 from_column = from.column_of[to.components[column]];
+        if (from_column == ECS_NONE) {
+            continue;
+        }
+
+        u32 size = to.column_sizes[column];
+        std::memcpy(
+            static_cast<u8*>(to.column(to_chunk, column)) + static_cast<usize>(to_index) * size,
+            static_cast<u8*>(from.column(from_chunk, from_column)) + static_cast<usize>(from_index) * size,
+            size
+        );
+    }
+
+    _remove_row(from, source_row);
+    record.archetype = destination;
+    record.row = row;
+}
+
+} // core namespace
+} // bifrost namespace
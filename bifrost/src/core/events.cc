@@ -1,71 +1,127 @@
 #include "core/events.h"
+#include "core/profiler.h"
+#include <cstring>
 
 namespace bifrost {
 namespace core {
 
+// Marks a code that has nothing queued for it
+constexpr u32 NO_QUEUED_EVENT = ~0u;
+
+// The top bit of a payload offset selects which of the two arenas holds it
+constexpr u32 PAYLOAD_ARENA_BIT = 1u << 31;
+
 // Event handler singleton
 EventHandler* EventHandler::handler_instance = nullptr;
 
-EventHandler::EventHandler() {
+EventHandler::EventHandler()
+: m_posted(EVENT_POST_CAPACITY)
+{
     for (usize i = 0; i < EVENT_CODE_AMOUNT; i++) {
         m_events[i].registered_events.clear();
+        m_coalesce[i] = EventCoalesce::NONE;
+        m_last_queued[i] = NO_QUEUED_EVENT;
     }
 
+    // Only the latest position and size matter within a frame
+    m_coalesce[code_as_usize(EventCode::MOUSE_MOVED)] = EventCoalesce::LAST;
+    m_coalesce[code_as_usize(EventCode::RESIZED)] = EventCoalesce::LAST;
+
+    m_queues[0].reserve(EVENT_QUEUE_INITIAL_CAPACITY);
+    m_queues[1].reserve(EVENT_QUEUE_INITIAL_CAPACITY);
+    m_dispatch_order.reserve(EVENT_QUEUE_INITIAL_CAPACITY);
+    m_payloads[0].reserve(EVENT_PAYLOAD_ARENA_SIZE);
+    m_payloads[1].reserve(EVENT_PAYLOAD_ARENA_SIZE);
+
     m_is_initialized = true;
 }
 
-// Return a pointer reference to the singleton instance
+// Return a pointer reference to the singleton instance. The first call
+// may be a post_event from a worker thread, so the handler is created
+// under the thread safe initialization of a local static.
 EventHandler* EventHandler::get_reference() {
-    if (handler_instance == nullptr) {
+    static EventHandler* instance = [] {
+        MemoryTagScope memory_scope(MemoryTag::EVENTS);
         handler_instance = new EventHandler();
-    }
+        return handler_instance;
+    }();
 
-    return handler_instance;
+    return instance;
 }
 
 // Register an event
-bool EventHandler::register_event(
+ListenerHandle EventHandler::register_event(
     EventCode code,
     void* listener,
     event_callback callback
 ) {
-    // Check if event has been registered
-    usize code_usize = code_as_usize(code);
-    usize amount_registered = m_events[code_usize].registered_events.size();
-    for (usize i = 0; i < amount_registered; i++) {
-        if (m_events[code_usize].registered_events[i].listener == listener) {
-            return false;
-        }
+    MemoryTagScope memory_scope(MemoryTag::EVENTS);
+
+    u32 slot_index;
+    if (!m_free_slots.empty()) {
+        slot_index = m_free_slots.back();
+        m_free_slots.pop_back();
+    } else {
+        slot_index = static_cast<u32>(m_slots.size());
+        m_slots.push_back({ 1, 0, 0, false });
     }
 
+    std::pmr::vector<RegisteredEvent>& events = m_events[code_as_usize(code)].registered_events;
+
+    ListenerSlot& slot = m_slots[slot_index];
+    slot.position = static_cast<u32>(events.size());
+    slot.code = static_cast<u32>(code);
+    slot.in_use = true;
+
     RegisteredEvent event = {};
     event.listener = listener;
     event.callback = callback;
-    m_events[code_usize].registered_events.push_back(event);
+    event.slot = slot_index;
+    events.push_back(event);
+
+    return { slot_index, slot.generation };
+}
+
+// Unregister an event from its handle
+bool EventHandler::unregister_event(ListenerHandle handle) {
+    if (handle.index >= m_slots.size()) {
+        return false;
+    }
+
+    ListenerSlot& slot = m_slots[handle.index];
+    if (!slot.in_use || slot.generation != handle.generation) {
+        return false;
+    }
+
+    // Invalidate the handle right away, skipping 0 which marks invalid handles
+    slot.in_use = false;
+    slot.generation = (slot.generation + 1) ? slot.generation + 1 : 1;
+
+    if (m_dispatch_depth > 0) {
+        // Removing now would move listeners under the loop in fire_event,
+        // so only stop the callback from running until firing finishes
+        m_events[slot.code].registered_events[slot.position].callback.reset();
+        m_pending_removals.push_back(handle.index);
+        return true;
+    }
 
+    _remove_listener(handle.index);
     return true;
 }
 
-// Unregister an event
+// Unregister an event. Slow path, linear in the listeners of the code.
 bool EventHandler::unregister_event(
     EventCode code,
     void* listener
 ) {
-    usize code_usize = code_as_usize(code);
-    usize amount_registered = m_events[code_usize].registered_events.size();
-
-    if (m_events[code_usize].registered_events.size() == 0) {
-        return false;
-    }
+    const std::pmr::vector<RegisteredEvent>& events = m_events[code_as_usize(code)].registered_events;
+    usize amount_registered = events.size();
 
     for (usize i = 0; i < amount_registered; i++) {
-        RegisteredEvent& ev = m_events[code_usize].registered_events[i];
-        if (ev.listener == listener) {
-            m_events[code_usize].registered_events.erase(
-                m_events[code_usize].registered_events.begin() + i
-            );
-
-            return true;
+        const RegisteredEvent& ev = events[i];
+        if (ev.listener == listener && ev.callback) {
+            const ListenerSlot& slot = m_slots[ev.slot];
+            return unregister_event({ ev.slot, slot.generation });
         }
     }
 
@@ -74,26 +130,170 @@ bool EventHandler::unregister_event(
 
 // Fire an event
 bool EventHandler::fire_event(EventCode code, void* sender, EventData data) {
-    usize code_usize = code_as_usize(code);
-    usize amount_registered = m_events[code_usize].registered_events.size();
+    PROFILE_SCOPE("EventHandler::fire_event");
 
-    if (amount_registered == 0) {
-        return false;
-    }
-    
+    const std::pmr::vector<RegisteredEvent>& events = m_events[code_as_usize(code)].registered_events;
+
+    // Listeners registered by a callback are not called until the next fire
+    usize amount_registered = events.size();
+    bool handled = false;
+
+    m_dispatch_depth++;
     for (usize i = 0; i < amount_registered; i++) {
-        RegisteredEvent& ev = m_events[code_usize].registered_events[i];
-        // auto& func = ev.callback;
-        if (ev.callback(code, sender, ev.listener, data)) {
+        // Index into the vector on every iteration and call copies of the
+        // callback and listener, since a callback registering a listener
+        // may reallocate the vector while it is still running
+        const RegisteredEvent& ev = events[i];
+        if (!ev.callback) {
+            continue;
+        }
+
+        event_callback callback = ev.callback;
+        void* listener = ev.listener;
+        if (callback(code, sender, listener, data)) {
             // A true result of the callback function means that 
-            // the event was fired
-            return true;
+            // the event was handled
+            handled = true;
+            break;
         }
     }
+    m_dispatch_depth--;
 
-    return false;
+    if (m_dispatch_depth == 0 && !m_pending_removals.empty()) {
+        for (u32 slot_index : m_pending_removals) {
+            _remove_listener(slot_index);
+        }
+        m_pending_removals.clear();
+    }
+
+    return handled;
 }
 
+// Queue an event to be dispatched on the next flush
+bool EventHandler::queue_event(EventCode code, void* sender, EventData data) {
+    usize code_usize = code_as_usize(code);
+    std::pmr::vector<QueuedEvent>& queue = m_queues[m_write_queue];
+
+    // Overwrite the pending event of this code rather than adding another
+    if (m_coalesce[code_usize] == EventCoalesce::LAST
+        && m_last_queued[code_usize] != NO_QUEUED_EVENT) {
+        QueuedEvent& pending = queue[m_last_queued[code_usize]];
+        pending.sender = sender;
+        pending.data = data;
+        return true;
+    }
+
+    m_last_queued[code_usize] = static_cast<u32>(queue.size());
+    queue.push_back({ code, sender, data });
+
+    return true;
+}
+
+// Post an event from any thread
+bool EventHandler::post_event(EventCode code, void* sender, EventData data) {
+    return m_posted.try_push({ code, sender, data });
+}
+
+// Dispatch every queued event. Posted events are moved into the
+// queue first so they follow the same coalescing rules. Events are grouped by code with a
+// counting sort so each code's listeners are walked back to back,
+// while events of the same code keep the order they were queued in.
+void EventHandler::flush() {
+    QueuedEvent posted;
+    while (m_posted.try_pop(posted)) {
+        queue_event(posted.code, posted.sender, posted.data);
+    }
+
+    std::pmr::vector<QueuedEvent>& queue = m_queues[m_write_queue];
+    m_write_queue ^= 1;
+    for (usize i = 0; i < EVENT_CODE_AMOUNT; i++) {
+        m_last_queued[i] = NO_QUEUED_EVENT;
+    }
+
+    usize amount_queued = queue.size();
+    if (amount_queued == 0) {
+        m_payloads[m_write_queue ^ 1].clear();
+        return;
+    }
+
+    std::memset(m_code_offsets, 0, sizeof(m_code_offsets));
+    for (usize i = 0; i < amount_queued; i++) {
+        m_code_offsets[code_as_usize(queue[i].code)]++;
+    }
+
+    u32 offset = 0;
+    for (usize i = 0; i < EVENT_CODE_AMOUNT; i++) {
+        u32 count = m_code_offsets[i];
+        m_code_offsets[i] = offset;
+        offset += count;
+    }
+
+    m_dispatch_order.resize(amount_queued);
+    for (usize i = 0; i < amount_queued; i++) {
+        m_dispatch_order[m_code_offsets[code_as_usize(queue[i].code)]++] = static_cast<u32>(i);
+    }
+
+    for (usize i = 0; i < amount_queued; i++) {
+        const QueuedEvent& ev = queue[m_dispatch_order[i]];
+        fire_event(ev.code, ev.sender, ev.data);
+    }
+
+    queue.clear();
+    m_payloads[m_write_queue ^ 1].clear();
+}
+
+// Get the counters for events posted from other threads
+EventPostStats EventHandler::get_post_stats() const {
+    EventPostStats stats = {};
+    stats.posted = m_posted.pushed_count();
+    stats.dropped = m_posted.dropped_count();
+    return stats;
+}
+
+// Copy a payload into the arena paired with the queue currently being written
+EventPayload EventHandler::push_payload(const void* data, u32 size) {
+    std::pmr::vector<u8>& arena = m_payloads[m_write_queue];
+    if (size == 0 || arena.size() + size > EVENT_PAYLOAD_ARENA_SIZE) {
+        return { 0, 0 };
+    }
+
+    u32 offset = static_cast<u32>(arena.size());
+    const u8* bytes = static_cast<const u8*>(data);
+    arena.insert(arena.end(), bytes, bytes + size);
+
+    return { offset | (m_write_queue ? PAYLOAD_ARENA_BIT : 0), size };
+}
+
+// Get the bytes of a payload
+const void* EventHandler::get_payload(EventPayload payload) const {
+    if (!payload.is_valid()) {
+        return nullptr;
+    }
+
+    const std::pmr::vector<u8>& arena = m_payloads[(payload.offset & PAYLOAD_ARENA_BIT) ? 1 : 0];
+    return arena.data() + (payload.offset & ~PAYLOAD_ARENA_BIT);
+}
+
+// Set how queued events of the code are merged before a flush
+void EventHandler::set_coalesce(EventCode code, EventCoalesce mode) {
+    m_coalesce[code_as_usize(code)] = mode;
+}
+/// PRIVATE ///
+
+// Swap the last listener of the code into the removed listener's place
+void EventHandler::_remove_listener(u32 slot_index) {
+    ListenerSlot& slot = m_slots[slot_index];
+    std::pmr::vector<RegisteredEvent>& events = m_events[slot.code].registered_events;
+
+    u32 last = static_cast<u32>(events.size() - 1);
+    if (slot.position != last) {
+        events[slot.position] = events[last];
+        m_slots[events[slot.position].slot].position = slot.position;
+    }
+    events.pop_back();
+
+    m_free_slots.push_back(slot_index);
+}
 
 } // core namespace
 } // bifrost namespace
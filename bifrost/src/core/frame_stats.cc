@@ -0,0 +1,66 @@
+#include "core/frame_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bifrost {
+namespace core {
+
+// Compute the percentiles of a phase over the history
+FrameTimeSummary FrameTimeTracker::summarize(FramePhase phase) const {
+    u8 index = static_cast<u8>(phase);
+    usize count = m_count[index];
+
+    FrameTimeSummary summary = {};
+    summary.sample_count = count;
+    summary.last_ns = m_last[index];
+    if (count == 0) {
+        return summary;
+    }
+
+    // Select on a copy so the history keeps its order
+    u64 sorted[FRAME_STATS_HISTORY];
+    std::memcpy(sorted, m_samples[index], count * sizeof(u64));
+
+    u64 total = 0;
+    for (usize i = 0; i < count; i++) {
+        total += sorted[i];
+    }
+    summary.mean_ns = total / count;
+
+    usize p50 = count / 2;
+    usize p99 = (count * 99) / 100;
+    std::nth_element(sorted, sorted + p99, sorted + count);
+    summary.p99_ns = sorted[p99];
+    summary.max_ns = *std::max_element(sorted + p99, sorted + count);
+
+    // Everything below p99 is already on its left
+    std::nth_element(sorted, sorted + p50, sorted + p99);
+    summary.p50_ns = p50 < p99 ? sorted[p50] : sorted[p99];
+
+    return summary;
+}
+
+void FrameTimeTracker::reset() {
+    std::memset(m_cursor, 0, sizeof(m_cursor));
+    std::memset(m_count, 0, sizeof(m_count));
+    std::memset(m_last, 0, sizeof(m_last));
+}
+
+u32 FixedTimestep::advance(u64 delta_ns) {
+    m_accumulator_ns += delta_ns;
+    u32 steps = 0;
+    while (m_accumulator_ns >= m_step_ns && steps < m_max_steps) {
+        m_accumulator_ns -= m_step_ns;
+        steps++;
+    }
+
+    // Too far behind to catch up, so drop the whole steps that are left
+    if (m_accumulator_ns >= m_step_ns) {
+        m_accumulator_ns %= m_step_ns;
+    }
+    return steps;
+}
+
+} // core namespace
+} // bifrost namespace
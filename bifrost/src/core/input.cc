@@ -1,14 +1,63 @@
 #include "core/input.h"
 #include "core/buttons.h"
+#include "core/events.h"
+#include "core/clock.h"
+#include "core/input_record.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace bifrost {
 namespace core {
 
+// Compute pressed = curr & ~prev and released = prev & ~curr for every key at once
+static void compute_key_transitions(
+    const KeyMask& curr,
+    const KeyMask& prev,
+    KeyMask& pressed,
+    KeyMask& released
+) {
+#if defined(__AVX2__)
+    __m256i c = _mm256_load_si256(reinterpret_cast<const __m256i*>(curr.bits));
+    __m256i p = _mm256_load_si256(reinterpret_cast<const __m256i*>(prev.bits));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(pressed.bits), _mm256_andnot_si256(p, c));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(released.bits), _mm256_andnot_si256(c, p));
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (usize i = 0; i < 4; i += 2) {
+        __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(curr.bits + i));
+        __m128i p = _mm_load_si128(reinterpret_cast<const __m128i*>(prev.bits + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(pressed.bits + i), _mm_andnot_si128(p, c));
+        _mm_store_si128(reinterpret_cast<__m128i*>(released.bits + i), _mm_andnot_si128(c, p));
+    }
+#elif defined(__ARM_NEON)
+    for (usize i = 0; i < 4; i += 2) {
+        uint64x2_t c = vld1q_u64(curr.bits + i);
+        uint64x2_t p = vld1q_u64(prev.bits + i);
+        vst1q_u64(pressed.bits + i, vbicq_u64(c, p));
+        vst1q_u64(released.bits + i, vbicq_u64(p, c));
+    }
+#else
+    for (usize i = 0; i < 4; i++) {
+        pressed.bits[i] = curr.bits[i] & ~prev.bits[i];
+        released.bits[i] = prev.bits[i] & ~curr.bits[i];
+    }
+#endif
+}
+
 // Singleton instance for the input handler
 InputHandler* InputHandler::handler_instance = nullptr;
 
 InputHandler* InputHandler::get_reference() {
     if (handler_instance == nullptr) {
+        MemoryTagScope memory_scope(MemoryTag::INPUT);
         handler_instance = new InputHandler();
     }
 
@@ -17,143 +66,217 @@ InputHandler* InputHandler::get_reference() {
 
 // Constructor
 InputHandler::InputHandler() 
-: m_logger(qlogger::Logger()) 
+: m_state()
 {
     m_state.is_initialized = true;
-    m_logger.info("Input handler is initialized");
+    reset_latency_report();
+    Q_LOG_INFO("Input handler is initialized");
 }
 
 // Destructor
 InputHandler::~InputHandler() {
-    m_logger.info("Input handler shutting down");
+    Q_LOG_INFO("Input handler shutting down");
     m_state.is_initialized = false;
 }
 
 void InputHandler::update(f64 delta_time) {
+    PROFILE_SCOPE("InputHandler::update");
+
     (void)delta_time;
     if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: attempting to update uninitialized handler.");
+        Q_LOG_WARN("InputHandler: attempting to update uninitialized handler.");
         return;
     }
 
-    // Copy current state to prev
-    m_state.keyboard_prev_state = m_state.keyboard_curr_state;
-    m_state.mouse_prev_state = m_state.mouse_curr_state;
-}
+    if (m_recorder != nullptr) {
+        m_recorder->record_frame(platform_time_ns());
+    }
 
-void InputHandler::process_window_resize(u32 w, u32 h) {
-}
+    // Last frame's snapshot becomes the previous state
+    m_state.keyboard_prev_state = m_state.keyboard_frame_state;
+    m_state.mouse_prev_state = m_state.mouse_frame_state;
+    m_state.keyboard_frame_state = m_state.keyboard_curr_state;
+    m_state.mouse_frame_state = m_state.mouse_curr_state;
+
+    compute_key_transitions(
+        m_state.keyboard_frame_state.keys,
+        m_state.keyboard_prev_state.keys,
+        m_state.keys_pressed,
+        m_state.keys_released
+    );
+
+    u8 buttons = m_state.mouse_frame_state.buttons;
+    u8 prev_buttons = m_state.mouse_prev_state.buttons;
+    m_state.buttons_pressed = buttons & ~prev_buttons;
+    m_state.buttons_released = prev_buttons & ~buttons;
+
+    // Drain the ring into this frame's events, oldest first
+    usize first = (m_ring_head + INPUT_EVENT_RING_CAPACITY - m_ring_count) % INPUT_EVENT_RING_CAPACITY;
+    for (usize i = 0; i < m_ring_count; i++) {
+        m_frame_events[i] = m_event_ring[(first + i) % INPUT_EVENT_RING_CAPACITY];
+    }
+    m_frame_event_count = m_ring_count;
+    m_ring_count = 0;
+
+    // Measure how long each input waited to be consumed
+    u64 now = platform_time_ns();
+    u64 frame_max = 0;
+    for (usize i = 0; i < m_frame_event_count; i++) {
+        u64 timestamp = m_frame_events[i].timestamp_ns;
+        u64 latency = now > timestamp ? now - timestamp : 0;
+
+        frame_max = latency > frame_max ? latency : frame_max;
+        m_latency.min_ns = latency < m_latency.min_ns ? latency : m_latency.min_ns;
+        m_latency_total_ns += latency;
+    }
 
-// Return a tuple of the current mouse position.
-// The first item in the tuple is the x coordinate 
-// and the second is the y.
-std::tuple<i32, i32> InputHandler::get_mouse_position() {
-    return std::make_tuple(m_state.mouse_curr_state.x, m_state.mouse_curr_state.y);
+    m_latency.event_count += m_frame_event_count;
+    m_latency.max_ns = frame_max > m_latency.max_ns ? frame_max : m_latency.max_ns;
+    m_latency.last_frame_max_ns = frame_max;
 }
 
-void InputHandler::process_key(Keys key, bool pressed) {
-    if (m_state.keyboard_curr_state.keys[key] != pressed) {
-        m_state.keyboard_curr_state.keys[key] = pressed;
-
-        if (pressed)
-            m_logger.debug("Key pressed: %c", static_cast<char>(key));
-        else
-            m_logger.debug("Key released: %c", static_cast<char>(key));
-
-        // TODO: fire event once events are setup
+// Get the input latency measured since the report was last reset
+InputLatencyReport InputHandler::get_latency_report() const {
+    InputLatencyReport report = m_latency;
+    if (report.event_count == 0) {
+        report.min_ns = 0;
+        report.mean_ns = 0.0;
+    } else {
+        report.mean_ns = static_cast<f64>(m_latency_total_ns) / static_cast<f64>(report.event_count);
     }
-}
 
-// Process the mouse wheel input
-void InputHandler::process_mouse_wheel(i32 z_delta) {
-    (void)z_delta;
+    return report;
 }
 
-// Process a move of the mouse
-void InputHandler::process_mouse_move(i32 x, i32 y) {
-    if (m_state.mouse_curr_state.x != x
-        || m_state.mouse_curr_state.y != y) {
-        m_state.mouse_curr_state.x = x;
-        m_state.mouse_curr_state.y = y;
-
-        // TODO: fire event
-    }
+void InputHandler::reset_latency_report() {
+    m_latency = {};
+    m_latency.min_ns = ~0ull;
+    m_latency_total_ns = 0;
 }
 
-
-/// PRIVATE ///
-
-bool InputHandler::_is_button_down(MouseButtons button) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
+// Record an input in the ring, overwriting the oldest one if it is full
+void InputHandler::_record_event(const InputEvent& event) {
+    if (m_recorder != nullptr) {
+        m_recorder->record(event);
     }
 
-    return m_state.mouse_curr_state.buttons[button] == false;
-}
+    m_event_ring[m_ring_head] = event;
+    m_ring_head = (m_ring_head + 1) % INPUT_EVENT_RING_CAPACITY;
 
-bool InputHandler::_was_button_down(MouseButtons button) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
+    if (m_ring_count < INPUT_EVENT_RING_CAPACITY) {
+        m_ring_count++;
+    } else {
+        m_latency.dropped_count++;
     }
-
-    return m_state.mouse_prev_state.buttons[button] == true;
 }
 
+// Windows call this once per pump, with the final size of a resize
+void InputHandler::process_window_resize(u32 w, u32 h, u64 timestamp_ns) {
+    InputEvent event = {};
+    event.timestamp_ns = timestamp_ns ? timestamp_ns : platform_time_ns();
+    event.type = InputEventType::RESIZE;
+    event.x = static_cast<i32>(w);
+    event.y = static_cast<i32>(h);
+    _record_event(event);
+
+    Q_LOG_DEBUG("Window resized [%u, %u]", w, h);
+
+    EventData data = {};
+    data.u16[0] = static_cast<u16>(w);
+    data.u16[1] = static_cast<u16>(h);
+    EventHandler::get_reference()->queue_event(EventCode::RESIZED, this, data);
+}
 
-bool InputHandler::_is_button_up(MouseButtons button) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
-    }
-
-    return m_state.mouse_curr_state.buttons[button] == true;
+// Return a tuple of the current mouse position.
+// The first item in the tuple is the x coordinate 
+// and the second is the y.
+std::tuple<i32, i32> InputHandler::get_mouse_position() {
+    return std::make_tuple(m_state.mouse_curr_state.x, m_state.mouse_curr_state.y);
 }
 
-bool InputHandler::_was_button_up(MouseButtons button) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
-    }
+void InputHandler::process_key(Keys key, bool pressed, u64 timestamp_ns) {
+    InputEvent event = {};
+    event.timestamp_ns = timestamp_ns ? timestamp_ns : platform_time_ns();
+    event.type = InputEventType::KEY;
+    event.pressed = pressed;
+    event.code = static_cast<u16>(key);
+    _record_event(event);
 
-    return m_state.mouse_prev_state.buttons[button] == false;
-}
+    if (m_state.keyboard_curr_state.keys.test(key) != pressed) {
+        m_state.keyboard_curr_state.keys.set(key, pressed);
 
-bool InputHandler::_is_key_down(Keys key) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
+        if (pressed)
+            Q_LOG_DEBUG("Key pressed: %c", static_cast<char>(key));
+        else
+            Q_LOG_DEBUG("Key released: %c", static_cast<char>(key));
+
+        EventData data = {};
+        data.u16[0] = static_cast<u16>(key);
+        EventHandler::get_reference()->queue_event(
+            pressed ? EventCode::KEY_PRESSED : EventCode::KEY_RELEASED,
+            this,
+            data
+        );
     }
-
-    return m_state.keyboard_curr_state.keys[key] == true;
 }
 
-bool InputHandler::_was_key_down(Keys key) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
+// Process a press or release of a mouse button
+void InputHandler::process_buttons(MouseButtons button, bool pressed, u64 timestamp_ns) {
+    InputEvent event = {};
+    event.timestamp_ns = timestamp_ns ? timestamp_ns : platform_time_ns();
+    event.type = InputEventType::BUTTON;
+    event.pressed = pressed;
+    event.code = static_cast<u16>(button);
+    _record_event(event);
+
+    u8 bit = static_cast<u8>(1 << button);
+    if (((m_state.mouse_curr_state.buttons & bit) != 0) != pressed) {
+        m_state.mouse_curr_state.buttons = pressed
+            ? (m_state.mouse_curr_state.buttons | bit)
+            : (m_state.mouse_curr_state.buttons & ~bit);
+
+        EventData data = {};
+        data.u16[0] = static_cast<u16>(button);
+        EventHandler::get_reference()->queue_event(
+            pressed ? EventCode::BUTTON_PRESSED : EventCode::BUTTON_RELEASED,
+            this,
+            data
+        );
     }
+}
 
-    return m_state.keyboard_prev_state.keys[key] == true;
+// Process the mouse wheel input
+void InputHandler::process_mouse_wheel(i32 z_delta, u64 timestamp_ns) {
+    InputEvent event = {};
+    event.timestamp_ns = timestamp_ns ? timestamp_ns : platform_time_ns();
+    event.type = InputEventType::MOUSE_WHEEL;
+    event.x = z_delta;
+    _record_event(event);
+
+    EventData data = {};
+    data.i8[0] = static_cast<i8>(z_delta);
+    EventHandler::get_reference()->queue_event(EventCode::MOUSE_WHEEL, this, data);
 }
 
-bool InputHandler::_is_key_up(Keys key) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
-    }
+// Process a move of the mouse
+void InputHandler::process_mouse_move(i32 x, i32 y, u64 timestamp_ns) {
+    InputEvent event = {};
+    event.timestamp_ns = timestamp_ns ? timestamp_ns : platform_time_ns();
+    event.type = InputEventType::MOUSE_MOVE;
+    event.x = x;
+    event.y = y;
+    _record_event(event);
 
-    return m_state.keyboard_curr_state.keys[key] == true;
-}
+    if (m_state.mouse_curr_state.x != x
+        || m_state.mouse_curr_state.y != y) {
+        m_state.mouse_curr_state.x = x;
+        m_state.mouse_curr_state.y = y;
 
-bool InputHandler::_was_key_up(Keys key) {
-    if (!m_state.is_initialized) {
-        m_logger.warn("InputHandler: trying to access uninitialized handler.");
-        return false;
+        EventData data = {};
+        data.i32[0] = x;
+        data.i32[1] = y;
+        EventHandler::get_reference()->queue_event(EventCode::MOUSE_MOVED, this, data);
     }
-    
-    return m_state.keyboard_curr_state.keys[key] == false;
 }
 
 } // core namespace
@@ -0,0 +1,421 @@
+#include "core/input_record.h"
+#include "core/clock.h"
+#include "core/defines.h"
+#include "core/window.h"
+
+#include <cstring>
+
+#ifdef Q_PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif Q_PLATFORM_WINDOWS
+#include <windows.h>
+#endif // Platform Detection macros
+
+namespace bifrost {
+namespace core {
+
+constexpr u8 INPUT_RECORD_MAGIC[4] = { 'B', 'F', 'I', 'R' };
+constexpr u32 INPUT_RECORD_VERSION = 1;
+constexpr usize INPUT_RECORD_HEADER_SIZE = 8;
+
+// Tag values. Input records use their InputEventType as the tag.
+constexpr u8 RECORD_TAG_FRAME = 0x0F;
+constexpr u8 RECORD_TAG_PRESSED = 0x80;
+constexpr u8 RECORD_TAG_TYPE_MASK = 0x7F;
+
+// Largest encoded record: a tag and three 10 byte varints
+constexpr usize INPUT_RECORD_MAX_SIZE = 1 + 3 * 10;
+
+/// InputRecorder ///
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+// Start recording into the file
+bool InputRecorder::open(const char* path) {
+    close();
+
+    m_file = std::fopen(path, "wb");
+    if (m_file == nullptr) {
+        return false;
+    }
+
+    m_buffer_used = 0;
+    m_has_timestamp = false;
+    m_last_timestamp = 0;
+    m_last_x = 0;
+    m_last_y = 0;
+
+    std::memcpy(m_buffer, INPUT_RECORD_MAGIC, sizeof(INPUT_RECORD_MAGIC));
+    std::memcpy(m_buffer + sizeof(INPUT_RECORD_MAGIC), &INPUT_RECORD_VERSION, sizeof(INPUT_RECORD_VERSION));
+    m_buffer_used = INPUT_RECORD_HEADER_SIZE;
+
+    return true;
+}
+
+// Write out everything recorded so far and close the file
+void InputRecorder::close() {
+    if (m_file == nullptr) {
+        return;
+    }
+
+    _flush();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+// Record a single input
+void InputRecorder::record(const InputEvent& event) {
+    if (m_file == nullptr) {
+        return;
+    }
+
+    u8 tag = static_cast<u8>(event.type) | (event.pressed ? RECORD_TAG_PRESSED : 0);
+    _write_header(tag, event.timestamp_ns);
+
+    switch (event.type) {
+        case InputEventType::KEY:
+        case InputEventType::BUTTON:
+            _write_varint(event.code);
+            break;
+
+        case InputEventType::MOUSE_MOVE:
+            _write_signed(static_cast<i64>(event.x) - m_last_x);
+            _write_signed(static_cast<i64>(event.y) - m_last_y);
+            m_last_x = event.x;
+            m_last_y = event.y;
+            break;
+
+        case InputEventType::MOUSE_WHEEL:
+            _write_signed(event.x);
+            break;
+
+        case InputEventType::RESIZE:
+            _write_varint(static_cast<u32>(event.x));
+            _write_varint(static_cast<u32>(event.y));
+            break;
+    }
+}
+
+// Mark an update of the InputHandler
+void InputRecorder::record_frame(u64 timestamp_ns) {
+    if (m_file == nullptr) {
+        return;
+    }
+
+    _write_header(RECORD_TAG_FRAME, timestamp_ns);
+}
+
+// Write the tag and the time since the previous record
+void InputRecorder::_write_header(u8 tag, u64 timestamp_ns) {
+    if (m_buffer_used + INPUT_RECORD_MAX_SIZE > INPUT_RECORD_BUFFER_SIZE) {
+        _flush();
+    }
+
+    if (!m_has_timestamp) {
+        m_has_timestamp = true;
+        m_last_timestamp = timestamp_ns;
+    }
+
+    u64 delta = timestamp_ns > m_last_timestamp ? timestamp_ns - m_last_timestamp : 0;
+    m_last_timestamp = timestamp_ns > m_last_timestamp ? timestamp_ns : m_last_timestamp;
+
+    m_buffer[m_buffer_used++] = tag;
+    _write_varint(delta);
+}
+
+// LEB128 encoding: 7 bits per byte, high bit set while more bytes follow
+void InputRecorder::_write_varint(u64 value) {
+    while (value >= 0x80) {
+        m_buffer[m_buffer_used++] = static_cast<u8>(value | 0x80);
+        value >>= 7;
+    }
+    m_buffer[m_buffer_used++] = static_cast<u8>(value);
+}
+
+// Zigzag encoding keeps small negative values small
+void InputRecorder::_write_signed(i64 value) {
+    _write_varint((static_cast<u64>(value) << 1) ^ static_cast<u64>(value >> 63));
+}
+
+void InputRecorder::_flush() {
+    if (m_buffer_used > 0) {
+        std::fwrite(m_buffer, 1, m_buffer_used, m_file);
+        m_buffer_used = 0;
+    }
+}
+
+/// InputReplayer ///
+
+InputReplayer::~InputReplayer() {
+    close();
+}
+
+// Map the recording into memory and check its header
+bool InputReplayer::open(const char* path) {
+    close();
+
+#ifdef Q_PLATFORM_LINUX
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<usize>(info.st_size) < INPUT_RECORD_HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<usize>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    // Records are read front to back exactly once
+    madvise(data, static_cast<usize>(info.st_size), MADV_SEQUENTIAL);
+
+    m_data = static_cast<const u8*>(data);
+    m_size = static_cast<usize>(info.st_size);
+#elif Q_PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || static_cast<usize>(file_size.QuadPart) < INPUT_RECORD_HEADER_SIZE) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_data = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file_handle = file;
+    m_mapping_handle = mapping;
+    m_size = static_cast<usize>(file_size.QuadPart);
+#endif // Platform Detection macros
+
+    u32 version = 0;
+    std::memcpy(&version, m_data + sizeof(INPUT_RECORD_MAGIC), sizeof(version));
+    if (std::memcmp(m_data, INPUT_RECORD_MAGIC, sizeof(INPUT_RECORD_MAGIC)) != 0
+        || version != INPUT_RECORD_VERSION) {
+        close();
+        return false;
+    }
+
+    m_cursor = INPUT_RECORD_HEADER_SIZE;
+    m_record_time = 0;
+    m_last_x = 0;
+    m_last_y = 0;
+    m_started = false;
+
+    return true;
+}
+
+void InputReplayer::close() {
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef Q_PLATFORM_LINUX
+    munmap(const_cast<u8*>(m_data), m_size);
+#elif Q_PLATFORM_WINDOWS
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+    CloseHandle(static_cast<HANDLE>(m_file_handle));
+    m_mapping_handle = nullptr;
+    m_file_handle = nullptr;
+#endif // Platform Detection macros
+
+    m_data = nullptr;
+    m_size = 0;
+    m_cursor = 0;
+}
+
+// Feed the recorded inputs that are due into the handler
+bool InputReplayer::replay_frame(InputHandler* handler, ReplayTiming timing) {
+    return _replay(timing, [handler](const InputEvent& event) {
+        switch (event.type) {
+            case InputEventType::KEY:
+                handler->process_key(static_cast<Keys>(event.code), event.pressed, event.timestamp_ns);
+                break;
+
+            case InputEventType::BUTTON:
+                handler->process_buttons(static_cast<MouseButtons>(event.code), event.pressed, event.timestamp_ns);
+                break;
+
+            case InputEventType::MOUSE_MOVE:
+                handler->process_mouse_move(event.x, event.y, event.timestamp_ns);
+                break;
+
+            case InputEventType::MOUSE_WHEEL:
+                handler->process_mouse_wheel(event.x, event.timestamp_ns);
+                break;
+
+            case InputEventType::RESIZE:
+                handler->process_window_resize(static_cast<u32>(event.x), static_cast<u32>(event.y), event.timestamp_ns);
+                break;
+        }
+    });
+}
+
+// Inject the recorded inputs that are due into a headless window. A
+// window hands resizes to the input handler once per pump, which is how
+// they were recorded.
+bool InputReplayer::replay_frame(Window& window, ReplayTiming timing) {
+    Window* target = &window;
+    return _replay(timing, [target](const InputEvent& event) {
+        WindowEvent window_event = {};
+        window_event.pressed = event.pressed;
+        window_event.code = event.code;
+        window_event.x = event.x;
+        window_event.y = event.y;
+
+        switch (event.type) {
+            case InputEventType::KEY:         window_event.type = WindowEventType::KEY; break;
+            case InputEventType::BUTTON:      window_event.type = WindowEventType::BUTTON; break;
+            case InputEventType::MOUSE_MOVE:  window_event.type = WindowEventType::MOUSE_MOVE; break;
+            case InputEventType::MOUSE_WHEEL: window_event.type = WindowEventType::MOUSE_WHEEL; break;
+            case InputEventType::RESIZE:      window_event.type = WindowEventType::RESIZE; break;
+        }
+
+        target->inject_event(window_event);
+    });
+}
+
+// Decode the records that are due and hand each input to the sink
+bool InputReplayer::_replay(ReplayTiming timing, input_sink sink) {
+    if (is_finished()) {
+        return false;
+    }
+
+    u64 now = platform_time_ns();
+    if (!m_started) {
+        m_started = true;
+        m_replay_start = now;
+    }
+    u64 elapsed = now - m_replay_start;
+
+    while (m_cursor < m_size) {
+        usize record_start = m_cursor;
+        u8 tag = m_data[m_cursor++];
+
+        u64 delta = 0;
+        if (!_read_varint(delta)) {
+            break;
+        }
+
+        // Leave inputs recorded later than this point in the replay for a later frame
+        u64 record_time = m_record_time + delta;
+        if (timing == ReplayTiming::ORIGINAL && record_time > elapsed) {
+            m_cursor = record_start;
+            break;
+        }
+        m_record_time = record_time;
+
+        u8 type = tag & RECORD_TAG_TYPE_MASK;
+        if (type == RECORD_TAG_FRAME) {
+            if (timing == ReplayTiming::AS_FAST_AS_POSSIBLE) {
+                break;
+            }
+            continue;
+        }
+
+        InputEvent event = {};
+        event.timestamp_ns = timing == ReplayTiming::ORIGINAL ? m_replay_start + record_time : now;
+        event.type = static_cast<InputEventType>(type);
+        event.pressed = (tag & RECORD_TAG_PRESSED) != 0;
+
+        u64 a = 0, b = 0;
+        i64 sa = 0, sb = 0;
+        switch (event.type) {
+            case InputEventType::KEY:
+                if (!_read_varint(a) || a >= KEYS_MAX_KEY) continue;
+                event.code = static_cast<u16>(a);
+                break;
+
+            case InputEventType::BUTTON:
+                if (!_read_varint(a) || a >= MouseButtons::MAX_BUTTONS) continue;
+                event.code = static_cast<u16>(a);
+                break;
+
+            case InputEventType::MOUSE_MOVE:
+                if (!_read_signed(sa) || !_read_signed(sb)) continue;
+                m_last_x = static_cast<i32>(m_last_x + sa);
+                m_last_y = static_cast<i32>(m_last_y + sb);
+                event.x = m_last_x;
+                event.y = m_last_y;
+                break;
+
+            case InputEventType::MOUSE_WHEEL:
+                if (!_read_signed(sa)) continue;
+                event.x = static_cast<i32>(sa);
+                break;
+
+            case InputEventType::RESIZE:
+                if (!_read_varint(a) || !_read_varint(b)) continue;
+                event.x = static_cast<i32>(a);
+                event.y = static_cast<i32>(b);
+                break;
+
+            default:
+                // Unknown record, the rest of the file cannot be decoded
+                m_cursor = m_size;
+                continue;
+        }
+
+        sink(event);
+    }
+
+    return true;
+}
+
+// Read an LEB128 varint, stopping at the end of the recording
+bool InputReplayer::_read_varint(u64& value) {
+    value = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        if (m_cursor >= m_size) {
+            m_cursor = m_size;
+            return false;
+        }
+
+        u8 byte = m_data[m_cursor++];
+        value |= static_cast<u64>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    m_cursor = m_size;
+    return false;
+}
+
+bool InputReplayer::_read_signed(i64& value) {
+    u64 encoded = 0;
+    if (!_read_varint(encoded)) {
+        return false;
+    }
+
+    value = static_cast<i64>(encoded >> 1) ^ -static_cast<i64>(encoded & 1);
+    return true;
+}
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,358 @@
+#include "core/jobs.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace bifrost {
+namespace core {
+
+// Times an idle worker yields before going to sleep
+constexpr u32 JOB_IDLE_SPIN_COUNT = 64;
+
+// Index of the calling thread in the job system
+thread_local u32 t_thread_index = JOB_THREAD_EXTERNAL;
+
+// Shared state of a parallel_for. It lives on the stack of the calling
+// thread, which waits for every range to finish before returning.
+struct ParallelForRange {
+    range_function body;
+    usize count;
+    usize batch_size;
+    std::atomic<usize> next;
+};
+
+// Take ranges until there are none left. Ranges are handed out on
+// demand, so a thread that falls behind simply takes fewer of them.
+static void run_ranges(ParallelForRange* range) {
+    for (;;) {
+        usize begin = range->next.fetch_add(range->batch_size, std::memory_order_relaxed);
+        if (begin >= range->count) {
+            return;
+        }
+
+        usize end = std::min(begin + range->batch_size, range->count);
+        range->body(begin, end);
+    }
+}
+
+// xorshift32
+static u32 next_random(u32& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Job system singleton
+JobSystem* JobSystem::job_system_instance = nullptr;
+
+JobSystem::JobSystem()
+    : m_is_initialized(false)
+    , m_running(false)
+    , m_main_jobs(JOB_SHARED_QUEUE_CAPACITY)
+    , m_external_jobs(JOB_SHARED_QUEUE_CAPACITY)
+    , m_wake_epoch(0)
+    , m_sleeping(0)
+{
+    m_external_lock.clear();
+}
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+// Return a pointer reference to the singleton instance. Workers and
+// query threads reach it as well, so it is created under the thread safe
+// initialization of a local static.
+JobSystem* JobSystem::get_reference() {
+    static JobSystem* instance = [] {
+        job_system_instance = new JobSystem();
+        return job_system_instance;
+    }();
+
+    return instance;
+}
+
+u32 JobSystem::get_thread_index() {
+    return t_thread_index;
+}
+
+// Start the worker threads
+bool JobSystem::init(u32 worker_count) {
+    if (m_is_initialized) {
+        Q_LOG_WARN("JobSystem: attempting to initialize job system twice");
+        return false;
+    }
+
+    MemoryTagScope memory_scope(MemoryTag::JOBS);
+
+    if (worker_count == 0) {
+        u32 cores = std::thread::hardware_concurrency();
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+
+    m_threads.reserve(worker_count + 1);
+    for (u32 i = 0; i <= worker_count; i++) {
+        m_threads.push_back(std::make_unique<JobThread>());
+        m_threads.back()->random_state = 2654435761u * (i + 1);
+    }
+
+    t_thread_index = 0;
+    m_running.store(true, std::memory_order_release);
+    m_is_initialized = true;
+
+    m_workers.reserve(worker_count);
+    for (u32 i = 1; i <= worker_count; i++) {
+        m_workers.emplace_back(&JobSystem::_worker_main, this, i);
+    }
+
+    Q_LOG_INFO("JobSystem: started %u workers", worker_count);
+    return true;
+}
+
+// Finish the jobs that are left and join the workers
+void JobSystem::shutdown() {
+    if (!m_is_initialized) {
+        return;
+    }
+
+    m_running.store(false, std::memory_order_release);
+    m_wake_epoch.fetch_add(1);
+    m_wake_epoch.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+
+    // Whatever the workers left behind runs here
+    while (_run_one(0)) {
+    }
+    run_main_jobs();
+
+    m_threads.clear();
+    m_is_initialized = false;
+    t_thread_index = JOB_THREAD_EXTERNAL;
+}
+
+// Run a job on any thread
+void JobSystem::submit(job_function function, JobCounter* counter) {
+    Job job = { function, counter };
+    if (counter != nullptr) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!m_is_initialized) {
+        _execute(job);
+        return;
+    }
+
+    u32 index = t_thread_index;
+    if (index == JOB_THREAD_EXTERNAL) {
+        if (!m_external_jobs.try_push(job)) {
+            _execute(job);
+            return;
+        }
+        _wake_one();
+        return;
+    }
+
+    // Run the job here if every slot is waiting to be picked up
+    JobThread& thread = *m_threads[index];
+    JobSlot& slot = thread.slots[thread.next_slot & (JOB_QUEUE_CAPACITY - 1)];
+    if (slot.queued.load(std::memory_order_acquire)) {
+        _execute(job);
+        return;
+    }
+
+    slot.job = job;
+    slot.queued.store(true, std::memory_order_relaxed);
+    if (!thread.deque.push(&slot)) {
+        slot.queued.store(false, std::memory_order_relaxed);
+        _execute(job);
+        return;
+    }
+
+    thread.next_slot++;
+    _wake_one();
+}
+
+// Run a job on the main thread
+void JobSystem::submit_main(job_function function, JobCounter* counter) {
+    Job job = { function, counter };
+    if (counter != nullptr) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!m_is_initialized) {
+        _execute(job);
+        return;
+    }
+
+    while (!m_main_jobs.try_push(job)) {
+        // Nobody else can empty the queue
+        if (t_thread_index == 0) {
+            _execute(job);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Run the jobs pinned to the main thread
+void JobSystem::run_main_jobs() {
+    if (t_thread_index != 0 && m_is_initialized) {
+        Q_LOG_WARN("JobSystem: main thread jobs can only be run on the main thread");
+        return;
+    }
+
+    Job job;
+    while (m_main_jobs.try_pop(job)) {
+        _execute(job);
+    }
+}
+
+// Run other jobs until the counter reaches zero
+void JobSystem::wait(JobCounter& counter) {
+    u32 index = t_thread_index;
+
+    while (!counter.is_done()) {
+        if (index == 0) {
+            run_main_jobs();
+        }
+
+        if (index == JOB_THREAD_EXTERNAL || !_run_one(index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Run ranges of [0, count) across all threads
+void JobSystem::parallel_for(usize count, usize batch_size, range_function body) {
+    if (count == 0) {
+        return;
+    }
+    batch_size = batch_size > 0 ? batch_size : 1;
+
+    ParallelForRange range;
+    range.body = body;
+    range.count = count;
+    range.batch_size = batch_size;
+    range.next.store(0, std::memory_order_relaxed);
+
+    // One job per thread at most; each takes ranges until they run out
+    usize batches = (count + batch_size - 1) / batch_size;
+    usize threads = m_is_initialized ? m_threads.size() : 1;
+    usize jobs = std::min(batches, threads);
+
+    JobCounter counter;
+    ParallelForRange* shared = &range;
+    for (usize i = 1; i < jobs; i++) {
+        submit([shared] { run_ranges(shared); }, &counter);
+    }
+
+    run_ranges(shared);
+    wait(counter);
+}
+
+void JobSystem::_worker_main(u32 index) {
+    t_thread_index = index;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "Worker %u", index);
+    PROFILE_THREAD(name);
+
+    u32 idle = 0;
+    while (m_running.load(std::memory_order_acquire)) {
+        if (_run_one(index)) {
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < JOB_IDLE_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Read the epoch before the last look for work, so a submit in
+        // between changes it and the wait returns right away
+        u32 epoch = m_wake_epoch.load();
+        if (_run_one(index)) {
+            idle = 0;
+            continue;
+        }
+
+        m_sleeping.fetch_add(1);
+        if (m_running.load(std::memory_order_acquire)) {
+            m_wake_epoch.wait(epoch);
+        }
+        m_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+}
+
+bool JobSystem::_run_one(u32 index) {
+    Job job;
+    if (!_take_job(index, job)) {
+        return false;
+    }
+
+    _execute(job);
+    return true;
+}
+
+// Look for a job in the thread's own deque, then in the external queue,
+// then in the other threads' deques
+bool JobSystem::_take_job(u32 index, Job& out) {
+    JobThread& thread = *m_threads[index];
+
+    JobSlot* slot = thread.deque.pop();
+    if (slot == nullptr) {
+        if (!m_external_lock.test_and_set(std::memory_order_acquire)) {
+            bool found = m_external_jobs.try_pop(out);
+            m_external_lock.clear(std::memory_order_release);
+            if (found) {
+                return true;
+            }
+        }
+
+        // Start at a random thread so thieves spread out over the victims
+        usize count = m_threads.size();
+        usize start = next_random(thread.random_state) % count;
+        for (usize i = 0; i < count && slot == nullptr; i++) {
+            usize victim = (start + i) % count;
+            if (victim != index) {
+                slot = m_threads[victim]->deque.steal();
+            }
+        }
+
+        if (slot == nullptr) {
+            return false;
+        }
+    }
+
+    out = slot->job;
+    slot->queued.store(false, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::_execute(const Job& job) {
+    job.function();
+
+    if (job.counter != nullptr) {
+        job.counter->m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::_wake_one() {
+    m_wake_epoch.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+        m_wake_epoch.notify_one();
+    }
+}
+
+} // core namespace
+} // bifrost namespace
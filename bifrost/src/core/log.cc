@@ -0,0 +1,271 @@
+#include "core/log.h"
+#include "core/memory.h"
+#include <qlogger/qlogger.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+
+namespace bifrost {
+namespace core {
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "Log: buffer size must be a power of two");
+static_assert(sizeof(LogRecord) % 8 == 0, "Log: records must keep 8 byte alignment");
+
+// Level of the filler written when a record does not fit before the end
+// of the buffer and starts over at the beginning
+constexpr u8 LOG_RECORD_PADDING = 0xFF;
+
+// How long the writer sleeps when there is nothing to print
+constexpr std::chrono::milliseconds LOG_WRITER_INTERVAL(1);
+
+// Ring of records of one thread. The owner moves head and the writer moves
+// tail, so neither ever waits on the other.
+struct LogBuffer {
+    alignas(Q_CACHE_LINE_SIZE) std::atomic<u64> head;
+    u64 reserved_head;  // Head once the record being written is published
+    u64 cached_tail;    // Last tail the owner read, to not touch the writer's line every call
+    std::atomic<u64> dropped;
+
+    alignas(Q_CACHE_LINE_SIZE) std::atomic<u64> tail;
+
+    std::atomic<bool> owned;
+    u32 id;
+    LogBuffer* next;
+
+    alignas(8) u8 data[LOG_BUFFER_SIZE];
+};
+
+// Every buffer ever created. A buffer whose thread exited is handed to the
+// next thread that starts logging.
+static std::atomic<LogBuffer*> log_buffers = nullptr;
+static std::atomic<u32> log_buffer_count = 0;
+static std::atomic<u64> log_sequence = 0;
+
+// Held while printing, by the writer or by a thread flushing
+static std::atomic_flag log_print_lock = ATOMIC_FLAG_INIT;
+
+// Cleared at exit. From then on every message is printed when it is logged.
+static std::atomic<bool> log_writer_running = false;
+static std::once_flag log_writer_once;
+
+struct LogBufferOwner {
+    LogBuffer* buffer = nullptr;
+
+    ~LogBufferOwner() {
+        if (buffer != nullptr) {
+            buffer->owned.store(false, std::memory_order_release);
+            buffer = nullptr;
+        }
+    }
+};
+
+static thread_local LogBufferOwner t_log_buffer;
+
+static bool log_print_pending();
+
+static void log_writer_main() {
+    while (log_writer_running.load(std::memory_order_acquire)) {
+        if (!log_print_pending()) {
+            std::this_thread::sleep_for(LOG_WRITER_INTERVAL);
+        }
+    }
+}
+
+// Stops the writer once static destructors run and prints what is left
+static struct LogWriter {
+    std::thread thread;
+
+    void start() {
+        log_writer_running.store(true, std::memory_order_release);
+        thread = std::thread(log_writer_main);
+    }
+
+    ~LogWriter() {
+        if (thread.joinable()) {
+            log_writer_running.store(false, std::memory_order_release);
+            thread.join();
+        }
+        log_print_pending();
+    }
+} log_writer;
+
+static LogBuffer* log_claim_buffer() {
+    std::call_once(log_writer_once, [] { log_writer.start(); });
+
+    for (LogBuffer* buffer = log_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        bool owned = false;
+        if (!buffer->owned.load(std::memory_order_relaxed)
+            && buffer->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+            return buffer;
+        }
+    }
+
+    std::pmr::memory_resource* heap = get_tagged_heap(MemoryTag::LOG);
+    LogBuffer* buffer = new (heap->allocate(sizeof(LogBuffer), alignof(LogBuffer))) LogBuffer;
+    buffer->head.store(0, std::memory_order_relaxed);
+    buffer->reserved_head = 0;
+    buffer->cached_tail = 0;
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->tail.store(0, std::memory_order_relaxed);
+    buffer->owned.store(true, std::memory_order_relaxed);
+    buffer->id = log_buffer_count.fetch_add(1, std::memory_order_relaxed);
+
+    buffer->next = log_buffers.load(std::memory_order_relaxed);
+    while (!log_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return buffer;
+}
+
+LogRecord* log_begin(usize size) {
+    LogBuffer* buffer = t_log_buffer.buffer;
+    if (buffer == nullptr) {
+        buffer = t_log_buffer.buffer = log_claim_buffer();
+    }
+
+    size = (size + 7) & ~usize(7);
+    u64 head = buffer->head.load(std::memory_order_relaxed);
+    usize offset = static_cast<usize>(head & (LOG_BUFFER_SIZE - 1));
+    usize padding = offset + size > LOG_BUFFER_SIZE ? LOG_BUFFER_SIZE - offset : 0;
+
+    if (head + padding + size - buffer->cached_tail > LOG_BUFFER_SIZE) {
+        // Without the writer nothing else makes room
+        if (!log_writer_running.load(std::memory_order_relaxed)) {
+            log_print_pending();
+        }
+        buffer->cached_tail = buffer->tail.load(std::memory_order_acquire);
+        if (head + padding + size - buffer->cached_tail > LOG_BUFFER_SIZE) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+
+    if (padding > 0) {
+        LogRecord* filler = reinterpret_cast<LogRecord*>(buffer->data + offset);
+        filler->size = static_cast<u32>(padding);
+        filler->level = LOG_RECORD_PADDING;
+        head += padding;
+        offset = 0;
+    }
+
+    LogRecord* record = reinterpret_cast<LogRecord*>(buffer->data + offset);
+    record->size = static_cast<u32>(size);
+    record->sequence = log_sequence.fetch_add(1, std::memory_order_relaxed);
+    buffer->reserved_head = head + size;
+    return record;
+}
+
+void log_end() {
+    LogBuffer* buffer = t_log_buffer.buffer;
+    buffer->head.store(buffer->reserved_head, std::memory_order_release);
+
+    if (!log_writer_running.load(std::memory_order_relaxed)) {
+        log_print_pending();
+    }
+}
+
+static void log_print(qlogger::Logger& logger, u8 level, const char* message) {
+    switch (level) {
+    case LOG_LEVEL_TRACE:
+    case LOG_LEVEL_DEBUG:
+        logger.debug("%s", message);
+        break;
+    case LOG_LEVEL_INFO:
+        logger.info("%s", message);
+        break;
+    case LOG_LEVEL_WARN:
+        logger.warn("%s", message);
+        break;
+    case LOG_LEVEL_ERROR:
+        logger.error("%s", message);
+        break;
+    default:
+        logger.fatal("%s", message);
+        break;
+    }
+}
+
+// Next record of a buffer, skipping filler. Returns nullptr if it is empty.
+static const LogRecord* log_peek(LogBuffer* buffer) {
+    u64 tail = buffer->tail.load(std::memory_order_relaxed);
+    u64 head = buffer->head.load(std::memory_order_acquire);
+    while (tail != head) {
+        const LogRecord* record = reinterpret_cast<const LogRecord*>(buffer->data + (tail & (LOG_BUFFER_SIZE - 1)));
+        if (record->level != LOG_RECORD_PADDING) {
+            return record;
+        }
+        tail += record->size;
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+    return nullptr;
+}
+
+// Print the published records of every buffer, oldest first across
+// threads. Returns whether anything was printed.
+static bool log_print_pending() {
+    while (log_print_lock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    std::optional<qlogger::Logger> logger;
+    char message[LOG_MESSAGE_MAX];
+
+    while (true) {
+        LogBuffer* oldest = nullptr;
+        const LogRecord* oldest_record = nullptr;
+        for (LogBuffer* buffer = log_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+            const LogRecord* record = log_peek(buffer);
+            if (record != nullptr && (oldest_record == nullptr || record->sequence < oldest_record->sequence)) {
+                oldest = buffer;
+                oldest_record = record;
+            }
+        }
+
+        if (oldest == nullptr) {
+            break;
+        }
+
+        if (!logger) {
+            logger.emplace();
+        }
+
+        oldest_record->format_args(message, sizeof(message), oldest_record->format, reinterpret_cast<const u8*>(oldest_record + 1));
+        log_print(*logger, oldest_record->level, message);
+        oldest->tail.store(oldest->tail.load(std::memory_order_relaxed) + oldest_record->size, std::memory_order_release);
+    }
+
+    for (LogBuffer* buffer = log_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        u64 dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            if (!logger) {
+                logger.emplace();
+            }
+            logger->warn("Log: dropped %llu messages of thread %u, its buffer was full", static_cast<unsigned long long>(dropped), buffer->id);
+        }
+    }
+
+    log_print_lock.clear(std::memory_order_release);
+    return logger.has_value();
+}
+
+void log_flush() {
+    log_print_pending();
+}
+
+usize log_format_text(char* out, usize capacity, const char* format) {
+    usize length = 0;
+    for (const char* c = format; *c != '\0' && length + 1 < capacity; c++) {
+        if (c[0] == '%' && c[1] == '%') {
+            c++;
+        }
+        out[length++] = *c;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,272 @@
+#include "core/memory.h"
+#include "core/log.h"
+
+namespace bifrost {
+namespace core {
+
+constexpr usize MEMORY_TAG_COUNT = static_cast<usize>(MemoryTag::COUNT);
+
+static const char* memory_tag_names[MEMORY_TAG_COUNT] = {
+    "UNTAGGED",
+    "EVENTS",
+    "ECS",
+    "FRAME",
+    "WINDOW",
+    "INPUT",
+    "JOBS",
+    "PROFILER",
+    "LOG",
+    "RENDER",
+    "FILES"
+};
+
+struct MemoryTagCounters {
+    std::atomic<u64> live_bytes = 0;
+    std::atomic<u64> peak_bytes = 0;
+    std::atomic<u64> allocations = 0;
+    std::atomic<u64> frees = 0;
+};
+
+static MemoryTagCounters memory_counters[MEMORY_TAG_COUNT];
+
+static usize align_up(usize value, usize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+const char* memory_tag_name(MemoryTag tag) {
+    return tag < MemoryTag::COUNT ? memory_tag_names[static_cast<usize>(tag)] : "INVALID";
+}
+
+MemoryTagStats get_memory_stats(MemoryTag tag) {
+    flush_memory_counts();
+
+    const MemoryTagCounters& counters = memory_counters[static_cast<usize>(tag)];
+    i64 live = static_cast<i64>(counters.live_bytes.load(std::memory_order_relaxed));
+    return {
+        live > 0 ? static_cast<u64>(live) : 0,
+        counters.peak_bytes.load(std::memory_order_relaxed),
+        counters.allocations.load(std::memory_order_relaxed),
+        counters.frees.load(std::memory_order_relaxed)
+    };
+}
+
+// Log the stats of every tag that has allocated anything
+void log_memory_report() {
+    Q_LOG_INFO("Memory report:");
+    for (usize i = 0; i < MEMORY_TAG_COUNT; i++) {
+        MemoryTagStats stats = get_memory_stats(static_cast<MemoryTag>(i));
+        if (stats.allocations == 0) {
+            continue;
+        }
+
+        Q_LOG_INFO(
+            "    %-10s live %10llu  peak %10llu  allocs %8llu  frees %8llu",
+            memory_tag_names[i],
+            static_cast<unsigned long long>(stats.live_bytes),
+            static_cast<unsigned long long>(stats.peak_bytes),
+            static_cast<unsigned long long>(stats.allocations),
+            static_cast<unsigned long long>(stats.frees)
+        );
+    }
+}
+
+// One heap per tag, all on top of new and delete
+std::pmr::memory_resource* get_tagged_heap(MemoryTag tag) {
+    static TaggedHeap heaps[MEMORY_TAG_COUNT] = {
+        TaggedHeap(MemoryTag::UNTAGGED),
+        TaggedHeap(MemoryTag::EVENTS),
+        TaggedHeap(MemoryTag::ECS),
+        TaggedHeap(MemoryTag::FRAME),
+        TaggedHeap(MemoryTag::WINDOW),
+        TaggedHeap(MemoryTag::INPUT),
+        TaggedHeap(MemoryTag::JOBS),
+        TaggedHeap(MemoryTag::PROFILER),
+        TaggedHeap(MemoryTag::LOG),
+        TaggedHeap(MemoryTag::RENDER),
+        TaggedHeap(MemoryTag::FILES)
+    };
+
+    return &heaps[static_cast<usize>(tag)];
+}
+
+void memory_record(MemoryTag tag, i64 bytes, u64 allocations, u64 frees) {
+    MemoryTagCounters& counters = memory_counters[static_cast<usize>(tag)];
+    u64 live = counters.live_bytes.fetch_add(static_cast<u64>(bytes), std::memory_order_relaxed) + static_cast<u64>(bytes);
+    if (allocations > 0) {
+        counters.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    }
+    if (frees > 0) {
+        counters.frees.fetch_add(frees, std::memory_order_relaxed);
+    }
+
+    // Batched frees can be added before the allocations they free, so
+    // live bytes may briefly wrap below zero
+    if (bytes > 0 && static_cast<i64>(live) > 0) {
+        u64 peak = counters.peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+/// TaggedHeap ///
+
+// When global allocations are tracked, the operator new hook already
+// counts the upstream allocation, so the heap only has to set the tag
+void* TaggedHeap::do_allocate(usize bytes, usize alignment) {
+#ifdef BIFROST_TRACK_ALLOCATIONS
+    MemoryTagScope scope(m_tag);
+    return m_upstream->allocate(bytes, alignment);
+#else
+    void* pointer = m_upstream->allocate(bytes, alignment);
+    memory_record(m_tag, static_cast<i64>(bytes), 1, 0);
+    return pointer;
+#endif // BIFROST_TRACK_ALLOCATIONS
+}
+
+void TaggedHeap::do_deallocate(void* pointer, usize bytes, usize alignment) {
+#ifndef BIFROST_TRACK_ALLOCATIONS
+    memory_record(m_tag, -static_cast<i64>(bytes), 0, 1);
+#endif // BIFROST_TRACK_ALLOCATIONS
+
+    m_upstream->deallocate(pointer, bytes, alignment);
+}
+
+/// LinearArena ///
+
+LinearArena::LinearArena(usize capacity, std::pmr::memory_resource* upstream)
+    : m_upstream(upstream)
+    , m_block(static_cast<u8*>(upstream->allocate(capacity, alignof(std::max_align_t))))
+    , m_capacity(capacity)
+    , m_used(0)
+    , m_overflow_bytes(0)
+    , m_high_water(0)
+    , m_overflow(nullptr)
+{
+}
+
+LinearArena::~LinearArena() {
+    reset();
+    m_upstream->deallocate(m_block, m_capacity, alignof(std::max_align_t));
+}
+
+// Free everything allocated since the last reset
+void LinearArena::reset() {
+    usize overflow_bytes = m_overflow_bytes;
+
+    while (m_overflow != nullptr) {
+        Overflow* next = m_overflow->next;
+        usize header = align_up(sizeof(Overflow), m_overflow->alignment);
+        m_upstream->deallocate(m_overflow, header + m_overflow->bytes, m_overflow->alignment);
+        m_overflow = next;
+    }
+    m_overflow_bytes = 0;
+    m_used = 0;
+
+    // Grow so the frame that overflowed would have fit
+    if (overflow_bytes > 0) {
+        m_upstream->deallocate(m_block, m_capacity, alignof(std::max_align_t));
+        m_capacity = align_up(m_capacity + overflow_bytes, 4096);
+        m_block = static_cast<u8*>(m_upstream->allocate(m_capacity, alignof(std::max_align_t)));
+    }
+}
+
+void* LinearArena::do_allocate(usize bytes, usize alignment) {
+    usize offset = align_up(reinterpret_cast<usize>(m_block) + m_used, alignment) - reinterpret_cast<usize>(m_block);
+    if (offset + bytes <= m_capacity) {
+        m_used = offset + bytes;
+        m_high_water = m_used + m_overflow_bytes > m_high_water ? m_used + m_overflow_bytes : m_high_water;
+        return m_block + offset;
+    }
+
+    // Out of space, remember the allocation so reset can free it
+    alignment = alignment > alignof(Overflow) ? alignment : alignof(Overflow);
+    usize header = align_up(sizeof(Overflow), alignment);
+    u8* memory = static_cast<u8*>(m_upstream->allocate(header + bytes, alignment));
+
+    Overflow* overflow = reinterpret_cast<Overflow*>(memory);
+    overflow->next = m_overflow;
+    overflow->bytes = bytes;
+    overflow->alignment = alignment;
+    m_overflow = overflow;
+
+    m_overflow_bytes += bytes + alignment;
+    m_high_water = m_used + m_overflow_bytes > m_high_water ? m_used + m_overflow_bytes : m_high_water;
+    return memory + header;
+}
+
+void LinearArena::do_deallocate(void* pointer, usize bytes, usize alignment) {
+    // Released by reset
+    (void)pointer;
+    (void)bytes;
+    (void)alignment;
+}
+
+/// PoolResource ///
+
+PoolResource::PoolResource(usize block_size, usize block_alignment, usize blocks_per_page, std::pmr::memory_resource* upstream)
+    : m_upstream(upstream)
+    , m_block_alignment(block_alignment > alignof(FreeBlock) ? block_alignment : alignof(FreeBlock))
+    , m_blocks_per_page(blocks_per_page > 0 ? blocks_per_page : 1)
+    , m_blocks_in_use(0)
+    , m_free(nullptr)
+    , m_pages(nullptr)
+{
+    m_block_size = align_up(block_size > sizeof(FreeBlock) ? block_size : sizeof(FreeBlock), m_block_alignment);
+    m_page_header = align_up(sizeof(Page), m_block_alignment);
+}
+
+PoolResource::~PoolResource() {
+    usize page_size = m_page_header + m_block_size * m_blocks_per_page;
+    while (m_pages != nullptr) {
+        Page* next = m_pages->next;
+        m_upstream->deallocate(m_pages, page_size, m_block_alignment);
+        m_pages = next;
+    }
+}
+
+// Take a page from the upstream and put all of its blocks on the free list
+void PoolResource::_add_page() {
+    usize page_size = m_page_header + m_block_size * m_blocks_per_page;
+    u8* memory = static_cast<u8*>(m_upstream->allocate(page_size, m_block_alignment));
+
+    Page* page = reinterpret_cast<Page*>(memory);
+    page->next = m_pages;
+    m_pages = page;
+
+    // Link the blocks back to front so they are handed out in address order
+    for (usize i = m_blocks_per_page; i > 0; i--) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + m_page_header + (i - 1) * m_block_size);
+        block->next = m_free;
+        m_free = block;
+    }
+}
+
+void* PoolResource::do_allocate(usize bytes, usize alignment) {
+    if (bytes > m_block_size || alignment > m_block_alignment) {
+        return m_upstream->allocate(bytes, alignment);
+    }
+
+    if (m_free == nullptr) {
+        _add_page();
+    }
+
+    FreeBlock* block = m_free;
+    m_free = block->next;
+    m_blocks_in_use++;
+    return block;
+}
+
+void PoolResource::do_deallocate(void* pointer, usize bytes, usize alignment) {
+    if (bytes > m_block_size || alignment > m_block_alignment) {
+        m_upstream->deallocate(pointer, bytes, alignment);
+        return;
+    }
+
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = m_free;
+    m_free = block;
+    m_blocks_in_use--;
+}
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,457 @@
+#include "core/memory.h"
+#include "core/log.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef BIFROST_TRACK_ALLOCATIONS
+#ifdef Q_PLATFORM_WINDOWS
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <execinfo.h>
+#endif
+#endif // BIFROST_TRACK_ALLOCATIONS
+
+namespace bifrost {
+namespace core {
+
+// Tag the calling thread's heap allocations are counted under
+static thread_local MemoryTag t_memory_tag = MemoryTag::UNTAGGED;
+
+MemoryTag get_current_memory_tag() {
+    return t_memory_tag;
+}
+
+void set_current_memory_tag(MemoryTag tag) {
+    t_memory_tag = tag;
+}
+
+// Log the tags that still hold memory
+static void log_live_tags() {
+    for (usize i = 0; i < static_cast<usize>(MemoryTag::COUNT); i++) {
+        MemoryTagStats stats = get_memory_stats(static_cast<MemoryTag>(i));
+        if (stats.live_bytes == 0) {
+            continue;
+        }
+
+        Q_LOG_WARN(
+            "    %-10s %10llu bytes in %llu allocations",
+            memory_tag_name(static_cast<MemoryTag>(i)),
+            static_cast<unsigned long long>(stats.live_bytes),
+            static_cast<unsigned long long>(stats.allocations - stats.frees)
+        );
+    }
+}
+
+#ifdef BIFROST_TRACK_ALLOCATIONS
+
+// Frames kept of each sampled call stack
+constexpr usize ALLOCATION_STACK_DEPTH = 16;
+
+// Frames of the hooks themselves at the top of every captured stack
+constexpr usize ALLOCATION_STACK_SKIP = 2;
+
+// Distinct call stacks that can be recorded. Must be a power of two.
+constexpr usize ALLOCATION_SITE_CAPACITY = 4096;
+
+constexpr u32 ALLOCATION_SAMPLE_RATE_DEFAULT = 1024;
+
+constexpr u8 ALLOCATION_ALIGNED = 1 << 0;
+
+// Placed right before every pointer the hooks return. 16 bytes keeps the
+// default new alignment; larger alignments pad in front of the header.
+struct AllocationHeader {
+    u64 size;
+    u16 offset; // bytes from the start of the system block to the pointer
+    u8 tag;
+    u8 flags;
+    u32 site;   // index + 1 of the sampled call site, 0 if not sampled
+};
+
+static_assert(sizeof(AllocationHeader) == 16, "Memory: allocation header must stay 16 bytes");
+
+// A call stack that allocated. Counts only cover sampled allocations.
+struct AllocationSite {
+    u64 hash;
+    void* frames[ALLOCATION_STACK_DEPTH];
+    u32 frame_count;
+    MemoryTag tag;
+    u64 live_bytes;
+    u64 live_count;
+    u64 total_bytes;
+    u64 total_count;
+};
+
+static AllocationSite allocation_sites[ALLOCATION_SITE_CAPACITY];
+static std::atomic_flag allocation_sites_lock = ATOMIC_FLAG_INIT;
+static std::atomic<u32> allocation_sample_rate = ALLOCATION_SAMPLE_RATE_DEFAULT;
+
+// Allocations left before the thread samples the next one
+static thread_local u32 t_allocation_countdown = 0;
+
+// Set while a thread captures a stack, so allocations made by the
+// unwinder are not sampled in turn
+static thread_local bool t_allocation_sampling = false;
+
+// Counts of a thread's allocations not yet added to the shared stats.
+// Batching keeps the shared atomics off the path of every allocation.
+struct PendingCounts {
+    i64 bytes[static_cast<usize>(MemoryTag::COUNT)];
+    u64 allocations[static_cast<usize>(MemoryTag::COUNT)];
+    u64 frees[static_cast<usize>(MemoryTag::COUNT)];
+    u32 operations;
+    u32 interval;
+
+    void flush() {
+        for (usize i = 0; i < static_cast<usize>(MemoryTag::COUNT); i++) {
+            if (allocations[i] != 0 || frees[i] != 0) {
+                memory_record(static_cast<MemoryTag>(i), bytes[i], allocations[i], frees[i]);
+                bytes[i] = 0;
+                allocations[i] = 0;
+                frees[i] = 0;
+            }
+        }
+        operations = 0;
+    }
+
+    // Allocations made later by the thread's exit code are added at once
+    ~PendingCounts() {
+        flush();
+        interval = 1;
+    }
+};
+
+static thread_local PendingCounts t_pending = { {}, {}, {}, 0, ALLOCATION_FLUSH_INTERVAL };
+
+static void count_operation() {
+    if (++t_pending.operations >= t_pending.interval) {
+        t_pending.flush();
+    }
+}
+
+static void lock_sites() {
+    while (allocation_sites_lock.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+static void unlock_sites() {
+    allocation_sites_lock.clear(std::memory_order_release);
+}
+
+static u32 capture_stack(void** frames, u32 depth) {
+#ifdef Q_PLATFORM_WINDOWS
+    return CaptureStackBackTrace(ALLOCATION_STACK_SKIP, depth, frames, nullptr);
+#else
+    void* captured[ALLOCATION_STACK_DEPTH + ALLOCATION_STACK_SKIP];
+    int count = backtrace(captured, static_cast<int>(depth + ALLOCATION_STACK_SKIP));
+    u32 kept = count > static_cast<int>(ALLOCATION_STACK_SKIP) ? static_cast<u32>(count) - ALLOCATION_STACK_SKIP : 0;
+    for (u32 i = 0; i < kept; i++) {
+        frames[i] = captured[i + ALLOCATION_STACK_SKIP];
+    }
+    return kept;
+#endif
+}
+
+// Record a sampled allocation against its call stack. Returns the site
+// index + 1, or 0 if the site table is full.
+static u32 sample_allocation(MemoryTag tag, usize size) {
+    t_allocation_sampling = true;
+    void* frames[ALLOCATION_STACK_DEPTH];
+    u32 frame_count = capture_stack(frames, ALLOCATION_STACK_DEPTH);
+    t_allocation_sampling = false;
+
+    // FNV-1a over the return addresses and the tag
+    u64 hash = 14695981039346656037ull ^ static_cast<u64>(tag);
+    for (u32 i = 0; i < frame_count; i++) {
+        hash = (hash ^ reinterpret_cast<u64>(frames[i])) * 1099511628211ull;
+    }
+    hash |= 1; // 0 marks an empty site
+
+    u32 site = 0;
+    lock_sites();
+    for (usize probe = 0; probe < ALLOCATION_SITE_CAPACITY; probe++) {
+        usize index = (hash + probe) & (ALLOCATION_SITE_CAPACITY - 1);
+        AllocationSite& entry = allocation_sites[index];
+
+        if (entry.hash == 0) {
+            entry.hash = hash;
+            entry.frame_count = frame_count;
+            entry.tag = tag;
+            for (u32 i = 0; i < frame_count; i++) {
+                entry.frames[i] = frames[i];
+            }
+        } else if (entry.hash != hash) {
+            continue;
+        }
+
+        entry.live_bytes += size;
+        entry.live_count++;
+        entry.total_bytes += size;
+        entry.total_count++;
+        site = static_cast<u32>(index) + 1;
+        break;
+    }
+    unlock_sites();
+
+    return site;
+}
+
+static void release_sample(u32 site, usize size) {
+    lock_sites();
+    AllocationSite& entry = allocation_sites[site - 1];
+    entry.live_bytes -= size;
+    entry.live_count--;
+    unlock_sites();
+}
+
+static void* tracked_allocate(usize size, usize alignment) {
+    alignment = alignment > sizeof(AllocationHeader) ? alignment : sizeof(AllocationHeader);
+    usize offset = alignment;
+
+    u8* block;
+    if (alignment == sizeof(AllocationHeader)) {
+        block = static_cast<u8*>(std::malloc(offset + size));
+    } else {
+#ifdef Q_PLATFORM_WINDOWS
+        block = static_cast<u8*>(_aligned_malloc(offset + size, alignment));
+#else
+        block = static_cast<u8*>(std::aligned_alloc(alignment, (offset + size + alignment - 1) & ~(alignment - 1)));
+#endif
+    }
+
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    MemoryTag tag = t_memory_tag;
+    t_pending.bytes[static_cast<usize>(tag)] += static_cast<i64>(size);
+    t_pending.allocations[static_cast<usize>(tag)]++;
+    count_operation();
+
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(block + offset) - 1;
+    header->size = size;
+    header->offset = static_cast<u16>(offset);
+    header->tag = static_cast<u8>(tag);
+    header->flags = alignment == sizeof(AllocationHeader) ? 0 : ALLOCATION_ALIGNED;
+    header->site = 0;
+
+    // Sample one in every allocation_sample_rate allocations
+    if (t_allocation_countdown > 1) {
+        t_allocation_countdown--;
+    } else {
+        t_allocation_countdown = allocation_sample_rate.load(std::memory_order_relaxed);
+        if (t_allocation_countdown != 0 && !t_allocation_sampling) {
+            header->site = sample_allocation(tag, size);
+        }
+    }
+
+    return block + offset;
+}
+
+static void tracked_free(void* pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+    t_pending.bytes[header->tag] -= static_cast<i64>(header->size);
+    t_pending.frees[header->tag]++;
+    count_operation();
+    if (header->site != 0) {
+        release_sample(header->site, header->size);
+    }
+
+    u8* block = static_cast<u8*>(pointer) - header->offset;
+#ifdef Q_PLATFORM_WINDOWS
+    if (header->flags & ALLOCATION_ALIGNED) {
+        _aligned_free(block);
+        return;
+    }
+#endif
+    std::free(block);
+}
+
+// Throwing new retries through the new handler like the standard one
+static void* tracked_new(usize size, usize alignment) {
+    for (;;) {
+        void* pointer = tracked_allocate(size, alignment);
+        if (pointer != nullptr) {
+            return pointer;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void* tracked_new_nothrow(usize size, usize alignment) noexcept {
+    try {
+        return tracked_new(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void flush_memory_counts() {
+    t_pending.flush();
+}
+
+// Other threads pick the new rate up after their next sample
+void set_allocation_sample_rate(u32 rate) {
+    allocation_sample_rate.store(rate, std::memory_order_relaxed);
+    t_allocation_countdown = 0;
+}
+
+// Log the sampled sites with the most bytes, live or in total
+static void log_sites(usize max_sites, bool live_only) {
+    if (max_sites == 0) {
+        return;
+    }
+
+    // Taken from malloc, so neither the hooks nor the sites see it, and
+    // nothing is allocated while the lock is held
+    AllocationSite* top = static_cast<AllocationSite*>(std::malloc(sizeof(AllocationSite) * (max_sites + 1)));
+    if (top == nullptr) {
+        return;
+    }
+    usize top_count = 0;
+
+    auto weight = [live_only](const AllocationSite& site) {
+        return live_only ? site.live_bytes : site.total_bytes;
+    };
+
+    lock_sites();
+    for (const AllocationSite& site : allocation_sites) {
+        if (site.hash == 0 || weight(site) == 0) {
+            continue;
+        }
+
+        if (top_count == max_sites && weight(site) <= weight(top[top_count - 1])) {
+            continue;
+        }
+
+        // Insert sorted by weight, heaviest first
+        usize position = top_count;
+        while (position > 0 && weight(top[position - 1]) < weight(site)) {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position] = site;
+        top_count = top_count < max_sites ? top_count + 1 : max_sites;
+    }
+    unlock_sites();
+
+    u32 rate = allocation_sample_rate.load(std::memory_order_relaxed);
+    Q_LOG_INFO("    Sampled call sites (1 in %u allocations):", rate);
+    for (usize index = 0; index < top_count; index++) {
+        const AllocationSite& site = top[index];
+        Q_LOG_INFO(
+            "    %-10s live %10llu in %6llu  total %10llu in %6llu",
+            memory_tag_name(site.tag),
+            static_cast<unsigned long long>(site.live_bytes),
+            static_cast<unsigned long long>(site.live_count),
+            static_cast<unsigned long long>(site.total_bytes),
+            static_cast<unsigned long long>(site.total_count)
+        );
+
+#ifdef Q_PLATFORM_WINDOWS
+        for (u32 i = 0; i < site.frame_count; i++) {
+            Q_LOG_INFO("        %p", site.frames[i]);
+        }
+#else
+        char** symbols = backtrace_symbols(site.frames, static_cast<int>(site.frame_count));
+        for (u32 i = 0; i < site.frame_count; i++) {
+            Q_LOG_INFO("        %s", symbols != nullptr ? symbols[i] : "?");
+        }
+        std::free(symbols);
+#endif
+    }
+
+    std::free(top);
+}
+
+// Log the tags and the sampled call sites that allocated the most
+void log_allocation_report(usize max_sites) {
+    log_memory_report();
+
+    log_sites(max_sites, false);
+}
+
+// Log what is still allocated and where it came from
+void log_leak_report() {
+    Q_LOG_WARN("Memory still allocated:");
+    log_live_tags();
+    log_sites(32, true);
+}
+
+// Reports leaks once static destructors run at exit
+static struct LeakReporter {
+    ~LeakReporter() { log_leak_report(); }
+} leak_reporter;
+
+#else
+
+void flush_memory_counts() {
+}
+
+void set_allocation_sample_rate(u32 rate) {
+    (void)rate;
+}
+
+void log_allocation_report(usize max_sites) {
+    (void)max_sites;
+    log_memory_report();
+}
+
+// Without the hooks only memory taken through the tagged heaps is known
+void log_leak_report() {
+    Q_LOG_WARN("Memory still allocated:");
+    log_live_tags();
+}
+
+#endif // BIFROST_TRACK_ALLOCATIONS
+
+} // core namespace
+} // bifrost namespace
+
+#ifdef BIFROST_TRACK_ALLOCATIONS
+
+// Global allocation hooks. On Windows they only replace new and delete
+// for code linked into this module.
+
+using bifrost::core::tracked_free;
+using bifrost::core::tracked_new;
+using bifrost::core::tracked_new_nothrow;
+
+void* operator new(std::size_t size) { return tracked_new(size, 0); }
+void* operator new[](std::size_t size) { return tracked_new(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return tracked_new(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return tracked_new(size, static_cast<std::size_t>(alignment)); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return tracked_new_nothrow(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return tracked_new_nothrow(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return tracked_new_nothrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return tracked_new_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer) noexcept { tracked_free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { tracked_free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { tracked_free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { tracked_free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { tracked_free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { tracked_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { tracked_free(pointer); }
+
+#endif // BIFROST_TRACK_ALLOCATIONS
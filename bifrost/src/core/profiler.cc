@@ -0,0 +1,225 @@
+#include "core/profiler.h"
+#include "core/memory.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace bifrost {
+namespace core {
+
+static_assert((PROFILE_EVENTS_PER_THREAD & (PROFILE_EVENTS_PER_THREAD - 1)) == 0, "Profiler: events per thread must be a power of two");
+
+struct ProfileEvent {
+    const char* name;
+    u64 begin;
+    u64 end;
+};
+
+// Events of one thread. Only the owning thread writes to it; the count
+// is published with a release store so an export sees whole events.
+struct ProfileThread {
+    ProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+    std::atomic<u64> written;
+    u32 id;
+    char name[32];
+    ProfileThread* next;
+};
+
+struct ProfileFrame {
+    u64 frame;
+    u64 ticks;
+    u32 thread;
+};
+
+// Every thread that ever recorded. Buffers are never freed, so the scopes
+// of threads that exited can still be exported.
+static std::atomic<ProfileThread*> profile_threads = nullptr;
+static std::atomic<u32> profile_thread_count = 0;
+static thread_local ProfileThread* t_profile_thread = nullptr;
+
+// Names copied by profile_intern. Like the buffers they are never freed,
+// since recorded scopes keep pointing at them.
+struct ProfileName {
+    ProfileName* next;
+    char text[1];
+};
+
+static ProfileName* profile_names = nullptr;
+static std::mutex profile_names_lock;
+
+static ProfileFrame profile_frames[PROFILE_FRAME_HISTORY];
+static std::atomic<u64> profile_frame_count = 0;
+
+// Tick and time pair taken when profiling started, to turn ticks into time
+static u64 calibration_ticks;
+static u64 calibration_ns;
+static std::once_flag calibration_once;
+
+static ProfileThread* profile_register_thread() {
+    std::call_once(calibration_once, [] {
+        calibration_ticks = profile_ticks();
+        calibration_ns = platform_time_ns();
+    });
+
+    std::pmr::memory_resource* heap = get_tagged_heap(MemoryTag::PROFILER);
+    ProfileThread* thread = new (heap->allocate(sizeof(ProfileThread), alignof(ProfileThread))) ProfileThread;
+    thread->written.store(0, std::memory_order_relaxed);
+    thread->id = profile_thread_count.fetch_add(1, std::memory_order_relaxed);
+    std::snprintf(thread->name, sizeof(thread->name), "Thread %u", thread->id);
+
+    thread->next = profile_threads.load(std::memory_order_relaxed);
+    while (!profile_threads.compare_exchange_weak(thread->next, thread, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    t_profile_thread = thread;
+    return thread;
+}
+
+static ProfileThread* profile_get_thread() {
+    ProfileThread* thread = t_profile_thread;
+    return thread != nullptr ? thread : profile_register_thread();
+}
+
+void profile_record(const char* name, u64 begin_ticks, u64 end_ticks) {
+    ProfileThread* thread = profile_get_thread();
+    u64 index = thread->written.load(std::memory_order_relaxed);
+    thread->events[index & (PROFILE_EVENTS_PER_THREAD - 1)] = { name, begin_ticks, end_ticks };
+    thread->written.store(index + 1, std::memory_order_release);
+}
+
+const char* profile_intern(const char* name) {
+    std::lock_guard<std::mutex> lock(profile_names_lock);
+    for (ProfileName* interned = profile_names; interned != nullptr; interned = interned->next) {
+        if (std::strcmp(interned->text, name) == 0) {
+            return interned->text;
+        }
+    }
+
+    usize length = std::strlen(name);
+    std::pmr::memory_resource* heap = get_tagged_heap(MemoryTag::PROFILER);
+    ProfileName* interned = new (heap->allocate(sizeof(ProfileName) + length, alignof(ProfileName))) ProfileName;
+    std::memcpy(interned->text, name, length + 1);
+    interned->next = profile_names;
+    profile_names = interned;
+    return interned->text;
+}
+
+void profile_set_thread_name(const char* name) {
+    ProfileThread* thread = profile_get_thread();
+    std::snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+// Called from one thread, normally the main loop
+void profile_begin_frame(u64 frame) {
+    u64 index = profile_frame_count.load(std::memory_order_relaxed);
+    profile_frames[index % PROFILE_FRAME_HISTORY] = { frame, profile_ticks(), profile_get_thread()->id };
+    profile_frame_count.store(index + 1, std::memory_order_release);
+}
+
+// Names are written as JSON strings, so quotes and backslashes are escaped
+static void write_json_string(FILE* file, const char* text) {
+    std::fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            std::fputc('\\', file);
+        }
+        if (static_cast<unsigned char>(*c) >= 0x20) {
+            std::fputc(*c, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+bool profile_export_chrome_trace(const char* path, u64 first_frame, u64 last_frame) {
+    // Find the ticks the range starts and ends at among the kept frames
+    u64 frame_count = profile_frame_count.load(std::memory_order_acquire);
+    u64 oldest = frame_count > PROFILE_FRAME_HISTORY ? frame_count - PROFILE_FRAME_HISTORY : 0;
+
+    u64 range_begin = ~0ull;
+    u64 range_end = profile_ticks();
+    for (u64 i = oldest; i < frame_count; i++) {
+        const ProfileFrame& frame = profile_frames[i % PROFILE_FRAME_HISTORY];
+        if (frame.frame >= first_frame && frame.frame <= last_frame && frame.ticks < range_begin) {
+            range_begin = frame.ticks;
+        }
+        if (frame.frame > last_frame && frame.ticks < range_end) {
+            range_end = frame.ticks;
+        }
+    }
+
+    if (range_begin == ~0ull) {
+        return false;
+    }
+
+    FILE* file = std::fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Microseconds per tick, from the time that passed since calibration
+    u64 ticks_elapsed = profile_ticks() - calibration_ticks;
+    u64 ns_elapsed = platform_time_ns() - calibration_ns;
+    f64 us_per_tick = ticks_elapsed > 0 ? static_cast<f64>(ns_elapsed) / 1000.0 / static_cast<f64>(ticks_elapsed) : 0.001;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (ProfileThread* thread = profile_threads.load(std::memory_order_acquire); thread != nullptr; thread = thread->next) {
+        std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+        write_json_string(file, thread->name);
+        std::fprintf(file, "}}");
+        first = false;
+
+        u64 written = thread->written.load(std::memory_order_acquire);
+        u64 begin = written > PROFILE_EVENTS_PER_THREAD ? written - PROFILE_EVENTS_PER_THREAD : 0;
+        for (u64 i = begin; i < written; i++) {
+            ProfileEvent event = thread->events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+
+            // Skip the slots the thread may have overwritten while we read
+            if (i + PROFILE_EVENTS_PER_THREAD < thread->written.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            if (event.end < range_begin || event.begin >= range_end) {
+                continue;
+            }
+
+            std::fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"bifrost\",\"name\":");
+            write_json_string(file, event.name);
+            std::fprintf(
+                file,
+                ",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                thread->id,
+                static_cast<f64>(static_cast<i64>(event.begin - range_begin)) * us_per_tick,
+                static_cast<f64>(event.end - event.begin) * us_per_tick
+            );
+        }
+    }
+
+    // One span per frame, on the thread that marked it
+    for (u64 i = oldest; i < frame_count; i++) {
+        const ProfileFrame& frame = profile_frames[i % PROFILE_FRAME_HISTORY];
+        if (frame.frame < first_frame || frame.frame > last_frame) {
+            continue;
+        }
+
+        u64 end = i + 1 < frame_count ? profile_frames[(i + 1) % PROFILE_FRAME_HISTORY].ticks : range_end;
+        std::fprintf(
+            file,
+            ",\n{\"ph\":\"X\",\"cat\":\"frame\",\"name\":\"Frame %llu\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            static_cast<unsigned long long>(frame.frame),
+            frame.thread,
+            static_cast<f64>(frame.ticks - range_begin) * us_per_tick,
+            static_cast<f64>(end - frame.ticks) * us_per_tick
+        );
+    }
+
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+} // core namespace
+} // bifrost namespace
@@ -0,0 +1,323 @@
+#include "core/task_graph.h"
+#include "core/clock.h"
+#include "core/log.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+
+namespace bifrost {
+namespace core {
+
+// Whether two systems touch the same data with at least one writing it
+static bool systems_conflict(const TaskSystem& a, const TaskSystem& b) {
+    return (a.writes & (b.reads | b.writes)) != 0 || (b.writes & a.reads) != 0;
+}
+
+TaskGraph::TaskGraph()
+    : m_simulation_count(0)
+    , m_dirty(false)
+    , m_sequence(0)
+    , m_last_report({})
+{
+    for (FrameState& state : m_frames) {
+        state.frame = 0;
+        state.prepared = false;
+        state.started = false;
+    }
+}
+
+TaskGraph::~TaskGraph() {
+    wait_all();
+}
+
+// Register a resource
+ResourceMask TaskGraph::add_resource(const char* name) {
+    if (m_resource_names.size() >= TASK_GRAPH_MAX_RESOURCES) {
+        Q_LOG_ERROR("TaskGraph: cannot track more than %u resources", TASK_GRAPH_MAX_RESOURCES);
+        return 0;
+    }
+
+    m_resource_names.push_back(name);
+    return ResourceMask(1) << (m_resource_names.size() - 1);
+}
+
+// Add a system to the end of the frame
+u32 TaskGraph::add_system(
+    const char* name,
+    system_function function,
+    ResourceMask reads,
+    ResourceMask writes,
+    SystemStage stage
+) {
+    // Jobs of frames in flight index m_systems, and their reports are
+    // sized for the systems they started with
+    wait_all();
+
+    TaskSystem system = {};
+    system.name = name;
+    system.profile_name = profile_intern(name);
+    system.function = function;
+    system.reads = reads;
+    system.writes = writes;
+    system.stage = stage;
+
+    m_systems.push_back(system);
+    m_dirty = true;
+    return static_cast<u32>(m_systems.size() - 1);
+}
+
+// Start the frame's systems and wait for its simulation
+void TaskGraph::execute(u64 frame) {
+    if (m_systems.empty()) {
+        return;
+    }
+
+    JobSystem* jobs = JobSystem::get_reference();
+
+    if (m_dirty) {
+        wait_all();
+        _build();
+    }
+
+    FrameState& state = m_frames[m_sequence % TASK_GRAPH_FRAMES_IN_FLIGHT];
+    if (!state.prepared) {
+        _prepare_frame(state, false);
+    }
+    state.frame = frame;
+
+    // The next frame's slot last held the frame before the previous one.
+    // Its counters have to be ready before any system of this frame can
+    // finish and release systems of the next frame.
+    FrameState& next = m_frames[(m_sequence + 1) % TASK_GRAPH_FRAMES_IN_FLIGHT];
+    if (next.started) {
+        jobs->wait(next.all_done);
+        _finish_frame(next);
+    }
+    _prepare_frame(next, true);
+
+    // Each system holds one dependency on the start of its frame
+    state.started = true;
+    for (u32 i = 0; i < m_systems.size(); i++) {
+        _release(state, i);
+    }
+
+    m_sequence++;
+    jobs->wait(state.simulation_done);
+}
+
+// Wait until every frame in flight has finished
+void TaskGraph::wait_all() {
+    JobSystem* jobs = JobSystem::get_reference();
+
+    // Oldest frame first, so the last report is the newest frame
+    for (u64 age = TASK_GRAPH_FRAMES_IN_FLIGHT; age > 0; age--) {
+        FrameState& state = m_frames[(m_sequence + TASK_GRAPH_FRAMES_IN_FLIGHT - age) % TASK_GRAPH_FRAMES_IN_FLIGHT];
+        if (state.started) {
+            jobs->wait(state.all_done);
+            _finish_frame(state);
+        }
+    }
+}
+
+// Log the most recent report
+void TaskGraph::dump_report() {
+    const TaskGraphReport& report = m_last_report;
+
+    std::string path;
+    for (u32 system : report.critical_path) {
+        if (!path.empty()) {
+            path += " -> ";
+        }
+        path += m_systems[system].name;
+    }
+
+    Q_LOG_INFO(
+        "TaskGraph frame %llu: wall %.3fms, critical path %.3fms [%s], utilization %.1f%%",
+        static_cast<unsigned long long>(report.frame),
+        static_cast<f64>(report.wall_ns) / 1e6,
+        static_cast<f64>(report.critical_path_ns) / 1e6,
+        path.c_str(),
+        report.utilization * 100.0
+    );
+
+    for (usize i = 0; i < report.thread_busy_ns.size(); i++) {
+        f64 busy = report.wall_ns > 0
+            ? static_cast<f64>(report.thread_busy_ns[i]) / static_cast<f64>(report.wall_ns) * 100.0
+            : 0.0;
+        Q_LOG_INFO("    thread %zu: busy %.3fms (%.1f%%)", i, static_cast<f64>(report.thread_busy_ns[i]) / 1e6, busy);
+    }
+}
+
+// Work out the dependencies between systems from their resources
+void TaskGraph::_build() {
+    m_simulation_count = 0;
+    for (TaskSystem& system : m_systems) {
+        system.dependencies.clear();
+        system.dependents.clear();
+        system.next_frame_dependents.clear();
+        system.previous_frame_dependency_count = 0;
+        if (system.stage == SystemStage::SIMULATION) {
+            m_simulation_count++;
+        }
+    }
+
+    for (u32 i = 0; i < m_systems.size(); i++) {
+        for (u32 j = 0; j < i; j++) {
+            if (systems_conflict(m_systems[j], m_systems[i])) {
+                m_systems[i].dependencies.push_back(j);
+                m_systems[j].dependents.push_back(i);
+            }
+        }
+    }
+
+    // A system also never overlaps its own run in the previous frame
+    for (u32 j = 0; j < m_systems.size(); j++) {
+        for (u32 i = 0; i < m_systems.size(); i++) {
+            if (i == j || systems_conflict(m_systems[j], m_systems[i])) {
+                m_systems[j].next_frame_dependents.push_back(i);
+                m_systems[i].previous_frame_dependency_count++;
+            }
+        }
+    }
+
+    // Nothing is running after wait_all, but the next frame's slot is
+    // already prepared and its counters still count the old systems
+    for (FrameState& state : m_frames) {
+        state.simulation_done.reset();
+        state.all_done.reset();
+        state.pending = std::make_unique<std::atomic<u32>[]>(m_systems.size());
+        state.records.assign(m_systems.size(), {});
+        state.prepared = false;
+        state.started = false;
+    }
+
+    m_dirty = false;
+}
+
+// Reset a frame's counters before any system that can release it runs
+void TaskGraph::_prepare_frame(FrameState& state, bool after_previous) {
+    for (u32 i = 0; i < m_systems.size(); i++) {
+        const TaskSystem& system = m_systems[i];
+        u32 pending = static_cast<u32>(system.dependencies.size()) + 1;
+        if (after_previous) {
+            pending += system.previous_frame_dependency_count;
+        }
+        state.pending[i].store(pending, std::memory_order_relaxed);
+    }
+
+    state.simulation_done.add(m_simulation_count);
+    state.all_done.add(static_cast<u32>(m_systems.size()));
+    state.prepared = true;
+    state.started = false;
+}
+
+// Build the report of a frame whose systems have all finished
+void TaskGraph::_finish_frame(FrameState& state) {
+    // Filled in place so the vectors keep their capacity from frame to
+    // frame, and a steady frame does not touch the heap
+    TaskGraphReport& report = m_last_report;
+    report.frame = state.frame;
+    report.critical_path_ns = 0;
+    report.utilization = 0.0;
+
+    JobSystem* jobs = JobSystem::get_reference();
+    usize thread_count = jobs->is_initialized() ? jobs->get_thread_count() : 1;
+    report.thread_busy_ns.assign(thread_count, 0);
+
+    u64 first_start = ~0ull;
+    u64 last_end = 0;
+    u32 last_system = 0;
+    u64 busy_total = 0;
+    u32 system_count = static_cast<u32>(state.records.size());
+    for (u32 i = 0; i < system_count; i++) {
+        const TaskRecord& record = state.records[i];
+        u64 duration = record.end_ns - record.start_ns;
+
+        first_start = record.start_ns < first_start ? record.start_ns : first_start;
+        if (record.end_ns >= last_end) {
+            last_end = record.end_ns;
+            last_system = i;
+        }
+
+        if (record.thread < thread_count) {
+            report.thread_busy_ns[record.thread] += duration;
+        }
+        busy_total += duration;
+    }
+    report.wall_ns = last_end - first_start;
+
+    // Walk back from the system that ended last through the dependency
+    // that ended last, which is the one that let each system start
+    report.critical_path.clear();
+    u32 current = last_system;
+    while (system_count > 0) {
+        report.critical_path.push_back(current);
+        report.critical_path_ns += state.records[current].end_ns - state.records[current].start_ns;
+
+        const std::vector<u32>& dependencies = m_systems[current].dependencies;
+        if (dependencies.empty()) {
+            break;
+        }
+
+        u32 latest = dependencies[0];
+        for (u32 dependency : dependencies) {
+            if (state.records[dependency].end_ns > state.records[latest].end_ns) {
+                latest = dependency;
+            }
+        }
+        current = latest;
+    }
+    std::reverse(report.critical_path.begin(), report.critical_path.end());
+
+    if (report.wall_ns > 0) {
+        report.utilization = static_cast<f64>(busy_total) / (static_cast<f64>(report.wall_ns) * static_cast<f64>(thread_count));
+    }
+
+    state.started = false;
+    state.prepared = false;
+}
+
+// Drop one dependency of a system, and start it once none are left
+void TaskGraph::_release(FrameState& state, u32 system) {
+    if (state.pending[system].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    u64 slot = static_cast<u64>(&state - m_frames);
+    u64 packed = (slot << 32) | system;
+    TaskGraph* graph = this;
+    JobSystem::get_reference()->submit([graph, packed] {
+        graph->_run_system(graph->m_frames[packed >> 32], static_cast<u32>(packed));
+    });
+}
+
+void TaskGraph::_run_system(FrameState& state, u32 index) {
+    const TaskSystem& system = m_systems[index];
+    TaskRecord& record = state.records[index];
+
+    u32 thread = JobSystem::get_thread_index();
+    record.thread = thread == JOB_THREAD_EXTERNAL ? 0 : thread;
+    record.start_ns = platform_time_ns();
+    {
+        PROFILE_SCOPE(system.profile_name);
+        system.function(state.frame);
+    }
+    record.end_ns = platform_time_ns();
+
+    for (u32 dependent : system.dependents) {
+        _release(state, dependent);
+    }
+
+    FrameState& next = m_frames[(&state - m_frames + 1) % TASK_GRAPH_FRAMES_IN_FLIGHT];
+    for (u32 dependent : system.next_frame_dependents) {
+        _release(next, dependent);
+    }
+
+    if (system.stage == SystemStage::SIMULATION) {
+        state.simulation_done.finish();
+    }
+    state.all_done.finish();
+}
+
+} // core namespace
+} // bifrost namespace
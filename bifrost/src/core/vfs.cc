@@ -0,0 +1,1038 @@
+#include "core/vfs.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#ifdef Q_PLATFORM_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif Q_PLATFORM_WINDOWS
+#include <windows.h>
+#endif // Platform Detection macros
+
+namespace bifrost {
+namespace core {
+
+static_assert(sizeof(PakHeader) == 32 && sizeof(PakEntry) == 32, "VFS: pak structures must match the file layout");
+
+// Reads are split so each fits the u32 length of a read request
+constexpr usize VFS_MAX_READ = 1u << 30;
+
+// Room for a mount path, a separator and an engine path
+constexpr usize VFS_MAX_FULL_PATH = 2 * VFS_MAX_PATH + 2;
+
+// Files are handles on Windows and descriptors elsewhere, both kept in an
+// isize where -1 means none
+
+#ifdef Q_PLATFORM_LINUX
+
+static isize vfs_open(const char* path) {
+    return ::open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static void vfs_close(isize file) {
+    ::close(static_cast<int>(file));
+}
+
+static i64 vfs_file_size(isize file) {
+    struct stat info;
+    return fstat(static_cast<int>(file), &info) == 0 ? static_cast<i64>(info.st_size) : -1;
+}
+
+// Read until size bytes are in or the file ends
+static i64 vfs_read_at(isize file, void* buffer, usize size, u64 offset) {
+    usize done = 0;
+    while (done < size) {
+        ssize_t count = pread(static_cast<int>(file), static_cast<u8*>(buffer) + done, std::min(size - done, VFS_MAX_READ), static_cast<off_t>(offset + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        done += static_cast<usize>(count);
+    }
+    return static_cast<i64>(done);
+}
+
+static bool vfs_is_directory(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool vfs_is_file(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+#elif Q_PLATFORM_WINDOWS
+
+static isize vfs_open(const char* path) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return reinterpret_cast<isize>(file);
+}
+
+static void vfs_close(isize file) {
+    CloseHandle(reinterpret_cast<HANDLE>(file));
+}
+
+static i64 vfs_file_size(isize file) {
+    LARGE_INTEGER size;
+    return GetFileSizeEx(reinterpret_cast<HANDLE>(file), &size) ? static_cast<i64>(size.QuadPart) : -1;
+}
+
+// Read until size bytes are in or the file ends. The offset goes in the
+// OVERLAPPED, so threads can share a handle.
+static i64 vfs_read_at(isize file, void* buffer, usize size, u64 offset) {
+    usize done = 0;
+    while (done < size) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset + done);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD count = 0;
+        DWORD request = static_cast<DWORD>(std::min(size - done, VFS_MAX_READ));
+        if (!ReadFile(reinterpret_cast<HANDLE>(file), static_cast<u8*>(buffer) + done, request, &count, &overlapped)) {
+            return GetLastError() == ERROR_HANDLE_EOF ? static_cast<i64>(done) : -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        done += count;
+    }
+    return static_cast<i64>(done);
+}
+
+static bool vfs_is_directory(const char* path) {
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+static bool vfs_is_file(const char* path) {
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+#endif // Platform Detection macros
+
+usize vfs_normalize_path(const char* path, char* out, usize capacity) {
+    usize length = 0;
+    const char* c = path;
+    while (*c != '\0') {
+        // The next part of the path, up to a separator
+        const char* part = c;
+        while (*c != '\0' && *c != '/' && *c != '\\') {
+            c++;
+        }
+        usize part_length = static_cast<usize>(c - part);
+        if (*c != '\0') {
+            c++;
+        }
+
+        if (part_length == 0 || (part_length == 1 && part[0] == '.')) {
+            continue;
+        }
+        if (part_length == 2 && part[0] == '.' && part[1] == '.') {
+            return 0;
+        }
+
+        usize separator = length > 0 ? 1 : 0;
+        if (length + separator + part_length + 1 > capacity) {
+            return 0;
+        }
+        if (separator) {
+            out[length++] = '/';
+        }
+        std::memcpy(out + length, part, part_length);
+        length += part_length;
+    }
+
+    if (length > 0) {
+        out[length] = '\0';
+    }
+    return length;
+}
+
+u64 vfs_hash_path(const char* path, usize length) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (usize i = 0; i < length; i++) {
+        hash ^= static_cast<u8>(path[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Files inside a pak, in the order they are written
+struct PakSource {
+    std::string path; // engine path
+    std::filesystem::path source;
+    u64 hash;
+    u64 size;
+};
+
+bool pak_build(const char* directory, const char* pak_path) {
+    MemoryTagScope memory_scope(MemoryTag::FILES);
+
+    std::error_code error;
+    std::vector<PakSource> sources;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file(error)) {
+            continue;
+        }
+
+        char path[VFS_MAX_PATH];
+        std::string relative = it->path().lexically_relative(directory).generic_string();
+        usize length = vfs_normalize_path(relative.c_str(), path, sizeof(path));
+        if (length == 0) {
+            Q_LOG_WARN("VFS: skipping '%s', its path is too long", relative.c_str());
+            continue;
+        }
+
+        sources.push_back({ std::string(path, length), it->path(), vfs_hash_path(path, length), static_cast<u64>(it->file_size(error)) });
+    }
+
+    if (error) {
+        Q_LOG_ERROR("VFS: failed to list '%s': %s", directory, error.message().c_str());
+        return false;
+    }
+
+    // Sorted by hash for lookups, and by path for a stable layout
+    std::sort(sources.begin(), sources.end(), [](const PakSource& a, const PakSource& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.path < b.path;
+    });
+
+    PakHeader header = {};
+    std::memcpy(header.magic, PAK_MAGIC, sizeof(PAK_MAGIC));
+    header.version = PAK_VERSION;
+    header.entry_count = static_cast<u32>(sources.size());
+    header.paths_offset = sizeof(PakHeader) + sources.size() * sizeof(PakEntry);
+
+    std::vector<PakEntry> entries(sources.size());
+    u64 paths_size = 0;
+    for (usize i = 0; i < sources.size(); i++) {
+        entries[i].path_hash = sources[i].hash;
+        entries[i].size = sources[i].size;
+        entries[i].path_offset = static_cast<u32>(paths_size);
+        entries[i].path_length = static_cast<u32>(sources[i].path.size());
+        paths_size += sources[i].path.size() + 1;
+    }
+    if (paths_size > ~0u) {
+        Q_LOG_ERROR("VFS: too many paths in '%s' for one pak", directory);
+        return false;
+    }
+
+    u64 offset = (header.paths_offset + paths_size + PAK_DATA_ALIGNMENT - 1) & ~u64(PAK_DATA_ALIGNMENT - 1);
+    header.data_offset = offset;
+    for (PakEntry& entry : entries) {
+        entry.offset = offset;
+        offset = (offset + entry.size + PAK_DATA_ALIGNMENT - 1) & ~u64(PAK_DATA_ALIGNMENT - 1);
+    }
+
+    FILE* file = std::fopen(pak_path, "wb");
+    if (file == nullptr) {
+        Q_LOG_ERROR("VFS: failed to create '%s'", pak_path);
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (entries.empty() || std::fwrite(entries.data(), sizeof(PakEntry), entries.size(), file) == entries.size());
+    for (const PakSource& source : sources) {
+        ok = ok && std::fwrite(source.path.c_str(), 1, source.path.size() + 1, file) == source.path.size() + 1;
+    }
+
+    // Contents are copied in, padded to the next file's alignment
+    static const u8 padding[PAK_DATA_ALIGNMENT] = {};
+    u64 written = header.paths_offset + paths_size;
+    std::vector<u8> contents;
+    for (usize i = 0; i < sources.size() && ok; i++) {
+        ok = std::fwrite(padding, 1, entries[i].offset - written, file) == entries[i].offset - written;
+
+        contents.resize(entries[i].size);
+        FILE* source = std::fopen(sources[i].source.string().c_str(), "rb");
+        ok = ok && source != nullptr && std::fread(contents.data(), 1, contents.size(), source) == contents.size();
+        if (source != nullptr) {
+            std::fclose(source);
+        }
+
+        ok = ok && std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        written = entries[i].offset + entries[i].size;
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        Q_LOG_ERROR("VFS: failed to write '%s'", pak_path);
+        return false;
+    }
+
+    Q_LOG_INFO("VFS: packed %zu files from '%s' into '%s'", sources.size(), directory, pak_path);
+    return true;
+}
+
+PakArchive::~PakArchive() {
+    close();
+}
+
+// Map the archive. The descriptor stays open for async reads.
+bool PakArchive::open(const char* path) {
+    close();
+
+#ifdef Q_PLATFORM_LINUX
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<usize>(info.st_size) < sizeof(PakHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<usize>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    m_data = static_cast<const u8*>(data);
+    m_size = static_cast<usize>(info.st_size);
+    m_file = fd;
+#elif Q_PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || static_cast<usize>(file_size.QuadPart) < sizeof(PakHeader)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_data = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_mapping_handle = mapping;
+    m_file = reinterpret_cast<isize>(file);
+    m_size = static_cast<usize>(file_size.QuadPart);
+#endif // Platform Detection macros
+
+    // Check everything a lookup or view relies on once, up front
+    const PakHeader* header = reinterpret_cast<const PakHeader*>(m_data);
+    u64 table_end = sizeof(PakHeader) + static_cast<u64>(header->entry_count) * sizeof(PakEntry);
+    bool valid = std::memcmp(header->magic, PAK_MAGIC, sizeof(PAK_MAGIC)) == 0
+        && header->version == PAK_VERSION
+        && table_end <= header->paths_offset
+        && header->paths_offset <= header->data_offset
+        && header->data_offset <= m_size;
+
+    const PakEntry* entries = reinterpret_cast<const PakEntry*>(m_data + sizeof(PakHeader));
+    u64 paths_size = valid ? header->data_offset - header->paths_offset : 0;
+    for (u32 i = 0; valid && i < header->entry_count; i++) {
+        const PakEntry& entry = entries[i];
+        valid = static_cast<u64>(entry.path_offset) + entry.path_length < paths_size
+            && entry.offset >= header->data_offset
+            && entry.offset <= m_size
+            && entry.size <= m_size - entry.offset
+            && (i == 0 || entries[i - 1].path_hash <= entry.path_hash);
+    }
+
+    if (!valid) {
+        Q_LOG_ERROR("VFS: '%s' is not a valid pak archive", path);
+        close();
+        return false;
+    }
+
+    m_entries = entries;
+    m_entry_count = header->entry_count;
+
+#ifdef Q_PLATFORM_LINUX
+    // Every lookup searches the table
+    madvise(const_cast<u8*>(m_data), static_cast<usize>(header->data_offset), MADV_WILLNEED);
+#endif // Q_PLATFORM_LINUX
+
+    return true;
+}
+
+void PakArchive::close() {
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef Q_PLATFORM_LINUX
+    munmap(const_cast<u8*>(m_data), m_size);
+    ::close(static_cast<int>(m_file));
+#elif Q_PLATFORM_WINDOWS
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+    CloseHandle(reinterpret_cast<HANDLE>(m_file));
+    m_mapping_handle = nullptr;
+#endif // Platform Detection macros
+
+    m_data = nullptr;
+    m_size = 0;
+    m_entries = nullptr;
+    m_entry_count = 0;
+    m_file = -1;
+}
+
+// Binary search for the hash, then compare paths among equal hashes
+const PakEntry* PakArchive::find(const char* path, usize length) const {
+    u64 hash = vfs_hash_path(path, length);
+    const PakEntry* end = m_entries + m_entry_count;
+    const PakEntry* entry = std::lower_bound(m_entries, end, hash, [](const PakEntry& e, u64 h) { return e.path_hash < h; });
+    for (; entry != end && entry->path_hash == hash; entry++) {
+        if (entry->path_length == length && std::memcmp(get_path(*entry), path, length) == 0) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+const char* PakArchive::get_path(const PakEntry& entry) const {
+    const PakHeader* header = reinterpret_cast<const PakHeader*>(m_data);
+    return reinterpret_cast<const char*>(m_data + header->paths_offset + entry.path_offset);
+}
+
+FileView::FileView(FileView&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+    , m_owned(other.m_owned)
+    , m_valid(other.m_valid)
+{
+    other.m_owned = nullptr;
+    other._release();
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept {
+    if (this != &other) {
+        _release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_owned = other.m_owned;
+        m_valid = other.m_valid;
+        other.m_owned = nullptr;
+        other._release();
+    }
+    return *this;
+}
+
+FileView::~FileView() {
+    _release();
+}
+
+void FileView::_release() {
+    if (m_owned != nullptr) {
+        get_tagged_heap(MemoryTag::FILES)->deallocate(m_owned, m_size, PAK_DATA_ALIGNMENT);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_owned = nullptr;
+    m_valid = false;
+}
+
+// Virtual file system singleton
+VirtualFileSystem* VirtualFileSystem::vfs_instance = nullptr;
+
+// Return a pointer reference to the singleton instance. read_async is
+// called from any thread, so the file system is created under the thread
+// safe initialization of a local static.
+VirtualFileSystem* VirtualFileSystem::get_reference() {
+    static VirtualFileSystem* instance = [] {
+        vfs_instance = new VirtualFileSystem();
+        return vfs_instance;
+    }();
+
+    return instance;
+}
+
+VirtualFileSystem::~VirtualFileSystem() {
+    shutdown();
+    for (Mount& mount : m_mounts) {
+        delete mount.pak;
+    }
+}
+
+bool VirtualFileSystem::mount(const char* path, const char* prefix) {
+    MemoryTagScope memory_scope(MemoryTag::FILES);
+
+    Mount mount;
+    mount.path = path;
+    mount.pak = nullptr;
+
+    char normalized[VFS_MAX_PATH];
+    usize length = vfs_normalize_path(prefix, normalized, sizeof(normalized));
+    if (length == 0 && prefix[0] != '\0' && std::strcmp(prefix, "/") != 0) {
+        Q_LOG_ERROR("VFS: invalid mount prefix '%s'", prefix);
+        return false;
+    }
+    if (length > 0) {
+        mount.prefix.assign(normalized, length);
+        mount.prefix.push_back('/');
+    }
+
+    if (!vfs_is_directory(path)) {
+        mount.pak = new PakArchive();
+        if (!mount.pak->open(path)) {
+            Q_LOG_ERROR("VFS: failed to mount '%s'", path);
+            delete mount.pak;
+            return false;
+        }
+    }
+
+    std::unique_lock lock(m_mounts_lock);
+    m_mounts.push_back(mount);
+    Q_LOG_INFO(
+        "VFS: mounted %s '%s' at '/%s'",
+        mount.pak != nullptr ? "pak" : "directory", path, mount.prefix.c_str()
+    );
+    return true;
+}
+
+bool VirtualFileSystem::unmount(const char* path) {
+    PakArchive* pak = nullptr;
+    {
+        std::unique_lock lock(m_mounts_lock);
+        usize i = m_mounts.size();
+        while (i > 0 && m_mounts[i - 1].path != path) {
+            i--;
+        }
+        if (i == 0) {
+            Q_LOG_WARN("VFS: '%s' is not mounted", path);
+            return false;
+        }
+
+        pak = m_mounts[i - 1].pak;
+        m_mounts.erase(m_mounts.begin() + static_cast<isize>(i - 1));
+    }
+
+    // No read can find the pak anymore, so only those counted already
+    // can still be using its descriptor
+    if (pak != nullptr) {
+        u32 reads = pak->m_async_reads.load(std::memory_order_acquire);
+        while (reads != 0) {
+            pak->m_async_reads.wait(reads, std::memory_order_acquire);
+            reads = pak->m_async_reads.load(std::memory_order_acquire);
+        }
+        delete pak;
+    }
+    return true;
+}
+
+// Search the mounts, newest first. Loose files are opened when asked for,
+// and only checked for otherwise.
+bool VirtualFileSystem::_locate(const char* path, Location& location, bool open_file, bool async_read) {
+    char normalized[VFS_MAX_PATH];
+    usize length = vfs_normalize_path(path, normalized, sizeof(normalized));
+    if (length == 0) {
+        return false;
+    }
+
+    location = { nullptr, nullptr, -1 };
+
+    std::shared_lock lock(m_mounts_lock);
+    for (usize i = m_mounts.size(); i > 0; i--) {
+        const Mount& mount = m_mounts[i - 1];
+        if (length <= mount.prefix.size() || std::memcmp(normalized, mount.prefix.data(), mount.prefix.size()) != 0) {
+            continue;
+        }
+
+        const char* relative = normalized + mount.prefix.size();
+        usize relative_length = length - mount.prefix.size();
+
+        if (mount.pak != nullptr) {
+            location.entry = mount.pak->find(relative, relative_length);
+            if (location.entry != nullptr) {
+                location.pak = mount.pak;
+                if (async_read) {
+                    mount.pak->m_async_reads.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+            continue;
+        }
+
+        char full_path[VFS_MAX_FULL_PATH];
+        std::snprintf(full_path, sizeof(full_path), "%s/%s", mount.path.c_str(), relative);
+        if (!open_file) {
+            if (vfs_is_file(full_path)) {
+                return true;
+            }
+            continue;
+        }
+
+        location.file = vfs_open(full_path);
+        if (location.file != -1) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool VirtualFileSystem::exists(const char* path) {
+    Location location;
+    return _locate(path, location, false, false);
+}
+
+FileView VirtualFileSystem::read(const char* path) {
+    PROFILE_SCOPE("VirtualFileSystem::read");
+
+    FileView view;
+    Location location;
+    if (!_locate(path, location, true, false)) {
+        return view;
+    }
+
+    if (location.pak != nullptr) {
+        view.m_data = location.pak->get_contents(*location.entry);
+        view.m_size = static_cast<usize>(location.entry->size);
+        view.m_valid = true;
+        return view;
+    }
+
+    i64 size = vfs_file_size(location.file);
+    if (size > 0) {
+        view.m_owned = static_cast<u8*>(get_tagged_heap(MemoryTag::FILES)->allocate(static_cast<usize>(size), PAK_DATA_ALIGNMENT));
+        view.m_size = static_cast<usize>(size);
+        view.m_data = view.m_owned;
+
+        // A file that shrank since it was measured keeps the size it had
+        i64 count = vfs_read_at(location.file, view.m_owned, view.m_size, 0);
+        if (count < 0) {
+            Q_LOG_ERROR("VFS: failed to read '%s'", path);
+            vfs_close(location.file);
+            view._release();
+            return view;
+        }
+        std::memset(view.m_owned + count, 0, view.m_size - static_cast<usize>(count));
+    }
+
+    vfs_close(location.file);
+    view.m_valid = size >= 0;
+    return view;
+}
+
+bool VirtualFileSystem::read_async(const char* path, AsyncRead& request, JobCounter& counter) {
+    PROFILE_SCOPE("VirtualFileSystem::read_async");
+
+    Location location;
+    if (!_locate(path, location, true, true)) {
+        return false;
+    }
+
+    u64 file_size;
+    request.pak = location.pak;
+    if (location.pak != nullptr) {
+        request.file = location.pak->get_file_handle();
+        request.file_offset = location.entry->offset;
+        request.owns_file = false;
+        file_size = location.entry->size;
+    } else {
+        request.file = location.file;
+        request.file_offset = 0;
+        request.owns_file = true;
+        i64 size = vfs_file_size(location.file);
+        file_size = size > 0 ? static_cast<u64>(size) : 0;
+    }
+
+    // Reads stop at the end of the file, as they would for a loose file
+    // that is longer than the pak entry
+    if (request.offset >= file_size) {
+        request.size = 0;
+    } else if (request.size > file_size - request.offset) {
+        request.size = static_cast<usize>(file_size - request.offset);
+    }
+
+    std::call_once(m_start_once, [this] { _start(); });
+    if (!m_running.load(std::memory_order_acquire)) {
+        _refuse(path, request);
+        return false;
+    }
+
+    request.result = 0;
+    request.completed = 0;
+    request.counter = &counter;
+    request.next = nullptr;
+
+    if (request.size == 0) {
+        counter.add(1);
+        _complete(request, 0);
+        return true;
+    }
+
+    if (m_ring != nullptr) {
+        // Take a slot, keeping the completions within the ring. Whoever
+        // waits here runs no jobs, but reads in flight finish on their own.
+        u32 in_flight = m_in_flight.load(std::memory_order_relaxed);
+        do {
+            while (in_flight >= VFS_ASYNC_QUEUE_DEPTH) {
+                std::this_thread::yield();
+                in_flight = m_in_flight.load(std::memory_order_relaxed);
+            }
+        } while (!m_in_flight.compare_exchange_weak(in_flight, in_flight + 1));
+
+        // Shutdown stops accepting reads before it waits for the slots to
+        // be returned, so either it waits for this read or this sees it
+        if (!m_running.load()) {
+            m_in_flight.fetch_sub(1, std::memory_order_release);
+            _refuse(path, request);
+            return false;
+        }
+
+        counter.add(1);
+        if (!_submit_io_uring(request)) {
+            m_in_flight.fetch_sub(1, std::memory_order_release);
+            _complete(request, -1);
+        }
+        return true;
+    }
+
+    {
+        // Checked under the lock, since the readers exit once they see
+        // shutdown with the queue empty
+        std::unique_lock lock(m_queue_lock);
+        if (!m_running.load(std::memory_order_relaxed)) {
+            lock.unlock();
+            _refuse(path, request);
+            return false;
+        }
+
+        counter.add(1);
+        if (m_queue_tail != nullptr) {
+            m_queue_tail->next = &request;
+        } else {
+            m_queue_head = &request;
+        }
+        m_queue_tail = &request;
+    }
+    m_queue_ready.notify_one();
+    return true;
+}
+
+// A read that arrived after shutdown. The descriptor it opened is closed.
+void VirtualFileSystem::_refuse(const char* path, AsyncRead& request) {
+    if (request.owns_file) {
+        vfs_close(request.file);
+    }
+    _release_pak(request);
+    Q_LOG_WARN("VFS: async read of '%s' after shutdown", path);
+}
+
+// The read no longer uses the descriptor of its pak
+void VirtualFileSystem::_release_pak(AsyncRead& request) {
+    PakArchive* pak = request.pak;
+    request.pak = nullptr;
+    if (pak != nullptr && pak->m_async_reads.fetch_sub(1, std::memory_order_release) == 1) {
+        pak->m_async_reads.notify_all();
+    }
+}
+
+// Close what the read opened and tell whoever waits. The request may be
+// gone as soon as the counter is finished.
+void VirtualFileSystem::_complete(AsyncRead& request, i64 result) {
+    JobCounter* counter = request.counter;
+    request.result = result;
+    if (request.owns_file) {
+        vfs_close(request.file);
+        request.file = -1;
+        request.owns_file = false;
+    }
+    _release_pak(request);
+    counter->finish();
+}
+
+void VirtualFileSystem::_start() {
+    MemoryTagScope memory_scope(MemoryTag::FILES);
+
+    m_running.store(true, std::memory_order_release);
+    const char* requested = std::getenv("BIFROST_VFS_ASYNC");
+    bool use_threads = requested != nullptr && std::strcmp(requested, "threads") == 0;
+    if (!use_threads && _init_io_uring()) {
+        m_threads.emplace_back([this] { _completion_main(); });
+        Q_LOG_INFO("VFS: async reads use io_uring");
+        return;
+    }
+
+    for (u32 i = 0; i < VFS_READER_THREADS; i++) {
+        m_threads.emplace_back([this] { _reader_main(); });
+    }
+    Q_LOG_INFO("VFS: async reads use %u reader threads", VFS_READER_THREADS);
+}
+
+void VirtualFileSystem::_reader_main() {
+    PROFILE_THREAD("VFS Reader");
+
+    while (true) {
+        AsyncRead* request;
+        {
+            std::unique_lock lock(m_queue_lock);
+            m_queue_ready.wait(lock, [this] { return m_queue_head != nullptr || !m_running.load(std::memory_order_relaxed); });
+            if (m_queue_head == nullptr) {
+                return;
+            }
+
+            request = m_queue_head;
+            m_queue_head = request->next;
+            if (m_queue_head == nullptr) {
+                m_queue_tail = nullptr;
+            }
+        }
+
+        PROFILE_SCOPE("VFS::read_at");
+        i64 result = vfs_read_at(request->file, request->buffer, request->size, request->file_offset + request->offset);
+        _complete(*request, result);
+    }
+}
+
+#if defined(Q_PLATFORM_LINUX) && defined(__NR_io_uring_setup)
+
+// The rings io_uring_setup maps. Head and tail indices are shared with the
+// kernel, so they are accessed atomically.
+struct VfsRing {
+    int fd;
+    u8* rings;
+    usize rings_size;
+    io_uring_sqe* sqes;
+    usize sqes_size;
+
+    u32* sq_head;
+    u32* sq_tail;
+    u32 sq_mask;
+    u32* sq_array;
+
+    u32* cq_head;
+    u32* cq_tail;
+    u32 cq_mask;
+    io_uring_cqe* cqes;
+};
+
+static int vfs_ring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+bool VirtualFileSystem::_init_io_uring() {
+    io_uring_params params = {};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, VFS_ASYNC_QUEUE_DEPTH, &params));
+    if (fd < 0) {
+        Q_LOG_DEBUG("VFS: io_uring_setup failed (errno %d)", errno);
+        return false;
+    }
+
+    // IORING_OP_READ came with the same kernel as IORING_FEAT_RW_CUR_POS
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    usize sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    usize cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    usize rings_size = std::max(sq_size, cq_size);
+    void* rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    usize sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(rings, rings_size);
+        ::close(fd);
+        return false;
+    }
+
+    u8* base = static_cast<u8*>(rings);
+    m_ring = new VfsRing();
+    m_ring->fd = fd;
+    m_ring->rings = base;
+    m_ring->rings_size = rings_size;
+    m_ring->sqes = static_cast<io_uring_sqe*>(sqes);
+    m_ring->sqes_size = sqes_size;
+    m_ring->sq_head = reinterpret_cast<u32*>(base + params.sq_off.head);
+    m_ring->sq_tail = reinterpret_cast<u32*>(base + params.sq_off.tail);
+    m_ring->sq_mask = *reinterpret_cast<u32*>(base + params.sq_off.ring_mask);
+    m_ring->sq_array = reinterpret_cast<u32*>(base + params.sq_off.array);
+    m_ring->cq_head = reinterpret_cast<u32*>(base + params.cq_off.head);
+    m_ring->cq_tail = reinterpret_cast<u32*>(base + params.cq_off.tail);
+    m_ring->cq_mask = *reinterpret_cast<u32*>(base + params.cq_off.ring_mask);
+    m_ring->cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    return true;
+}
+
+// Queue a read of what is left of the request, or a wakeup for the
+// completion thread when request is null
+static bool vfs_ring_submit(VfsRing* ring, std::mutex& submit_lock, AsyncRead* request) {
+    std::lock_guard lock(submit_lock);
+
+    // The kernel consumes submissions inside io_uring_enter, so the
+    // queue always has room here
+    u32 tail = std::atomic_ref<u32>(*ring->sq_tail).load(std::memory_order_relaxed);
+    u32 index = tail & ring->sq_mask;
+    io_uring_sqe* sqe = &ring->sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    if (request != nullptr) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = static_cast<int>(request->file);
+        sqe->off = request->file_offset + request->offset + request->completed;
+        sqe->addr = reinterpret_cast<u64>(static_cast<u8*>(request->buffer) + request->completed);
+        sqe->len = static_cast<u32>(std::min(request->size - request->completed, VFS_MAX_READ));
+        sqe->user_data = reinterpret_cast<u64>(request);
+    } else {
+        sqe->opcode = IORING_OP_NOP;
+    }
+
+    ring->sq_array[index] = index;
+    std::atomic_ref<u32>(*ring->sq_tail).store(tail + 1, std::memory_order_release);
+
+    while (true) {
+        int submitted = vfs_ring_enter(ring->fd, 1, 0, 0);
+        if (submitted >= 0) {
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            Q_LOG_ERROR("VFS: io_uring_enter failed (errno %d)", errno);
+            return false;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool VirtualFileSystem::_submit_io_uring(AsyncRead& request) {
+    return vfs_ring_submit(m_ring, m_submit_lock, &request);
+}
+
+// Reap completions. Short reads are submitted again for the rest, and a
+// NOP sent by shutdown stops the thread.
+void VirtualFileSystem::_completion_main() {
+    PROFILE_THREAD("VFS Completion");
+
+    bool stopping = false;
+    while (!stopping) {
+        if (vfs_ring_enter(m_ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            Q_LOG_ERROR("VFS: waiting on io_uring failed (errno %d)", errno);
+            return;
+        }
+
+        u32 head = std::atomic_ref<u32>(*m_ring->cq_head).load(std::memory_order_relaxed);
+        u32 tail = std::atomic_ref<u32>(*m_ring->cq_tail).load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = m_ring->cqes[head & m_ring->cq_mask];
+            AsyncRead* request = reinterpret_cast<AsyncRead*>(cqe.user_data);
+            i32 result = cqe.res;
+            std::atomic_ref<u32>(*m_ring->cq_head).store(head + 1, std::memory_order_release);
+
+            if (request == nullptr) {
+                stopping = true;
+                continue;
+            }
+
+            if (result > 0) {
+                request->completed += static_cast<usize>(result);
+                if (request->completed < request->size && vfs_ring_submit(m_ring, m_submit_lock, request)) {
+                    continue;
+                }
+            }
+
+            m_in_flight.fetch_sub(1, std::memory_order_release);
+            _complete(*request, result < 0 ? -1 : static_cast<i64>(request->completed));
+        }
+    }
+}
+
+// Wait for the reads in flight, then stop the completion thread and
+// release the rings
+static void vfs_ring_shutdown(VfsRing*& ring, std::mutex& submit_lock, std::atomic<u32>& in_flight, std::vector<std::thread>& threads) {
+    // Sequentially consistent, to pair with read_async taking a slot and
+    // then checking that the file system is still running
+    while (in_flight.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    vfs_ring_submit(ring, submit_lock, nullptr);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->rings, ring->rings_size);
+    ::close(ring->fd);
+    delete ring;
+    ring = nullptr;
+}
+
+#else
+
+struct VfsRing {};
+
+bool VirtualFileSystem::_init_io_uring() {
+    return false;
+}
+
+bool VirtualFileSystem::_submit_io_uring(AsyncRead& request) {
+    (void)request;
+    return false;
+}
+
+void VirtualFileSystem::_completion_main() {
+}
+
+static void vfs_ring_shutdown(VfsRing*& ring, std::mutex& submit_lock, std::atomic<u32>& in_flight, std::vector<std::thread>& threads) {
+    (void)submit_lock;
+    (void)in_flight;
+    (void)threads;
+    delete ring;
+    ring = nullptr;
+}
+
+#endif // io_uring
+
+void VirtualFileSystem::shutdown() {
+    // Stop accepting reads first. read_async checks again once it holds a
+    // ring slot or the queue lock, so each read is either waited for below
+    // or refused.
+    {
+        std::lock_guard lock(m_queue_lock);
+        if (!m_running.exchange(false)) {
+            return;
+        }
+    }
+
+    if (m_ring != nullptr) {
+        vfs_ring_shutdown(m_ring, m_submit_lock, m_in_flight, m_threads);
+    } else {
+        m_queue_ready.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+    }
+}
+
+} // core namespace
+} // bifrost namespace
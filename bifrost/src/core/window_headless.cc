@@ -0,0 +1,215 @@
+/// BIFROST ENGINE
+/// Headless window backend. It needs no display server, so the engine
+/// and its benchmarks can run on build machines. Events come from
+/// inject_event and the synthetic event source instead of the OS.
+
+#include "core/window.h"
+#include "core/input.h"
+#include "core/log.h"
+#include "core/memory.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace bifrost {
+namespace core {
+
+// Events a headless window can hold between two pumps before growing
+constexpr usize HEADLESS_EVENT_CAPACITY = 256;
+
+// Decide which backend to use. The environment variable wins over AUTO
+// so a build machine can force headless without code changes.
+WindowBackend Window::_select_backend() {
+    if (m_backend != WindowBackend::AUTO) {
+        return m_backend;
+    }
+
+    const char* requested = std::getenv("BIFROST_WINDOW_BACKEND");
+    if (requested != nullptr) {
+        if (std::strcmp(requested, "headless") == 0) {
+            return WindowBackend::HEADLESS;
+        }
+        if (std::strcmp(requested, "platform") == 0) {
+            return WindowBackend::PLATFORM;
+        }
+        Q_LOG_WARN("Window: unknown BIFROST_WINDOW_BACKEND '%s'", requested);
+    }
+
+    return WindowBackend::AUTO;
+}
+
+void Window::_init_headless() {
+    m_backend = WindowBackend::HEADLESS;
+    m_injected_events.reserve(HEADLESS_EVENT_CAPACITY);
+    m_is_initialized = true;
+    Q_LOG_INFO("Headless Window Created [%u, %u]", m_width, m_height);
+}
+
+// Queue an event for the next pump
+bool Window::inject_event(const WindowEvent& event) {
+    if (m_backend != WindowBackend::HEADLESS) {
+        Q_LOG_WARN("Window: events can only be injected into a headless window");
+        return false;
+    }
+
+    m_injected_events.push_back(event);
+    return true;
+}
+
+// Handle the injected events, then everything the event source has
+bool Window::_pump_headless() {
+    for (const WindowEvent& event : m_injected_events) {
+        _handle_window_event(event);
+    }
+    m_injected_events.clear();
+
+    if (m_event_source) {
+        WindowEvent event = {};
+        while (m_event_source(event)) {
+            _handle_window_event(event);
+            event = {};
+        }
+    }
+
+    _apply_resize();
+    return true;
+}
+
+// Whether an event is waiting for the next pump. An event the source
+// hands out is queued with the injected ones, so asking does not lose it.
+bool Window::_headless_event_ready() {
+    if (!m_injected_events.empty()) {
+        return true;
+    }
+
+    WindowEvent event = {};
+    if (m_event_source && m_event_source(event)) {
+        m_injected_events.push_back(event);
+        return true;
+    }
+
+    return false;
+}
+
+// Nothing wakes a headless window, so the source is asked again every
+// HEADLESS_WAIT_INTERVAL_MS until it has an event or the timeout expires.
+// Without a source no event can arrive, so rather than blocking forever
+// this only sleeps for a finite timeout.
+bool Window::_wait_headless(i32 timeout_ms) {
+    if (_headless_event_ready()) {
+        return true;
+    }
+
+    if (!m_event_source) {
+        if (timeout_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        }
+        return false;
+    }
+
+    if (timeout_ms == 0) {
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(HEADLESS_WAIT_INTERVAL_MS));
+        if (_headless_event_ready()) {
+            return true;
+        }
+    } while (timeout_ms < 0 || std::chrono::steady_clock::now() < deadline);
+
+    return false;
+}
+
+// Keep the frame, so it can be compared against a reference image. The
+// copy is sized by class like the render targets, so a drag does not
+// reallocate it every frame.
+bool Window::_present_headless(const u32* pixels, u32 width, u32 height) {
+    MemoryTagScope memory_scope(MemoryTag::WINDOW);
+
+    reserve_by_size_class(m_presented_pixels, static_cast<usize>(width) * height);
+    m_presented_pixels.assign(pixels, pixels + static_cast<usize>(width) * height);
+    m_presented_width = width;
+    m_presented_height = height;
+    return true;
+}
+
+// A framebuffer in plain memory, presented by copying it. Every
+// framebuffer shares one allocation, since presenting takes the copy
+// before the next frame is drawn.
+u32* Window::_acquire_memory_framebuffer(u32 width, u32 height) {
+    MemoryTagScope memory_scope(MemoryTag::WINDOW);
+
+    usize pixels = static_cast<usize>(width) * height;
+    reserve_by_size_class(m_framebuffer_memory, pixels);
+    m_framebuffer_memory.resize(pixels);
+    m_framebuffer_width = width;
+    m_framebuffer_height = height;
+    return m_framebuffer_memory.data();
+}
+
+// Remember a size the platform reported. Dragging an edge reports dozens
+// of sizes a second, and only the last one before the pump ends is used.
+void Window::_queue_resize(u32 width, u32 height) {
+    m_pending_width = width;
+    m_pending_height = height;
+    m_resize_pending = true;
+}
+
+// Called at the end of a pump. Moves and other configuration changes
+// report the size too, so sizes that did not change are dropped.
+void Window::_apply_resize() {
+    if (!m_resize_pending) {
+        return;
+    }
+
+    m_resize_pending = false;
+    if (m_pending_width == m_width && m_pending_height == m_height) {
+        return;
+    }
+
+    m_width = m_pending_width;
+    m_height = m_pending_height;
+    InputHandler::get_reference()->process_window_resize(m_width, m_height);
+}
+
+// Pass a platform independent event on to the input handler
+void Window::_handle_window_event(const WindowEvent& event) {
+    InputHandler* input = InputHandler::get_reference();
+
+    switch (event.type) {
+        case WindowEventType::KEY:
+            if (event.code < KEYS_MAX_KEY) {
+                input->process_key(static_cast<Keys>(event.code), event.pressed);
+            }
+            break;
+
+        case WindowEventType::BUTTON:
+            if (event.code < MouseButtons::MAX_BUTTONS) {
+                input->process_buttons(static_cast<MouseButtons>(event.code), event.pressed);
+            }
+            break;
+
+        case WindowEventType::MOUSE_MOVE:
+            input->process_mouse_move(event.x, event.y);
+            break;
+
+        case WindowEventType::MOUSE_WHEEL:
+            input->process_mouse_wheel(event.x);
+            break;
+
+        case WindowEventType::RESIZE:
+            _queue_resize(static_cast<u32>(event.x), static_cast<u32>(event.y));
+            break;
+
+        case WindowEventType::CLOSE:
+            m_should_close = true;
+            break;
+    }
+}
+
+} // core namespace
+} // bifrost namespace
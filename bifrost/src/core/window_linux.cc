@@ -1,82 +1,208 @@
 #include "core/input.h"
 #include "core/window.h"
+#include "core/clock.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profiler.h"
 #include "core/defines.h"
 
 #ifdef Q_PLATFORM_LINUX
 
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
+#include <xcb/shm.h>
 #include <X11/keysym.h>
-#include <X11/XKBlib.h>
-#include <X11/Xlib.h>
-#include <X11/Xlib-xcb.h>
-#include <X11/X.h>
-/* #include <X11/Xlib.h> */
-#include <X11/Xutil.h>
-#include <X11/Xatom.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
 
 namespace bifrost {
 namespace core {
 
-// The input handler shared reference
-InputHandler* input_handler = InputHandler::get_reference();
+// Most descriptors that can be waited on along with the X connection
+constexpr usize WINDOW_MAX_WAIT_FDS = 16;
+
+// WM_SIZE_HINTS property layout from the ICCCM
+constexpr u32 SIZE_HINTS_LENGTH = 18;
+constexpr u32 SIZE_HINTS_P_MIN_SIZE = 1 << 4;
+constexpr u32 SIZE_HINTS_MIN_WIDTH = 5;
+constexpr u32 SIZE_HINTS_MIN_HEIGHT = 6;
+
+// Bytes of a PutImage request before its pixel data
+constexpr u32 PUT_IMAGE_HEADER_SIZE = 24;
+
+// The header keeps segment ids as plain integers
+static_assert(sizeof(xcb_shm_seg_t) == sizeof(u32), "Window: xcb_shm_seg_t must fit the header's segment ids");
 
 // Initialization behavior for the Linux implementation of the Windowing
 void Window::_init() {
-    m_logger.info("Creating Window [%u, %u]", m_width, m_height);
-    m_display = XOpenDisplay(nullptr);
-    if (!m_display) {
-        // TODO: log failure
+    MemoryTagScope memory_scope(MemoryTag::WINDOW);
+
+    WindowBackend backend = _select_backend();
+    if (backend == WindowBackend::HEADLESS) {
+        _init_headless();
         return;
     }
-    m_logger.debug("Window: X display created");
-
-    m_screen = DefaultScreen(m_display);
-    m_window = XCreateSimpleWindow(
-        m_display, 
-        RootWindow(m_display, m_screen), 
-        10, 10, 
-        m_width, m_height, 
-        1, 
-        BlackPixel(m_display, m_screen), 
-        WhitePixel(m_display, m_screen)
-    );
 
-    XSelectInput(m_display, m_window, KeyPressMask | KeyReleaseMask | StructureNotifyMask | ExposureMask);
-    Atom wm_protocols = XInternAtom(m_display, "WM_PROTOCOLS", true);
-    (void) wm_protocols;
+    Q_LOG_INFO("Creating Window [%u, %u]", m_width, m_height);
+
+    int screen_number = 0;
+    m_connection = xcb_connect(nullptr, &screen_number);
+    if (xcb_connection_has_error(m_connection)) {
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+
+        if (backend == WindowBackend::AUTO) {
+            Q_LOG_WARN("Window: failed to connect to the X server, falling back to headless");
+            _init_headless();
+            return;
+        }
 
-    Atom wm_delete_window = XInternAtom(m_display, "WM_DELETE_WINDOW", true);
+        Q_LOG_ERROR("Window: failed to connect to the X server");
+        return;
+    }
+    m_backend = WindowBackend::PLATFORM;
+    Q_LOG_DEBUG("Window: X connection created");
 
-    XSetWMProtocols(m_display, m_window, &wm_delete_window, 1);
+    const xcb_setup_t* setup = xcb_get_setup(m_connection);
+    xcb_screen_iterator_t screens = xcb_setup_roots_iterator(setup);
+    for (int i = 0; i < screen_number; i++) {
+        xcb_screen_next(&screens);
+    }
+    m_screen = screens.data;
+
+    // Every request that needs a reply is sent before waiting on any of
+    // them, so creating the window costs a single round trip to the server
+    const char* protocols_name = "WM_PROTOCOLS";
+    const char* delete_window_name = "WM_DELETE_WINDOW";
+    xcb_intern_atom_cookie_t protocols_cookie = xcb_intern_atom(
+        m_connection, 0, static_cast<u16>(strlen(protocols_name)), protocols_name
+    );
+    xcb_intern_atom_cookie_t delete_window_cookie = xcb_intern_atom(
+        m_connection, 0, static_cast<u16>(strlen(delete_window_name)), delete_window_name
+    );
+    xcb_get_keyboard_mapping_cookie_t keymap_cookie = xcb_get_keyboard_mapping(
+        m_connection, setup->min_keycode, setup->max_keycode - setup->min_keycode + 1
+    );
+    xcb_prefetch_extension_data(m_connection, &xcb_shm_id);
+
+    u32 event_mask = XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE
+        | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE
+        | XCB_EVENT_MASK_POINTER_MOTION
+        | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_EXPOSURE;
+    u32 value_list[] = { m_screen->white_pixel, event_mask };
+
+    m_window = xcb_generate_id(m_connection);
+    xcb_create_window(
+        m_connection,
+        XCB_COPY_FROM_PARENT,
+        m_window,
+        m_screen->root,
+        10, 10,
+        m_width, m_height,
+        1,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        m_screen->root_visual,
+        XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK,
+        value_list
+    );
 
     // Set the Size Hints with the minimum window size
-    XSizeHints sizehints;
-    sizehints.flags = PMinSize;
-    sizehints.min_width = m_width;
-    sizehints.min_height = m_height;
+    u32 size_hints[SIZE_HINTS_LENGTH] = {};
+    size_hints[0] = SIZE_HINTS_P_MIN_SIZE;
+    size_hints[SIZE_HINTS_MIN_WIDTH] = m_width;
+    size_hints[SIZE_HINTS_MIN_HEIGHT] = m_height;
+    xcb_change_property(
+        m_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_window,
+        XCB_ATOM_WM_NORMAL_HINTS,
+        XCB_ATOM_WM_SIZE_HINTS,
+        32,
+        SIZE_HINTS_LENGTH,
+        size_hints
+    );
+
+    // Set the name of the window
+    xcb_change_property(
+        m_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_window,
+        XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING,
+        8,
+        static_cast<u32>(m_title.size()),
+        m_title.c_str()
+    );
+
+    xcb_intern_atom_reply_t* protocols_reply = xcb_intern_atom_reply(m_connection, protocols_cookie, nullptr);
+    xcb_intern_atom_reply_t* delete_window_reply = xcb_intern_atom_reply(m_connection, delete_window_cookie, nullptr);
+    m_wm_protocols = protocols_reply ? protocols_reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+    m_wm_delete_window = delete_window_reply ? delete_window_reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+    free(protocols_reply);
+    free(delete_window_reply);
+
+    // Ask the window manager to send us a message instead of killing the connection
+    xcb_change_property(
+        m_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_window,
+        m_wm_protocols,
+        XCB_ATOM_ATOM,
+        32,
+        1,
+        &m_wm_delete_window
+    );
 
-    // Tell window manager our hints about the minimum window size
-    XSetWMSizeHints(m_display, m_window, &sizehints, XA_WM_NORMAL_HINTS);
+    // Frames are put as they are, so the screen must keep pixels in 32 bits
+    // with the same byte order as ours. Otherwise present fails.
+    u32 bits_per_pixel = 0;
+    for (xcb_format_iterator_t formats = xcb_setup_pixmap_formats_iterator(setup); formats.rem > 0; xcb_format_next(&formats)) {
+        if (formats.data->depth == m_screen->root_depth) {
+            bits_per_pixel = formats.data->bits_per_pixel;
+        }
+    }
+    m_can_present = (m_screen->root_depth == 24 || m_screen->root_depth == 32)
+        && bits_per_pixel == 32
+        && setup->image_byte_order == XCB_IMAGE_ORDER_LSB_FIRST;
+    if (!m_can_present) {
+        Q_LOG_WARN("Window: screen of depth %u can not show 32 bit frames", m_screen->root_depth);
+    }
 
-    // Request to display the window on the screen, and flush teh request buffer
-    XMapWindow(m_display, m_window);
+    m_gc = xcb_generate_id(m_connection);
+    xcb_create_gc(m_connection, m_gc, m_window, 0, nullptr);
 
-    m_logger.debug("Window: X Window created");
+    // Whether framebuffers can be shared with the server is only known once
+    // the first segment is attached, since a remote server refuses them
+    const xcb_query_extension_reply_t* shm_extension = xcb_get_extension_data(m_connection, &xcb_shm_id);
+    m_has_shm = m_can_present && shm_extension != nullptr && shm_extension->present;
+    if (m_has_shm) {
+        m_shm_completion_event = shm_extension->first_event + XCB_SHM_COMPLETION;
+    }
 
-    m_is_initialized = true;
-    m_logger.info("Window Created");
+    xcb_get_keyboard_mapping_reply_t* keymap_reply = xcb_get_keyboard_mapping_reply(m_connection, keymap_cookie, nullptr);
+    _build_key_table(keymap_reply, setup->min_keycode);
+    free(keymap_reply);
 
-    // Set the name of the window
-    XStoreName(m_display, m_window, m_title.c_str());
-    XFlush(m_display);
+    // Request to display the window on the screen, and flush the request buffer
+    xcb_map_window(m_connection, m_window);
+    xcb_flush(m_connection);
+
+    Q_LOG_DEBUG("Window: X Window created");
+
+    m_is_initialized = true;
+    Q_LOG_INFO("Window Created");
 }
 
 // Destructor
 Window::~Window() {
     if (m_is_initialized) {
         // Window has not been shutdown yet, so shut it down
-        m_logger.warn("Window: Window's destructor called before explicitly shutdown");
+        Q_LOG_WARN("Window: Window's destructor called before explicitly shutdown");
         this->shutdown();
     }
 }
@@ -84,35 +210,275 @@ Window::~Window() {
 // Shutdown behavior for the Window
 void Window::shutdown() {
     if (!m_is_initialized) {
-        m_logger.warn("Window: attempting to shutdown window that is not initialized.");
+        Q_LOG_WARN("Window: attempting to shutdown window that is not initialized.");
+        return;
+    }
+
+    Q_LOG_INFO("Shutting down window...");
+    if (m_backend == WindowBackend::HEADLESS) {
+        m_is_initialized = false;
+        Q_LOG_INFO("Window shutdown succesfully");
         return;
     }
 
-    m_logger.info("Shutting down window...");
-    XDestroyWindow(m_display, m_window);
-    XCloseDisplay(m_display);
+    free(m_pending_event);
+    m_pending_event = nullptr;
+    _destroy_shm_framebuffers();
+    xcb_free_gc(m_connection, m_gc);
+    xcb_destroy_window(m_connection, m_window);
+    xcb_disconnect(m_connection);
+    m_connection = nullptr;
     m_is_initialized = false;
-    m_logger.info("Window shutdown succesfully");
+    Q_LOG_INFO("Window shutdown succesfully");
 }
 
 // Open and display the window
 void Window::show() {
-    XMapWindow(m_display, m_window);
-    XFlush(m_display);
+    if (!m_is_initialized) {
+        Q_LOG_ERROR("Window: attempting to show uninitialized Window. Aborting");
+        return;
+    }
+
+    if (m_backend == WindowBackend::HEADLESS) {
+        return;
+    }
+
+    xcb_map_window(m_connection, m_window);
+    xcb_flush(m_connection);
 }
 
 // Set the title of the window. This will mostly be displayed at 
 // the top of the window.
 void Window::set_title(const std::string& title) {
     if (!m_is_initialized) {
-        m_logger.warn("Window: Attempted to set the title of the window on unitialized Window");
+        Q_LOG_WARN("Window: Attempted to set the title of the window on unitialized Window");
         return;
     }
 
     m_title = title;
-    XStoreName(m_display, m_window, title.c_str());
-    XFlush(m_display);
-    m_logger.info("Set Window title to %s", title.c_str());
+    if (m_backend == WindowBackend::HEADLESS) {
+        return;
+    }
+
+    xcb_change_property(
+        m_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_window,
+        XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING,
+        8,
+        static_cast<u32>(m_title.size()),
+        m_title.c_str()
+    );
+    xcb_flush(m_connection);
+    Q_LOG_INFO("Set Window title to %s", title.c_str());
+}
+
+// Put the frame into the window. Frames larger than one request allows
+// are sent in bands of rows.
+bool Window::present(const u32* pixels, u32 width, u32 height) {
+    PROFILE_SCOPE("Window::present");
+
+    if (!m_is_initialized) {
+        return false;
+    }
+
+    if (m_backend == WindowBackend::HEADLESS) {
+        return _present_headless(pixels, width, height);
+    }
+
+    if (!m_can_present || width == 0 || height == 0) {
+        return false;
+    }
+
+    u32 max_bytes = xcb_get_maximum_request_length(m_connection) * 4 - PUT_IMAGE_HEADER_SIZE;
+    u32 band_rows = max_bytes / (width * 4);
+    if (band_rows == 0) {
+        Q_LOG_ERROR("Window: frame rows of %u pixels do not fit in a request", width);
+        return false;
+    }
+
+    for (u32 y = 0; y < height; y += band_rows) {
+        u32 rows = height - y < band_rows ? height - y : band_rows;
+        xcb_put_image(
+            m_connection,
+            XCB_IMAGE_FORMAT_Z_PIXMAP,
+            m_window,
+            m_gc,
+            static_cast<u16>(width), static_cast<u16>(rows),
+            0, static_cast<i16>(y),
+            0,
+            m_screen->root_depth,
+            rows * width * 4,
+            reinterpret_cast<const u8*>(pixels + static_cast<usize>(y) * width)
+        );
+    }
+
+    xcb_flush(m_connection);
+    return true;
+}
+
+// Take the next framebuffer in turn, waiting for the server to be done
+// with it. Events that arrive while waiting are handled as a pump would.
+bool Window::acquire_framebuffer(u32 width, u32 height, WindowFramebuffer& framebuffer) {
+    PROFILE_SCOPE("Window::acquire_framebuffer");
+
+    if (!m_is_initialized || width == 0 || height == 0) {
+        return false;
+    }
+
+    framebuffer.width = width;
+    framebuffer.height = height;
+
+    if (m_backend == WindowBackend::HEADLESS) {
+        framebuffer.pixels = _acquire_memory_framebuffer(width, height);
+        return true;
+    }
+
+    if (!m_can_present) {
+        return false;
+    }
+
+    // Segments are sized by class and only replaced when the frame stops
+    // fitting or gets much smaller, since attaching one is a round trip
+    if (m_has_shm && (width != m_framebuffer_width || height != m_framebuffer_height)) {
+        usize size = static_cast<usize>(width) * height * sizeof(u32);
+        if (size > m_shm_capacity || memory_size_class(size) < m_shm_capacity / 2) {
+            if (!_create_shm_framebuffers(memory_size_class(size))) {
+                Q_LOG_WARN("Window: MIT-SHM is not available, presenting framebuffers with copies");
+                m_has_shm = false;
+            }
+        }
+
+        if (m_has_shm) {
+            m_framebuffer_width = width;
+            m_framebuffer_height = height;
+        }
+    }
+
+    if (!m_has_shm) {
+        framebuffer.pixels = _acquire_memory_framebuffer(width, height);
+        return true;
+    }
+
+    ShmFramebuffer& shm = m_shm_framebuffers[m_framebuffer_index];
+    while (shm.busy) {
+        xcb_generic_event_t* event = m_pending_event;
+        m_pending_event = nullptr;
+        if (event == nullptr) {
+            xcb_flush(m_connection);
+            event = xcb_wait_for_event(m_connection);
+        }
+
+        if (event == nullptr) {
+            Q_LOG_ERROR("Window: lost the connection to the X server");
+            m_should_close = true;
+            return false;
+        }
+
+        _handle_x11_event(event);
+        free(event);
+    }
+
+    framebuffer.pixels = shm.pixels;
+    return true;
+}
+
+// Have the server copy the framebuffer into the window and tell us when it
+// is done, so the buffer is not drawn into while it is being read
+bool Window::present_framebuffer() {
+    PROFILE_SCOPE("Window::present_framebuffer");
+
+    if (!m_is_initialized || m_framebuffer_width == 0) {
+        return false;
+    }
+
+    if (!m_has_shm || m_backend == WindowBackend::HEADLESS) {
+        return present(m_framebuffer_memory.data(), m_framebuffer_width, m_framebuffer_height);
+    }
+
+    ShmFramebuffer& shm = m_shm_framebuffers[m_framebuffer_index];
+    xcb_shm_put_image(
+        m_connection,
+        m_window,
+        m_gc,
+        static_cast<u16>(m_framebuffer_width), static_cast<u16>(m_framebuffer_height),
+        0, 0,
+        static_cast<u16>(m_framebuffer_width), static_cast<u16>(m_framebuffer_height),
+        0, 0,
+        m_screen->root_depth,
+        XCB_IMAGE_FORMAT_Z_PIXMAP,
+        1,
+        shm.segment,
+        0
+    );
+    xcb_flush(m_connection);
+
+    shm.busy = true;
+    m_framebuffer_index = (m_framebuffer_index + 1) % WINDOW_FRAMEBUFFER_COUNT;
+    return true;
+}
+
+// Create a segment of capacity bytes for every framebuffer and have the
+// server attach them
+bool Window::_create_shm_framebuffers(usize capacity) {
+    MemoryTagScope memory_scope(MemoryTag::WINDOW);
+
+    _destroy_shm_framebuffers();
+
+    for (ShmFramebuffer& shm : m_shm_framebuffers) {
+        int id = shmget(IPC_PRIVATE, capacity, IPC_CREAT | 0600);
+        if (id < 0) {
+            Q_LOG_WARN("Window: shmget of %zu bytes failed (errno %d)", capacity, errno);
+            _destroy_shm_framebuffers();
+            return false;
+        }
+
+        void* memory = shmat(id, nullptr, 0);
+        if (memory == reinterpret_cast<void*>(-1)) {
+            Q_LOG_WARN("Window: shmat failed (errno %d)", errno);
+            shmctl(id, IPC_RMID, nullptr);
+            _destroy_shm_framebuffers();
+            return false;
+        }
+
+        xcb_shm_seg_t segment = xcb_generate_id(m_connection);
+        xcb_generic_error_t* error = xcb_request_check(m_connection, xcb_shm_attach_checked(m_connection, segment, id, 1));
+
+        // Marked for removal now, the segment goes away once both sides detach
+        shmctl(id, IPC_RMID, nullptr);
+
+        if (error != nullptr) {
+            free(error);
+            shmdt(memory);
+            _destroy_shm_framebuffers();
+            return false;
+        }
+
+        shm.segment = segment;
+        shm.pixels = static_cast<u32*>(memory);
+        shm.busy = false;
+    }
+
+    m_shm_capacity = capacity;
+    m_framebuffer_index = 0;
+    Q_LOG_DEBUG("Window: created %u shared framebuffers of %zu bytes", WINDOW_FRAMEBUFFER_COUNT, capacity);
+    return true;
+}
+
+// Requests run in order, so the server finishes any image it is putting
+// from a segment before it detaches it, and our side can let go at once
+void Window::_destroy_shm_framebuffers() {
+    for (ShmFramebuffer& shm : m_shm_framebuffers) {
+        if (shm.pixels != nullptr) {
+            xcb_shm_detach(m_connection, shm.segment);
+            shmdt(shm.pixels);
+        }
+        shm = ShmFramebuffer();
+    }
+    m_shm_capacity = 0;
+    m_framebuffer_width = 0;
+    m_framebuffer_height = 0;
 }
 
 // Return whether the window should close or not
@@ -121,48 +487,243 @@ bool Window::should_close() {
     return m_should_close;
 }
 
-// Handle the X11 Window events
+// Handle the X11 Window events.
+// Only the first poll reads from the socket. The rest of the events it
+// brought in are drained from XCB's queue without any more syscalls.
 bool Window::pump_messages() {
-    XEvent event;
-    while ((XPending(m_display) > 0)) {
-        XNextEvent(m_display, &event);
+    PROFILE_SCOPE("Window::pump_messages");
+
+    if (!m_is_initialized) {
+        return false;
+    }
+
+    if (m_backend == WindowBackend::HEADLESS) {
+        return _pump_headless();
+    }
+
+    xcb_generic_event_t* event = m_pending_event;
+    m_pending_event = nullptr;
+    if (event == nullptr) {
+        event = xcb_poll_for_event(m_connection);
+    }
+
+    while (event != nullptr) {
         _handle_x11_event(event);
+        free(event);
+        event = xcb_poll_for_queued_event(m_connection);
     }
-    XFlush(m_display);
 
+    _apply_resize();
+
+    if (xcb_connection_has_error(m_connection)) {
+        Q_LOG_ERROR("Window: lost the connection to the X server");
+        m_should_close = true;
+        return false;
+    }
+
+    xcb_flush(m_connection);
     return true;
 }
 
+// Block until there are X events to pump or the timeout expires
+bool Window::wait_events(i32 timeout_ms) {
+    return wait_events(timeout_ms, nullptr, 0);
+}
+
+// Return the file descriptor of the X server connection
+int Window::get_connection_fd() const {
+    if (!m_is_initialized || m_backend == WindowBackend::HEADLESS) {
+        return -1;
+    }
+
+    return xcb_get_file_descriptor(m_connection);
+}
+
+// The server answers requests in order, so the reply to one that does
+// nothing comes once every request before it has been handled
+void Window::sync() {
+    if (!m_is_initialized || m_backend == WindowBackend::HEADLESS) {
+        return;
+    }
+
+    free(xcb_get_input_focus_reply(m_connection, xcb_get_input_focus(m_connection), nullptr));
+}
+
+// Block in poll on the X connection and the extra descriptors
+bool Window::wait_events(i32 timeout_ms, pollfd* extra_fds, usize extra_count) {
+    if (!m_is_initialized) {
+        Q_LOG_WARN("Window: attempting to wait for events on uninitialized window");
+        return false;
+    }
+
+    // A headless window only has the extra descriptors to wait on. With
+    // an event source it polls them in short slices, asking the source for
+    // an event in between.
+    if (m_backend == WindowBackend::HEADLESS) {
+        if (extra_count == 0) {
+            return _wait_headless(timeout_ms);
+        }
+        if (_headless_event_ready()) {
+            return true;
+        }
+
+        u64 deadline = platform_time_ns() + static_cast<u64>(timeout_ms) * 1000000ull;
+        while (true) {
+            i32 slice = m_event_source ? HEADLESS_WAIT_INTERVAL_MS : timeout_ms;
+            if (timeout_ms >= 0 && slice > timeout_ms) {
+                slice = timeout_ms;
+            }
+
+            int result;
+            do {
+                result = poll(extra_fds, extra_count, slice);
+            } while (result < 0 && errno == EINTR);
+
+            bool ready = _headless_event_ready();
+            if (ready || result != 0 || !m_event_source || (timeout_ms >= 0 && platform_time_ns() >= deadline)) {
+                return ready;
+            }
+        }
+    }
+
+    // XCB may already have read events off the socket, and those will
+    // never make the descriptor readable again. Hold on to the first one
+    // so the next pump starts with it.
+    if (m_pending_event == nullptr) {
+        m_pending_event = xcb_poll_for_queued_event(m_connection);
+    }
+    if (m_pending_event != nullptr) {
+        return true;
+    }
+
+    // Send any buffered requests before going to sleep
+    xcb_flush(m_connection);
+
+    if (extra_count > WINDOW_MAX_WAIT_FDS) {
+        Q_LOG_WARN("Window: can only wait on %zu extra descriptors", WINDOW_MAX_WAIT_FDS);
+        extra_count = WINDOW_MAX_WAIT_FDS;
+    }
+
+    pollfd fds[WINDOW_MAX_WAIT_FDS + 1];
+    fds[0].fd = xcb_get_file_descriptor(m_connection);
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    for (usize i = 0; i < extra_count; i++) {
+        fds[i + 1] = extra_fds[i];
+        fds[i + 1].revents = 0;
+    }
+
+    int result;
+    do {
+        result = poll(fds, extra_count + 1, timeout_ms);
+    } while (result < 0 && errno == EINTR);
+
+    if (result <= 0) {
+        return false;
+    }
+
+    for (usize i = 0; i < extra_count; i++) {
+        extra_fds[i].revents = fds[i + 1].revents;
+    }
+
+    return (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+}
+
 // Handle an incoming event from the X server
-void Window::_handle_x11_event(XEvent& ev) {
-    Keys key = {};
-    KeySym keysym;
-    xcb_keycode_t keycode = 0;
-    
-    switch (ev.type) {
-        case ClientMessage:
+void Window::_handle_x11_event(xcb_generic_event_t* ev) {
+    PROFILE_SCOPE("Window::_handle_x11_event");
+
+    // The server finished reading a presented framebuffer. Extension events
+    // have codes assigned at runtime, so they can not be switch cases.
+    if (m_shm_completion_event != 0 && (ev->response_type & ~0x80) == m_shm_completion_event) {
+        xcb_shm_completion_event_t* completion = reinterpret_cast<xcb_shm_completion_event_t*>(ev);
+        for (ShmFramebuffer& shm : m_shm_framebuffers) {
+            if (shm.pixels != nullptr && shm.segment == completion->shmseg) {
+                shm.busy = false;
+            }
+        }
+        return;
+    }
+
+    // The top bit marks events sent by other clients
+    switch (ev->response_type & ~0x80) {
+        case XCB_CLIENT_MESSAGE:
         {
-            m_should_close = true;
+            xcb_client_message_event_t* message = reinterpret_cast<xcb_client_message_event_t*>(ev);
+            if (message->data.data32[0] == m_wm_delete_window) {
+                m_should_close = true;
+            }
         } break;
         
-        case ConfigureNotify:
+        case XCB_CONFIGURE_NOTIFY:
         {
-            // TODO: handle resizing the window
+            xcb_configure_notify_event_t* configure = reinterpret_cast<xcb_configure_notify_event_t*>(ev);
+            if (configure->window == m_window) {
+                _queue_resize(configure->width, configure->height);
+            }
         } break;
        
-        case KeyPress:
+        case XCB_KEY_PRESS:
+        case XCB_KEY_RELEASE:
+        {
+            xcb_key_press_event_t* key_event = reinterpret_cast<xcb_key_press_event_t*>(ev);
+            bool pressed = (ev->response_type & ~0x80) == XCB_KEY_PRESS;
+            Keys key = m_key_table.translate(key_event->detail);
+            if (key != KEYS_MAX_KEY) {
+                InputHandler::get_reference()->process_key(key, pressed);
+            }
+        } break;
+
+        case XCB_BUTTON_PRESS:
+        case XCB_BUTTON_RELEASE:
         {
-            keycode = ev.xkey.keycode;
-            keysym = XkbKeycodeToKeysym(m_display, keycode, 0, keycode & ShiftMask ? 1: 0);
-            key = _translate_key(keysym);
-            InputHandler::get_reference()->process_key(key, true);
+            xcb_button_press_event_t* button_event = reinterpret_cast<xcb_button_press_event_t*>(ev);
+            bool pressed = (ev->response_type & ~0x80) == XCB_BUTTON_PRESS;
+            switch (button_event->detail) {
+                case XCB_BUTTON_INDEX_1:
+                    InputHandler::get_reference()->process_buttons(MouseButtons::LEFT, pressed);
+                    break;
+                case XCB_BUTTON_INDEX_2:
+                    InputHandler::get_reference()->process_buttons(MouseButtons::MIDDLE, pressed);
+                    break;
+                case XCB_BUTTON_INDEX_3:
+                    InputHandler::get_reference()->process_buttons(MouseButtons::RIGHT, pressed);
+                    break;
+
+                // X11 reports the wheel as buttons 4 and 5
+                case XCB_BUTTON_INDEX_4:
+                    if (pressed)
+                        InputHandler::get_reference()->process_mouse_wheel(1);
+                    break;
+                case XCB_BUTTON_INDEX_5:
+                    if (pressed)
+                        InputHandler::get_reference()->process_mouse_wheel(-1);
+                    break;
+                default:
+                    break;
+            }
         } break;
-        case KeyRelease:
+
+        case XCB_MAPPING_NOTIFY:
         {
-            keycode = ev.xkey.keycode;
-            keysym = XkbKeycodeToKeysym(m_display, keycode, 0, keycode & ShiftMask ? 1: 0);
-            key = _translate_key(keysym);
-            InputHandler::get_reference()->process_key(key, false);
+            // The keyboard layout changed, so the key table is stale
+            xcb_mapping_notify_event_t* mapping = reinterpret_cast<xcb_mapping_notify_event_t*>(ev);
+            if (mapping->request == XCB_MAPPING_KEYBOARD) {
+                const xcb_setup_t* setup = xcb_get_setup(m_connection);
+                xcb_get_keyboard_mapping_cookie_t keymap_cookie = xcb_get_keyboard_mapping(
+                    m_connection, setup->min_keycode, setup->max_keycode - setup->min_keycode + 1
+                );
+                xcb_get_keyboard_mapping_reply_t* keymap_reply = xcb_get_keyboard_mapping_reply(m_connection, keymap_cookie, nullptr);
+                _build_key_table(keymap_reply, setup->min_keycode);
+                free(keymap_reply);
+                Q_LOG_DEBUG("Window: rebuilt the key table after a keyboard mapping change");
+            }
+        } break;
+
+        case XCB_MOTION_NOTIFY:
+        {
+            xcb_motion_notify_event_t* motion = reinterpret_cast<xcb_motion_notify_event_t*>(ev);
+            InputHandler::get_reference()->process_mouse_move(motion->event_x, motion->event_y);
         } break;
 
         default:
@@ -170,269 +731,211 @@ void Window::_handle_x11_event(XEvent& ev) {
     }
 }
 
+// Translate the keyboard mapping into a table indexed by hardware keycode,
+// so that key events only need a single lookup.
+// The first keysym of a keycode that the engine knows about is used,
+// which picks the digits on the keypad over their navigation keysyms.
+// A modifier key is the modifier of its first keysym: the ones after it
+// name the same key again, like Meta_L on the Alt key of most layouts,
+// so a modifier the engine has no key for stays unmapped.
+void Window::_build_key_table(xcb_get_keyboard_mapping_reply_t* mapping, u32 min_keycode) {
+    m_key_table.clear();
+
+    if (mapping == nullptr) {
+        Q_LOG_WARN("Window: could not get the keyboard mapping");
+        return;
+    }
+
+    const xcb_keysym_t* keysyms = xcb_get_keyboard_mapping_keysyms(mapping);
+    u32 keysyms_per_keycode = mapping->keysyms_per_keycode;
+    u32 keycode_count = keysyms_per_keycode ? mapping->length / keysyms_per_keycode : 0;
+
+    for (u32 i = 0; i < keycode_count && min_keycode + i < KEY_TABLE_SIZE; i++) {
+        for (u32 column = 0; column < keysyms_per_keycode; column++) {
+            u32 keysym = keysyms[i * keysyms_per_keycode + column];
+            Keys key = _translate_key(keysym);
+            if (key != KEYS_MAX_KEY) {
+                m_key_table.keys[min_keycode + i] = key;
+                break;
+            }
+            if (column == 0 && keysym >= XK_Shift_L && keysym <= XK_Hyper_R) {
+                break;
+            }
+        }
+    }
+}
+
+// Maps X keysyms to engine keys. This is only searched while building
+// the keycode table, never while handling key events.
+struct KeysymMapping {
+    u32 keysym;
+    Keys key;
+};
+
+constexpr KeysymMapping KEYSYM_MAPPINGS[] = {
+    { XK_BackSpace, KEY_BACKSPACE },
+    { XK_Return, KEY_ENTER },
+    { XK_Tab, KEY_TAB },
+    // { XK_Shift, KEY_SHIFT },
+    // { XK_Control, KEY_CONTROL },
+
+    { XK_Pause, KEY_PAUSE },
+    { XK_Caps_Lock, KEY_CAPITAL },
+
+    { XK_Escape, KEY_ESCAPE },
+
+    // Not supported: KEY_CONVERT, KEY_NONCONVERT, KEY_ACCEPT
+
+    { XK_Mode_switch, KEY_MODECHANGE },
+
+    { XK_space, KEY_SPACE },
+    { XK_Prior, KEY_PRIOR },
+    { XK_Next, KEY_NEXT },
+    { XK_End, KEY_END },
+    { XK_Home, KEY_HOME },
+    { XK_Left, KEY_LEFT },
+    { XK_Up, KEY_UP },
+    { XK_Right, KEY_RIGHT },
+    { XK_Down, KEY_DOWN },
+    { XK_Select, KEY_SELECT },
+    { XK_Print, KEY_PRINT },
+    { XK_Execute, KEY_EXECUTEKEY },
+    // { XK_snapshot, KEY_SNAPSHOT }, // not supported
+    { XK_Insert, KEY_INSERT },
+    { XK_Delete, KEY_DELETE },
+    { XK_Help, KEY_HELP },
+
+    // The Windows keys send Super on most layouts and Meta on some
+    { XK_Super_L, KEY_LWIN },
+    { XK_Super_R, KEY_RWIN },
+    { XK_Meta_L, KEY_LWIN },
+    { XK_Meta_R, KEY_RWIN },
+    // { XK_apps, KEY_APPS }, // not supported
+
+    // { XK_sleep, KEY_SLEEP }, //not supported
+
+    { XK_KP_0, KEY_NUMPAD0 },
+    { XK_KP_1, KEY_NUMPAD1 },
+    { XK_KP_2, KEY_NUMPAD2 },
+    { XK_KP_3, KEY_NUMPAD3 },
+    { XK_KP_4, KEY_NUMPAD4 },
+    { XK_KP_5, KEY_NUMPAD5 },
+    { XK_KP_6, KEY_NUMPAD6 },
+    { XK_KP_7, KEY_NUMPAD7 },
+    { XK_KP_8, KEY_NUMPAD8 },
+    { XK_KP_9, KEY_NUMPAD9 },
+    { XK_multiply, KEY_MULTIPLY },
+    { XK_KP_Add, KEY_ADD },
+    { XK_KP_Separator, KEY_SEPARATOR },
+    { XK_KP_Subtract, KEY_SUBTRACT },
+    { XK_KP_Decimal, KEY_DECIMAL },
+    { XK_KP_Divide, KEY_DIVIDE },
+    { XK_F1, KEY_F1 },
+    { XK_F2, KEY_F2 },
+    { XK_F3, KEY_F3 },
+    { XK_F4, KEY_F4 },
+    { XK_F5, KEY_F5 },
+    { XK_F6, KEY_F6 },
+    { XK_F7, KEY_F7 },
+    { XK_F8, KEY_F8 },
+    { XK_F9, KEY_F9 },
+    { XK_F10, KEY_F10 },
+    { XK_F11, KEY_F11 },
+    { XK_F12, KEY_F12 },
+    { XK_F13, KEY_F13 },
+    { XK_F14, KEY_F14 },
+    { XK_F15, KEY_F15 },
+    { XK_F16, KEY_F16 },
+    { XK_F17, KEY_F17 },
+    { XK_F18, KEY_F18 },
+    { XK_F19, KEY_F19 },
+    { XK_F20, KEY_F20 },
+    { XK_F21, KEY_F21 },
+    { XK_F22, KEY_F22 },
+    { XK_F23, KEY_F23 },
+    { XK_F24, KEY_F24 },
+
+    { XK_Num_Lock, KEY_NUMLOCK },
+    { XK_Scroll_Lock, KEY_SCROLL },
+
+    { XK_KP_Equal, KEY_NUMPAD_EQUAL },
+
+    { XK_Shift_L, KEY_LSHIFT },
+    { XK_Shift_R, KEY_RSHIFT },
+    { XK_Control_L, KEY_LCONTROL },
+    { XK_Control_R, KEY_RCONTROL },
+    // { XK_Menu, KEY_LMENU },
+    { XK_semicolon, KEY_SEMICOLON },
+    { XK_plus, KEY_PLUS },
+    { XK_comma, KEY_COMMA },
+    { XK_minus, KEY_MINUS },
+    { XK_period, KEY_PERIOD },
+    { XK_slash, KEY_SLASH },
+    { XK_grave, KEY_GRAVE },
+
+    { XK_a, KEY_A },
+    { XK_A, KEY_A },
+    { XK_b, KEY_B },
+    { XK_B, KEY_B },
+    { XK_c, KEY_C },
+    { XK_C, KEY_C },
+    { XK_d, KEY_D },
+    { XK_D, KEY_D },
+    { XK_e, KEY_E },
+    { XK_E, KEY_E },
+    { XK_f, KEY_F },
+    { XK_F, KEY_F },
+    { XK_g, KEY_G },
+    { XK_G, KEY_G },
+    { XK_h, KEY_H },
+    { XK_H, KEY_H },
+    { XK_i, KEY_I },
+    { XK_I, KEY_I },
+    { XK_j, KEY_J },
+    { XK_J, KEY_J },
+    { XK_k, KEY_K },
+    { XK_K, KEY_K },
+    { XK_l, KEY_L },
+    { XK_L, KEY_L },
+    { XK_m, KEY_M },
+    { XK_M, KEY_M },
+    { XK_n, KEY_N },
+    { XK_N, KEY_N },
+    { XK_o, KEY_O },
+    { XK_O, KEY_O },
+    { XK_p, KEY_P },
+    { XK_P, KEY_P },
+    { XK_q, KEY_Q },
+    { XK_Q, KEY_Q },
+    { XK_r, KEY_R },
+    { XK_R, KEY_R },
+    { XK_s, KEY_S },
+    { XK_S, KEY_S },
+    { XK_t, KEY_T },
+    { XK_T, KEY_T },
+    { XK_u, KEY_U },
+    { XK_U, KEY_U },
+    { XK_v, KEY_V },
+    { XK_V, KEY_V },
+    { XK_w, KEY_W },
+    { XK_W, KEY_W },
+    { XK_x, KEY_X },
+    { XK_X, KEY_X },
+    { XK_y, KEY_Y },
+    { XK_Y, KEY_Y },
+    { XK_z, KEY_Z },
+    { XK_Z, KEY_Z },
+};
+
+// Translate an X keysym to an engine key
 Keys Window::_translate_key(u32 code) {
-    switch (code) {
-        case XK_BackSpace:
-            return KEY_BACKSPACE;
-        case XK_Return:
-            return KEY_ENTER;
-        case XK_Tab:
-            return KEY_TAB;
-            //case XK_Shift: return KEY_SHIFT;
-            //case XK_Control: return KEY_CONTROL;
-
-        case XK_Pause:
-            return KEY_PAUSE;
-        case XK_Caps_Lock:
-            return KEY_CAPITAL;
-
-        case XK_Escape:
-            return KEY_ESCAPE;
-
-            // Not supported
-            // case : return KEY_CONVERT;
-            // case : return KEY_NONCONVERT;
-            // case : return KEY_ACCEPT;
-
-        case XK_Mode_switch:
-            return KEY_MODECHANGE;
-
-        case XK_space:
-            return KEY_SPACE;
-        case XK_Prior:
-            return KEY_PRIOR;
-        case XK_Next:
-            return KEY_NEXT;
-        case XK_End:
-            return KEY_END;
-        case XK_Home:
-            return KEY_HOME;
-        case XK_Left:
-            return KEY_LEFT;
-        case XK_Up:
-            return KEY_UP;
-        case XK_Right:
-            return KEY_RIGHT;
-        case XK_Down:
-            return KEY_DOWN;
-        case XK_Select:
-            return KEY_SELECT;
-        case XK_Print:
-            return KEY_PRINT;
-        case XK_Execute:
-            return KEY_EXECUTEKEY;
-        // case XK_snapshot: return KEY_SNAPSHOT; // not supported
-        case XK_Insert:
-            return KEY_INSERT;
-        case XK_Delete:
-            return KEY_DELETE;
-        case XK_Help:
-            return KEY_HELP;
-
-        case XK_Meta_L:
-            return KEY_LWIN;  // TODO: not sure this is right
-        case XK_Meta_R:
-            return KEY_RWIN;
-            // case XK_apps: return KEY_APPS; // not supported
-
-            // case XK_sleep: return KEY_SLEEP; //not supported
-
-        case XK_KP_0:
-            return KEY_NUMPAD0;
-        case XK_KP_1:
-            return KEY_NUMPAD1;
-        case XK_KP_2:
-            return KEY_NUMPAD2;
-        case XK_KP_3:
-            return KEY_NUMPAD3;
-        case XK_KP_4:
-            return KEY_NUMPAD4;
-        case XK_KP_5:
-            return KEY_NUMPAD5;
-        case XK_KP_6:
-            return KEY_NUMPAD6;
-        case XK_KP_7:
-            return KEY_NUMPAD7;
-        case XK_KP_8:
-            return KEY_NUMPAD8;
-        case XK_KP_9:
-            return KEY_NUMPAD9;
-        case XK_multiply:
-            return KEY_MULTIPLY;
-        case XK_KP_Add:
-            return KEY_ADD;
-        case XK_KP_Separator:
-            return KEY_SEPARATOR;
-        case XK_KP_Subtract:
-            return KEY_SUBTRACT;
-        case XK_KP_Decimal:
-            return KEY_DECIMAL;
-        case XK_KP_Divide:
-            return KEY_DIVIDE;
-        case XK_F1:
-            return KEY_F1;
-        case XK_F2:
-            return KEY_F2;
-        case XK_F3:
-            return KEY_F3;
-        case XK_F4:
-            return KEY_F4;
-        case XK_F5:
-            return KEY_F5;
-        case XK_F6:
-            return KEY_F6;
-        case XK_F7:
-            return KEY_F7;
-        case XK_F8:
-            return KEY_F8;
-        case XK_F9:
-            return KEY_F9;
-        case XK_F10:
-            return KEY_F10;
-        case XK_F11:
-            return KEY_F11;
-        case XK_F12:
-            return KEY_F12;
-        case XK_F13:
-            return KEY_F13;
-        case XK_F14:
-            return KEY_F14;
-        case XK_F15:
-            return KEY_F15;
-        case XK_F16:
-            return KEY_F16;
-        case XK_F17:
-            return KEY_F17;
-        case XK_F18:
-            return KEY_F18;
-        case XK_F19:
-            return KEY_F19;
-        case XK_F20:
-            return KEY_F20;
-        case XK_F21:
-            return KEY_F21;
-        case XK_F22:
-            return KEY_F22;
-        case XK_F23:
-            return KEY_F23;
-        case XK_F24:
-            return KEY_F24;
-
-        case XK_Num_Lock:
-            return KEY_NUMLOCK;
-        case XK_Scroll_Lock:
-            return KEY_SCROLL;
-
-        case XK_KP_Equal:
-            return KEY_NUMPAD_EQUAL;
-
-        case XK_Shift_L:
-            return KEY_LSHIFT;
-        case XK_Shift_R:
-            return KEY_RSHIFT;
-        case XK_Control_L:
-            return KEY_LCONTROL;
-        case XK_Control_R:
-            return KEY_RCONTROL;
-        // case XK_Menu: return KEY_LMENU;
-        /* case XK_Menu: */
-        /*     return KEY_RMENU; */
-        case XK_semicolon:
-            return KEY_SEMICOLON;
-        case XK_plus:
-            return KEY_PLUS;
-        case XK_comma:
-            return KEY_COMMA;
-        case XK_minus:
-            return KEY_MINUS;
-        case XK_period:
-            return KEY_PERIOD;
-        case XK_slash:
-            return KEY_SLASH;
-        case XK_grave:
-            return KEY_GRAVE;
-
-        case XK_a:
-        case XK_A:
-            return KEY_A;
-        case XK_b:
-        case XK_B:
-            return KEY_B;
-        case XK_c:
-        case XK_C:
-            return KEY_C;
-        case XK_d:
-        case XK_D:
-            return KEY_D;
-        case XK_e:
-        case XK_E:
-            return KEY_E;
-        case XK_f:
-        case XK_F:
-            return KEY_F;
-        case XK_g:
-        case XK_G:
-            return KEY_G;
-        case XK_h:
-        case XK_H:
-            return KEY_H;
-        case XK_i:
-        case XK_I:
-            return KEY_I;
-        case XK_j:
-        case XK_J:
-            return KEY_J;
-        case XK_k:
-        case XK_K:
-            return KEY_K;
-        case XK_l:
-        case XK_L:
-            return KEY_L;
-        case XK_m:
-        case XK_M:
-            return KEY_M;
-        case XK_n:
-        case XK_N:
-            return KEY_N;
-        case XK_o:
-        case XK_O:
-            return KEY_O;
-        case XK_p:
-        case XK_P:
-            return KEY_P;
-        case XK_q:
-        case XK_Q:
-            return KEY_Q;
-        case XK_r:
-        case XK_R:
-            return KEY_R;
-        case XK_s:
-        case XK_S:
-            return KEY_S;
-        case XK_t:
-        case XK_T:
-            return KEY_T;
-        case XK_u:
-        case XK_U:
-            return KEY_U;
-        case XK_v:
-        case XK_V:
-            return KEY_V;
-        case XK_w:
-        case XK_W:
-            return KEY_W;
-        case XK_x:
-        case XK_X:
-            return KEY_X;
-        case XK_y:
-        case XK_Y:
-            return KEY_Y;
-        case XK_z:
-        case XK_Z:
-            return KEY_Z;
-        default:
-            return KEYS_MAX_KEY;
+    for (const KeysymMapping& mapping : KEYSYM_MAPPINGS) {
+        if (mapping.keysym == code) {
+            return mapping.key;
+        }
     }
+
+    return KEYS_MAX_KEY;
 }
 
 } // core namespace
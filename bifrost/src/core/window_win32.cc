@@ -2,30 +2,63 @@
 /// This file contains the windowing API for the Win32 Platform
 
 #include "core/window.h"
+#include "core/memory.h"
+#include "core/profiler.h"
 #include "core/defines.h"
 #include "core/input.h"
+#include "core/log.h"
 
 #ifdef Q_PLATFORM_WINDOWS
+#include <windowsx.h>
 
 namespace bifrost {
 namespace core {
 
-InputHandler* input_handler = InputHandler::get_reference();
+// Set when a window is created, rather than at library load where it
+// would start the logger before main
+InputHandler* input_handler = nullptr;
+
+// Virtual key code to engine key
+KeyTable win32_key_table;
 
 bool window_should_close = false;
 
+// Last client area size WM_SIZE reported, applied once the pump is done
+u32 window_resize_width = 0;
+u32 window_resize_height = 0;
+bool window_resize_pending = false;
+
 constexpr const char* WINDOW_CLASS_NAME = "BIFROST WINDOW CLASS NAME";
 
 Window::~Window() {
 	if (m_is_initialized) {
-		m_logger.warn("Window destructor called without explicit shutdown. Shutting down now.");
+		Q_LOG_WARN("Window destructor called without explicit shutdown. Shutting down now.");
 		this->shutdown();
 	}
 }
 
+// Engine keys share their values with the virtual key codes they represent,
+// so the table maps each code below KEYS_MAX_KEY onto itself. Anything past
+// that would index out of the input state and is dropped.
+static void build_key_table(KeyTable& table) {
+	table.clear();
+	for (usize code = 0; code < KEY_TABLE_SIZE && code < KEYS_MAX_KEY; code++) {
+		table.keys[code] = static_cast<Keys>(code);
+	}
+}
+
 void Window::_init() {
+	MemoryTagScope memory_scope(MemoryTag::WINDOW);
 	input_handler = InputHandler::get_reference();
-	m_logger.info("Creating window.");
+
+	WindowBackend backend = _select_backend();
+	if (backend == WindowBackend::HEADLESS) {
+		_init_headless();
+		return;
+	}
+
+	build_key_table(win32_key_table);
+	Q_LOG_INFO("Creating window.");
 
 	m_hinstance = GetModuleHandle(0);
 
@@ -43,6 +76,11 @@ void Window::_init() {
 	wc.lpszClassName = WINDOW_CLASS_NAME;
 
 	if (!RegisterClassA(&wc)) {
+		if (backend == WindowBackend::AUTO) {
+			Q_LOG_WARN("Window registration failed, falling back to headless");
+			_init_headless();
+			return;
+		}
 		MessageBoxA(
 			0,
 			"Window registration failed",
@@ -51,7 +89,7 @@ void Window::_init() {
 		);
 		return;
 	}
-	m_logger.info("Window registration succeeded.");
+	Q_LOG_INFO("Window registration succeeded.");
 
 	// Create window
 	uint32_t client_x = 300;
@@ -97,39 +135,49 @@ void Window::_init() {
 	);
 
 	if (m_window == nullptr) {
-		m_logger.error("Failed to create window");
+		if (backend == WindowBackend::AUTO) {
+			Q_LOG_WARN("Failed to create window, falling back to headless");
+			_init_headless();
+			return;
+		}
+		Q_LOG_ERROR("Failed to create window");
 		MessageBoxA(NULL, "Window creation failed", "Error!", MB_ICONEXCLAMATION | MB_OK);
 		return;
 	}
 
-	m_logger.info("Window created successfully");
-	m_logger.info("Window is initialized");
+	Q_LOG_INFO("Window created successfully");
+	Q_LOG_INFO("Window is initialized");
 
+	m_backend = WindowBackend::PLATFORM;
 	m_is_initialized = true;
 }
 
 // Gracefully exit the window shutdown
 void Window::shutdown() {
 	if (!m_is_initialized) {
-		m_logger.warn("Calling shutdown on uninitialized Window. Aborting");
+		Q_LOG_WARN("Calling shutdown on uninitialized Window. Aborting");
 		return;
 	}
 
-	m_logger.info("Shutting down window.");
+	Q_LOG_INFO("Shutting down window.");
 	m_is_initialized = false;
 }
 
 // Open and display the window
 void Window::show() {
 	if (!m_is_initialized) {
-		m_logger.error("Attempting to show uninitialized Window. Aborting");
+		Q_LOG_ERROR("Attempting to show uninitialized Window. Aborting");
+		return;
+	}
+
+	if (m_backend == WindowBackend::HEADLESS) {
 		return;
 	}
 
 	bool should_activate = true;
 	int32_t show_window_command_flags = should_activate ? SW_SHOW : SW_SHOWNOACTIVATE;
 
-	m_logger.info("Showing window");
+	Q_LOG_INFO("Showing window");
 	m_should_close = false;
 	window_should_close = false;
 	ShowWindow(m_window, show_window_command_flags);
@@ -140,11 +188,70 @@ void Window::show() {
 */
 bool Window::should_close() {
 	pump_messages();
+	if (m_backend == WindowBackend::HEADLESS) {
+		return m_should_close;
+	}
 	return window_should_close;
 }
 
+// Copy the frame into the window's client area
+bool Window::present(const u32* pixels, u32 width, u32 height) {
+	PROFILE_SCOPE("Window::present");
+
+	if (!m_is_initialized) {
+		return false;
+	}
+
+	if (m_backend == WindowBackend::HEADLESS) {
+		return _present_headless(pixels, width, height);
+	}
+
+	// A negative height makes the bitmap top-down, like the frame
+	BITMAPINFO info = {};
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = static_cast<LONG>(width);
+	info.bmiHeader.biHeight = -static_cast<LONG>(height);
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	HDC dc = GetDC(m_window);
+	int lines = SetDIBitsToDevice(dc, 0, 0, width, height, 0, 0, 0, height, pixels, &info, DIB_RGB_COLORS);
+	ReleaseDC(m_window, dc);
+
+	return lines > 0;
+}
+
+// SetDIBitsToDevice copies the frame before it returns, so one buffer in
+// plain memory serves every frame
+bool Window::acquire_framebuffer(u32 width, u32 height, WindowFramebuffer& framebuffer) {
+	if (!m_is_initialized || width == 0 || height == 0) {
+		return false;
+	}
+
+	framebuffer.pixels = _acquire_memory_framebuffer(width, height);
+	framebuffer.width = width;
+	framebuffer.height = height;
+	return true;
+}
+
+// Show the frame drawn into the last acquired framebuffer
+bool Window::present_framebuffer() {
+	if (!m_is_initialized || m_framebuffer_width == 0) {
+		return false;
+	}
+
+	return present(m_framebuffer_memory.data(), m_framebuffer_width, m_framebuffer_height);
+}
+
 // Handle messages from the window
 bool Window::pump_messages() {
+	PROFILE_SCOPE("Window::pump_messages");
+
+	if (m_backend == WindowBackend::HEADLESS) {
+		return _pump_headless();
+	}
+
 	MSG message;
 
 	// takes messages from the queue and pumps it to the application
@@ -153,11 +260,31 @@ bool Window::pump_messages() {
 		DispatchMessageA(&message);
 	}
 
+	if (window_resize_pending) {
+		window_resize_pending = false;
+		_queue_resize(window_resize_width, window_resize_height);
+	}
+	_apply_resize();
+
 	return true;
 }
 
+// Block until there are messages to pump or the timeout expires
+bool Window::wait_events(i32 timeout_ms) {
+	if (m_backend == WindowBackend::HEADLESS) {
+		return _wait_headless(timeout_ms);
+	}
+
+	DWORD timeout = timeout_ms < 0 ? INFINITE : static_cast<DWORD>(timeout_ms);
+	DWORD result = MsgWaitForMultipleObjects(0, nullptr, FALSE, timeout, QS_ALLINPUT);
+
+	return result == WAIT_OBJECT_0;
+}
+
 // Callback function to handle received messages
 LRESULT CALLBACK Window::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+	PROFILE_SCOPE("Window::WindowProc");
+
 	switch (message) {
 	case WM_ERASEBKGND: // notify the OS that erasing the screen will be handled by Application
 		return 1;
@@ -173,15 +300,16 @@ LRESULT CALLBACK Window::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPAR
 		return 0;
 
 	case WM_SIZE: {
+		// A minimized window keeps its size, rather than shrinking render targets to nothing
+		if (wParam == SIZE_MINIMIZED) {
+			break;
+		}
+
 		RECT r;
 		GetClientRect(hWnd, &r);
-		u32 width = r.right - r.left;
-		u32 height = r.bottom - r.top;
-
-		input_handler->process_window_resize(
-			width,
-			height
-		);
+		window_resize_width = r.right - r.left;
+		window_resize_height = r.bottom - r.top;
+		window_resize_pending = true;
 	} break;
 
 	case WM_KEYDOWN:
@@ -189,18 +317,29 @@ LRESULT CALLBACK Window::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPAR
 	case WM_SYSKEYDOWN:
 	case WM_SYSKEYUP: {
 		bool pressed = (message == WM_KEYDOWN || message == WM_SYSKEYDOWN);
-		Keys key = static_cast<Keys>(wParam);
+		Keys key = win32_key_table.translate(static_cast<u32>(wParam));
 
 		// Pass the input subsystem
-		input_handler->process_key(key, pressed);
+		if (key != KEYS_MAX_KEY) {
+			input_handler->process_key(key, pressed);
+		}
+	} break;
+
+	case WM_MOUSEMOVE: {
+		i32 x = GET_X_LPARAM(lParam);
+		i32 y = GET_Y_LPARAM(lParam);
+
+		input_handler->process_mouse_move(x, y);
 	} break;
 
-	case WM_MOUSEMOVE:
-		// Fire an event for mouse movement
-		break;
-	case WM_MOUSEWHEEL:
-		// Fire an event for mouse movement
-		break;
+	case WM_MOUSEWHEEL: {
+		i32 z_delta = GET_WHEEL_DELTA_WPARAM(wParam);
+		if (z_delta != 0) {
+			// Flatten the input to be OS-independent (-1, 1)
+			z_delta = (z_delta < 0) ? -1 : 1;
+			input_handler->process_mouse_wheel(z_delta);
+		}
+	} break;
 
 	case WM_LBUTTONUP:
 	case WM_LBUTTONDOWN:
@@ -208,7 +347,26 @@ LRESULT CALLBACK Window::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPAR
 	case WM_RBUTTONDOWN:
 	case WM_MBUTTONUP:
 	case WM_MBUTTONDOWN: {
-		// TODO: fire events for mouse buttons
+		bool pressed = message == WM_LBUTTONDOWN || message == WM_RBUTTONDOWN || message == WM_MBUTTONDOWN;
+		MouseButtons button = MouseButtons::MAX_BUTTONS;
+		switch (message) {
+		case WM_LBUTTONDOWN:
+		case WM_LBUTTONUP:
+			button = MouseButtons::LEFT;
+			break;
+		case WM_MBUTTONDOWN:
+		case WM_MBUTTONUP:
+			button = MouseButtons::MIDDLE;
+			break;
+		case WM_RBUTTONDOWN:
+		case WM_RBUTTONUP:
+			button = MouseButtons::RIGHT;
+			break;
+		}
+
+		if (button != MouseButtons::MAX_BUTTONS) {
+			input_handler->process_buttons(button, pressed);
+		}
 	} break;
 	}
 
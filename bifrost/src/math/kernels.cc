@@ -0,0 +1,385 @@
+#include "math/kernels.h"
+
+#include <bit>
+
+namespace bifrost {
+namespace math {
+
+const char* simd_isa_name() {
+#if defined(Q_SIMD_AVX2)
+    return "AVX2";
+#elif defined(Q_SIMD_SSE)
+    return "SSE2";
+#elif defined(Q_SIMD_NEON)
+    return "NEON";
+#else
+    return "SCALAR";
+#endif
+}
+
+#if defined(Q_SIMD_AVX2)
+
+// The same 128 bit value in both halves
+static __m256 broadcast(const vec4& v) {
+    return _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&v.x));
+}
+
+static __m256 madd8(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+#endif
+
+/// transform_points ///
+
+void transform_points(const mat4& m, const vec3* in, vec3* out, usize count) {
+    usize i = 0;
+
+#if defined(Q_SIMD_AVX2)
+    // Two points per register, one in each half
+    __m256 w0 = broadcast(m[0]), w1 = broadcast(m[1]), w2 = broadcast(m[2]), w3 = broadcast(m[3]);
+    __m256 zero = _mm256_setzero_ps();
+    for (; i + 2 <= count; i += 2) {
+        __m256 p = _mm256_loadu_ps(&in[i].x);
+        __m256 r = madd8(w0, _mm256_permute_ps(p, 0x00), w3);
+        r = madd8(w1, _mm256_permute_ps(p, 0x55), r);
+        r = madd8(w2, _mm256_permute_ps(p, 0xAA), r);
+        _mm256_storeu_ps(&out[i].x, _mm256_blend_ps(r, zero, 0x88));
+    }
+#endif
+
+    f32x4 c0 = m[0].simd(), c1 = m[1].simd(), c2 = m[2].simd(), c3 = m[3].simd();
+    for (; i < count; i++) {
+        f32x4 p = in[i].simd();
+        f32x4 r = f32x4_madd(c0, f32x4_splat_lane<0>(p), c3);
+        r = f32x4_madd(c1, f32x4_splat_lane<1>(p), r);
+        r = f32x4_madd(c2, f32x4_splat_lane<2>(p), r);
+        out[i] = vec3(r);
+    }
+}
+
+void transform_points_scalar(const mat4& m, const vec3* in, vec3* out, usize count) {
+    for (usize i = 0; i < count; i++) {
+        vec3 p = in[i];
+        vec3 r;
+        for (usize row = 0; row < 3; row++) {
+            r[row] = m[0][row] * p.x + m[1][row] * p.y + m[2][row] * p.z + m[3][row];
+        }
+        out[i] = r;
+    }
+}
+
+/// transform_vectors ///
+
+void transform_vectors(const mat4& m, const vec4* in, vec4* out, usize count) {
+    usize i = 0;
+
+#if defined(Q_SIMD_AVX2)
+    __m256 c0 = broadcast(m[0]), c1 = broadcast(m[1]), c2 = broadcast(m[2]), c3 = broadcast(m[3]);
+    for (; i + 2 <= count; i += 2) {
+        __m256 v = _mm256_loadu_ps(&in[i].x);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+        r = madd8(c1, _mm256_permute_ps(v, 0x55), r);
+        r = madd8(c2, _mm256_permute_ps(v, 0xAA), r);
+        r = madd8(c3, _mm256_permute_ps(v, 0xFF), r);
+        _mm256_storeu_ps(&out[i].x, r);
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = m * in[i];
+    }
+}
+
+void transform_vectors_scalar(const mat4& m, const vec4* in, vec4* out, usize count) {
+    for (usize i = 0; i < count; i++) {
+        vec4 v = in[i];
+        vec4 r;
+        for (usize row = 0; row < 4; row++) {
+            r[row] = m[0][row] * v.x + m[1][row] * v.y + m[2][row] * v.z + m[3][row] * v.w;
+        }
+        out[i] = r;
+    }
+}
+
+/// multiply_matrices ///
+
+void multiply_matrices(const mat4* a, const mat4* b, mat4* out, usize count) {
+#if defined(Q_SIMD_SCALAR)
+    multiply_matrices_scalar(a, b, out, count);
+    return;
+#endif
+
+    for (usize i = 0; i < count; i++) {
+#if defined(Q_SIMD_AVX2)
+        // Two columns of b per register
+        __m256 c0 = broadcast(a[i][0]), c1 = broadcast(a[i][1]), c2 = broadcast(a[i][2]), c3 = broadcast(a[i][3]);
+        for (usize column = 0; column < 4; column += 2) {
+            __m256 v = _mm256_loadu_ps(&b[i][column].x);
+            __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+            r = madd8(c1, _mm256_permute_ps(v, 0x55), r);
+            r = madd8(c2, _mm256_permute_ps(v, 0xAA), r);
+            r = madd8(c3, _mm256_permute_ps(v, 0xFF), r);
+            _mm256_storeu_ps(&out[i][column].x, r);
+        }
+#else
+        out[i] = a[i] * b[i];
+#endif
+    }
+}
+
+void multiply_matrices_scalar(const mat4* a, const mat4* b, mat4* out, usize count) {
+    for (usize i = 0; i < count; i++) {
+        mat4 r;
+        for (usize column = 0; column < 4; column++) {
+            for (usize row = 0; row < 4; row++) {
+                f32 sum = 0;
+                for (usize k = 0; k < 4; k++) {
+                    sum += a[i][k][row] * b[i][column][k];
+                }
+                r[column][row] = sum;
+            }
+        }
+        out[i] = r;
+    }
+}
+
+/// transform_aabbs ///
+
+void transform_aabbs(const mat4& m, const aabb* in, aabb* out, usize count) {
+    f32x4 c0 = m[0].simd(), c1 = m[1].simd(), c2 = m[2].simd(), c3 = m[3].simd();
+    f32x4 a0 = f32x4_abs(c0), a1 = f32x4_abs(c1), a2 = f32x4_abs(c2);
+    f32x4 half = f32x4_splat(0.5f);
+
+    for (usize i = 0; i < count; i++) {
+        f32x4 min = in[i].min.simd();
+        f32x4 max = in[i].max.simd();
+        f32x4 center = f32x4_mul(f32x4_add(min, max), half);
+        f32x4 extents = f32x4_mul(f32x4_sub(max, min), half);
+
+        f32x4 c = f32x4_madd(c0, f32x4_splat_lane<0>(center), c3);
+        c = f32x4_madd(c1, f32x4_splat_lane<1>(center), c);
+        c = f32x4_madd(c2, f32x4_splat_lane<2>(center), c);
+
+        f32x4 e = f32x4_mul(a0, f32x4_splat_lane<0>(extents));
+        e = f32x4_madd(a1, f32x4_splat_lane<1>(extents), e);
+        e = f32x4_madd(a2, f32x4_splat_lane<2>(extents), e);
+
+        out[i].min = vec3(f32x4_sub(c, e));
+        out[i].max = vec3(f32x4_add(c, e));
+    }
+}
+
+void transform_aabbs_scalar(const mat4& m, const aabb* in, aabb* out, usize count) {
+    for (usize i = 0; i < count; i++) {
+        f32 center[3], extents[3];
+        for (usize axis = 0; axis < 3; axis++) {
+            center[axis] = (in[i].min[axis] + in[i].max[axis]) * 0.5f;
+            extents[axis] = (in[i].max[axis] - in[i].min[axis]) * 0.5f;
+        }
+
+        aabb box;
+        for (usize row = 0; row < 3; row++) {
+            f32 c = m[0][row] * center[0] + m[1][row] * center[1] + m[2][row] * center[2] + m[3][row];
+            f32 e = std::fabs(m[0][row]) * extents[0] + std::fabs(m[1][row]) * extents[1] + std::fabs(m[2][row]) * extents[2];
+            box.min[row] = c - e;
+            box.max[row] = c + e;
+        }
+        out[i] = box;
+    }
+}
+
+/// cull_spheres ///
+
+usize cull_spheres(
+    const frustum& view,
+    const f32* x, const f32* y, const f32* z, const f32* radius,
+    u8* visible, usize count
+) {
+    usize visible_count = 0;
+    usize i = 0;
+
+#if defined(Q_SIMD_AVX2)
+    __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+
+        // A sphere is outside when it is behind any plane by more than its radius
+        __m256 outside = zero;
+        for (const vec4& plane : view.planes) {
+            __m256 d = madd8(_mm256_set1_ps(plane.x), px, _mm256_set1_ps(plane.w));
+            d = madd8(_mm256_set1_ps(plane.y), py, d);
+            d = madd8(_mm256_set1_ps(plane.z), pz, d);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_LT_OQ));
+        }
+
+        u32 mask = ~static_cast<u32>(_mm256_movemask_ps(outside)) & 0xFF;
+        for (usize lane = 0; lane < 8; lane++) {
+            visible[i + lane] = static_cast<u8>((mask >> lane) & 1);
+        }
+        visible_count += static_cast<usize>(std::popcount(mask));
+    }
+#elif !defined(Q_SIMD_SCALAR)
+    f32x4 zero = f32x4_splat(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        f32x4 px = f32x4_load(x + i);
+        f32x4 py = f32x4_load(y + i);
+        f32x4 pz = f32x4_load(z + i);
+        f32x4 r = f32x4_load(radius + i);
+
+        u32 outside = 0;
+        for (const vec4& plane : view.planes) {
+            f32x4 d = f32x4_madd(f32x4_splat(plane.x), px, f32x4_splat(plane.w));
+            d = f32x4_madd(f32x4_splat(plane.y), py, d);
+            d = f32x4_madd(f32x4_splat(plane.z), pz, d);
+            outside |= f32x4_less_mask(f32x4_add(d, r), zero);
+        }
+
+        for (usize lane = 0; lane < 4; lane++) {
+            u8 inside = static_cast<u8>(((outside >> lane) & 1) ^ 1);
+            visible[i + lane] = inside;
+            visible_count += inside;
+        }
+    }
+#endif
+
+    return visible_count + cull_spheres_scalar(view, x + i, y + i, z + i, radius + i, visible + i, count - i);
+}
+
+usize cull_spheres_scalar(
+    const frustum& view,
+    const f32* x, const f32* y, const f32* z, const f32* radius,
+    u8* visible, usize count
+) {
+    usize visible_count = 0;
+    for (usize i = 0; i < count; i++) {
+        bool inside = true;
+        for (const vec4& plane : view.planes) {
+            if (plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w + radius[i] < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+
+        visible[i] = inside ? 1 : 0;
+        visible_count += inside ? 1 : 0;
+    }
+    return visible_count;
+}
+
+/// cull_aabbs ///
+
+// A box is outside a plane when even its corner furthest along the
+// plane's normal is behind it: dot(n, center) + dot(|n|, extents) + d < 0
+usize cull_aabbs(const frustum& view, const aabb* boxes, u8* visible, usize count) {
+#if defined(Q_SIMD_SCALAR)
+    return cull_aabbs_scalar(view, boxes, visible, count);
+#endif
+
+    // The planes as columns of x, y, z and d. The group of eight (or two
+    // groups of four) repeats the last planes, which does not change the result.
+    f32 nx[8], ny[8], nz[8], nd[8];
+    for (usize p = 0; p < 8; p++) {
+        const vec4& plane = view.planes[p < 6 ? p : p - 2];
+        nx[p] = plane.x;
+        ny[p] = plane.y;
+        nz[p] = plane.z;
+        nd[p] = plane.w;
+    }
+
+    usize visible_count = 0;
+
+#if defined(Q_SIMD_AVX2)
+    __m256 px = _mm256_loadu_ps(nx), py = _mm256_loadu_ps(ny), pz = _mm256_loadu_ps(nz), pd = _mm256_loadu_ps(nd);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign, px), ay = _mm256_andnot_ps(sign, py), az = _mm256_andnot_ps(sign, pz);
+    __m256 half = _mm256_set1_ps(0.5f);
+
+    for (usize i = 0; i < count; i++) {
+        // Both halves hold min and max
+        __m256 bounds = _mm256_loadu2_m128(&boxes[i].max.x, &boxes[i].min.x);
+        __m256 swapped = _mm256_permute2f128_ps(bounds, bounds, 0x01);
+        __m256 center = _mm256_mul_ps(_mm256_add_ps(bounds, swapped), half);
+        __m256 extents = _mm256_mul_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(swapped, bounds)), half);
+
+        __m256 d = madd8(px, _mm256_permute_ps(center, 0x00), pd);
+        d = madd8(py, _mm256_permute_ps(center, 0x55), d);
+        d = madd8(pz, _mm256_permute_ps(center, 0xAA), d);
+        d = madd8(ax, _mm256_permute_ps(extents, 0x00), d);
+        d = madd8(ay, _mm256_permute_ps(extents, 0x55), d);
+        d = madd8(az, _mm256_permute_ps(extents, 0xAA), d);
+
+        u8 inside = _mm256_movemask_ps(_mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ)) == 0 ? 1 : 0;
+        visible[i] = inside;
+        visible_count += inside;
+    }
+#else
+    f32x4 px[2] = { f32x4_load(nx), f32x4_load(nx + 4) };
+    f32x4 py[2] = { f32x4_load(ny), f32x4_load(ny + 4) };
+    f32x4 pz[2] = { f32x4_load(nz), f32x4_load(nz + 4) };
+    f32x4 pd[2] = { f32x4_load(nd), f32x4_load(nd + 4) };
+    f32x4 zero = f32x4_splat(0.0f);
+    f32x4 half = f32x4_splat(0.5f);
+
+    for (usize i = 0; i < count; i++) {
+        f32x4 min = boxes[i].min.simd();
+        f32x4 max = boxes[i].max.simd();
+        f32x4 center = f32x4_mul(f32x4_add(min, max), half);
+        f32x4 extents = f32x4_mul(f32x4_sub(max, min), half);
+        f32x4 cx = f32x4_splat_lane<0>(center), cy = f32x4_splat_lane<1>(center), cz = f32x4_splat_lane<2>(center);
+        f32x4 ex = f32x4_splat_lane<0>(extents), ey = f32x4_splat_lane<1>(extents), ez = f32x4_splat_lane<2>(extents);
+
+        u32 outside = 0;
+        for (usize group = 0; group < 2; group++) {
+            f32x4 d = f32x4_madd(px[group], cx, pd[group]);
+            d = f32x4_madd(py[group], cy, d);
+            d = f32x4_madd(pz[group], cz, d);
+            d = f32x4_madd(f32x4_abs(px[group]), ex, d);
+            d = f32x4_madd(f32x4_abs(py[group]), ey, d);
+            d = f32x4_madd(f32x4_abs(pz[group]), ez, d);
+            outside |= f32x4_less_mask(d, zero);
+        }
+
+        u8 inside = outside == 0 ? 1 : 0;
+        visible[i] = inside;
+        visible_count += inside;
+    }
+#endif
+
+    return visible_count;
+}
+
+usize cull_aabbs_scalar(const frustum& view, const aabb* boxes, u8* visible, usize count) {
+    usize visible_count = 0;
+    for (usize i = 0; i < count; i++) {
+        f32 center[3], extents[3];
+        for (usize axis = 0; axis < 3; axis++) {
+            center[axis] = (boxes[i].min[axis] + boxes[i].max[axis]) * 0.5f;
+            extents[axis] = (boxes[i].max[axis] - boxes[i].min[axis]) * 0.5f;
+        }
+
+        bool inside = true;
+        for (const vec4& plane : view.planes) {
+            f32 distance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w
+                + std::fabs(plane.x) * extents[0] + std::fabs(plane.y) * extents[1] + std::fabs(plane.z) * extents[2];
+            if (distance < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+
+        visible[i] = inside ? 1 : 0;
+        visible_count += inside ? 1 : 0;
+    }
+    return visible_count;
+}
+
+} // math namespace
+} // bifrost namespace
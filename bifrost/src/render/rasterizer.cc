@@ -0,0 +1,689 @@
+#include "render/rasterizer.h"
+#include "core/clock.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace bifrost {
+namespace render {
+
+using namespace math;
+using core::MemoryTag;
+using core::get_tagged_heap;
+using core::reserve_by_size_class;
+
+// Vertices are snapped to 1/16 of a pixel
+constexpr i32 RASTER_SUBPIXEL_BITS = 4;
+constexpr f32 RASTER_SUBPIXEL_SCALE = static_cast<f32>(1 << RASTER_SUBPIXEL_BITS);
+
+// Pixels past each side of the framebuffer a triangle may reach before it
+// is clipped. Triangles that merely cross the screen edges are common and
+// cost nothing to rasterize, so only the rare huge ones are clipped.
+constexpr f32 RASTER_GUARD_BAND = 2048.0f;
+
+// Smallest w kept by clipping, so the perspective divide stays finite
+constexpr f32 RASTER_MIN_W = 1e-5f;
+
+// Setup jobs at most. Rasterizing a tile walks the bins of every batch.
+constexpr usize RASTER_MAX_SETUP_BATCHES = 256;
+
+// Planes triangles are clipped against, inside where the distance is positive
+constexpr u32 CLIP_PLANE_COUNT = 6;
+constexpr usize CLIP_MAX_VERTICES = 3 + CLIP_PLANE_COUNT;
+
+constexpr u32 BLOCKS_PER_TILE = RASTER_TILE_SIZE / RASTER_BLOCK_SIZE;
+
+static_assert(RASTER_TILE_SIZE % RASTER_BLOCK_SIZE == 0, "Rasterizer: tiles must be made of whole blocks");
+static_assert(RASTER_BLOCK_SIZE % 4 == 0, "Rasterizer: block rows are rasterized four pixels at a time");
+
+static f32 clip_distance(const vec4& p, u32 plane, f32 guard_x, f32 guard_y) {
+    switch (plane) {
+        case 0: return p.w - RASTER_MIN_W;
+        case 1: return p.z;                 // near, depth starts at 0
+        case 2: return guard_x * p.w + p.x; // left
+        case 3: return guard_x * p.w - p.x; // right
+        case 4: return guard_y * p.w + p.y; // bottom
+        default: return guard_y * p.w - p.y; // top
+    }
+}
+
+// Floor of a / b for a positive b
+static i32 floor_div(i32 a, i32 b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+#if defined(Q_SIMD_SSE)
+// Load and store the first count lanes of a group of four pixels. The
+// last group of a row can reach past the right edge of the framebuffer,
+// and the pixels there start the next row, which belongs to another tile.
+template<typename T>
+static __m128i load_lanes(const T* pixels, i32 count) {
+    alignas(16) T lanes[4] = {};
+    std::memcpy(lanes, pixels, static_cast<usize>(count) * sizeof(T));
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+}
+
+template<typename T>
+static void store_lanes(T* pixels, __m128i value, i32 count) {
+    alignas(16) T lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), value);
+    std::memcpy(pixels, lanes, static_cast<usize>(count) * sizeof(T));
+}
+#endif // Q_SIMD_SSE
+
+Rasterizer::SetupBatch::SetupBatch()
+    : triangles(get_tagged_heap(MemoryTag::RENDER))
+    , tile_start(get_tagged_heap(MemoryTag::RENDER))
+    , tile_entries(get_tagged_heap(MemoryTag::RENDER))
+    , bins(get_tagged_heap(MemoryTag::RENDER))
+{
+}
+
+Rasterizer::Rasterizer(u32 width, u32 height)
+    : m_width(0)
+    , m_height(0)
+    , m_cull_mode(CullMode::BACK)
+    , m_clear_pending(false)
+    , m_clear_color(0)
+    , m_clear_depth(1.0f)
+    , m_color(get_tagged_heap(MemoryTag::RENDER))
+    , m_depth(get_tagged_heap(MemoryTag::RENDER))
+    , m_block_depth(get_tagged_heap(MemoryTag::RENDER))
+    , m_vertices(get_tagged_heap(MemoryTag::RENDER))
+    , m_indices(get_tagged_heap(MemoryTag::RENDER))
+    , m_batch_count(0)
+    , m_batch_triangles(0)
+    , m_tile_stats(get_tagged_heap(MemoryTag::RENDER))
+    , m_triangles_submitted(0)
+    , m_stats()
+{
+    resize(width, height);
+}
+
+void Rasterizer::resize(u32 width, u32 height) {
+    width = std::clamp(width, 1u, RASTER_MAX_SIZE);
+    height = std::clamp(height, 1u, RASTER_MAX_SIZE);
+    if (width == m_width && height == m_height) {
+        return;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_tiles_x = (m_width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    m_tiles_y = (m_height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    m_blocks_x = (m_width + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+    m_blocks_y = (m_height + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+    m_guard_x = 1.0f + 2.0f * RASTER_GUARD_BAND / static_cast<f32>(m_width);
+    m_guard_y = 1.0f + 2.0f * RASTER_GUARD_BAND / static_cast<f32>(m_height);
+
+    usize pixels = static_cast<usize>(m_width) * m_height;
+    usize blocks = static_cast<usize>(m_blocks_x) * m_blocks_y;
+    usize tiles = static_cast<usize>(m_tiles_x) * m_tiles_y;
+    reserve_by_size_class(m_color, pixels);
+    reserve_by_size_class(m_depth, pixels);
+    reserve_by_size_class(m_block_depth, blocks);
+    reserve_by_size_class(m_tile_stats, tiles);
+    m_color.assign(pixels, 0);
+    m_depth.assign(pixels, 1.0f);
+    m_block_depth.assign(blocks, 1.0f);
+    m_tile_stats.resize(tiles);
+}
+
+void Rasterizer::clear(u32 color, f32 depth) {
+    m_clear_pending = true;
+    m_clear_color = color;
+    m_clear_depth = depth;
+}
+
+void Rasterizer::draw(
+    const mat4& mvp,
+    const vec3* positions,
+    const u32* colors,
+    usize vertex_count,
+    const u32* indices,
+    usize index_count
+) {
+    usize base = m_vertices.size();
+    for (usize i = 0; i < vertex_count; i++) {
+        u32 color = colors[i];
+        ClipVertex vertex;
+        vertex.position = mvp * vec4(positions[i], 1.0f);
+        vertex.color = vec4(
+            static_cast<f32>((color >> 16) & 0xFF),
+            static_cast<f32>((color >> 8) & 0xFF),
+            static_cast<f32>(color & 0xFF),
+            0.0f
+        );
+        m_vertices.push_back(vertex);
+    }
+
+    // Triangles with an index out of range are dropped
+    for (usize i = 0; i + 2 < index_count; i += 3) {
+        m_triangles_submitted++;
+        if (indices[i] >= vertex_count || indices[i + 1] >= vertex_count || indices[i + 2] >= vertex_count) {
+            continue;
+        }
+        m_indices.push_back(static_cast<u32>(base + indices[i]));
+        m_indices.push_back(static_cast<u32>(base + indices[i + 1]));
+        m_indices.push_back(static_cast<u32>(base + indices[i + 2]));
+    }
+}
+
+void Rasterizer::flush() {
+    PROFILE_SCOPE("Rasterizer::flush");
+    core::JobSystem* jobs = core::JobSystem::get_reference();
+
+    m_stats = {};
+    m_stats.triangles_submitted = m_triangles_submitted;
+
+    // Setup and binning, in batches of consecutive triangles so every tile
+    // sees its triangles in the order they were drawn
+    u64 setup_start = core::platform_time_ns();
+    usize triangle_count = m_indices.size() / 3;
+    m_batch_triangles = std::max(RASTER_SETUP_BATCH, (triangle_count + RASTER_MAX_SETUP_BATCHES - 1) / RASTER_MAX_SETUP_BATCHES);
+    m_batch_count = (triangle_count + m_batch_triangles - 1) / m_batch_triangles;
+    if (m_batches.size() < m_batch_count) {
+        m_batches.resize(m_batch_count);
+    }
+
+    {
+        PROFILE_SCOPE("Rasterizer::setup");
+        jobs->parallel_for(m_batch_count, 1, [this](usize begin, usize end) {
+            for (usize batch = begin; batch < end; batch++) {
+                _setup_batch(batch);
+            }
+        });
+    }
+
+    for (usize i = 0; i < m_batch_count; i++) {
+        m_stats.triangles_setup += m_batches[i].triangles.size();
+        m_stats.tile_bins += m_batches[i].tile_entries.size();
+    }
+
+    u64 raster_start = core::platform_time_ns();
+    m_stats.setup_ns = raster_start - setup_start;
+
+    // Rasterize every tile, each on one thread
+    if (m_clear_pending || m_batch_count > 0) {
+        PROFILE_SCOPE("Rasterizer::raster");
+        jobs->parallel_for(m_tile_stats.size(), 1, [this](usize begin, usize end) {
+            for (usize tile = begin; tile < end; tile++) {
+                m_tile_stats[tile] = {};
+                _rasterize_tile(static_cast<u32>(tile), m_tile_stats[tile]);
+            }
+        });
+
+        for (const RasterStats& tile : m_tile_stats) {
+            m_stats.blocks_rasterized += tile.blocks_rasterized;
+            m_stats.blocks_depth_culled += tile.blocks_depth_culled;
+        }
+    }
+    m_stats.raster_ns = core::platform_time_ns() - raster_start;
+
+    m_clear_pending = false;
+    m_vertices.clear();
+    m_indices.clear();
+    m_triangles_submitted = 0;
+}
+
+void Rasterizer::_setup_batch(usize index) {
+    SetupBatch& batch = m_batches[index];
+    batch.triangles.clear();
+    batch.bins.clear();
+
+    usize first = index * m_batch_triangles;
+    usize last = std::min(first + m_batch_triangles, m_indices.size() / 3);
+    for (usize triangle = first; triangle < last; triangle++) {
+        const ClipVertex* vertices[3] = {
+            &m_vertices[m_indices[triangle * 3]],
+            &m_vertices[m_indices[triangle * 3 + 1]],
+            &m_vertices[m_indices[triangle * 3 + 2]]
+        };
+        _setup_triangle(batch, vertices);
+    }
+
+    // Counting sort of the bins by tile. It is stable, so each tile keeps
+    // its triangles in the order they were drawn.
+    usize tile_count = static_cast<usize>(m_tiles_x) * m_tiles_y;
+    batch.tile_start.assign(tile_count + 1, 0);
+    for (u64 bin : batch.bins) {
+        batch.tile_start[(bin >> 32) + 1]++;
+    }
+    for (usize tile = 0; tile < tile_count; tile++) {
+        batch.tile_start[tile + 1] += batch.tile_start[tile];
+    }
+
+    batch.tile_entries.resize(batch.bins.size());
+    for (u64 bin : batch.bins) {
+        batch.tile_entries[batch.tile_start[bin >> 32]++] = static_cast<u32>(bin);
+    }
+
+    // Filling moved every start to the next tile's, so shift them back
+    for (usize tile = tile_count; tile > 0; tile--) {
+        batch.tile_start[tile] = batch.tile_start[tile - 1];
+    }
+    batch.tile_start[0] = 0;
+}
+
+// Clip a triangle against the planes its vertices are outside of, and
+// emit what is left as a fan
+void Rasterizer::_setup_triangle(SetupBatch& batch, const ClipVertex* vertices[3]) {
+    u32 outside[3] = {};
+    for (u32 v = 0; v < 3; v++) {
+        for (u32 plane = 0; plane < CLIP_PLANE_COUNT; plane++) {
+            if (clip_distance(vertices[v]->position, plane, m_guard_x, m_guard_y) < 0.0f) {
+                outside[v] |= 1u << plane;
+            }
+        }
+    }
+
+    // Entirely outside one plane
+    if ((outside[0] & outside[1] & outside[2]) != 0) {
+        return;
+    }
+
+    u32 crossed = outside[0] | outside[1] | outside[2];
+    if (crossed == 0) {
+        _emit_triangle(batch, *vertices[0], *vertices[1], *vertices[2]);
+        return;
+    }
+
+    ClipVertex polygons[2][CLIP_MAX_VERTICES];
+    ClipVertex* in = polygons[0];
+    ClipVertex* out = polygons[1];
+    usize count = 3;
+    for (u32 v = 0; v < 3; v++) {
+        in[v] = *vertices[v];
+    }
+
+    for (u32 plane = 0; plane < CLIP_PLANE_COUNT; plane++) {
+        if ((crossed & (1u << plane)) == 0) {
+            continue;
+        }
+
+        usize out_count = 0;
+        for (usize v = 0; v < count; v++) {
+            const ClipVertex& a = in[v];
+            const ClipVertex& b = in[(v + 1) % count];
+            f32 distance_a = clip_distance(a.position, plane, m_guard_x, m_guard_y);
+            f32 distance_b = clip_distance(b.position, plane, m_guard_x, m_guard_y);
+
+            if (distance_a >= 0.0f) {
+                out[out_count++] = a;
+            }
+            if ((distance_a >= 0.0f) != (distance_b >= 0.0f)) {
+                f32 t = distance_a / (distance_a - distance_b);
+                out[out_count].position = lerp(a.position, b.position, t);
+                out[out_count].color = lerp(a.color, b.color, t);
+                out_count++;
+            }
+        }
+
+        std::swap(in, out);
+        count = out_count;
+        if (count < 3) {
+            return;
+        }
+    }
+
+    for (usize v = 1; v + 1 < count; v++) {
+        _emit_triangle(batch, in[0], in[v], in[v + 1]);
+    }
+}
+
+// Project, snap and cull a triangle inside the guard band, then compute
+// its edge functions and planes and bin it into the tiles it touches
+void Rasterizer::_emit_triangle(SetupBatch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2) {
+    const ClipVertex* vertices[3] = { &v0, &v1, &v2 };
+    i32 x[3], y[3];
+    f32 z[3], inv_w[3];
+    for (u32 v = 0; v < 3; v++) {
+        const vec4& p = vertices[v]->position;
+        inv_w[v] = 1.0f / p.w;
+        f32 screen_x = (p.x * inv_w[v] * 0.5f + 0.5f) * static_cast<f32>(m_width);
+        f32 screen_y = (0.5f - p.y * inv_w[v] * 0.5f) * static_cast<f32>(m_height);
+        x[v] = static_cast<i32>(std::floor(screen_x * RASTER_SUBPIXEL_SCALE + 0.5f));
+        y[v] = static_cast<i32>(std::floor(screen_y * RASTER_SUBPIXEL_SCALE + 0.5f));
+        z[v] = p.z * inv_w[v];
+    }
+
+    // Twice the signed area, with y pointing down. Positive is clockwise as
+    // seen on screen, the back faces of counter-clockwise meshes.
+    i64 area = static_cast<i64>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<i64>(y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0 || (m_cull_mode == CullMode::BACK && area > 0) || (m_cull_mode == CullMode::FRONT && area < 0)) {
+        return;
+    }
+
+    // Wind every triangle the same way so covered pixels are always positive
+    if (area < 0) {
+        std::swap(vertices[1], vertices[2]);
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        std::swap(inv_w[1], inv_w[2]);
+        area = -area;
+    }
+
+    // Pixels whose centers are inside the snapped bounds
+    constexpr i32 subpixels = 1 << RASTER_SUBPIXEL_BITS;
+    constexpr i32 half = subpixels / 2;
+    RasterTriangle triangle;
+    triangle.min_x = std::max(floor_div(std::min({ x[0], x[1], x[2] }) - half + subpixels - 1, subpixels), 0);
+    triangle.min_y = std::max(floor_div(std::min({ y[0], y[1], y[2] }) - half + subpixels - 1, subpixels), 0);
+    triangle.max_x = std::min(floor_div(std::max({ x[0], x[1], x[2] }) - half, subpixels), static_cast<i32>(m_width) - 1);
+    triangle.max_y = std::min(floor_div(std::max({ y[0], y[1], y[2] }) - half, subpixels), static_cast<i32>(m_height) - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        return;
+    }
+
+    // Edge i runs between the two vertices other than i. Its function is
+    // evaluated at pixel centers, in subpixels.
+    for (u32 edge = 0; edge < 3; edge++) {
+        u32 from = (edge + 1) % 3;
+        u32 to = (edge + 2) % 3;
+        i32 dx = x[to] - x[from];
+        i32 dy = y[to] - y[from];
+        triangle.edge_a[edge] = -dy * subpixels;
+        triangle.edge_b[edge] = dx * subpixels;
+        triangle.edge_c[edge] = static_cast<i64>(dx) * (half - y[from]) - static_cast<i64>(dy) * (half - x[from]);
+
+        // A pixel center exactly on an edge shared by two triangles goes
+        // to only one of them: edges facing one way keep it, their
+        // reverse, as seen from the other triangle, does not
+        if (!(dy > 0 || (dy == 0 && dx < 0))) {
+            triangle.edge_c[edge] -= 1;
+        }
+    }
+
+    // Planes through the three vertices, in pixels
+    f32 fx[3], fy[3];
+    for (u32 v = 0; v < 3; v++) {
+        fx[v] = static_cast<f32>(x[v]) / RASTER_SUBPIXEL_SCALE;
+        fy[v] = static_cast<f32>(y[v]) / RASTER_SUBPIXEL_SCALE;
+    }
+    f32 area_pixels = static_cast<f32>(area) / (RASTER_SUBPIXEL_SCALE * RASTER_SUBPIXEL_SCALE);
+
+    f32 values[5][3];
+    for (u32 v = 0; v < 3; v++) {
+        const vec4& color = vertices[v]->color;
+        values[0][v] = z[v];
+        values[1][v] = inv_w[v];
+        values[2][v] = color.x * inv_w[v];
+        values[3][v] = color.y * inv_w[v];
+        values[4][v] = color.z * inv_w[v];
+    }
+
+    for (u32 plane = 0; plane < 5; plane++) {
+        f32 d1 = values[plane][1] - values[plane][0];
+        f32 d2 = values[plane][2] - values[plane][0];
+        f32 ddx = (d1 * (fy[2] - fy[0]) - d2 * (fy[1] - fy[0])) / area_pixels;
+        f32 ddy = (d2 * (fx[1] - fx[0]) - d1 * (fx[2] - fx[0])) / area_pixels;
+        triangle.planes[plane][0] = ddx;
+        triangle.planes[plane][1] = ddy;
+        triangle.planes[plane][2] = values[plane][0] + ddx * (0.5f - fx[0]) + ddy * (0.5f - fy[0]);
+    }
+    triangle.min_z = std::min({ z[0], z[1], z[2] });
+
+    // Bin into every tile of the bounds that the edges do not rule out
+    u32 index = static_cast<u32>(batch.triangles.size());
+    batch.triangles.push_back(triangle);
+
+    i32 tile_x0 = triangle.min_x / static_cast<i32>(RASTER_TILE_SIZE);
+    i32 tile_y0 = triangle.min_y / static_cast<i32>(RASTER_TILE_SIZE);
+    i32 tile_x1 = triangle.max_x / static_cast<i32>(RASTER_TILE_SIZE);
+    i32 tile_y1 = triangle.max_y / static_cast<i32>(RASTER_TILE_SIZE);
+    bool single_tile = tile_x0 == tile_x1 && tile_y0 == tile_y1;
+
+    for (i32 tile_y = tile_y0; tile_y <= tile_y1; tile_y++) {
+        for (i32 tile_x = tile_x0; tile_x <= tile_x1; tile_x++) {
+            if (!single_tile) {
+                i64 left = std::max(tile_x * static_cast<i32>(RASTER_TILE_SIZE), triangle.min_x);
+                i64 top = std::max(tile_y * static_cast<i32>(RASTER_TILE_SIZE), triangle.min_y);
+                i64 right = std::min((tile_x + 1) * static_cast<i32>(RASTER_TILE_SIZE) - 1, triangle.max_x);
+                i64 bottom = std::min((tile_y + 1) * static_cast<i32>(RASTER_TILE_SIZE) - 1, triangle.max_y);
+
+                bool outside = false;
+                for (u32 edge = 0; edge < 3 && !outside; edge++) {
+                    i64 a = triangle.edge_a[edge];
+                    i64 b = triangle.edge_b[edge];
+                    i64 most = triangle.edge_c[edge] + std::max(a * left, a * right) + std::max(b * top, b * bottom);
+                    outside = most < 0;
+                }
+                if (outside) {
+                    continue;
+                }
+            }
+
+            u64 tile = static_cast<u64>(tile_y) * m_tiles_x + static_cast<u64>(tile_x);
+            batch.bins.push_back((tile << 32) | index);
+        }
+    }
+}
+
+void Rasterizer::_rasterize_tile(u32 tile, RasterStats& stats) {
+    u32 tile_x = tile % m_tiles_x;
+    u32 tile_y = tile / m_tiles_x;
+    u32 x0 = tile_x * RASTER_TILE_SIZE;
+    u32 y0 = tile_y * RASTER_TILE_SIZE;
+    u32 x1 = std::min(x0 + RASTER_TILE_SIZE, m_width);
+    u32 y1 = std::min(y0 + RASTER_TILE_SIZE, m_height);
+
+    if (m_clear_pending) {
+        for (u32 y = y0; y < y1; y++) {
+            std::fill_n(&m_color[static_cast<usize>(y) * m_width + x0], x1 - x0, m_clear_color);
+            std::fill_n(&m_depth[static_cast<usize>(y) * m_width + x0], x1 - x0, m_clear_depth);
+        }
+
+        u32 block_x1 = std::min(tile_x * BLOCKS_PER_TILE + BLOCKS_PER_TILE, m_blocks_x);
+        u32 block_y1 = std::min(tile_y * BLOCKS_PER_TILE + BLOCKS_PER_TILE, m_blocks_y);
+        for (u32 block_y = tile_y * BLOCKS_PER_TILE; block_y < block_y1; block_y++) {
+            for (u32 block_x = tile_x * BLOCKS_PER_TILE; block_x < block_x1; block_x++) {
+                m_block_depth[static_cast<usize>(block_y) * m_blocks_x + block_x] = m_clear_depth;
+            }
+        }
+    }
+
+    for (usize index = 0; index < m_batch_count; index++) {
+        const SetupBatch& batch = m_batches[index];
+        for (u32 entry = batch.tile_start[tile]; entry < batch.tile_start[tile + 1]; entry++) {
+            const RasterTriangle& triangle = batch.triangles[batch.tile_entries[entry]];
+
+            u32 block_x0 = std::max(static_cast<u32>(triangle.min_x), x0) / RASTER_BLOCK_SIZE;
+            u32 block_y0 = std::max(static_cast<u32>(triangle.min_y), y0) / RASTER_BLOCK_SIZE;
+            u32 block_x1 = std::min(static_cast<u32>(triangle.max_x), x1 - 1) / RASTER_BLOCK_SIZE;
+            u32 block_y1 = std::min(static_cast<u32>(triangle.max_y), y1 - 1) / RASTER_BLOCK_SIZE;
+
+            for (u32 block_y = block_y0; block_y <= block_y1; block_y++) {
+                for (u32 block_x = block_x0; block_x <= block_x1; block_x++) {
+                    // Every pixel of the block is nearer than the whole triangle
+                    if (triangle.min_z >= m_block_depth[static_cast<usize>(block_y) * m_blocks_x + block_x]) {
+                        stats.blocks_depth_culled++;
+                        continue;
+                    }
+
+                    stats.blocks_rasterized++;
+                    if (_rasterize_block(triangle, block_x, block_y)) {
+                        _update_block_depth(block_x, block_y);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Rasterize the part of a triangle inside a block. Returns whether any
+// pixel was written.
+bool Rasterizer::_rasterize_block(const RasterTriangle& triangle, u32 block_x, u32 block_y) {
+    i32 x0 = static_cast<i32>(block_x * RASTER_BLOCK_SIZE);
+    i32 y0 = static_cast<i32>(block_y * RASTER_BLOCK_SIZE);
+
+    // Edge functions at the block's first pixel. An edge the whole block is
+    // inside of is dropped, and with it the values that may not fit in 32
+    // bits; one the whole block is outside of rules the block out.
+    i32 edge_start[3], edge_a[3], edge_b[3];
+    constexpr i64 last = RASTER_BLOCK_SIZE - 1;
+    for (u32 edge = 0; edge < 3; edge++) {
+        i64 a = triangle.edge_a[edge];
+        i64 b = triangle.edge_b[edge];
+        i64 value = a * x0 + b * y0 + triangle.edge_c[edge];
+        i64 least = value + std::min<i64>(0, a * last) + std::min<i64>(0, b * last);
+        i64 most = value + std::max<i64>(0, a * last) + std::max<i64>(0, b * last);
+        if (most < 0) {
+            return false;
+        }
+
+        bool inside = least >= 0;
+        edge_start[edge] = inside ? 0 : static_cast<i32>(value);
+        edge_a[edge] = inside ? 0 : triangle.edge_a[edge];
+        edge_b[edge] = inside ? 0 : triangle.edge_b[edge];
+    }
+
+    i32 row_y0 = std::max(y0, triangle.min_y);
+    i32 row_y1 = std::min(y0 + static_cast<i32>(RASTER_BLOCK_SIZE) - 1, triangle.max_y);
+    i32 end_x = std::min(x0 + static_cast<i32>(RASTER_BLOCK_SIZE), triangle.max_x + 1);
+    const f32 (*planes)[3] = triangle.planes;
+    bool written = false;
+
+#if defined(Q_SIMD_SSE)
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128 lane_f = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128i step[3];
+    for (u32 edge = 0; edge < 3; edge++) {
+        step[edge] = _mm_setr_epi32(0, edge_a[edge], 2 * edge_a[edge], 3 * edge_a[edge]);
+    }
+    __m128 plane_step[5];
+    for (u32 plane = 0; plane < 5; plane++) {
+        plane_step[plane] = _mm_mul_ps(_mm_set1_ps(planes[plane][0]), lane_f);
+    }
+
+    for (i32 y = row_y0; y <= row_y1; y++) {
+        usize row = static_cast<usize>(y) * m_width;
+        for (i32 x = x0; x < end_x; x += 4) {
+            __m128i w0 = _mm_add_epi32(_mm_set1_epi32(edge_start[0] + edge_a[0] * (x - x0) + edge_b[0] * (y - y0)), step[0]);
+            __m128i w1 = _mm_add_epi32(_mm_set1_epi32(edge_start[1] + edge_a[1] * (x - x0) + edge_b[1] * (y - y0)), step[1]);
+            __m128i w2 = _mm_add_epi32(_mm_set1_epi32(edge_start[2] + edge_a[2] * (x - x0) + edge_b[2] * (y - y0)), step[2]);
+
+            // Covered where no edge function is negative, within the framebuffer
+            __m128i covered = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(w0, w1), w2), _mm_set1_epi32(-1));
+            covered = _mm_and_si128(covered, _mm_cmpgt_epi32(_mm_set1_epi32(end_x - x), lane));
+            if (_mm_movemask_epi8(covered) == 0) {
+                continue;
+            }
+
+            // Pixels of the group that are in this row
+            i32 count = std::min(static_cast<i32>(m_width) - x, 4);
+
+            f32 fx = static_cast<f32>(x);
+            f32 fy = static_cast<f32>(y);
+            __m128 z = _mm_add_ps(_mm_set1_ps(planes[0][0] * fx + planes[0][1] * fy + planes[0][2]), plane_step[0]);
+            __m128 depth = count == 4
+                ? _mm_loadu_ps(&m_depth[row + x])
+                : _mm_castsi128_ps(load_lanes(&m_depth[row + x], count));
+            __m128 pass = _mm_and_ps(_mm_castsi128_ps(covered), _mm_cmplt_ps(z, depth));
+            if (_mm_movemask_ps(pass) == 0) {
+                continue;
+            }
+            __m128 new_depth = _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, depth));
+            if (count == 4) {
+                _mm_storeu_ps(&m_depth[row + x], new_depth);
+            } else {
+                store_lanes(&m_depth[row + x], _mm_castps_si128(new_depth), count);
+            }
+
+            __m128 inv_w = _mm_add_ps(_mm_set1_ps(planes[1][0] * fx + planes[1][1] * fy + planes[1][2]), plane_step[1]);
+            __m128i channels[3];
+            for (u32 channel = 0; channel < 3; channel++) {
+                const f32* plane = planes[2 + channel];
+                __m128 value = _mm_add_ps(_mm_set1_ps(plane[0] * fx + plane[1] * fy + plane[2]), plane_step[2 + channel]);
+                value = _mm_div_ps(value, inv_w);
+                value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+                channels[channel] = _mm_cvtps_epi32(value);
+            }
+            __m128i color = _mm_or_si128(
+                _mm_or_si128(_mm_slli_epi32(channels[0], 16), _mm_slli_epi32(channels[1], 8)),
+                channels[2]
+            );
+
+            __m128i mask = _mm_castps_si128(pass);
+            if (count == 4) {
+                __m128i old_color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_color[row + x]));
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i*>(&m_color[row + x]),
+                    _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old_color))
+                );
+            } else {
+                __m128i old_color = load_lanes(&m_color[row + x], count);
+                store_lanes(&m_color[row + x], _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old_color)), count);
+            }
+            written = true;
+        }
+    }
+#else
+    // Same arithmetic as the SIMD path, one lane at a time, so both
+    // render the same pixels
+    for (i32 y = row_y0; y <= row_y1; y++) {
+        usize row = static_cast<usize>(y) * m_width;
+        for (i32 group = x0; group < end_x; group += 4) {
+            f32 fx = static_cast<f32>(group);
+            f32 fy = static_cast<f32>(y);
+            f32 base[5];
+            for (u32 plane = 0; plane < 5; plane++) {
+                base[plane] = planes[plane][0] * fx + planes[plane][1] * fy + planes[plane][2];
+            }
+
+            for (i32 lane = 0; lane < 4 && group + lane < end_x; lane++) {
+                i32 x = group + lane;
+                i32 w0 = edge_start[0] + edge_a[0] * (group - x0) + edge_b[0] * (y - y0) + edge_a[0] * lane;
+                i32 w1 = edge_start[1] + edge_a[1] * (group - x0) + edge_b[1] * (y - y0) + edge_a[1] * lane;
+                i32 w2 = edge_start[2] + edge_a[2] * (group - x0) + edge_b[2] * (y - y0) + edge_a[2] * lane;
+                if ((w0 | w1 | w2) < 0) {
+                    continue;
+                }
+
+                f32 lane_f = static_cast<f32>(lane);
+                f32 z = base[0] + planes[0][0] * lane_f;
+                if (!(z < m_depth[row + x])) {
+                    continue;
+                }
+                m_depth[row + x] = z;
+
+                f32 inv_w = base[1] + planes[1][0] * lane_f;
+                u32 color = 0;
+                for (u32 channel = 0; channel < 3; channel++) {
+                    f32 value = (base[2 + channel] + planes[2 + channel][0] * lane_f) / inv_w;
+                    value = std::min(std::max(value, 0.0f), 255.0f);
+                    color = (color << 8) | static_cast<u32>(std::nearbyint(value));
+                }
+                m_color[row + x] = color;
+                written = true;
+            }
+        }
+    }
+#endif // Q_SIMD_SSE
+
+    return written;
+}
+
+// Recompute the farthest depth of a block after it was drawn to
+void Rasterizer::_update_block_depth(u32 block_x, u32 block_y) {
+    u32 x0 = block_x * RASTER_BLOCK_SIZE;
+    u32 y0 = block_y * RASTER_BLOCK_SIZE;
+    u32 x1 = std::min(x0 + RASTER_BLOCK_SIZE, m_width);
+    u32 y1 = std::min(y0 + RASTER_BLOCK_SIZE, m_height);
+
+    f32 farthest = 0.0f;
+    for (u32 y = y0; y < y1; y++) {
+        const f32* row = &m_depth[static_cast<usize>(y) * m_width];
+        for (u32 x = x0; x < x1; x++) {
+            farthest = std::max(farthest, row[x]);
+        }
+    }
+    m_block_depth[static_cast<usize>(block_y) * m_blocks_x + block_x] = farthest;
+}
+
+} // render namespace
+} // bifrost namespace
@@ -0,0 +1,118 @@
+/// BIFROST GAME ENGINE
+/// Application owns the window and runs the engine's main loop
+
+#pragma once
+#include "core/frame_stats.h"
+#include "core/input_record.h"
+#include "core/memory.h"
+#include "core/task_graph.h"
+#include "core/window.h"
+#include "types.h"
+#include "defines.h"
+
+#include <string>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+struct ApplicationConfig {
+    u32 width = 640;
+    u32 height = 480;
+    std::string title = "Bifrost";
+    WindowBackend backend = WindowBackend::AUTO;
+
+    f64 fixed_step = 1.0 / 60.0;  // seconds simulated by every fixed update
+    u32 max_fixed_steps = 8;      // fixed updates per frame before falling behind is dropped
+    f64 target_frame_time = 1.0 / 60.0; // seconds per frame, 0 runs uncapped
+
+    u32 worker_count = 0; // job system workers, 0 starts one per extra core
+
+    usize frame_arena_size = 1024 * 1024; // bytes, grows if a frame needs more
+
+    // When set and built with BIFROST_PROFILE, a Chrome trace of frames
+    // trace_first_frame to trace_last_frame is written here on exit
+    std::string trace_path;
+    u64 trace_first_frame = 0;
+    u64 trace_last_frame = ~0ull;
+
+    // When set, every input is recorded into input_record_path, or the
+    // recording at input_replay_path is fed in place of live input. A
+    // replay runs on a headless window and ends the main loop when the
+    // recording does. Replaying AS_FAST_AS_POSSIBLE also runs uncapped, so
+    // a captured session can be replayed as a benchmark. The
+    // BIFROST_INPUT_RECORD and BIFROST_INPUT_REPLAY environment variables
+    // set the paths without code changes.
+    std::string input_record_path;
+    std::string input_replay_path;
+    ReplayTiming input_replay_timing = ReplayTiming::AS_FAST_AS_POSSIBLE;
+};
+
+// The main loop runs the simulation at a fixed step and renders as often
+// as the frame pacing allows, interpolating between simulation states:
+//
+//   pump -> input -> fixed updates + update -> render -> idle
+//
+// The job system runs for as long as the loop does, and jobs pinned to
+// the main thread run during the pump phase. Systems added to the task
+// graph run every frame in the update phase, after on_update.
+//
+// Subclasses override the on_* hooks to drive the game.
+class QAPI Application {
+public:
+    Application(const ApplicationConfig& config);
+    Application(const Application&) = delete;
+    virtual ~Application() = default;
+
+    // Run the main loop until the window closes or quit is called,
+    // then shut the window down
+    void run();
+
+    // Stop the main loop at the end of the current frame
+    void quit() { m_running = false; }
+
+    Window& get_window() { return m_window; }
+
+    // Systems run every frame. Add them before calling run.
+    TaskGraph& get_task_graph() { return m_task_graph; }
+
+    // Scratch memory for the current frame, freed when the next frame starts
+    LinearArena& get_frame_arena() { return m_frame_arena; }
+
+    // Time spent in each phase over the recent frames
+    const FrameTimeTracker& get_frame_stats() const { return m_frame_stats; }
+
+protected:
+    // Advance the simulation by exactly one fixed step
+    virtual void on_fixed_update(f64 step) { (void)step; }
+
+    // Called once per frame after the fixed updates with the real frame time
+    virtual void on_update(f64 delta_time) { (void)delta_time; }
+
+    // Render the state alpha of the way from the previous fixed update to the last one
+    virtual void on_render(f64 alpha) { (void)alpha; }
+
+private:
+    ApplicationConfig m_config;
+    Window m_window;
+    FrameTimeTracker m_frame_stats;
+    TaskGraph m_task_graph;
+    LinearArena m_frame_arena;
+    bool m_running;
+    u64 m_frame_index;
+
+    FixedTimestep m_timestep;
+    u64 m_frame_ns;        // target frame time in nanoseconds, 0 when uncapped
+
+    InputRecorder m_recorder;
+    InputReplayer m_replayer;
+    bool m_replaying;
+
+    void _wait_until(u64 deadline_ns);
+};
+
+} // core namespace
+
+} // bifrost namespace
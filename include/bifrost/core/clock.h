@@ -0,0 +1,24 @@
+/// BIFROST GAME ENGINE
+/// Monotonic clock used to timestamp input, time frames and pace the main loop
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Current time of a monotonic clock in nanoseconds.
+// Only the difference between two values is meaningful.
+QAPI u64 platform_time_ns();
+
+// Sleep until platform_time_ns() reaches the deadline.
+// Returns immediately if the deadline has already passed.
+QAPI void platform_sleep_until_ns(u64 deadline_ns);
+
+} // core namespace
+
+} // bifrost namespace
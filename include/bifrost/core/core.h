@@ -3,4 +3,6 @@
 /// and other utilities used across the library
 
 #pragma once
+#include "application.h"
+#include "events.h"
 #include "window.h"
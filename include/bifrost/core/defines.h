@@ -33,3 +33,7 @@
 #define QAPI
 #endif
 #endif
+
+// Size of a cache line. Data written by different threads is
+// aligned to this to avoid false sharing.
+#define Q_CACHE_LINE_SIZE 64
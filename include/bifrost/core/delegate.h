@@ -0,0 +1,127 @@
+/// BIFROST GAME ENGINE
+/// Delegate is a small type-erased callable that never allocates.
+/// It replaces std::function for engine callbacks that are fired often.
+
+#pragma once
+#include "types.h"
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Bytes of inline storage a Delegate has for its callable.
+// This fits a function pointer, an object + member function binding,
+// or a lambda capturing up to two pointers.
+constexpr usize DELEGATE_STORAGE_SIZE = 2 * sizeof(void*);
+
+template <typename Signature>
+class Delegate;
+
+// A Delegate stores its callable inline and invokes it through a single
+// function pointer. Only trivially copyable callables that fit in
+// DELEGATE_STORAGE_SIZE bytes are accepted, so copying a Delegate is a memcpy
+// and constructing one never touches the heap.
+template <typename R, typename... Args>
+class Delegate<R(Args...)> {
+public:
+    using stub_function = R (*)(const void* storage, Args... args);
+
+    Delegate() = default;
+
+    // Bind a plain function pointer
+    Delegate(R (*function)(Args...)) {
+        if (function == nullptr) {
+            return;
+        }
+        _store(function);
+        m_stub = &_function_stub;
+    }
+
+    // Bind a small, trivially copyable callable such as a lambda
+    template <
+        typename F,
+        typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<F>, Delegate> &&
+            !std::is_same_v<std::decay_t<F>, R (*)(Args...)> &&
+            std::is_invocable_r_v<R, F&, Args...>
+        >
+    >
+    Delegate(F&& callable) {
+        using callable_type = std::decay_t<F>;
+        static_assert(
+            sizeof(callable_type) <= DELEGATE_STORAGE_SIZE,
+            "Delegate: callable is too large to be stored inline"
+        );
+        static_assert(
+            alignof(callable_type) <= alignof(void*),
+            "Delegate: callable is over-aligned"
+        );
+        static_assert(
+            std::is_trivially_copyable_v<callable_type> && std::is_trivially_destructible_v<callable_type>,
+            "Delegate: callable must be trivially copyable"
+        );
+
+        new (m_storage) callable_type(std::forward<F>(callable));
+        m_stub = &_callable_stub<callable_type>;
+    }
+
+    // Bind a member function to an object instance
+    template <auto Method, typename T>
+    static Delegate bind(T* instance) {
+        Delegate delegate;
+        delegate._store(instance);
+        delegate.m_stub = &_method_stub<Method, T>;
+        return delegate;
+    }
+
+    R operator()(Args... args) const {
+        return m_stub(m_storage, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return m_stub != nullptr; }
+
+    // Unbind the delegate
+    void reset() { m_stub = nullptr; }
+
+private:
+    alignas(void*) unsigned char m_storage[DELEGATE_STORAGE_SIZE] = {};
+    stub_function m_stub = nullptr;
+
+    template <typename T>
+    void _store(T value) {
+        static_assert(sizeof(T) <= DELEGATE_STORAGE_SIZE);
+        std::memcpy(m_storage, &value, sizeof(T));
+    }
+
+    template <typename T>
+    static T _load(const void* storage) {
+        T value;
+        std::memcpy(&value, storage, sizeof(T));
+        return value;
+    }
+
+    static R _function_stub(const void* storage, Args... args) {
+        return _load<R (*)(Args...)>(storage)(std::forward<Args>(args)...);
+    }
+
+    template <typename F>
+    static R _callable_stub(const void* storage, Args... args) {
+        const F& callable = *std::launder(reinterpret_cast<const F*>(storage));
+        return const_cast<F&>(callable)(std::forward<Args>(args)...);
+    }
+
+    template <auto Method, typename T>
+    static R _method_stub(const void* storage, Args... args) {
+        return (_load<T*>(storage)->*Method)(std::forward<Args>(args)...);
+    }
+};
+
+} // core namespace
+
+} // bifrost namespace
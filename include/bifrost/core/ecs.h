@@ -0,0 +1,345 @@
+/// BIFROST GAME ENGINE
+/// Archetype based entity component system. Entities with the same set of
+/// components share an archetype, whose components are stored column by
+/// column in fixed size chunks so queries walk contiguous memory.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "jobs.h"
+#include "memory.h"
+
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Size of the blocks archetypes store their entities in
+constexpr usize ECS_CHUNK_SIZE = 16 * 1024;
+
+// Chunks are aligned to a cache line so columns can be too
+constexpr usize ECS_CHUNK_ALIGNMENT = 64;
+
+// Chunks the chunk pool takes from the heap at a time
+constexpr usize ECS_CHUNKS_PER_PAGE = 16;
+
+// Most component types a program can use
+constexpr u32 ECS_MAX_COMPONENTS = 64;
+
+// Marks a missing archetype or column
+constexpr u32 ECS_NONE = ~0u;
+
+// Set in the generation of entities created by a CommandBuffer that do
+// not exist yet. The other bits of their generation identify the buffer,
+// and the generations of existing entities never have it set.
+constexpr u32 ECS_PENDING_FLAG = 1u << 31;
+
+using ComponentId = u32;
+
+// Set of components, one bit per ComponentId
+using ComponentMask = u64;
+
+// Handle to an entity. The generation changes every time the index is
+// reused, so handles to destroyed entities are detected.
+struct Entity {
+    u32 index;
+    u32 generation;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+};
+
+// Register a component type. Use component_id<T>() instead.
+QAPI ComponentId register_component(u32 size, u32 alignment);
+
+// Id of a component type, registered the first time it is asked for.
+// Components are copied around with memcpy when entities change archetype,
+// so they must be trivially copyable.
+template <typename T>
+ComponentId component_id() {
+    static_assert(std::is_trivially_copyable_v<T>, "ECS: components must be trivially copyable");
+    static_assert(std::is_trivially_destructible_v<T>, "ECS: components must be trivially destructible");
+    static const ComponentId id = register_component(sizeof(T), alignof(T));
+    return id;
+}
+
+template <typename... Ts>
+ComponentMask component_mask() {
+    return ((ComponentMask(1) << component_id<Ts>()) | ... | ComponentMask(0));
+}
+
+// Entities that all have exactly the same components. Row r of the
+// archetype lives in chunk r / chunk_capacity. Each chunk starts with the
+// entity column, followed by one column per component.
+struct Archetype {
+    ComponentMask mask;
+    std::vector<ComponentId> components;
+    u32 column_of[ECS_MAX_COMPONENTS];  // column of each component, ECS_NONE if absent
+    std::vector<u32> column_offsets;
+    std::vector<u32> column_sizes;
+    u32 chunk_capacity;
+
+    std::vector<u8*> chunks; // rows in use, plus at most one empty chunk
+    u32 entity_count;
+
+    // Archetype reached by adding or removing each component
+    u32 add_edge[ECS_MAX_COMPONENTS];
+    u32 remove_edge[ECS_MAX_COMPONENTS];
+
+    u32 chunk_count() const { return (entity_count + chunk_capacity - 1) / chunk_capacity; }
+    u32 rows_in_chunk(u32 chunk) const {
+        u32 rows = entity_count - chunk * chunk_capacity;
+        return rows < chunk_capacity ? rows : chunk_capacity;
+    }
+    Entity* entities(u32 chunk) const { return reinterpret_cast<Entity*>(chunks[chunk]); }
+    void* column(u32 chunk, u32 column) const { return chunks[chunk] + column_offsets[column]; }
+};
+
+class World;
+
+// Records structural changes so they can be made later, typically by
+// jobs that are iterating a query and must not change the archetypes
+// under it. Each job should use its own buffer.
+class QAPI CommandBuffer {
+public:
+    CommandBuffer();
+
+    // Create an entity when the buffer is applied. The returned handle
+    // can only be used with this buffer until it is applied or cleared;
+    // commands given it anywhere else are skipped.
+    Entity create();
+    void destroy(Entity entity);
+
+    template <typename T>
+    void add(Entity entity, const T& value) {
+        _record(COMMAND_ADD, entity, component_id<T>(), &value, sizeof(T));
+    }
+
+    template <typename T>
+    void remove(Entity entity) {
+        _record(COMMAND_REMOVE, entity, component_id<T>(), nullptr, 0);
+    }
+
+    bool is_empty() const { return m_commands.empty(); }
+    void clear();
+
+private:
+    friend class World;
+
+    enum CommandType : u32 {
+        COMMAND_CREATE,
+        COMMAND_DESTROY,
+        COMMAND_ADD,
+        COMMAND_REMOVE
+    };
+
+    struct CommandHeader {
+        CommandType type;
+        ComponentId component;
+        Entity entity;
+        u32 size; // bytes of component data following the header
+    };
+
+    std::vector<u8> m_commands;
+    u32 m_created = 0;
+    u32 m_pending_generation; // ECS_PENDING_FLAG and an id renewed by clear
+
+    void _record(CommandType type, Entity entity, ComponentId component, const void* data, u32 size);
+};
+
+template <typename... Ts>
+class Query;
+
+class QAPI World {
+public:
+    World();
+    World(const World&) = delete;
+    ~World();
+
+    Entity create();
+    bool destroy(Entity entity);
+    bool is_alive(Entity entity) const;
+
+    usize entity_count() const { return m_alive_count; }
+
+    // Add a component, or overwrite it if the entity already has it
+    template <typename T>
+    bool add(Entity entity, const T& value) {
+        return _add_component(entity, component_id<T>(), &value);
+    }
+
+    template <typename T>
+    bool remove(Entity entity) {
+        return _remove_component(entity, component_id<T>());
+    }
+
+    // Pointer to the component, or nullptr if the entity does not have it.
+    // Only valid until the next structural change.
+    template <typename T>
+    T* get(Entity entity) {
+        return static_cast<T*>(_get_component(entity, component_id<T>()));
+    }
+
+    template <typename T>
+    bool has(Entity entity) {
+        return _get_component(entity, component_id<T>()) != nullptr;
+    }
+
+    template <typename... Ts>
+    Query<Ts...> query() { return Query<Ts...>(); }
+
+    // Make the changes recorded in the buffer and clear it
+    void apply(CommandBuffer& commands);
+
+    usize archetype_count() const { return m_archetypes.size(); }
+    const Archetype& get_archetype(u32 index) const { return m_archetypes[index]; }
+
+private:
+    struct EntityRecord {
+        u32 generation;
+        u32 archetype; // ECS_NONE when the index is free
+        u32 row;
+    };
+
+
+    // Chunks are recycled through the pool, so churn does not reach the heap
+    PoolResource m_chunk_pool;
+
+    std::pmr::vector<EntityRecord> m_records;
+    std::pmr::vector<u32> m_free_indices;
+    usize m_alive_count;
+
+    std::vector<Archetype> m_archetypes;
+    std::unordered_map<ComponentMask, u32> m_archetype_lookup;
+
+    bool _add_component(Entity entity, ComponentId component, const void* value);
+    bool _remove_component(Entity entity, ComponentId component);
+    void* _get_component(Entity entity, ComponentId component);
+
+    u32 _get_archetype(ComponentMask mask);
+    u32 _allocate_row(Archetype& archetype);
+    void _remove_row(Archetype& archetype, u32 row);
+    void _move_entity(Entity entity, u32 destination);
+};
+
+// Iterates every entity that has all of Ts. The matching archetypes are
+// cached, and only archetypes created since the last iteration are tested,
+// so keep the query around between frames.
+template <typename... Ts>
+class Query {
+    static_assert(sizeof...(Ts) > 0, "ECS: a query needs at least one component");
+
+public:
+    Query() : m_mask(component_mask<Ts...>()), m_ids{ component_id<Ts>()... } {}
+
+    // Call f(Ts&...) for every matching entity
+    template <typename F>
+    void each(World& world, F&& f) {
+        each_chunk(world, [&f](usize count, Entity*, Ts*... columns) {
+            for (usize i = 0; i < count; i++) {
+                f(columns[i]...);
+            }
+        });
+    }
+
+    // Call f(count, entities, Ts*... columns) for every chunk with matching entities
+    template <typename F>
+    void each_chunk(World& world, F&& f) {
+        _update(world);
+        for (u32 index : m_archetypes) {
+            const Archetype& archetype = world.get_archetype(index);
+            for (u32 chunk = 0; chunk < archetype.chunk_count(); chunk++) {
+                _call(archetype, chunk, f, std::index_sequence_for<Ts...>());
+            }
+        }
+    }
+
+    // Split the matching chunks over the job system. f is called as in
+    // each_chunk, from several threads at once. Returns once all chunks
+    // have been visited.
+    template <typename F>
+    void parallel_each_chunk(World& world, F&& f, usize chunks_per_job = 1) {
+        _update(world);
+
+        m_chunks.clear();
+        for (u32 index : m_archetypes) {
+            const Archetype& archetype = world.get_archetype(index);
+            for (u32 chunk = 0; chunk < archetype.chunk_count(); chunk++) {
+                m_chunks.push_back({ &archetype, chunk });
+            }
+        }
+
+        struct Context {
+            Query* query;
+            F* function;
+        } context = { this, &f };
+
+        Context* shared = &context;
+        JobSystem::get_reference()->parallel_for(m_chunks.size(), chunks_per_job, [shared](usize begin, usize end) {
+            for (usize i = begin; i < end; i++) {
+                const ChunkRef& ref = shared->query->m_chunks[i];
+                shared->query->_call(*ref.archetype, ref.chunk, *shared->function, std::index_sequence_for<Ts...>());
+            }
+        });
+    }
+
+    // Call f(Ts&...) for every matching entity, from several threads at once
+    template <typename F>
+    void parallel_each(World& world, F&& f, usize chunks_per_job = 1) {
+        parallel_each_chunk(world, [&f](usize count, Entity*, Ts*... columns) {
+            for (usize i = 0; i < count; i++) {
+                f(columns[i]...);
+            }
+        }, chunks_per_job);
+    }
+
+    // Number of entities the query matches
+    usize count(World& world) {
+        _update(world);
+        usize total = 0;
+        for (u32 index : m_archetypes) {
+            total += world.get_archetype(index).entity_count;
+        }
+        return total;
+    }
+
+private:
+    struct ChunkRef {
+        const Archetype* archetype;
+        u32 chunk;
+    };
+
+    ComponentMask m_mask;
+    ComponentId m_ids[sizeof...(Ts)];
+    std::vector<u32> m_archetypes;
+    usize m_archetypes_seen = 0;
+    std::vector<ChunkRef> m_chunks;
+
+    // Test the archetypes created since the last update
+    void _update(World& world) {
+        for (; m_archetypes_seen < world.archetype_count(); m_archetypes_seen++) {
+            const Archetype& archetype = world.get_archetype(static_cast<u32>(m_archetypes_seen));
+            if ((archetype.mask & m_mask) == m_mask) {
+                m_archetypes.push_back(static_cast<u32>(m_archetypes_seen));
+            }
+        }
+    }
+
+    template <typename F, usize... Is>
+    void _call(const Archetype& archetype, u32 chunk, F& f, std::index_sequence<Is...>) {
+        f(
+            static_cast<usize>(archetype.rows_in_chunk(chunk)),
+            archetype.entities(chunk),
+            static_cast<Ts*>(archetype.column(chunk, archetype.column_of[m_ids[Is]]))...
+        );
+    }
+};
+
+} // core namespace
+
+} // bifrost namespace
@@ -1,6 +1,11 @@
 #pragma once
 #include "types.h"
-#include <functional>
+#include "delegate.h"
+#include "memory.h"
+#include "mpsc_queue.h"
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
 
 using namespace bifrost::core::types;
 
@@ -24,17 +29,27 @@ enum class EventCode : u64 {
     BUTTON_RELEASED = 0x05,
 
     // Usage:
-    //        uint32_t mouse_x = data.u32[0];
-    //        uint32_t mouse_y = data.u32[1];
+    //        int32_t mouse_x = data.i32[0];
+    //        int32_t mouse_y = data.i32[1];
     MOUSE_MOVED = 0x06,
 
-    // Usage: uint8_t z_delta = data.u8[0];
+    // Usage: int8_t z_delta = data.i8[0];
     MOUSE_WHEEL = 0x07,
 
     // Usage: 
     //        uint16_t width = data.u16[0];
     //        uint16_t height = data.u16[1];
     RESIZED = 0x08,
+
+    // Usage: 
+    //        EventPayload payload = EventPayload::from_data(data);
+    //        const char* text = static_cast<const char*>(handler->get_payload(payload));
+    TEXT_INPUT = 0x09,
+
+    // Usage: 
+    //        EventPayload payload = EventPayload::from_data(data);
+    //        const char* path = static_cast<const char*>(handler->get_payload(payload));
+    FILE_DROPPED = 0x0A,
     
     MAX_EVENT_CODE = 0xFF
 };
@@ -47,22 +62,118 @@ inline usize code_as_usize(EventCode code) {
     return static_cast<usize>(code);
 }
 
+// 128 bits of data sent along with an event. The usage comments on
+// each EventCode describe how the data is laid out for that code.
+// It is trivially copyable so it can be passed by value in registers.
 struct EventData {
+    union {
+        int64_t i64[2];
+        uint64_t u64[2];
+        double f64[2];
+
+        int32_t i32[4];
+        uint32_t u32[4];
+        float f32[4];
+
+        int16_t i16[8];
+        uint16_t u16[8];
+
+        int8_t i8[16];
+        uint8_t u8[16];
+        char c[16];
+    };
+};
+
+static_assert(sizeof(EventData) == 16, "EventData must be 128 bits");
+static_assert(std::is_trivially_copyable_v<EventData>, "EventData must be trivially copyable");
+
+// Handle to a payload that does not fit in EventData, such as text or
+// a file path. The bytes live in the event handler's payload arena and
+// stay valid until the flush that dispatches the event has finished.
+struct EventPayload {
+    u32 offset;
+    u32 size;
+
+    bool is_valid() const { return size != 0; }
 
+    // Pack the handle into the first 64 bits of the event data
+    EventData to_data() const {
+        EventData data = {};
+        data.u32[0] = offset;
+        data.u32[1] = size;
+        return data;
+    }
+
+    static EventPayload from_data(const EventData& data) {
+        return { data.u32[0], data.u32[1] };
+    }
 };
 
-// Callback function object for dispatching
-using event_callback = std::function<bool (EventCode code, void* sender, void* listener, EventData data)>;
+// Bytes of payload that can be stored between two flushes
+constexpr usize EVENT_PAYLOAD_ARENA_SIZE = 64 * 1024;
+
+// Callback for dispatching. This is a Delegate rather than a std::function
+// so that registering a listener never allocates and firing is a single
+// indirect call with no small-buffer checks.
+using event_callback = Delegate<bool (EventCode code, void* sender, void* listener, EventData data)>;
+
+// Handle to a registered listener, used to unregister it in O(1).
+// The generation makes a handle stale once its listener is removed,
+// even after the slot has been reused by another listener.
+struct ListenerHandle {
+    u32 index;
+    u32 generation;
+
+    bool is_valid() const { return generation != 0; }
+    explicit operator bool() const { return is_valid(); }
+};
 
 struct RegisteredEvent {
     void* listener;
-    event_callback callback;
+    event_callback callback; // reset while the listener is waiting to be removed
+    u32 slot;                // index of the listener's slot
+};
+
+// Tracks where a registered listener lives so it can be found from its handle
+struct ListenerSlot {
+    u32 generation;
+    u32 position;  // index into the code's registered events
+    u32 code;
+    bool in_use;
+};
+
+// How queued events of a single code are merged before being flushed
+enum class EventCoalesce : u8 {
+    NONE, // every queued event is dispatched
+    LAST  // only the last event queued before a flush is dispatched
+};
+
+// An event waiting in the queue to be dispatched on the next flush
+struct QueuedEvent {
+    EventCode code;
+    void* sender;
+    EventData data;
+};
+
+// Number of events the queue can hold before it has to grow
+constexpr usize EVENT_QUEUE_INITIAL_CAPACITY = 4096;
+
+// Number of events other threads can post between two flushes
+constexpr usize EVENT_POST_CAPACITY = 4096;
+
+// Counters for events posted from other threads
+struct EventPostStats {
+    u64 posted;  // events accepted into the post queue
+    u64 dropped; // events rejected because the post queue was full
 };
 
 // Holds information for each specific event code
 struct EventCodeEntry {
-    // The events registered for this particular code
-    std::vector<RegisteredEvent> registered_events;
+    EventCodeEntry() : registered_events(get_tagged_heap(MemoryTag::EVENTS)) {}
+
+    // The events registered for this particular code, stored contiguously
+    // so that firing walks a single array
+    std::pmr::vector<RegisteredEvent> registered_events;
 };
 
 class EventHandler {
@@ -70,10 +181,45 @@ public:
     static EventHandler* handler_instance;
     static EventHandler* get_reference();
 
-    bool register_event(EventCode code, void* listener, event_callback callback);
+    // Register a listener for the code. The returned handle unregisters it.
+    ListenerHandle register_event(EventCode code, void* listener, event_callback callback);
+
+    // Unregister the listener in constant time. Listeners unregistered while
+    // an event is being fired are skipped and removed once firing finishes.
+    bool unregister_event(ListenerHandle handle);
+
+    // Unregister the first listener of the code matching the pointer.
+    // Slow path: this scans every listener of the code, about 10us per
+    // call with 50k listeners in bench_listener_churn, where the handle
+    // version takes constant time. Keep it out of per-frame code and
+    // level loads.
     bool unregister_event(EventCode code, void* listener);
+
     bool fire_event(EventCode code, void* sender, EventData data);
-    
+
+    // Queue an event to be dispatched on the next flush instead of immediately
+    bool queue_event(EventCode code, void* sender, EventData data);
+
+    // Post an event from any thread. It is moved into the queue on the
+    // main thread's next flush. Returns false when the post queue is full,
+    // in which case the event is dropped and the caller may retry later.
+    bool post_event(EventCode code, void* sender, EventData data);
+
+    // Dispatch every posted and queued event, grouped by event code.
+    // This should be called once per frame from the main thread.
+    void flush();
+
+    EventPostStats get_post_stats() const;
+
+    // Copy a payload into the payload arena. Must be called from the main thread.
+    // Returns an invalid payload if the arena is full.
+    EventPayload push_payload(const void* data, u32 size);
+
+    // Get the bytes of a payload pushed with push_payload
+    const void* get_payload(EventPayload payload) const;
+
+    // Set how queued events of the code are merged before a flush
+    void set_coalesce(EventCode code, EventCoalesce mode);
 
 protected:
     EventHandler();
@@ -81,6 +227,37 @@ private:
 
     bool m_is_initialized = false;
     EventCodeEntry m_events[EVENT_CODE_AMOUNT];
+
+    // Every container of the handler counts its memory under EVENTS
+    std::pmr::vector<ListenerSlot> m_slots{ get_tagged_heap(MemoryTag::EVENTS) };
+    std::pmr::vector<u32> m_free_slots{ get_tagged_heap(MemoryTag::EVENTS) };
+    std::pmr::vector<u32> m_pending_removals{ get_tagged_heap(MemoryTag::EVENTS) }; // slots unregistered while firing
+    u32 m_dispatch_depth = 0;            // nested fire_event calls in progress
+
+    void _remove_listener(u32 slot_index);
+
+    // Queued events are double buffered so that events queued by a
+    // callback during a flush are dispatched on the following flush
+    std::pmr::vector<QueuedEvent> m_queues[2] = {
+        std::pmr::vector<QueuedEvent>(get_tagged_heap(MemoryTag::EVENTS)),
+        std::pmr::vector<QueuedEvent>(get_tagged_heap(MemoryTag::EVENTS))
+    };
+    u32 m_write_queue = 0;
+
+    EventCoalesce m_coalesce[EVENT_CODE_AMOUNT];
+    u32 m_last_queued[EVENT_CODE_AMOUNT]; // index of the last event queued for each code
+    u32 m_code_offsets[EVENT_CODE_AMOUNT];
+    std::pmr::vector<u32> m_dispatch_order{ get_tagged_heap(MemoryTag::EVENTS) }; // queue indices sorted by event code
+
+    // Payload arenas, paired with the queue buffers so that payloads
+    // live exactly as long as the events that reference them
+    std::pmr::vector<u8> m_payloads[2] = {
+        std::pmr::vector<u8>(get_tagged_heap(MemoryTag::EVENTS)),
+        std::pmr::vector<u8>(get_tagged_heap(MemoryTag::EVENTS))
+    };
+
+    // Events posted by other threads, drained on the main thread
+    MPSCQueue<QueuedEvent> m_posted;
 };
 
 };
@@ -0,0 +1,99 @@
+/// BIFROST GAME ENGINE
+/// Rolling frame time statistics, kept per phase of the main loop, and
+/// the fixed timestep the main loop turns frame times into
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Phases of a frame of the main loop
+enum class FramePhase : u8 {
+    PUMP,   // pumping the window messages and running main thread jobs
+    INPUT,  // updating the input state and flushing queued events
+    UPDATE, // fixed simulation steps and the variable update
+    RENDER, // rendering the interpolated state
+    IDLE,   // waiting for the next frame
+    FRAME,  // the whole frame, start to start
+    COUNT
+};
+
+// Number of frames the statistics are computed over
+constexpr usize FRAME_STATS_HISTORY = 512;
+
+// Statistics of one phase over the frames in the history
+struct FrameTimeSummary {
+    u64 sample_count;
+    u64 last_ns;
+    u64 mean_ns;
+    u64 p50_ns;
+    u64 p99_ns;
+    u64 max_ns;
+};
+
+// Keeps the time spent in every phase for the last FRAME_STATS_HISTORY
+// frames. Recording is constant time. Percentiles are only computed
+// when summarize is called.
+class QAPI FrameTimeTracker {
+public:
+    FrameTimeTracker() = default;
+
+    void record(FramePhase phase, u64 duration_ns) {
+        u8 index = static_cast<u8>(phase);
+        m_samples[index][m_cursor[index]] = duration_ns;
+        m_cursor[index] = (m_cursor[index] + 1) % FRAME_STATS_HISTORY;
+        m_count[index] = m_count[index] < FRAME_STATS_HISTORY ? m_count[index] + 1 : m_count[index];
+        m_last[index] = duration_ns;
+    }
+
+    FrameTimeSummary summarize(FramePhase phase) const;
+
+    void reset();
+
+private:
+    static constexpr usize PHASE_COUNT = static_cast<usize>(FramePhase::COUNT);
+
+    u64 m_samples[PHASE_COUNT][FRAME_STATS_HISTORY] = {};
+    usize m_cursor[PHASE_COUNT] = {};
+    usize m_count[PHASE_COUNT] = {};
+    u64 m_last[PHASE_COUNT] = {};
+};
+
+// Turns variable frame times into whole fixed simulation steps. Time
+// not consumed by a step carries over to the next frame, and how far it
+// is into the next step is where rendering interpolates.
+class QAPI FixedTimestep {
+public:
+    FixedTimestep(u64 step_ns, u32 max_steps)
+        : m_step_ns(step_ns)
+        , m_max_steps(max_steps)
+        , m_accumulator_ns(0)
+    {
+    }
+
+    // Add the time of a frame and return the fixed steps to run for it.
+    // After max_steps the whole steps left are dropped rather than
+    // falling further behind every frame.
+    u32 advance(u64 delta_ns);
+
+    // How far the time left over is into the next step, from 0 to 1
+    f64 get_alpha() const { return static_cast<f64>(m_accumulator_ns) / static_cast<f64>(m_step_ns); }
+
+    u64 get_step_ns() const { return m_step_ns; }
+
+    void reset() { m_accumulator_ns = 0; }
+
+private:
+    u64 m_step_ns;         // fixed step in nanoseconds
+    u32 m_max_steps;       // steps per frame before falling behind is dropped
+    u64 m_accumulator_ns;  // simulation time not consumed by fixed steps yet
+};
+
+} // core namespace
+
+} // bifrost namespace
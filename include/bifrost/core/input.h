@@ -2,8 +2,9 @@
 #include "types.h"
 #include "key.h"
 #include "buttons.h"
+#include <initializer_list>
+#include <span>
 #include <tuple>
-#include <qlogger/qlogger.h>
 
 using namespace bifrost::core::types;
 
@@ -11,29 +12,111 @@ namespace bifrost {
 
 namespace core {
 
+// Set of keys packed one bit per key, so the whole keyboard fits in
+// 256 bits and can be compared against other sets a register at a time
+struct alignas(32) KeyMask {
+    u64 bits[4] = {};
+
+    KeyMask() = default;
+    KeyMask(std::initializer_list<Keys> keys) {
+        for (Keys key : keys) {
+            set(key, true);
+        }
+    }
+
+    bool test(Keys key) const {
+        return (bits[key >> 6] >> (key & 63)) & 1;
+    }
+
+    void set(Keys key, bool value) {
+        u64 bit = u64(1) << (key & 63);
+        bits[key >> 6] = value ? (bits[key >> 6] | bit) : (bits[key >> 6] & ~bit);
+    }
+
+    // Whether any of the keys in the mask are set
+    bool any_of(const KeyMask& keys) const {
+        return ((bits[0] & keys.bits[0]) | (bits[1] & keys.bits[1])
+            | (bits[2] & keys.bits[2]) | (bits[3] & keys.bits[3])) != 0;
+    }
+
+    // Whether all of the keys in the mask are set
+    bool all_of(const KeyMask& keys) const {
+        return ((bits[0] & keys.bits[0]) == keys.bits[0]) && ((bits[1] & keys.bits[1]) == keys.bits[1])
+            && ((bits[2] & keys.bits[2]) == keys.bits[2]) && ((bits[3] & keys.bits[3]) == keys.bits[3]);
+    }
+
+    bool none() const {
+        return (bits[0] | bits[1] | bits[2] | bits[3]) == 0;
+    }
+};
+
+static_assert(Keys::KEYS_MAX_KEY <= 256, "KeyMask holds at most 256 keys");
+
 // State of the keys for the keyboard
 struct KeyboardState {
-    bool keys[Keys::KEYS_MAX_KEY] = { false };
+    KeyMask keys;
 };
 
 // State of the mouse
 struct MouseState {
-    i32 x, y;
-    bool buttons[MouseButtons::MAX_BUTTONS] = { false };
+    i32 x = 0, y = 0;
+    u8 buttons = 0; // one bit per MouseButtons
 };
 
 // The state for the input handler
 struct InputState {
     bool is_initialized;
-    u32 mouse_x, 
-        mouse_y;
-    
+
+    // Updated as soon as the platform reports input
     KeyboardState keyboard_curr_state;
-    KeyboardState keyboard_prev_state;
     MouseState mouse_curr_state;
+
+    // Snapshots taken by update() that are queried for the whole frame
+    KeyboardState keyboard_frame_state;
+    KeyboardState keyboard_prev_state;
+    MouseState mouse_frame_state;
     MouseState mouse_prev_state;
+
+    // Transitions between the previous and the current frame
+    KeyMask keys_pressed;
+    KeyMask keys_released;
+    u8 buttons_pressed;
+    u8 buttons_released;
+};
+
+// Kinds of input kept in the input event ring
+enum class InputEventType : u8 {
+    KEY,
+    BUTTON,
+    MOUSE_MOVE,
+    MOUSE_WHEEL,
+    RESIZE
+};
+
+// A single input as the platform reported it, with the time it arrived
+struct InputEvent {
+    u64 timestamp_ns;    // platform_time_ns() when the platform reported the input
+    InputEventType type;
+    bool pressed;        // KEY and BUTTON
+    u16 code;            // Keys for KEY, MouseButtons for BUTTON
+    i32 x, y;            // position for MOUSE_MOVE, delta in x for MOUSE_WHEEL, size for RESIZE
 };
 
+// Inputs that can be recorded between two updates before the oldest are overwritten
+constexpr usize INPUT_EVENT_RING_CAPACITY = 1024;
+
+// Latency between the platform reporting an input and the update that consumed it
+struct InputLatencyReport {
+    u64 event_count;       // inputs consumed since the report was reset
+    u64 dropped_count;     // inputs overwritten before an update consumed them
+    u64 min_ns;
+    u64 max_ns;
+    f64 mean_ns;
+    u64 last_frame_max_ns; // worst latency in the most recent update
+};
+
+class InputRecorder;
+
 // TODO: Input Handler
 class InputHandler {
 public:
@@ -41,27 +124,72 @@ public:
     static InputHandler* get_reference();
     ~InputHandler();
 
+    // Snapshot the input for this frame and compute which keys and
+    // buttons changed since the last update. Call once per frame
+    // after pumping the window messages.
     void update(f64 delta_time);
-    void process_key(Keys key, bool pressed);
-    void process_buttons(MouseButtons button, bool pressed);
-    void process_mouse_move(i32 x, i32 y);
-    void process_mouse_wheel(i32 z_delta);
+
+    // Inputs are timestamped with platform_time_ns(). A timestamp of 0
+    // means the input is happening now.
+    void process_key(Keys key, bool pressed, u64 timestamp_ns = 0);
+    void process_buttons(MouseButtons button, bool pressed, u64 timestamp_ns = 0);
+    void process_mouse_move(i32 x, i32 y, u64 timestamp_ns = 0);
+    void process_mouse_wheel(i32 z_delta, u64 timestamp_ns = 0);
     std::tuple<i32, i32> get_mouse_position();
-    void process_window_resize(u32 width, u32 height);
+    void process_window_resize(u32 width, u32 height, u64 timestamp_ns = 0);
+
+    // Stream every input and update to the recorder, or stop with nullptr
+    void set_recorder(InputRecorder* recorder) { m_recorder = recorder; }
+
+    // Every input consumed by the last update, in the order it arrived.
+    // Unlike the state masks this keeps presses and moves that happened
+    // within a single frame, along with their timestamps.
+    std::span<const InputEvent> frame_events() const {
+        return std::span<const InputEvent>(m_frame_events, m_frame_event_count);
+    }
+
+    InputLatencyReport get_latency_report() const;
+    void reset_latency_report();
+
+    // Whole-frame key masks. Test many keys at once with KeyMask::any_of
+    // and KeyMask::all_of, e.g. for action mappings.
+    const KeyMask& keys_down() const { return m_state.keyboard_frame_state.keys; }
+    const KeyMask& keys_pressed() const { return m_state.keys_pressed; }
+    const KeyMask& keys_released() const { return m_state.keys_released; }
+
+    bool is_key_down(Keys key) const { return m_state.keyboard_frame_state.keys.test(key); }
+    bool is_key_up(Keys key) const { return !m_state.keyboard_frame_state.keys.test(key); }
+    bool was_key_down(Keys key) const { return m_state.keyboard_prev_state.keys.test(key); }
+    bool was_key_up(Keys key) const { return !m_state.keyboard_prev_state.keys.test(key); }
+    bool key_pressed(Keys key) const { return m_state.keys_pressed.test(key); }
+    bool key_released(Keys key) const { return m_state.keys_released.test(key); }
+
+    bool is_button_down(MouseButtons button) const { return (m_state.mouse_frame_state.buttons >> button) & 1; }
+    bool is_button_up(MouseButtons button) const { return !is_button_down(button); }
+    bool was_button_down(MouseButtons button) const { return (m_state.mouse_prev_state.buttons >> button) & 1; }
+    bool was_button_up(MouseButtons button) const { return !was_button_down(button); }
+    bool button_pressed(MouseButtons button) const { return (m_state.buttons_pressed >> button) & 1; }
+    bool button_released(MouseButtons button) const { return (m_state.buttons_released >> button) & 1; }
+
 private:
-    bool _is_button_down(MouseButtons button);
-    bool _is_button_up(MouseButtons button);
-    bool _was_button_down(MouseButtons button);
-    bool _was_button_up(MouseButtons button);
-    
-    bool _is_key_down(Keys key);
-    bool _is_key_up(Keys key);
-    bool _was_key_down(Keys key);
-    bool _was_key_up(Keys key);
-
-    qlogger::Logger m_logger;
     InputState m_state;
 
+    // Inputs recorded since the last update. Once full, the oldest are overwritten.
+    InputEvent m_event_ring[INPUT_EVENT_RING_CAPACITY];
+    usize m_ring_head = 0;
+    usize m_ring_count = 0;
+
+    // Inputs consumed by the last update
+    InputEvent m_frame_events[INPUT_EVENT_RING_CAPACITY];
+    usize m_frame_event_count = 0;
+
+    InputRecorder* m_recorder = nullptr;
+
+    InputLatencyReport m_latency;
+    u64 m_latency_total_ns = 0;
+
+    void _record_event(const InputEvent& event);
+
 protected:
     InputHandler();
 };
@@ -0,0 +1,122 @@
+/// BIFROST GAME ENGINE
+/// Recording and replaying of input so that a captured session can be
+/// played back deterministically, with or without a window.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "input.h"
+#include "delegate.h"
+#include <cstdio>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Size of the buffer the recorder fills before writing to the file
+constexpr usize INPUT_RECORD_BUFFER_SIZE = 64 * 1024;
+
+// Streams every input the InputHandler receives, along with a marker for
+// every update, into a compact binary file.
+//
+// File layout: an 8 byte header ("BFIR" then a u32 version) followed by
+// records. Each record is a tag byte (record type, plus the pressed flag
+// in the high bit) and the time since the previous record as a varint.
+// The payload follows: key and button codes as varints, and mouse positions
+// as zigzag varint deltas from the previous position. Wheel deltas and
+// window sizes are zigzag varints.
+class QAPI InputRecorder {
+public:
+    InputRecorder() = default;
+    InputRecorder(const InputRecorder&) = delete;
+    ~InputRecorder();
+
+    // Start recording into the file, replacing it if it exists
+    bool open(const char* path);
+
+    // Write out everything recorded so far and close the file
+    void close();
+
+    bool is_recording() const { return m_file != nullptr; }
+
+    void record(const InputEvent& event);
+
+    // Mark an InputHandler::update so replay can reproduce frame boundaries
+    void record_frame(u64 timestamp_ns);
+
+private:
+    FILE* m_file = nullptr;
+    u8 m_buffer[INPUT_RECORD_BUFFER_SIZE];
+    usize m_buffer_used = 0;
+
+    bool m_has_timestamp = false;
+    u64 m_last_timestamp = 0;
+    i32 m_last_x = 0;
+    i32 m_last_y = 0;
+
+    void _write_header(u8 tag, u64 timestamp_ns);
+    void _write_varint(u64 value);
+    void _write_signed(i64 value);
+    void _flush();
+};
+
+class Window;
+
+// How quickly a recording is fed back into the InputHandler
+enum class ReplayTiming {
+    ORIGINAL,           // inputs are fed when as much time has passed as when they were recorded
+    AS_FAST_AS_POSSIBLE // every call feeds exactly one recorded frame
+};
+
+// Plays a recording made by InputRecorder back into an InputHandler.
+// The file is memory mapped, so playback does no reads or copies.
+class QAPI InputReplayer {
+public:
+    InputReplayer() = default;
+    InputReplayer(const InputReplayer&) = delete;
+    ~InputReplayer();
+
+    bool open(const char* path);
+    void close();
+
+    // Feed the recorded inputs that are due into the handler.
+    // Call once per frame before InputHandler::update.
+    // Returns false, without feeding anything, once the whole recording
+    // has been replayed.
+    bool replay_frame(InputHandler* handler, ReplayTiming timing);
+
+    // Inject the recorded inputs that are due into a headless window, so
+    // they go through its pump like live input. Call before pumping it.
+    bool replay_frame(Window& window, ReplayTiming timing);
+
+    bool is_finished() const { return m_data == nullptr || m_cursor >= m_size; }
+
+private:
+    const u8* m_data = nullptr;
+    usize m_size = 0;
+    usize m_cursor = 0;
+
+#ifdef Q_PLATFORM_WINDOWS
+    void* m_file_handle = nullptr;
+    void* m_mapping_handle = nullptr;
+#endif // Q_PLATFORM_WINDOWS
+
+    // Decoding state
+    u64 m_record_time = 0;   // time of the last decoded record, relative to the first
+    i32 m_last_x = 0;
+    i32 m_last_y = 0;
+    bool m_started = false;
+    u64 m_replay_start = 0;  // platform_time_ns() when replay started
+
+    using input_sink = Delegate<void (const InputEvent& event)>;
+    bool _replay(ReplayTiming timing, input_sink sink);
+
+    bool _read_varint(u64& value);
+    bool _read_signed(i64& value);
+};
+
+} // core namespace
+
+} // bifrost namespace
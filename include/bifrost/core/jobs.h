@@ -0,0 +1,162 @@
+/// BIFROST GAME ENGINE
+/// Job system: one worker thread per core sharing work through
+/// work-stealing deques, plus a queue pinned to the main thread.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "delegate.h"
+#include "mpsc_queue.h"
+#include "work_stealing_deque.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Work run by the job system
+using job_function = Delegate<void ()>;
+
+// Body of a parallel_for, called with a [begin, end) range of indices
+using range_function = Delegate<void (usize begin, usize end)>;
+
+// Jobs each thread can have submitted but not yet picked up.
+// Submitting more than this runs the extra jobs on the submitting thread.
+constexpr usize JOB_QUEUE_CAPACITY = 4096;
+
+// Jobs that can wait for the main thread, or be submitted from threads
+// outside the job system, at once
+constexpr usize JOB_SHARED_QUEUE_CAPACITY = 4096;
+
+// Index of threads that are not part of the job system
+constexpr u32 JOB_THREAD_EXTERNAL = ~0u;
+
+// Counts the jobs that were submitted with it and have not finished.
+// Waiting on a counter is how one piece of work depends on another.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+
+    bool is_done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+    // Track work that is not submitted as a job with this counter,
+    // such as jobs that will be submitted later by other jobs
+    void add(u32 count) { m_pending.fetch_add(count, std::memory_order_relaxed); }
+    void finish() { m_pending.fetch_sub(1, std::memory_order_release); }
+
+    // Drop work that was added but will never be finished. Nothing may
+    // be waiting on the counter or still finishing it.
+    void reset() { m_pending.store(0, std::memory_order_relaxed); }
+
+private:
+    friend class JobSystem;
+    std::atomic<u32> m_pending = 0;
+};
+
+struct Job {
+    job_function function;
+    JobCounter* counter;
+};
+
+// A job submitted by a job system thread. The slot is free again as soon
+// as a thread picks the job up, before it runs.
+struct JobSlot {
+    Job job;
+    std::atomic<bool> queued = false;
+};
+
+// Per thread state. Thread 0 is the thread that initialized the job system.
+struct alignas(Q_CACHE_LINE_SIZE) JobThread {
+    WorkStealingDeque<JobSlot> deque = WorkStealingDeque<JobSlot>(JOB_QUEUE_CAPACITY);
+    std::unique_ptr<JobSlot[]> slots = std::make_unique<JobSlot[]>(JOB_QUEUE_CAPACITY);
+    usize next_slot = 0;
+    u32 random_state = 0; // picks which thread to steal from
+};
+
+// Jobs are small delegates and run to completion on whichever thread
+// picks them up. A thread waiting on a counter runs other jobs until the
+// counter reaches zero, so waiting never idles a worker while there is
+// work to do.
+//
+// The thread that calls init becomes the main thread. Work that must run
+// there, like pumping window messages, is submitted with submit_main and
+// runs when the main thread calls run_main_jobs or waits on a counter.
+class QAPI JobSystem {
+public:
+    static JobSystem* job_system_instance;
+    static JobSystem* get_reference();
+    ~JobSystem();
+
+    // Start the worker threads. A worker count of 0 starts one worker for
+    // every core besides the calling thread.
+    bool init(u32 worker_count = 0);
+
+    // Finish the jobs that are left and join the workers
+    void shutdown();
+
+    bool is_initialized() const { return m_is_initialized; }
+
+    // Worker threads plus the main thread
+    u32 get_thread_count() const { return static_cast<u32>(m_threads.size()); }
+
+    // Index of the calling thread: 0 for the main thread, 1 and up for
+    // the workers and JOB_THREAD_EXTERNAL for any other thread
+    static u32 get_thread_index();
+
+    // Run a job on any thread. The counter, if any, is incremented now and
+    // decremented once the job has run. Before init, jobs run immediately.
+    void submit(job_function function, JobCounter* counter = nullptr);
+
+    // Run a job on the main thread
+    void submit_main(job_function function, JobCounter* counter = nullptr);
+
+    // Run the jobs pinned to the main thread. Must be called from the main thread.
+    void run_main_jobs();
+
+    // Run other jobs until every job submitted with the counter has finished
+    void wait(JobCounter& counter);
+
+    // Split [0, count) into ranges of at most batch_size indices and run
+    // them across all threads, including the calling one. Returns once
+    // every range has been run.
+    void parallel_for(usize count, usize batch_size, range_function body);
+
+private:
+    bool m_is_initialized;
+
+    std::vector<std::unique_ptr<JobThread>> m_threads;
+    std::vector<std::thread> m_workers;
+    std::atomic<bool> m_running;
+
+    // Jobs pinned to the main thread
+    MPSCQueue<Job> m_main_jobs;
+
+    // Jobs submitted by threads outside the job system. Workers take
+    // turns consuming it, guarded by the flag.
+    MPSCQueue<Job> m_external_jobs;
+    std::atomic_flag m_external_lock;
+
+    // Idle workers sleep on the epoch, which changes on every submit
+    alignas(Q_CACHE_LINE_SIZE) std::atomic<u32> m_wake_epoch;
+    std::atomic<u32> m_sleeping;
+
+    void _worker_main(u32 index);
+    bool _run_one(u32 index);
+    bool _take_job(u32 index, Job& out);
+    void _execute(const Job& job);
+    void _wake_one();
+
+protected:
+    JobSystem();
+};
+
+} // core namespace
+
+} // bifrost namespace
@@ -1,4 +1,7 @@
 #pragma once
+#include "types.h"
+
+using namespace bifrost::core::types;
 
 namespace bifrost {
 
@@ -136,5 +139,28 @@ enum Keys : int {
     KEYS_MAX_KEY
 };
 
+// Number of entries in a key table. X11 hardware keycodes and Win32
+// virtual key codes both fit in a byte.
+constexpr usize KEY_TABLE_SIZE = 256;
+
+// Flat lookup from a platform key code to an engine key.
+// Each platform fills it in from its keymap when the window is created
+// (and again when the keymap changes), so translating a key event in
+// the hot path is a single load.
+struct KeyTable {
+    Keys keys[KEY_TABLE_SIZE];
+
+    void clear() {
+        for (usize i = 0; i < KEY_TABLE_SIZE; i++) {
+            keys[i] = KEYS_MAX_KEY;
+        }
+    }
+
+    // Returns KEYS_MAX_KEY for codes that do not map to an engine key
+    Keys translate(u32 code) const {
+        return code < KEY_TABLE_SIZE ? keys[code] : KEYS_MAX_KEY;
+    }
+};
+
 
 } // bifrost namespace
@@ -0,0 +1,213 @@
+/// BIFROST GAME ENGINE
+/// Engine logging. Q_LOG_INFO("format", args...) copies the format pointer
+/// and the arguments into a buffer owned by the calling thread, and a
+/// background writer formats and prints them later, so logging never
+/// waits on formatting or the console.
+///
+/// Calls below BIFROST_LOG_LEVEL are compiled away, and their arguments
+/// are never evaluated.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+using namespace bifrost::core::types;
+
+// Lowest level that is compiled in: 0 trace, 1 debug, 2 info, 3 warn,
+// 4 error, 5 fatal. Debug builds keep debug messages, release builds
+// start at info.
+#ifndef BIFROST_LOG_LEVEL
+#ifdef NDEBUG
+#define BIFROST_LOG_LEVEL 2
+#else
+#define BIFROST_LOG_LEVEL 1
+#endif
+#endif
+
+namespace bifrost {
+
+namespace core {
+
+enum LogLevel : u8 {
+    LOG_LEVEL_TRACE,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_FATAL
+};
+
+// Bytes of messages each thread can have waiting for the writer.
+// Messages that do not fit are dropped and counted.
+constexpr usize LOG_BUFFER_SIZE = 128 * 1024;
+
+// Longest formatted message, and longest string argument that is copied
+constexpr usize LOG_MESSAGE_MAX = 1024;
+constexpr usize LOG_STRING_MAX = 512;
+
+// Turns the arguments stored after a record back into a message
+using log_format_function = usize (*)(char* out, usize capacity, const char* format, const u8* args);
+
+// A message in a thread's buffer. The arguments follow it.
+struct LogRecord {
+    u32 size;                        // Header and arguments, rounded to 8 bytes
+    u8 level;
+    u64 sequence;                    // Order of the message across all threads
+    const char* format;
+    log_format_function format_args;
+};
+
+// Reserve a record of size bytes in the calling thread's buffer, with size
+// and sequence set. Returns nullptr if the buffer is full.
+QAPI LogRecord* log_begin(usize size);
+
+// Publish the record reserved by log_begin to the writer
+QAPI void log_end();
+
+// Print every message logged so far before returning
+QAPI void log_flush();
+
+// Format a message without arguments, where only %% means anything
+QAPI usize log_format_text(char* out, usize capacity, const char* format);
+
+// How an argument is stored. Numbers, enums and pointers are copied as they
+// are; strings are copied into the record, since they may be gone by the
+// time the writer formats them.
+template<typename T>
+struct LogArgument {
+    static_assert(
+        std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+        "Log: arguments must be numbers, enums, pointers or C strings"
+    );
+
+    static usize size(T value) {
+        (void)value;
+        return sizeof(T);
+    }
+
+    static u8* write(u8* out, T value) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    static T read(const u8*& in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+};
+
+template<>
+struct LogArgument<const char*> {
+    static usize length(const char* value) {
+        return value != nullptr ? strnlen(value, LOG_STRING_MAX) : 0;
+    }
+
+    static usize size(const char* value) {
+        return sizeof(u32) + length(value) + 1;
+    }
+
+    static u8* write(u8* out, const char* value) {
+        u32 count = static_cast<u32>(length(value));
+        std::memcpy(out, &count, sizeof(u32));
+        if (count > 0) {
+            std::memcpy(out + sizeof(u32), value, count);
+        }
+        out[sizeof(u32) + count] = '\0';
+        return out + sizeof(u32) + count + 1;
+    }
+
+    static const char* read(const u8*& in) {
+        u32 count;
+        std::memcpy(&count, in, sizeof(u32));
+        const char* value = reinterpret_cast<const char*>(in + sizeof(u32));
+        in += sizeof(u32) + count + 1;
+        return value;
+    }
+};
+
+// Type an argument is stored as. Mutable strings are stored like constant ones.
+template<typename T>
+using log_argument_t = std::conditional_t<std::is_same_v<std::decay_t<T>, char*>, const char*, std::decay_t<T>>;
+
+template<typename... Args>
+usize log_format_args(char* out, usize capacity, const char* format, const u8* args) {
+    if constexpr (sizeof...(Args) == 0) {
+        (void)args;
+        return log_format_text(out, capacity, format);
+    } else {
+        // Braced initialization reads the arguments in order
+        std::tuple<Args...> values{ LogArgument<Args>::read(args)... };
+        int written = std::apply([&](auto... value) { return std::snprintf(out, capacity, format, value...); }, values);
+        return written > 0 ? static_cast<usize>(written) : 0;
+    }
+}
+
+template<typename... Args>
+void log_write(LogLevel level, const char* format, const Args&... args) {
+    usize size = sizeof(LogRecord) + (usize(0) + ... + LogArgument<log_argument_t<Args>>::size(args));
+    LogRecord* record = log_begin(size);
+    if (record == nullptr) {
+        return;
+    }
+
+    record->level = level;
+    record->format = format;
+    record->format_args = &log_format_args<log_argument_t<Args>...>;
+
+    u8* out = reinterpret_cast<u8*>(record + 1);
+    ((out = LogArgument<log_argument_t<Args>>::write(out, args)), ...);
+    (void)out;
+    log_end();
+}
+
+} // core namespace
+
+} // bifrost namespace
+
+// The unevaluated printf lets the compiler check the format against the arguments
+#define Q_LOG_WRITE(level, ...) \
+    ((void)sizeof(std::printf(__VA_ARGS__)), ::bifrost::core::log_write(level, __VA_ARGS__))
+
+// Calls that are compiled out keep the arguments in the unevaluated printf,
+// so variables that only feed log messages do not become unused
+#define Q_LOG_DISCARD(...) ((void)sizeof(std::printf(__VA_ARGS__)))
+
+#if BIFROST_LOG_LEVEL <= 0
+#define Q_LOG_TRACE(...) Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define Q_LOG_TRACE(...) Q_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if BIFROST_LOG_LEVEL <= 1
+#define Q_LOG_DEBUG(...) Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define Q_LOG_DEBUG(...) Q_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if BIFROST_LOG_LEVEL <= 2
+#define Q_LOG_INFO(...) Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define Q_LOG_INFO(...) Q_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if BIFROST_LOG_LEVEL <= 3
+#define Q_LOG_WARN(...) Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define Q_LOG_WARN(...) Q_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if BIFROST_LOG_LEVEL <= 4
+#define Q_LOG_ERROR(...) Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define Q_LOG_ERROR(...) Q_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+// Fatal messages are always kept, and printed before the call returns
+#define Q_LOG_FATAL(...) (Q_LOG_WRITE(::bifrost::core::LOG_LEVEL_FATAL, __VA_ARGS__), ::bifrost::core::log_flush())
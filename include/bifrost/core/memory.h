@@ -0,0 +1,225 @@
+/// BIFROST GAME ENGINE
+/// Engine allocators. Every allocator is a std::pmr::memory_resource so
+/// standard containers can allocate from it, and the memory they take from
+/// the system is counted under a tag.
+///
+/// Building with BIFROST_TRACK_ALLOCATIONS also routes the global operator
+/// new and delete through the tags, and samples call stacks so reports can
+/// show where memory comes from and what was leaked.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+
+#include <atomic>
+#include <bit>
+#include <memory_resource>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// What memory is used for
+enum class MemoryTag : u8 {
+    UNTAGGED,
+    EVENTS,
+    ECS,
+    FRAME,
+    WINDOW,
+    INPUT,
+    JOBS,
+    PROFILER,
+    LOG,
+    RENDER,
+    FILES,
+    COUNT
+};
+
+QAPI const char* memory_tag_name(MemoryTag tag);
+
+// Global allocations and frees a thread batches before adding them to the
+// shared stats, when BIFROST_TRACK_ALLOCATIONS is on
+constexpr u32 ALLOCATION_FLUSH_INTERVAL = 256;
+
+struct MemoryTagStats {
+    u64 live_bytes;  // allocated and not yet freed
+    u64 peak_bytes;  // most live bytes at any one time
+    u64 allocations; // number of allocations made
+    u64 frees;       // number of allocations freed
+};
+
+QAPI MemoryTagStats get_memory_stats(MemoryTag tag);
+
+// Log the stats of every tag that has allocated anything
+QAPI void log_memory_report();
+
+// Count memory taken (positive bytes) or returned under a tag. Used by
+// the allocators.
+QAPI void memory_record(MemoryTag tag, i64 bytes, u64 allocations, u64 frees);
+
+// With BIFROST_TRACK_ALLOCATIONS, each thread batches the counts of its
+// global allocations. This adds the calling thread's batch to the stats;
+// the other threads' may lag by up to ALLOCATION_FLUSH_INTERVAL calls, and
+// peaks are only seen when a batch is added.
+QAPI void flush_memory_counts();
+
+// Tag that heap allocations made by the calling thread are counted under
+QAPI MemoryTag get_current_memory_tag();
+QAPI void set_current_memory_tag(MemoryTag tag);
+
+// Counts the thread's heap allocations under a tag until the scope ends
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag) : m_previous(get_current_memory_tag()) {
+        set_current_memory_tag(tag);
+    }
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    ~MemoryTagScope() { set_current_memory_tag(m_previous); }
+
+private:
+    MemoryTag m_previous;
+};
+
+// Only available with BIFROST_TRACK_ALLOCATIONS. One in this many global
+// allocations has its call stack recorded. 0 turns sampling off.
+QAPI void set_allocation_sample_rate(u32 rate);
+
+// Log the tags and the sampled call sites holding the most live memory
+QAPI void log_allocation_report(usize max_sites = 10);
+
+// Log the memory that is still allocated, by tag and by sampled call site.
+// Runs automatically at exit in tracking builds.
+QAPI void log_leak_report();
+
+// Heap that counts its allocations under the tag. Shared by every user
+// of the tag and safe to use from any thread.
+QAPI std::pmr::memory_resource* get_tagged_heap(MemoryTag tag);
+
+// Forwards to an upstream resource and counts what passes through
+class QAPI TaggedHeap : public std::pmr::memory_resource {
+public:
+    explicit TaggedHeap(MemoryTag tag, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : m_tag(tag), m_upstream(upstream) {}
+
+    MemoryTag get_tag() const { return m_tag; }
+
+private:
+    MemoryTag m_tag;
+    std::pmr::memory_resource* m_upstream;
+
+    void* do_allocate(usize bytes, usize alignment) override;
+    void do_deallocate(void* pointer, usize bytes, usize alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Bump allocator over one block taken up front. Freeing does nothing;
+// everything is released at once by reset. When the block runs out,
+// allocations go to the upstream resource until the next reset, which
+// frees them and grows the block to fit.
+//
+// Not thread safe.
+class QAPI LinearArena : public std::pmr::memory_resource {
+public:
+    LinearArena(usize capacity, std::pmr::memory_resource* upstream);
+    LinearArena(const LinearArena&) = delete;
+    ~LinearArena();
+
+    // Free everything allocated since the last reset
+    void reset();
+
+    usize get_used() const { return m_used; }
+    usize get_capacity() const { return m_capacity; }
+
+    // Most bytes used between two resets, including overflow
+    usize get_high_water() const { return m_high_water; }
+
+private:
+    // Allocations made after the block ran out, freed on reset
+    struct Overflow {
+        Overflow* next;
+        usize bytes;
+        usize alignment;
+    };
+
+    std::pmr::memory_resource* m_upstream;
+    u8* m_block;
+    usize m_capacity;
+    usize m_used;
+    usize m_overflow_bytes;
+    usize m_high_water;
+    Overflow* m_overflow;
+
+    void* do_allocate(usize bytes, usize alignment) override;
+    void do_deallocate(void* pointer, usize bytes, usize alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Hands out blocks of one size from pages taken from the upstream
+// resource. Freed blocks go on a free list and are reused, and pages are
+// only returned to the upstream when the pool is destroyed. Requests that
+// do not fit a block are passed to the upstream.
+//
+// Not thread safe.
+class QAPI PoolResource : public std::pmr::memory_resource {
+public:
+    PoolResource(usize block_size, usize block_alignment, usize blocks_per_page, std::pmr::memory_resource* upstream);
+    PoolResource(const PoolResource&) = delete;
+    ~PoolResource();
+
+    usize get_block_size() const { return m_block_size; }
+    usize get_blocks_in_use() const { return m_blocks_in_use; }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Page {
+        Page* next;
+    };
+
+    std::pmr::memory_resource* m_upstream;
+    usize m_block_size;
+    usize m_block_alignment;
+    usize m_blocks_per_page;
+    usize m_page_header; // bytes before the first block of a page
+    usize m_blocks_in_use;
+    FreeBlock* m_free;
+    Page* m_pages;
+
+    void _add_page();
+
+    void* do_allocate(usize bytes, usize alignment) override;
+    void do_deallocate(void* pointer, usize bytes, usize alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Round a size up to its size class. There are four classes per power of
+// two, so a buffer allocated by class wastes at most a quarter of itself.
+inline usize memory_size_class(usize size) {
+    usize step = size > 4 ? std::bit_floor(size) / 4 : 1;
+    return (size + step - 1) & ~(step - 1);
+}
+
+// Make room in a vector whose size keeps changing, such as a render target
+// following the window size. The allocation is kept while the size fits
+// and its class is at least half of it, so dragging a window edge does
+// not reallocate on every step. Otherwise it is replaced with one of the
+// size's class, and the contents are lost.
+template<typename Vector>
+void reserve_by_size_class(Vector& vector, usize size) {
+    usize capacity = vector.capacity();
+    if (size <= capacity && memory_size_class(size) >= capacity / 2) {
+        return;
+    }
+
+    Vector replacement(vector.get_allocator());
+    replacement.reserve(memory_size_class(size));
+    vector.swap(replacement);
+}
+
+} // core namespace
+
+} // bifrost namespace
@@ -0,0 +1,112 @@
+/// BIFROST GAME ENGINE
+/// Bounded lock-free queue with many producer threads and a single consumer.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include <atomic>
+#include <memory>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Fixed capacity multi-producer single-consumer queue.
+// Each cell carries a sequence number that tells producers and the
+// consumer whether it is free or filled, so pushing is a single CAS
+// on the tail and popping needs no atomic read-modify-write at all.
+//
+// The queue never grows. A push into a full queue fails and is counted
+// as dropped, and the producer decides whether to retry, back off or
+// discard the item.
+template <typename T>
+class MPSCQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit MPSCQueue(usize capacity) {
+        usize size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        m_mask = size - 1;
+        m_cells = std::make_unique<Cell[]>(size);
+        for (usize i = 0; i < size; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Push a value. Safe to call from any thread.
+    // Returns false if the queue is full.
+    bool try_push(const T& value) {
+        usize pos = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            usize sequence = cell->sequence.load(std::memory_order_acquire);
+            isize diff = static_cast<isize>(sequence) - static_cast<isize>(pos);
+
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // The consumer has not freed this cell yet, so the queue is full
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pop the oldest value. Must only be called from the consumer thread.
+    // Returns false if the queue is empty.
+    bool try_pop(T& out) {
+        Cell& cell = m_cells[m_head & m_mask];
+        usize sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<isize>(sequence) - static_cast<isize>(m_head + 1) < 0) {
+            return false;
+        }
+
+        out = cell.value;
+        cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+    usize capacity() const { return m_mask + 1; }
+
+    // Number of values successfully pushed
+    u64 pushed_count() const { return m_tail.load(std::memory_order_relaxed); }
+
+    // Number of pushes rejected because the queue was full
+    u64 dropped_count() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<usize> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    usize m_mask;
+
+    alignas(Q_CACHE_LINE_SIZE) std::atomic<usize> m_tail = 0;   // written by producers
+    alignas(Q_CACHE_LINE_SIZE) usize m_head = 0;                // written by the consumer
+    alignas(Q_CACHE_LINE_SIZE) std::atomic<u64> m_dropped = 0;
+};
+
+} // core namespace
+
+} // bifrost namespace
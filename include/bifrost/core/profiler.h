@@ -0,0 +1,90 @@
+/// BIFROST GAME ENGINE
+/// Scoped instrumentation profiler. PROFILE_SCOPE("name") times the rest
+/// of the enclosing block into a buffer owned by the calling thread, and
+/// a range of frames can be exported as a Chrome trace for
+/// chrome://tracing or ui.perfetto.dev.
+///
+/// Building without BIFROST_PROFILE compiles every macro away.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "clock.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Scopes each thread keeps. Older ones are overwritten.
+constexpr usize PROFILE_EVENTS_PER_THREAD = 64 * 1024;
+
+// Frame starts kept to select the range to export
+constexpr usize PROFILE_FRAME_HISTORY = 1024;
+
+// Cheapest monotonic timestamp the platform has: the TSC on x86-64,
+// nanoseconds of the monotonic clock elsewhere
+inline u64 profile_ticks() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return platform_time_ns();
+#endif
+}
+
+// Record a finished scope for the calling thread. name must outlive the
+// profiler, typically a string literal.
+QAPI void profile_record(const char* name, u64 begin_ticks, u64 end_ticks);
+
+// Copy a scope name into storage that is never freed, for names that do
+// not outlive the profiler themselves. Equal names share one copy.
+QAPI const char* profile_intern(const char* name);
+
+// Name the calling thread in exported traces
+QAPI void profile_set_thread_name(const char* name);
+
+// Mark the start of a frame
+QAPI void profile_begin_frame(u64 frame);
+
+// Write the scopes of frames first_frame to last_frame, both included,
+// as Chrome trace event JSON. Scopes that were overwritten are missing.
+// Returns false if the file cannot be written or no frame in the range
+// is known.
+QAPI bool profile_export_chrome_trace(const char* path, u64 first_frame, u64 last_frame);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : m_name(name), m_begin(profile_ticks()) {}
+    ProfileScope(const ProfileScope&) = delete;
+    ~ProfileScope() { profile_record(m_name, m_begin, profile_ticks()); }
+
+private:
+    const char* m_name;
+    u64 m_begin;
+};
+
+} // core namespace
+
+} // bifrost namespace
+
+#define Q_PROFILE_CONCAT_INNER(a, b) a##b
+#define Q_PROFILE_CONCAT(a, b) Q_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef BIFROST_PROFILE
+#define PROFILE_SCOPE(name) ::bifrost::core::ProfileScope Q_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_FRAME(frame) ::bifrost::core::profile_begin_frame(frame)
+#define PROFILE_THREAD(name) ::bifrost::core::profile_set_thread_name(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME(frame) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif // BIFROST_PROFILE
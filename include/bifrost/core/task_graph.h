@@ -0,0 +1,142 @@
+/// BIFROST GAME ENGINE
+/// Frame task graph: a frame is described as systems that declare the
+/// data they read and write, and systems that do not conflict run in parallel.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "delegate.h"
+#include "jobs.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Set of resources, one bit per resource returned by TaskGraph::add_resource
+using ResourceMask = u64;
+
+// Most resources a task graph can track
+constexpr u32 TASK_GRAPH_MAX_RESOURCES = 64;
+
+// Frames that can have systems running at once, plus one being prepared
+constexpr usize TASK_GRAPH_FRAMES_IN_FLIGHT = 3;
+
+// Work of a system, called with the index of the frame it runs for
+using system_function = Delegate<void (u64 frame)>;
+
+// Where a system sits in the frame pipeline
+enum class SystemStage : u8 {
+    SIMULATION, // execute waits for these before returning
+    RENDER      // may still be running while the next frame's simulation starts
+};
+
+struct TaskSystem {
+    std::string name;
+    const char* profile_name; // interned copy of name, which recorded scopes can outlive
+    system_function function;
+    ResourceMask reads;
+    ResourceMask writes;
+    SystemStage stage;
+
+    std::vector<u32> dependencies;          // earlier systems in the same frame it waits for
+    std::vector<u32> dependents;            // later systems in the same frame waiting for it
+    std::vector<u32> next_frame_dependents; // systems of the next frame waiting for it
+    u32 previous_frame_dependency_count;
+};
+
+// When and where a system ran
+struct TaskRecord {
+    u64 start_ns;
+    u64 end_ns;
+    u32 thread;
+};
+
+// Where a frame's time went, computed once all of its systems finished
+struct TaskGraphReport {
+    u64 frame;
+    u64 wall_ns;                     // first system start to last system end
+    u64 critical_path_ns;            // time spent running the systems on the critical path
+    std::vector<u32> critical_path;  // chain of systems that ended last, in order
+    std::vector<u64> thread_busy_ns; // time each thread spent running systems
+    f64 utilization;                 // busy time over wall time of every thread
+};
+
+// Systems are added in the order they logically run. A system depends on
+// every earlier system it conflicts with: one writes what the other reads
+// or writes. Systems that do not conflict run in parallel on the job system.
+//
+// Frames are pipelined. execute returns once a frame's SIMULATION systems
+// are done, and its RENDER systems keep running while the next frame
+// starts. Across frames the same conflict rule applies, and every system
+// also waits for its own run in the previous frame.
+class QAPI TaskGraph {
+public:
+    TaskGraph();
+    TaskGraph(const TaskGraph&) = delete;
+    ~TaskGraph();
+
+    // Register a resource systems can read or write. Returns its bit,
+    // or 0 if there are already TASK_GRAPH_MAX_RESOURCES.
+    ResourceMask add_resource(const char* name);
+
+    // Add a system to the end of the frame. Returns its index. Frames
+    // already in flight finish with the old systems first.
+    u32 add_system(
+        const char* name,
+        system_function function,
+        ResourceMask reads,
+        ResourceMask writes,
+        SystemStage stage = SystemStage::SIMULATION
+    );
+
+    bool is_empty() const { return m_systems.empty(); }
+
+    // Start the frame's systems, and return once its SIMULATION systems finished
+    void execute(u64 frame);
+
+    // Wait until every frame in flight has finished
+    void wait_all();
+
+    // Report of the most recent frame that has fully finished
+    const TaskGraphReport& get_last_report() const { return m_last_report; }
+
+    // Log the most recent report
+    void dump_report();
+
+private:
+    struct FrameState {
+        u64 frame;
+        bool prepared; // counters are set up for the frame
+        bool started;  // the frame's systems have been released
+        std::unique_ptr<std::atomic<u32>[]> pending; // unfinished dependencies of each system
+        std::vector<TaskRecord> records;
+        JobCounter simulation_done;
+        JobCounter all_done;
+    };
+
+    std::vector<TaskSystem> m_systems;
+    std::vector<std::string> m_resource_names;
+    u32 m_simulation_count;
+    bool m_dirty;
+
+    FrameState m_frames[TASK_GRAPH_FRAMES_IN_FLIGHT];
+    u64 m_sequence; // frames executed, selects the frame slot
+    TaskGraphReport m_last_report;
+
+    void _build();
+    void _prepare_frame(FrameState& state, bool after_previous);
+    void _finish_frame(FrameState& state);
+    void _release(FrameState& state, u32 system);
+    void _run_system(FrameState& state, u32 system);
+};
+
+} // core namespace
+
+} // bifrost namespace
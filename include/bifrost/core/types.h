@@ -24,6 +24,7 @@ using f32 = float;
 using f64 = double;
 
 using usize = std::size_t;
+using isize = std::ptrdiff_t;
 
 
 } // types namespace
@@ -0,0 +1,254 @@
+/// BIFROST GAME ENGINE
+/// Virtual file system. Assets are opened by engine paths such as
+/// "textures/grass.png", looked up in the mounted directories and pak
+/// archives, the last mounted first.
+///
+/// A pak archive is a single file mapped into memory. Finding a file in
+/// it is a binary search over path hashes, with no syscalls, and its
+/// contents are read in place. Large reads can go through read_async,
+/// which uses io_uring on Linux and a pool of reader threads elsewhere.
+
+#pragma once
+#include "types.h"
+#include "defines.h"
+#include "jobs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace core {
+
+// Pak file layout, little endian:
+//   PakHeader
+//   PakEntry[entry_count], sorted by path hash
+//   Paths, each followed by a NUL
+//   File contents, each aligned to PAK_DATA_ALIGNMENT
+constexpr char PAK_MAGIC[4] = { 'B', 'P', 'A', 'K' };
+constexpr u32 PAK_VERSION = 1;
+
+// Contents are aligned for SIMD loads straight out of the mapping
+constexpr usize PAK_DATA_ALIGNMENT = 16;
+
+// Longest engine path
+constexpr usize VFS_MAX_PATH = 512;
+
+// Reads the io_uring can have in flight before read_async waits for room
+constexpr u32 VFS_ASYNC_QUEUE_DEPTH = 128;
+
+// Threads that serve read_async where io_uring is not available. Setting
+// the BIFROST_VFS_ASYNC environment variable to "threads" uses them even
+// where it is.
+constexpr u32 VFS_READER_THREADS = 2;
+
+struct PakHeader {
+    char magic[4];
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+    u64 paths_offset;
+    u64 data_offset;
+};
+
+struct PakEntry {
+    u64 path_hash;   // vfs_hash_path of the path
+    u64 offset;      // from the start of the file
+    u64 size;
+    u32 path_offset; // from paths_offset
+    u32 path_length;
+};
+
+// Turn a path into the form used for lookups: '/' separators, no leading
+// "./" or '/', no empty or "." parts. Paths that climb out with ".." are
+// refused. Returns the length written, or 0 if the path is refused or
+// does not fit.
+QAPI usize vfs_normalize_path(const char* path, char* out, usize capacity);
+
+// 64 bit FNV-1a of a normalized path
+QAPI u64 vfs_hash_path(const char* path, usize length);
+
+// Pack every file under a directory into a pak archive
+QAPI bool pak_build(const char* directory, const char* pak_path);
+
+// A pak archive mapped into memory
+class QAPI PakArchive {
+public:
+    PakArchive() = default;
+    PakArchive(const PakArchive&) = delete;
+    ~PakArchive();
+
+    // Map the archive and check its header and table
+    bool open(const char* path);
+    void close();
+
+    bool is_open() const { return m_data != nullptr; }
+
+    // The entry of a normalized path, or nullptr if it is not in the archive
+    const PakEntry* find(const char* path, usize length) const;
+
+    const u8* get_contents(const PakEntry& entry) const { return m_data + entry.offset; }
+    const char* get_path(const PakEntry& entry) const;
+
+    u32 get_entry_count() const { return m_entry_count; }
+    const PakEntry* get_entries() const { return m_entries; }
+
+    // Descriptor the archive was opened with, for async reads
+    isize get_file_handle() const { return m_file; }
+
+private:
+    friend class VirtualFileSystem;
+
+    const u8* m_data = nullptr;
+    usize m_size = 0;
+    const PakEntry* m_entries = nullptr;
+    u32 m_entry_count = 0;
+    isize m_file = -1;
+
+    // Async reads of the archive that have not completed. Unmounting
+    // waits for them before the descriptor is closed.
+    std::atomic<u32> m_async_reads = 0;
+
+#ifdef Q_PLATFORM_WINDOWS
+    void* m_mapping_handle = nullptr;
+#endif // Q_PLATFORM_WINDOWS
+};
+
+// Contents of a file. Files in a pak are views into its mapping, valid
+// until the pak is unmounted; loose files are read into memory the view
+// owns.
+class QAPI FileView {
+public:
+    FileView() = default;
+    FileView(const FileView&) = delete;
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+    ~FileView();
+
+    const u8* data() const { return m_data; }
+    usize size() const { return m_size; }
+
+    // Whether the file was found. Empty files are valid.
+    bool is_valid() const { return m_valid; }
+    explicit operator bool() const { return m_valid; }
+
+private:
+    friend class VirtualFileSystem;
+
+    const u8* m_data = nullptr;
+    usize m_size = 0;
+    u8* m_owned = nullptr; // freed with the view, for loose files
+    bool m_valid = false;
+
+    void _release();
+};
+
+// A read that completes in the background. It must stay alive and in
+// place until its counter is done.
+struct AsyncRead {
+    void* buffer = nullptr;
+    usize size = 0;            // bytes to read
+    u64 offset = 0;            // from the start of the file
+    i64 result = 0;            // bytes read, or -1 on failure, once done
+
+    // Filled in by read_async
+    JobCounter* counter = nullptr;
+    isize file = -1;
+    PakArchive* pak = nullptr; // holding the file, nullptr for a loose file
+    u64 file_offset = 0;       // where the file starts within the descriptor
+    usize completed = 0;
+    bool owns_file = false;
+    AsyncRead* next = nullptr; // in the reader threads' queue
+};
+
+// Memory the kernel shares with an io_uring, defined where it is used
+struct VfsRing;
+
+class QAPI VirtualFileSystem {
+public:
+    static VirtualFileSystem* vfs_instance;
+    static VirtualFileSystem* get_reference();
+
+    VirtualFileSystem(const VirtualFileSystem&) = delete;
+    ~VirtualFileSystem();
+
+    // Mount a directory or a pak archive at a prefix of the engine paths,
+    // "" for the root. Later mounts are searched first, so they override.
+    bool mount(const char* path, const char* prefix = "");
+
+    // Views into a pak are no longer valid once it is unmounted. Waits
+    // for the async reads of the pak that are still in flight.
+    bool unmount(const char* path);
+
+    bool exists(const char* path);
+
+    // Read a whole file. Files in a pak cost no copy or syscall.
+    FileView read(const char* path);
+
+    // Start reading request.size bytes at request.offset of a file into
+    // request.buffer. The counter is finished when the read is done,
+    // so a job can wait on it like on any other work.
+    bool read_async(const char* path, AsyncRead& request, JobCounter& counter);
+
+    // Whether read_async runs on io_uring rather than reader threads
+    bool has_io_uring() const { return m_ring != nullptr; }
+
+    // Stop the background reads. Called at exit.
+    void shutdown();
+
+private:
+    struct Mount {
+        std::string path;
+        std::string prefix; // normalized, with a trailing '/' unless empty
+        PakArchive* pak;    // nullptr for a directory
+    };
+
+    std::vector<Mount> m_mounts;
+    std::shared_mutex m_mounts_lock;
+
+    // io_uring, when the kernel has it
+    VfsRing* m_ring = nullptr;
+    std::mutex m_submit_lock;
+    std::atomic<u32> m_in_flight = 0;
+
+    // Reader threads, and the completion thread of the io_uring
+    std::vector<std::thread> m_threads;
+    std::mutex m_queue_lock;
+    std::condition_variable m_queue_ready;
+    AsyncRead* m_queue_head = nullptr;
+    AsyncRead* m_queue_tail = nullptr;
+    std::atomic<bool> m_running = false; // read by read_async on any thread
+    std::once_flag m_start_once;
+
+    VirtualFileSystem() = default;
+
+    // Where a path was found: an entry of a pak, or a loose file
+    struct Location {
+        PakArchive* pak;
+        const PakEntry* entry;
+        isize file; // opened when asked for, -1 otherwise
+    };
+
+    // Files of a pak found for an async read count as one of its reads
+    // before the mounts are unlocked, so unmount can wait for them
+    bool _locate(const char* path, Location& location, bool open_file, bool async_read);
+    void _start();
+    bool _init_io_uring();
+    bool _submit_io_uring(AsyncRead& request);
+    void _completion_main();
+    void _reader_main();
+    void _complete(AsyncRead& request, i64 result);
+    void _refuse(const char* path, AsyncRead& request);
+    void _release_pak(AsyncRead& request);
+};
+
+} // core namespace
+
+} // bifrost namespace
@@ -6,17 +6,19 @@
 #pragma once
 #include "core/input.h"
 #include "core/key.h"
+#include "core/delegate.h"
 #include "types.h"
 #include "defines.h"
-#include <qlogger/qlogger.h>
+
+#include <string>
+#include <vector>
 
 // Platform Specific includes
 #ifdef Q_PLATFORM_LINUX
-#include <X11/Xlib.h>
-#include <X11/X.h>
-#include <string>
+#include <xcb/xcb.h>
 
-using XWindow = Window;
+// Only taken by pointer, so users of the window do not get <poll.h>
+struct pollfd;
 #elif Q_PLATFORM_WINDOWS
 #include <windows.h>
 #endif // Platform Detection macros
@@ -26,10 +28,56 @@ using namespace bifrost::core::types;
 namespace bifrost {
 namespace core {
 
+// Which backend a Window runs on
+enum class WindowBackend {
+    AUTO,     // the platform backend, or headless when there is no display to connect to
+    PLATFORM, // XCB on Linux, Win32 on Windows
+    HEADLESS  // no display at all, events only come from injected or synthetic sources
+};
+
+// Kinds of platform independent window events
+enum class WindowEventType : u8 {
+    KEY,
+    BUTTON,
+    MOUSE_MOVE,
+    MOUSE_WHEEL,
+    RESIZE,
+    CLOSE
+};
+
+// A window event fed to a headless window in place of the display server's
+struct WindowEvent {
+    WindowEventType type;
+    bool pressed; // KEY and BUTTON
+    u16 code;     // Keys for KEY, MouseButtons for BUTTON
+    i32 x, y;     // position for MOUSE_MOVE, delta in x for MOUSE_WHEEL, size for RESIZE
+};
+
+// Frames acquire_framebuffer cycles through, so drawing the next frame
+// does not wait for the last one to be shown
+constexpr u32 WINDOW_FRAMEBUFFER_COUNT = 3;
+
+// Memory to draw a frame into, 0x00RRGGBB pixels, rows top to bottom
+struct WindowFramebuffer {
+    u32* pixels;
+    u32 width;
+    u32 height;
+};
+
+// Produces synthetic events for a headless window. It is called during
+// pump_messages until it returns false, and by wait_events to see whether
+// an event is ready.
+using window_event_source = Delegate<bool (WindowEvent& event)>;
+
+// How often a headless window that is waiting for events asks its source
+constexpr i32 HEADLESS_WAIT_INTERVAL_MS = 1;
+
 /// Window is the GUI window that is opened and contains all the events
 class QAPI Window {
 public:
-    Window(u32 width, u32 height, std::string title)
+    // The backend can also be chosen at runtime by setting the
+    // BIFROST_WINDOW_BACKEND environment variable to "headless" or "platform"
+    Window(u32 width, u32 height, std::string title, WindowBackend backend = WindowBackend::AUTO)
         : m_width(width)
         , m_height(height)
         , m_title(title)
@@ -37,7 +85,7 @@ public:
         , m_is_initialized(false)
         /* , m_input(InputHandler()) */
         , m_should_close(false)
-        , m_logger(qlogger::Logger())
+        , m_backend(backend)
     {
         _init();
     }
@@ -64,6 +112,64 @@ public:
     // Pump the window event messages to be handled
     bool pump_messages();
 
+    // Block until window events are ready to be pumped or the timeout
+    // expires. A timeout of -1 waits forever. Returns true if events are ready.
+    bool wait_events(i32 timeout_ms);
+
+    // The backend the window ended up running on
+    WindowBackend get_backend() const { return m_backend; }
+
+    // Size as of the last pump. Changes are applied once per pump, and
+    // fire a single EventCode::RESIZED with the final size.
+    u32 get_width() const { return m_width; }
+    u32 get_height() const { return m_height; }
+
+    // Queue an event for a headless window to handle on its next pump
+    bool inject_event(const WindowEvent& event);
+
+    // Set where a headless window pulls synthetic events from
+    void set_event_source(window_event_source source) { m_event_source = source; }
+
+    // Show a frame of 0x00RRGGBB pixels, rows top to bottom, at the top left
+    // of the window. A headless window keeps a copy of it instead.
+    bool present(const u32* pixels, u32 width, u32 height);
+
+    // Get memory to draw the next frame into. On X11 with MIT-SHM it is
+    // shared with the server, so presenting it copies nothing. Waits if the
+    // server is still reading every buffer. Returns false if the window
+    // can not present.
+    bool acquire_framebuffer(u32 width, u32 height, WindowFramebuffer& framebuffer);
+
+    // Show the frame drawn into the last acquired framebuffer
+    bool present_framebuffer();
+
+    // The last frame presented to a headless window, empty before the first
+    const u32* get_presented_pixels() const { return m_presented_pixels.data(); }
+    u32 get_presented_width() const { return m_presented_width; }
+    u32 get_presented_height() const { return m_presented_height; }
+
+#ifdef Q_PLATFORM_LINUX
+    // File descriptor of the connection to the X server. It becomes readable
+    // when events arrive, so it can be polled along with other descriptors.
+    int get_connection_fd() const;
+
+    // Id of the X window, for tools that talk to the server on a
+    // connection of their own
+    xcb_window_t get_xcb_window() const { return m_window; }
+
+    // Wait on the X connection together with other descriptors such as timers,
+    // file watchers or an eventfd signalled by jobs. The revents of the extra
+    // descriptors are filled in. Returns true if window events are ready.
+    bool wait_events(i32 timeout_ms, pollfd* extra_fds, usize extra_count);
+
+    // Whether acquire_framebuffer hands out memory shared with the X server
+    // through MIT-SHM. Known once a framebuffer has been acquired.
+    bool has_shared_framebuffers() const { return m_has_shm; }
+
+    // Wait until the X server has handled every request sent so far
+    void sync();
+#endif // Q_PLATFORM_LINUX
+
 private:
     
     u32 m_width, m_height; // the dimensions of the window
@@ -71,15 +177,65 @@ private:
     bool m_can_resize;     // whether we are allowed to resize the window
     bool m_is_initialized; // Whether the window is initialized properly yet
     bool m_should_close;   // whether the window should close
-    qlogger::Logger m_logger; // Logger
+    WindowBackend m_backend;  // the backend requested, and once initialized the one in use
+
+    // Headless backend
+    std::vector<WindowEvent> m_injected_events;
+    window_event_source m_event_source;
+    std::vector<u32> m_presented_pixels;
+    u32 m_presented_width = 0;
+    u32 m_presented_height = 0;
+
+    // Framebuffers in plain memory, when they can not be shared with the server
+    std::vector<u32> m_framebuffer_memory;
+    u32 m_framebuffer_width = 0;
+    u32 m_framebuffer_height = 0;
+    u32 m_framebuffer_index = 0;
+
+    // Last size the platform reported during the current pump
+    u32 m_pending_width = 0;
+    u32 m_pending_height = 0;
+    bool m_resize_pending = false;
+
+    WindowBackend _select_backend();
+    void _init_headless();
+    bool _pump_headless();
+    bool _wait_headless(i32 timeout_ms);
+    bool _headless_event_ready();
+    void _handle_window_event(const WindowEvent& event);
+    bool _present_headless(const u32* pixels, u32 width, u32 height);
+    u32* _acquire_memory_framebuffer(u32 width, u32 height);
+    void _queue_resize(u32 width, u32 height);
+    void _apply_resize();
 
     // Platform-Specific methods and members
 #ifdef Q_PLATFORM_LINUX
-    Display* m_display;
-    XWindow m_window;
-    int m_screen;
-
-    void _handle_x11_event(XEvent& ev);
+    xcb_connection_t* m_connection = nullptr;
+    xcb_window_t m_window = 0;
+    xcb_screen_t* m_screen = nullptr;
+    xcb_atom_t m_wm_protocols = 0;
+    xcb_atom_t m_wm_delete_window = 0;
+    xcb_generic_event_t* m_pending_event = nullptr; // event taken off the queue by wait_events
+    xcb_gcontext_t m_gc = 0;                        // graphics context frames are put with
+    bool m_can_present = false;                     // whether the screen takes 32 bit pixels as they are
+
+    // A framebuffer in a shared memory segment attached by the server
+    struct ShmFramebuffer {
+        u32 segment = 0;   // xcb_shm_seg_t, an id, so this header needs no <xcb/shm.h>
+        u32* pixels = nullptr;
+        bool busy = false; // presented, and the server has not finished reading it
+    };
+    ShmFramebuffer m_shm_framebuffers[WINDOW_FRAMEBUFFER_COUNT];
+    bool m_has_shm = false;
+    usize m_shm_capacity = 0;      // bytes in each segment
+    u8 m_shm_completion_event = 0; // response type of the server's completion events
+
+    bool _create_shm_framebuffers(usize capacity);
+    void _destroy_shm_framebuffers();
+    KeyTable m_key_table;                           // hardware keycode to engine key
+
+    void _handle_x11_event(xcb_generic_event_t* ev);
+    void _build_key_table(xcb_get_keyboard_mapping_reply_t* mapping, u32 min_keycode);
     Keys _translate_key(u32 code);
 
 #elif Q_PLATFORM_WINDOWS
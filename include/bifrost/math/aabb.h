@@ -0,0 +1,77 @@
+/// BIFROST GAME ENGINE
+/// Axis aligned bounding boxes and view frustums for culling.
+
+#pragma once
+#include "vector.h"
+#include "matrix.h"
+
+namespace bifrost {
+
+namespace math {
+
+struct aabb {
+    vec3 min;
+    vec3 max;
+
+    static aabb from_center_extents(vec3 center, vec3 extents) {
+        return { center - extents, center + extents };
+    }
+
+    vec3 center() const { return (min + max) * 0.5f; }
+    vec3 extents() const { return (max - min) * 0.5f; }
+
+    bool contains(vec3 p) const {
+        return p.x >= min.x && p.y >= min.y && p.z >= min.z
+            && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+    }
+
+    bool intersects(const aabb& b) const {
+        return min.x <= b.max.x && min.y <= b.max.y && min.z <= b.max.z
+            && b.min.x <= max.x && b.min.y <= max.y && b.min.z <= max.z;
+    }
+};
+
+inline aabb merge(const aabb& a, const aabb& b) {
+    return { math::min(a.min, b.min), math::max(a.max, b.max) };
+}
+
+// Box around the transformed box. The center is transformed, and the
+// extents become the absolute value of the rotation and scale times them.
+inline aabb transform(const mat4& m, const aabb& box) {
+    vec3 center = transform_point(m, box.center());
+    vec3 extents = box.extents();
+
+    f32x4 radius = f32x4_mul(f32x4_abs(m[0].simd()), f32x4_splat(extents.x));
+    radius = f32x4_madd(f32x4_abs(m[1].simd()), f32x4_splat(extents.y), radius);
+    radius = f32x4_madd(f32x4_abs(m[2].simd()), f32x4_splat(extents.z), radius);
+
+    return aabb::from_center_extents(center, vec3(radius));
+}
+
+// Six planes facing into the frustum, each (normal, distance) with
+// dot(normal, p) + distance >= 0 for points inside
+struct frustum {
+    vec4 planes[6];
+
+    // Planes of a view projection matrix, as made by mat4::perspective
+    static frustum from_matrix(const mat4& view_projection) {
+        mat4 rows = transpose(view_projection);
+
+        frustum result;
+        result.planes[0] = rows[3] + rows[0]; // left
+        result.planes[1] = rows[3] - rows[0]; // right
+        result.planes[2] = rows[3] + rows[1]; // bottom
+        result.planes[3] = rows[3] - rows[1]; // top
+        result.planes[4] = rows[2];           // near, depth starts at 0
+        result.planes[5] = rows[3] - rows[2]; // far
+
+        for (vec4& plane : result.planes) {
+            plane = plane / length(plane.xyz());
+        }
+        return result;
+    }
+};
+
+} // math namespace
+
+} // bifrost namespace
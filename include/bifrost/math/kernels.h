@@ -0,0 +1,55 @@
+/// BIFROST GAME ENGINE
+/// Batch kernels that transform or cull many items per call. Each uses the
+/// widest instruction set the library was built for, and has a plain
+/// scalar version that serves as the reference to check it against.
+
+#pragma once
+#include "vector.h"
+#include "matrix.h"
+#include "aabb.h"
+
+namespace bifrost {
+
+namespace math {
+
+// Instruction set the kernels were built for: "AVX2", "SSE2", "NEON" or "SCALAR"
+QAPI const char* simd_isa_name();
+
+// out[i] = m * (in[i], 1). in and out may be the same array.
+QAPI void transform_points(const mat4& m, const vec3* in, vec3* out, usize count);
+QAPI void transform_points_scalar(const mat4& m, const vec3* in, vec3* out, usize count);
+
+// out[i] = m * in[i]. in and out may be the same array.
+QAPI void transform_vectors(const mat4& m, const vec4* in, vec4* out, usize count);
+QAPI void transform_vectors_scalar(const mat4& m, const vec4* in, vec4* out, usize count);
+
+// out[i] = a[i] * b[i], typically parent world times local transforms
+QAPI void multiply_matrices(const mat4* a, const mat4* b, mat4* out, usize count);
+QAPI void multiply_matrices_scalar(const mat4* a, const mat4* b, mat4* out, usize count);
+
+// out[i] = the box around m applied to in[i]
+QAPI void transform_aabbs(const mat4& m, const aabb* in, aabb* out, usize count);
+QAPI void transform_aabbs_scalar(const mat4& m, const aabb* in, aabb* out, usize count);
+
+// Spheres are given as separate arrays of centers and radii. visible[i]
+// is set to 1 if sphere i is at least partly inside the frustum and 0
+// otherwise. Returns how many are visible.
+QAPI usize cull_spheres(
+    const frustum& view,
+    const f32* x, const f32* y, const f32* z, const f32* radius,
+    u8* visible, usize count
+);
+QAPI usize cull_spheres_scalar(
+    const frustum& view,
+    const f32* x, const f32* y, const f32* z, const f32* radius,
+    u8* visible, usize count
+);
+
+// Same as cull_spheres for boxes. Boxes that only cross the frustum's
+// planes outside of it may be kept, as with any plane test.
+QAPI usize cull_aabbs(const frustum& view, const aabb* boxes, u8* visible, usize count);
+QAPI usize cull_aabbs_scalar(const frustum& view, const aabb* boxes, u8* visible, usize count);
+
+} // math namespace
+
+} // bifrost namespace
@@ -0,0 +1,155 @@
+/// BIFROST GAME ENGINE
+/// Column major matrices that multiply column vectors: m * v. Projections
+/// are right handed and map depth to [0, 1].
+
+#pragma once
+#include "vector.h"
+#include "quaternion.h"
+
+namespace bifrost {
+
+namespace math {
+
+struct mat3 {
+    vec3 columns[3];
+
+    mat3() : columns{ vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1) } {}
+    mat3(vec3 c0, vec3 c1, vec3 c2) : columns{ c0, c1, c2 } {}
+
+    vec3& operator[](usize i) { return columns[i]; }
+    const vec3& operator[](usize i) const { return columns[i]; }
+
+    vec3 operator*(vec3 v) const {
+        f32x4 result = f32x4_mul(columns[0].simd(), f32x4_splat(v.x));
+        result = f32x4_madd(columns[1].simd(), f32x4_splat(v.y), result);
+        result = f32x4_madd(columns[2].simd(), f32x4_splat(v.z), result);
+        return vec3(result);
+    }
+
+    mat3 operator*(const mat3& b) const {
+        return mat3(*this * b.columns[0], *this * b.columns[1], *this * b.columns[2]);
+    }
+};
+
+inline mat3 transpose(const mat3& m) {
+    return mat3(
+        vec3(m[0].x, m[1].x, m[2].x),
+        vec3(m[0].y, m[1].y, m[2].y),
+        vec3(m[0].z, m[1].z, m[2].z)
+    );
+}
+
+struct mat4 {
+    vec4 columns[4];
+
+    mat4() : columns{ vec4(1, 0, 0, 0), vec4(0, 1, 0, 0), vec4(0, 0, 1, 0), vec4(0, 0, 0, 1) } {}
+    mat4(vec4 c0, vec4 c1, vec4 c2, vec4 c3) : columns{ c0, c1, c2, c3 } {}
+
+    vec4& operator[](usize i) { return columns[i]; }
+    const vec4& operator[](usize i) const { return columns[i]; }
+
+    f32x4 transform(f32x4 v) const {
+        f32x4 result = f32x4_mul(columns[0].simd(), f32x4_splat_lane<0>(v));
+        result = f32x4_madd(columns[1].simd(), f32x4_splat_lane<1>(v), result);
+        result = f32x4_madd(columns[2].simd(), f32x4_splat_lane<2>(v), result);
+        return f32x4_madd(columns[3].simd(), f32x4_splat_lane<3>(v), result);
+    }
+
+    vec4 operator*(vec4 v) const { return vec4(transform(v.simd())); }
+
+    mat4 operator*(const mat4& b) const {
+        return mat4(
+            vec4(transform(b.columns[0].simd())),
+            vec4(transform(b.columns[1].simd())),
+            vec4(transform(b.columns[2].simd())),
+            vec4(transform(b.columns[3].simd()))
+        );
+    }
+
+    static mat4 translation(vec3 t) {
+        return mat4(vec4(1, 0, 0, 0), vec4(0, 1, 0, 0), vec4(0, 0, 1, 0), vec4(t, 1));
+    }
+
+    static mat4 scale(vec3 s) {
+        return mat4(vec4(s.x, 0, 0, 0), vec4(0, s.y, 0, 0), vec4(0, 0, s.z, 0), vec4(0, 0, 0, 1));
+    }
+
+    static mat4 rotation(const quat& q) {
+        f32 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        f32 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        f32 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+        return mat4(
+            vec4(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0),
+            vec4(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0),
+            vec4(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0),
+            vec4(0, 0, 0, 1)
+        );
+    }
+
+    // Scale, then rotate, then translate
+    static mat4 trs(vec3 t, const quat& r, vec3 s) {
+        mat4 m = rotation(r);
+        m.columns[0] *= s.x;
+        m.columns[1] *= s.y;
+        m.columns[2] *= s.z;
+        m.columns[3] = vec4(t, 1);
+        return m;
+    }
+
+    // fov_y in radians. Looks down -z, depth goes from 0 at near to 1 at far.
+    static mat4 perspective(f32 fov_y, f32 aspect, f32 near_plane, f32 far_plane) {
+        f32 f = 1.0f / std::tan(fov_y * 0.5f);
+        f32 range = far_plane / (near_plane - far_plane);
+        return mat4(
+            vec4(f / aspect, 0, 0, 0),
+            vec4(0, f, 0, 0),
+            vec4(0, 0, range, -1),
+            vec4(0, 0, range * near_plane, 0)
+        );
+    }
+
+    static mat4 orthographic(f32 left, f32 right, f32 bottom, f32 top, f32 near_plane, f32 far_plane) {
+        return mat4(
+            vec4(2 / (right - left), 0, 0, 0),
+            vec4(0, 2 / (top - bottom), 0, 0),
+            vec4(0, 0, 1 / (near_plane - far_plane), 0),
+            vec4(-(right + left) / (right - left), -(top + bottom) / (top - bottom), near_plane / (near_plane - far_plane), 1)
+        );
+    }
+
+    // View matrix of a camera at eye looking at target
+    static mat4 look_at(vec3 eye, vec3 target, vec3 up) {
+        vec3 forward = normalize(target - eye);
+        vec3 side = normalize(cross(forward, up));
+        vec3 camera_up = cross(side, forward);
+        return mat4(
+            vec4(side.x, camera_up.x, -forward.x, 0),
+            vec4(side.y, camera_up.y, -forward.y, 0),
+            vec4(side.z, camera_up.z, -forward.z, 0),
+            vec4(-dot(side, eye), -dot(camera_up, eye), dot(forward, eye), 1)
+        );
+    }
+};
+
+// Point with w = 1, so the translation applies
+inline vec3 transform_point(const mat4& m, vec3 p) {
+    return vec3(m.transform(f32x4_set(p.x, p.y, p.z, 1.0f)));
+}
+
+// Direction with w = 0, so the translation does not apply
+inline vec3 transform_direction(const mat4& m, vec3 d) {
+    return vec3(m.transform(d.simd()));
+}
+
+inline mat3 upper_3x3(const mat4& m) {
+    return mat3(m[0].xyz(), m[1].xyz(), m[2].xyz());
+}
+
+QAPI mat4 transpose(const mat4& m);
+
+// General inverse. Returns the identity if m is singular.
+QAPI mat4 inverse(const mat4& m);
+
+} // math namespace
+
+} // bifrost namespace
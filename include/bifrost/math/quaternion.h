@@ -0,0 +1,93 @@
+/// BIFROST GAME ENGINE
+/// Unit quaternions for rotations, stored x, y, z, w with w the real part.
+
+#pragma once
+#include "vector.h"
+
+namespace bifrost {
+
+namespace math {
+
+struct alignas(16) quat {
+    f32 x, y, z, w;
+
+    quat() : x(0), y(0), z(0), w(1) {}
+    quat(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+    explicit quat(f32x4 v) { f32x4_store_aligned(&x, v); }
+
+    f32x4 simd() const { return f32x4_load_aligned(&x); }
+
+    // Rotation by angle radians around a unit axis
+    static quat from_axis_angle(vec3 axis, f32 angle) {
+        f32 s = std::sin(angle * 0.5f);
+        return quat(axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f));
+    }
+
+    // Applies b first, then this rotation
+    quat operator*(const quat& b) const {
+        f32x4 a = simd();
+        f32x4 q = b.simd();
+
+        // Hamilton product: a.w * b, plus each of a.x, a.y and a.z times
+        // a shuffle of b with the signs the product gives each lane
+        f32x4 result = f32x4_mul(f32x4_splat_lane<3>(a), q);
+        result = f32x4_madd(
+            f32x4_mul(f32x4_splat_lane<0>(a), f32x4_set(1.0f, -1.0f, 1.0f, -1.0f)),
+            f32x4_shuffle<3, 2, 1, 0>(q),
+            result
+        );
+        result = f32x4_madd(
+            f32x4_mul(f32x4_splat_lane<1>(a), f32x4_set(1.0f, 1.0f, -1.0f, -1.0f)),
+            f32x4_shuffle<2, 3, 0, 1>(q),
+            result
+        );
+        result = f32x4_madd(
+            f32x4_mul(f32x4_splat_lane<2>(a), f32x4_set(-1.0f, 1.0f, 1.0f, -1.0f)),
+            f32x4_shuffle<1, 0, 3, 2>(q),
+            result
+        );
+        return quat(result);
+    }
+};
+
+inline f32 dot(const quat& a, const quat& b) { return f32x4_x(f32x4_dot4(a.simd(), b.simd())); }
+
+inline quat normalize(const quat& q) {
+    return quat(f32x4_mul(q.simd(), f32x4_splat(1.0f / std::sqrt(dot(q, q)))));
+}
+
+// Inverse of a unit quaternion
+inline quat conjugate(const quat& q) { return quat(-q.x, -q.y, -q.z, q.w); }
+
+inline vec3 rotate(const quat& q, vec3 v) {
+    // v + 2w (u x v) + 2 u x (u x v), with u the vector part
+    vec3 u(q.x, q.y, q.z);
+    vec3 t = cross(u, v) * 2.0f;
+    return v + t * q.w + cross(u, t);
+}
+
+// Interpolate along the shorter arc
+inline quat slerp(const quat& a, const quat& b, f32 t) {
+    f32 cosine = dot(a, b);
+    quat end = b;
+    if (cosine < 0.0f) {
+        cosine = -cosine;
+        end = quat(f32x4_neg(b.simd()));
+    }
+
+    // Close enough for the sine to lose precision, fall back to lerp
+    if (cosine > 0.9995f) {
+        f32x4 blended = f32x4_madd(f32x4_sub(end.simd(), a.simd()), f32x4_splat(t), a.simd());
+        return normalize(quat(blended));
+    }
+
+    f32 angle = std::acos(cosine);
+    f32 inverse_sine = 1.0f / std::sin(angle);
+    f32 wa = std::sin((1.0f - t) * angle) * inverse_sine;
+    f32 wb = std::sin(t * angle) * inverse_sine;
+    return quat(f32x4_madd(a.simd(), f32x4_splat(wa), f32x4_mul(end.simd(), f32x4_splat(wb))));
+}
+
+} // math namespace
+
+} // bifrost namespace
@@ -0,0 +1,190 @@
+/// BIFROST GAME ENGINE
+/// Four wide float register the math types are built on. The instruction
+/// set is picked at compile time from the compiler's target flags, and
+/// BIFROST_MATH_SCALAR forces the plain C++ fallback.
+
+#pragma once
+#include "core/types.h"
+#include "core/defines.h"
+
+#include <cmath>
+
+#if defined(BIFROST_MATH_SCALAR)
+#define Q_SIMD_SCALAR 1
+#elif defined(__AVX2__)
+#define Q_SIMD_AVX2 1
+#define Q_SIMD_SSE 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define Q_SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define Q_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define Q_SIMD_SCALAR 1
+#endif
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace math {
+
+struct f32x4 {
+#if defined(Q_SIMD_SSE)
+    __m128 v;
+#elif defined(Q_SIMD_NEON)
+    float32x4_t v;
+#else
+    f32 v[4];
+#endif
+};
+
+#if defined(Q_SIMD_SSE)
+
+inline f32x4 f32x4_set(f32 x, f32 y, f32 z, f32 w) { return { _mm_setr_ps(x, y, z, w) }; }
+inline f32x4 f32x4_splat(f32 value) { return { _mm_set1_ps(value) }; }
+inline f32x4 f32x4_load(const f32* values) { return { _mm_loadu_ps(values) }; }
+inline f32x4 f32x4_load_aligned(const f32* values) { return { _mm_load_ps(values) }; }
+inline void f32x4_store(f32* values, f32x4 a) { _mm_storeu_ps(values, a.v); }
+inline void f32x4_store_aligned(f32* values, f32x4 a) { _mm_store_ps(values, a.v); }
+
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline f32x4 f32x4_div(f32x4 a, f32x4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline f32x4 f32x4_sqrt(f32x4 a) { return { _mm_sqrt_ps(a.v) }; }
+inline f32x4 f32x4_abs(f32x4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline f32x4 f32x4_neg(f32x4 a) { return { _mm_xor_ps(_mm_set1_ps(-0.0f), a.v) }; }
+
+// a * b + c
+inline f32x4 f32x4_madd(f32x4 a, f32x4 b, f32x4 c) {
+#if defined(__FMA__)
+    return { _mm_fmadd_ps(a.v, b.v, c.v) };
+#else
+    return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) };
+#endif
+}
+
+// Lane i of the result is lane I of a
+template <int X, int Y, int Z, int W>
+inline f32x4 f32x4_shuffle(f32x4 a) { return { _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(W, Z, Y, X)) }; }
+
+inline f32 f32x4_x(f32x4 a) { return _mm_cvtss_f32(a.v); }
+
+// Bit i is set when lane i of a is less than lane i of b
+inline u32 f32x4_less_mask(f32x4 a, f32x4 b) { return static_cast<u32>(_mm_movemask_ps(_mm_cmplt_ps(a.v, b.v))); }
+
+#elif defined(Q_SIMD_NEON)
+
+inline f32x4 f32x4_set(f32 x, f32 y, f32 z, f32 w) {
+    const f32 values[4] = { x, y, z, w };
+    return { vld1q_f32(values) };
+}
+inline f32x4 f32x4_splat(f32 value) { return { vdupq_n_f32(value) }; }
+inline f32x4 f32x4_load(const f32* values) { return { vld1q_f32(values) }; }
+inline f32x4 f32x4_load_aligned(const f32* values) { return { vld1q_f32(values) }; }
+inline void f32x4_store(f32* values, f32x4 a) { vst1q_f32(values, a.v); }
+inline void f32x4_store_aligned(f32* values, f32x4 a) { vst1q_f32(values, a.v); }
+
+inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_sub(f32x4 a, f32x4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_div(f32x4 a, f32x4 b) { return { vdivq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return { vminq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline f32x4 f32x4_sqrt(f32x4 a) { return { vsqrtq_f32(a.v) }; }
+inline f32x4 f32x4_abs(f32x4 a) { return { vabsq_f32(a.v) }; }
+inline f32x4 f32x4_neg(f32x4 a) { return { vnegq_f32(a.v) }; }
+inline f32x4 f32x4_madd(f32x4 a, f32x4 b, f32x4 c) { return { vfmaq_f32(c.v, a.v, b.v) }; }
+
+template <int X, int Y, int Z, int W>
+inline f32x4 f32x4_shuffle(f32x4 a) {
+#if defined(__clang__)
+    return { __builtin_shufflevector(a.v, a.v, X, Y, Z, W) };
+#elif defined(__GNUC__)
+    return { __builtin_shuffle(a.v, uint32x4_t{ X, Y, Z, W }) };
+#else
+    f32 values[4];
+    vst1q_f32(values, a.v);
+    return f32x4_set(values[X], values[Y], values[Z], values[W]);
+#endif
+}
+
+inline f32 f32x4_x(f32x4 a) { return vgetq_lane_f32(a.v, 0); }
+
+inline u32 f32x4_less_mask(f32x4 a, f32x4 b) {
+    static const u32 bits[4] = { 1, 2, 4, 8 };
+    uint32x4_t less = vandq_u32(vcltq_f32(a.v, b.v), vld1q_u32(bits));
+    return vaddvq_u32(less);
+}
+
+#else
+
+inline f32x4 f32x4_set(f32 x, f32 y, f32 z, f32 w) { return { { x, y, z, w } }; }
+inline f32x4 f32x4_splat(f32 value) { return { { value, value, value, value } }; }
+inline f32x4 f32x4_load(const f32* values) { return { { values[0], values[1], values[2], values[3] } }; }
+inline f32x4 f32x4_load_aligned(const f32* values) { return f32x4_load(values); }
+inline void f32x4_store(f32* values, f32x4 a) {
+    for (usize i = 0; i < 4; i++) {
+        values[i] = a.v[i];
+    }
+}
+inline void f32x4_store_aligned(f32* values, f32x4 a) { f32x4_store(values, a); }
+
+#define Q_SIMD_SCALAR_OP(name, expression)                                  \
+    inline f32x4 name(f32x4 a, f32x4 b) {                                   \
+        f32x4 r;                                                            \
+        for (usize i = 0; i < 4; i++) {                                     \
+            r.v[i] = expression;                                            \
+        }                                                                   \
+        return r;                                                           \
+    }
+
+Q_SIMD_SCALAR_OP(f32x4_add, a.v[i] + b.v[i])
+Q_SIMD_SCALAR_OP(f32x4_sub, a.v[i] - b.v[i])
+Q_SIMD_SCALAR_OP(f32x4_mul, a.v[i] * b.v[i])
+Q_SIMD_SCALAR_OP(f32x4_div, a.v[i] / b.v[i])
+Q_SIMD_SCALAR_OP(f32x4_min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+Q_SIMD_SCALAR_OP(f32x4_max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+
+#undef Q_SIMD_SCALAR_OP
+
+inline f32x4 f32x4_sqrt(f32x4 a) { return { { std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3]) } }; }
+inline f32x4 f32x4_abs(f32x4 a) { return { { std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3]) } }; }
+inline f32x4 f32x4_neg(f32x4 a) { return { { -a.v[0], -a.v[1], -a.v[2], -a.v[3] } }; }
+inline f32x4 f32x4_madd(f32x4 a, f32x4 b, f32x4 c) { return f32x4_add(f32x4_mul(a, b), c); }
+
+template <int X, int Y, int Z, int W>
+inline f32x4 f32x4_shuffle(f32x4 a) { return { { a.v[X], a.v[Y], a.v[Z], a.v[W] } }; }
+
+inline f32 f32x4_x(f32x4 a) { return a.v[0]; }
+
+inline u32 f32x4_less_mask(f32x4 a, f32x4 b) {
+    u32 mask = 0;
+    for (u32 i = 0; i < 4; i++) {
+        mask |= a.v[i] < b.v[i] ? 1u << i : 0u;
+    }
+    return mask;
+}
+
+#endif
+
+// Every lane set to lane I of a
+template <int I>
+inline f32x4 f32x4_splat_lane(f32x4 a) { return f32x4_shuffle<I, I, I, I>(a); }
+
+// Sum of all four lanes, in every lane
+inline f32x4 f32x4_horizontal_sum(f32x4 a) {
+    f32x4 pairs = f32x4_add(a, f32x4_shuffle<1, 0, 3, 2>(a));
+    return f32x4_add(pairs, f32x4_shuffle<2, 3, 0, 1>(pairs));
+}
+
+inline f32x4 f32x4_dot4(f32x4 a, f32x4 b) { return f32x4_horizontal_sum(f32x4_mul(a, b)); }
+
+} // math namespace
+
+} // bifrost namespace
@@ -0,0 +1,114 @@
+/// BIFROST GAME ENGINE
+/// Vectors. vec3 and vec4 are 16 byte aligned so they load straight into
+/// a SIMD register; vec2 is too small to gain from it and stays scalar.
+
+#pragma once
+#include "simd.h"
+
+namespace bifrost {
+
+namespace math {
+
+struct vec2 {
+    f32 x, y;
+
+    vec2() : x(0), y(0) {}
+    vec2(f32 x, f32 y) : x(x), y(y) {}
+    explicit vec2(f32 value) : x(value), y(value) {}
+
+    vec2 operator+(vec2 b) const { return { x + b.x, y + b.y }; }
+    vec2 operator-(vec2 b) const { return { x - b.x, y - b.y }; }
+    vec2 operator*(vec2 b) const { return { x * b.x, y * b.y }; }
+    vec2 operator*(f32 s) const { return { x * s, y * s }; }
+    vec2 operator/(f32 s) const { return { x / s, y / s }; }
+    vec2 operator-() const { return { -x, -y }; }
+    vec2& operator+=(vec2 b) { return *this = *this + b; }
+    vec2& operator-=(vec2 b) { return *this = *this - b; }
+    vec2& operator*=(f32 s) { return *this = *this * s; }
+};
+
+inline f32 dot(vec2 a, vec2 b) { return a.x * b.x + a.y * b.y; }
+inline f32 length(vec2 a) { return std::sqrt(dot(a, a)); }
+inline vec2 normalize(vec2 a) { return a / length(a); }
+inline vec2 lerp(vec2 a, vec2 b, f32 t) { return a + (b - a) * t; }
+
+// The fourth lane is padding and kept at 0
+struct alignas(16) vec3 {
+    f32 x, y, z;
+    f32 pad;
+
+    vec3() : x(0), y(0), z(0), pad(0) {}
+    vec3(f32 x, f32 y, f32 z) : x(x), y(y), z(z), pad(0) {}
+    explicit vec3(f32 value) : x(value), y(value), z(value), pad(0) {}
+    explicit vec3(f32x4 v) { f32x4_store_aligned(&x, v); pad = 0; }
+
+    f32x4 simd() const { return f32x4_load_aligned(&x); }
+
+    vec3 operator+(vec3 b) const { return vec3(f32x4_add(simd(), b.simd())); }
+    vec3 operator-(vec3 b) const { return vec3(f32x4_sub(simd(), b.simd())); }
+    vec3 operator*(vec3 b) const { return vec3(f32x4_mul(simd(), b.simd())); }
+    vec3 operator*(f32 s) const { return vec3(f32x4_mul(simd(), f32x4_splat(s))); }
+    vec3 operator/(f32 s) const { return vec3(f32x4_mul(simd(), f32x4_splat(1.0f / s))); }
+    vec3 operator-() const { return vec3(f32x4_neg(simd())); }
+    vec3& operator+=(vec3 b) { return *this = *this + b; }
+    vec3& operator-=(vec3 b) { return *this = *this - b; }
+    vec3& operator*=(f32 s) { return *this = *this * s; }
+
+    f32& operator[](usize i) { return (&x)[i]; }
+    f32 operator[](usize i) const { return (&x)[i]; }
+};
+
+// The padding lanes are 0, so a four lane dot product is the three lane one
+inline f32 dot(vec3 a, vec3 b) { return f32x4_x(f32x4_dot4(a.simd(), b.simd())); }
+inline f32 length(vec3 a) { return std::sqrt(dot(a, a)); }
+inline vec3 normalize(vec3 a) { return a / length(a); }
+inline vec3 lerp(vec3 a, vec3 b, f32 t) { return vec3(f32x4_madd(f32x4_sub(b.simd(), a.simd()), f32x4_splat(t), a.simd())); }
+inline vec3 min(vec3 a, vec3 b) { return vec3(f32x4_min(a.simd(), b.simd())); }
+inline vec3 max(vec3 a, vec3 b) { return vec3(f32x4_max(a.simd(), b.simd())); }
+inline vec3 abs(vec3 a) { return vec3(f32x4_abs(a.simd())); }
+
+inline vec3 cross(vec3 a, vec3 b) {
+    f32x4 va = a.simd();
+    f32x4 vb = b.simd();
+    f32x4 left = f32x4_mul(f32x4_shuffle<1, 2, 0, 3>(va), f32x4_shuffle<2, 0, 1, 3>(vb));
+    f32x4 right = f32x4_mul(f32x4_shuffle<2, 0, 1, 3>(va), f32x4_shuffle<1, 2, 0, 3>(vb));
+    return vec3(f32x4_sub(left, right));
+}
+
+struct alignas(16) vec4 {
+    f32 x, y, z, w;
+
+    vec4() : x(0), y(0), z(0), w(0) {}
+    vec4(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+    vec4(vec3 v, f32 w) : x(v.x), y(v.y), z(v.z), w(w) {}
+    explicit vec4(f32 value) : x(value), y(value), z(value), w(value) {}
+    explicit vec4(f32x4 v) { f32x4_store_aligned(&x, v); }
+
+    f32x4 simd() const { return f32x4_load_aligned(&x); }
+    vec3 xyz() const { return vec3(x, y, z); }
+
+    vec4 operator+(vec4 b) const { return vec4(f32x4_add(simd(), b.simd())); }
+    vec4 operator-(vec4 b) const { return vec4(f32x4_sub(simd(), b.simd())); }
+    vec4 operator*(vec4 b) const { return vec4(f32x4_mul(simd(), b.simd())); }
+    vec4 operator*(f32 s) const { return vec4(f32x4_mul(simd(), f32x4_splat(s))); }
+    vec4 operator/(f32 s) const { return vec4(f32x4_mul(simd(), f32x4_splat(1.0f / s))); }
+    vec4 operator-() const { return vec4(f32x4_neg(simd())); }
+    vec4& operator+=(vec4 b) { return *this = *this + b; }
+    vec4& operator-=(vec4 b) { return *this = *this - b; }
+    vec4& operator*=(f32 s) { return *this = *this * s; }
+
+    f32& operator[](usize i) { return (&x)[i]; }
+    f32 operator[](usize i) const { return (&x)[i]; }
+};
+
+inline f32 dot(vec4 a, vec4 b) { return f32x4_x(f32x4_dot4(a.simd(), b.simd())); }
+inline f32 length(vec4 a) { return std::sqrt(dot(a, a)); }
+inline vec4 normalize(vec4 a) { return a / length(a); }
+inline vec4 lerp(vec4 a, vec4 b, f32 t) { return vec4(f32x4_madd(f32x4_sub(b.simd(), a.simd()), f32x4_splat(t), a.simd())); }
+inline vec4 min(vec4 a, vec4 b) { return vec4(f32x4_min(a.simd(), b.simd())); }
+inline vec4 max(vec4 a, vec4 b) { return vec4(f32x4_max(a.simd(), b.simd())); }
+inline vec4 abs(vec4 a) { return vec4(f32x4_abs(a.simd())); }
+
+} // math namespace
+
+} // bifrost namespace
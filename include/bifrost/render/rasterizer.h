@@ -0,0 +1,163 @@
+/// BIFROST GAME ENGINE
+/// Software rasterizer that renders into a CPU framebuffer, for machines
+/// without a GPU and for pixel exact regression tests.
+///
+/// draw() queues triangles and flush() renders them in two parallel
+/// passes. Setup clips, culls and snaps batches of triangles and bins them
+/// into 64x64 pixel tiles; then each tile is rasterized by one thread, 8x8
+/// pixel blocks at a time. Blocks the triangle cannot cover, or that its
+/// depth cannot pass, are skipped whole. The result does not depend on
+/// the number of threads.
+
+#pragma once
+#include "core/types.h"
+#include "core/defines.h"
+#include "core/memory.h"
+#include "math/matrix.h"
+
+#include <memory_resource>
+#include <vector>
+
+using namespace bifrost::core::types;
+
+namespace bifrost {
+
+namespace render {
+
+// Tiles are binned and rasterized independently of each other
+constexpr u32 RASTER_TILE_SIZE = 64;
+
+// Pixels per side of the blocks that keep a hierarchical depth value
+constexpr u32 RASTER_BLOCK_SIZE = 8;
+
+// Largest framebuffer side. It bounds the fixed point coordinates so edge
+// functions fit in 32 bits within a block.
+constexpr u32 RASTER_MAX_SIZE = 4096;
+
+// Triangles each setup job takes
+constexpr usize RASTER_SETUP_BATCH = 1024;
+
+enum class CullMode : u8 {
+    NONE,
+    BACK,  // Drop triangles that are clockwise in device coordinates, y up
+    FRONT  // Drop triangles that are counter-clockwise in device coordinates
+};
+
+// Counts of the last flush
+struct RasterStats {
+    u64 triangles_submitted;
+    u64 triangles_setup;     // Left after clipping and culling
+    u64 tile_bins;           // Triangle and tile pairs
+    u64 blocks_rasterized;
+    u64 blocks_depth_culled; // Skipped by the hierarchical depth
+    u64 setup_ns;
+    u64 raster_ns;
+};
+
+// A triangle ready to rasterize. Edge functions are evaluated at pixel
+// centers as a * x + b * y + c; a pixel is covered when all three are
+// non-negative. The planes give depth, 1 / w and color / w the same way.
+struct RasterTriangle {
+    i32 min_x, min_y, max_x, max_y; // Pixel bounds, clamped to the framebuffer
+    i32 edge_a[3];
+    i32 edge_b[3];
+    i64 edge_c[3];
+    f32 min_z;
+    f32 planes[5][3]; // depth, 1 / w, red / w, green / w, blue / w
+};
+
+class QAPI Rasterizer {
+public:
+    Rasterizer(u32 width, u32 height);
+    Rasterizer(const Rasterizer&) = delete;
+
+    // Change the size of the framebuffer. Its contents are lost if the size
+    // changes. Memory is allocated by size class, so following a window
+    // that is being resized seldom reallocates.
+    void resize(u32 width, u32 height);
+
+    void set_cull_mode(CullMode mode) { m_cull_mode = mode; }
+
+    // Clear color and depth as the first step of the next flush
+    void clear(u32 color, f32 depth = 1.0f);
+
+    // Queue indexed triangles. Positions are transformed by mvp into clip
+    // space, depth runs from 0 to 1 as with mat4::perspective. Colors are
+    // 0x00RRGGBB per vertex and interpolated with perspective correction.
+    void draw(
+        const math::mat4& mvp,
+        const math::vec3* positions,
+        const u32* colors,
+        usize vertex_count,
+        const u32* indices,
+        usize index_count
+    );
+
+    // Render everything queued since the last flush, spread over the job system
+    void flush();
+
+    // 0x00RRGGBB pixels, rows top to bottom, get_width() pixels per row
+    const u32* get_pixels() const { return m_color.data(); }
+    const f32* get_depth() const { return m_depth.data(); }
+    u32 get_width() const { return m_width; }
+    u32 get_height() const { return m_height; }
+
+    const RasterStats& get_stats() const { return m_stats; }
+
+private:
+    // Vertex in clip space, as queued by draw
+    struct ClipVertex {
+        math::vec4 position;
+        math::vec4 color; // 0 to 255 per channel
+    };
+
+    // Triangles set up by one job, sorted by the tile they touch
+    struct SetupBatch {
+        std::pmr::vector<RasterTriangle> triangles;
+        std::pmr::vector<u32> tile_start;  // First entry of each tile, one extra at the end
+        std::pmr::vector<u32> tile_entries; // Triangle indices, tile after tile
+        std::pmr::vector<u64> bins;        // Scratch: tile and triangle of every bin
+
+        SetupBatch();
+    };
+
+    u32 m_width;
+    u32 m_height;
+    u32 m_tiles_x;
+    u32 m_tiles_y;
+    u32 m_blocks_x;
+    u32 m_blocks_y;
+    f32 m_guard_x;  // Clip space x / w past which triangles are clipped
+    f32 m_guard_y;
+    CullMode m_cull_mode;
+
+    bool m_clear_pending;
+    u32 m_clear_color;
+    f32 m_clear_depth;
+
+    std::pmr::vector<u32> m_color;
+    std::pmr::vector<f32> m_depth;
+    std::pmr::vector<f32> m_block_depth; // Farthest depth in each block
+
+    std::pmr::vector<ClipVertex> m_vertices;
+    std::pmr::vector<u32> m_indices;
+    std::vector<SetupBatch> m_batches;
+    usize m_batch_count;
+    usize m_batch_triangles;
+
+    std::pmr::vector<RasterStats> m_tile_stats;
+    u64 m_triangles_submitted;
+
+    RasterStats m_stats;
+
+    void _setup_batch(usize index);
+    void _setup_triangle(SetupBatch& batch, const ClipVertex* vertices[3]);
+    void _emit_triangle(SetupBatch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+    void _rasterize_tile(u32 tile, RasterStats& stats);
+    bool _rasterize_block(const RasterTriangle& triangle, u32 block_x, u32 block_y);
+    void _update_block_depth(u32 block_x, u32 block_y);
+};
+
+} // render namespace
+
+} // bifrost namespace
@@ -0,0 +1,23 @@
+/// BIFROST GAME ENGINE
+/// Checks shared by the engine tests. Every file in tests/ builds into
+/// its own executable, which ctest runs and which fails with a non-zero
+/// exit code on the first check that does not hold.
+
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+#define TEST_CHECK(condition)                                                               \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(EXIT_FAILURE);                                                        \
+        }                                                                                   \
+    } while (0)
+
+#define TEST_RUN(test)                         \
+    do {                                       \
+        std::printf("%s\n", #test);            \
+        std::fflush(stdout);                   \
+        test();                                \
+    } while (0)
@@ -0,0 +1,82 @@
+#include "test.h"
+
+#include <core/ecs.h>
+
+using namespace bifrost::core;
+
+struct Position { f32 x, y; };
+struct Health { f32 value; };
+
+static usize count_positions(World& world) {
+    return world.query<Position>().count(world);
+}
+
+// Entities created by a buffer exist once it is applied, with their components
+static void test_apply_created() {
+    World world;
+    CommandBuffer commands;
+    for (u32 i = 0; i < 10; i++) {
+        Entity entity = commands.create();
+        commands.add(entity, Position{ static_cast<f32>(i), 0.0f });
+        if (i % 2 == 0) {
+            commands.add(entity, Health{ 100.0f });
+        }
+    }
+    world.apply(commands);
+
+    TEST_CHECK(world.entity_count() == 10);
+    TEST_CHECK(count_positions(world) == 10);
+    TEST_CHECK((world.query<Position, Health>().count(world) == 5));
+    TEST_CHECK(commands.is_empty());
+}
+
+// A pending handle used with another buffer used to index past the
+// entities that buffer created
+static void test_reject_other_buffer_handle() {
+    World world;
+    CommandBuffer first;
+    CommandBuffer second;
+    Entity foreign = first.create();
+    first.create();
+    first.create();
+
+    Entity own = second.create();
+    second.add(own, Position{ 1.0f, 2.0f });
+    second.add(foreign, Position{ 3.0f, 4.0f });
+    second.destroy(foreign);
+    world.apply(second);
+
+    TEST_CHECK(world.entity_count() == 1);
+    TEST_CHECK(count_positions(world) == 1);
+
+    // A handle of a buffer that was applied since is stale
+    Entity stale = second.create();
+    second.clear();
+    second.add(stale, Position{ 5.0f, 6.0f });
+    world.apply(second);
+    TEST_CHECK(count_positions(world) == 1);
+}
+
+// Pending handles never match an existing entity, however often the
+// index was reused
+static void test_pending_handle_not_alive() {
+    World world;
+    CommandBuffer commands;
+    Entity pending = commands.create();
+
+    Entity entity = world.create();
+    for (u32 i = 0; i < 100; i++) {
+        world.destroy(entity);
+        entity = world.create();
+    }
+    TEST_CHECK(entity.index == pending.index);
+    TEST_CHECK(!world.is_alive(pending));
+    TEST_CHECK(!world.destroy(pending));
+}
+
+int main() {
+    TEST_RUN(test_apply_created);
+    TEST_RUN(test_reject_other_buffer_handle);
+    TEST_RUN(test_pending_handle_not_alive);
+    return EXIT_SUCCESS;
+}
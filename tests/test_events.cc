@@ -0,0 +1,94 @@
+#include "test.h"
+
+#include <core/events.h>
+
+#include <vector>
+
+using namespace bifrost::core;
+
+// Listeners a callback registers, enough for the code's vector to grow
+constexpr u32 REGISTERED_IN_CALLBACK = 64;
+
+struct FireCounts {
+    u32 registering;
+    u32 registered;
+};
+
+static std::vector<ListenerHandle> g_handles;
+
+static bool count_registered(EventCode, void*, void* listener, EventData) {
+    static_cast<FireCounts*>(listener)->registered++;
+    return false;
+}
+
+// A callback that registers listeners on the code being fired keeps
+// running after the vector holding it has been reallocated. It must not
+// be called through that vector, or its captures are read from freed
+// memory, which ASan reports.
+static void test_register_from_callback() {
+    EventHandler* handler = EventHandler::get_reference();
+    FireCounts counts = {};
+    FireCounts* captured = &counts;
+
+    ListenerHandle registering = handler->register_event(
+        EventCode::FILE_DROPPED,
+        &counts,
+        [captured](EventCode code, void*, void* listener, EventData) {
+            EventHandler* events = EventHandler::get_reference();
+            if (captured->registering == 0) {
+                for (u32 i = 0; i < REGISTERED_IN_CALLBACK; i++) {
+                    g_handles.push_back(events->register_event(code, listener, &count_registered));
+                }
+            }
+            captured->registering++;
+            return false;
+        }
+    );
+
+    handler->fire_event(EventCode::FILE_DROPPED, nullptr, {});
+    TEST_CHECK(counts.registering == 1);
+    TEST_CHECK(counts.registered == 0);
+
+    handler->fire_event(EventCode::FILE_DROPPED, nullptr, {});
+    TEST_CHECK(counts.registering == 2);
+    TEST_CHECK(counts.registered == REGISTERED_IN_CALLBACK);
+
+    TEST_CHECK(handler->unregister_event(registering));
+    for (ListenerHandle handle : g_handles) {
+        TEST_CHECK(handler->unregister_event(handle));
+    }
+    g_handles.clear();
+
+    handler->fire_event(EventCode::FILE_DROPPED, nullptr, {});
+    TEST_CHECK(counts.registering == 2);
+    TEST_CHECK(counts.registered == REGISTERED_IN_CALLBACK);
+}
+
+// A listener unregistered by an earlier callback of the same fire is
+// skipped, and its handle goes stale
+static void test_unregister_from_callback() {
+    EventHandler* handler = EventHandler::get_reference();
+    FireCounts counts = {};
+
+    g_handles.push_back(handler->register_event(
+        EventCode::TEXT_INPUT,
+        nullptr,
+        [](EventCode, void*, void*, EventData) {
+            EventHandler::get_reference()->unregister_event(g_handles[1]);
+            return false;
+        }
+    ));
+    g_handles.push_back(handler->register_event(EventCode::TEXT_INPUT, &counts, &count_registered));
+
+    handler->fire_event(EventCode::TEXT_INPUT, nullptr, {});
+    TEST_CHECK(counts.registered == 0);
+    TEST_CHECK(!handler->unregister_event(g_handles[1]));
+    TEST_CHECK(handler->unregister_event(g_handles[0]));
+    g_handles.clear();
+}
+
+int main() {
+    TEST_RUN(test_register_from_callback);
+    TEST_RUN(test_unregister_from_callback);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "test.h"
+
+#include <core/frame_stats.h>
+
+#include <cmath>
+
+using namespace bifrost::core;
+
+constexpr u64 MS = 1000000;
+
+static bool near(f64 a, f64 b) {
+    return std::fabs(a - b) < 1e-9;
+}
+
+// 1 to 100 ms in a shuffled order: the percentiles come out of the
+// sorted values, not the order they were recorded in
+static void test_percentiles() {
+    FrameTimeTracker tracker;
+    u64 last = 0;
+    for (u64 i = 0; i < 100; i++) {
+        last = ((i * 37) % 100 + 1) * MS;
+        tracker.record(FramePhase::FRAME, last);
+    }
+
+    FrameTimeSummary summary = tracker.summarize(FramePhase::FRAME);
+    TEST_CHECK(summary.sample_count == 100);
+    TEST_CHECK(summary.last_ns == last);
+    TEST_CHECK(summary.mean_ns == 50 * MS + MS / 2);
+    TEST_CHECK(summary.p50_ns == 51 * MS);
+    TEST_CHECK(summary.p99_ns == 100 * MS);
+    TEST_CHECK(summary.max_ns == 100 * MS);
+
+    // Summarizing leaves the history as it was
+    FrameTimeSummary again = tracker.summarize(FramePhase::FRAME);
+    TEST_CHECK(again.p50_ns == summary.p50_ns);
+    TEST_CHECK(again.p99_ns == summary.p99_ns);
+}
+
+// A single hitch among steady frames shows in the max, not the p99
+static void test_single_hitch() {
+    FrameTimeTracker tracker;
+    for (usize i = 0; i < FRAME_STATS_HISTORY; i++) {
+        tracker.record(FramePhase::FRAME, i == 100 ? 50 * MS : 16 * MS);
+    }
+
+    FrameTimeSummary summary = tracker.summarize(FramePhase::FRAME);
+    TEST_CHECK(summary.sample_count == FRAME_STATS_HISTORY);
+    TEST_CHECK(summary.p50_ns == 16 * MS);
+    TEST_CHECK(summary.p99_ns == 16 * MS);
+    TEST_CHECK(summary.max_ns == 50 * MS);
+}
+
+// Only the last FRAME_STATS_HISTORY frames count, and phases are kept apart
+static void test_history_and_phases() {
+    FrameTimeTracker tracker;
+    for (usize i = 0; i < FRAME_STATS_HISTORY; i++) {
+        tracker.record(FramePhase::UPDATE, 100 * MS);
+    }
+    for (usize i = 0; i < FRAME_STATS_HISTORY; i++) {
+        tracker.record(FramePhase::UPDATE, 2 * MS);
+    }
+    tracker.record(FramePhase::RENDER, 3 * MS);
+
+    FrameTimeSummary update = tracker.summarize(FramePhase::UPDATE);
+    TEST_CHECK(update.sample_count == FRAME_STATS_HISTORY);
+    TEST_CHECK(update.mean_ns == 2 * MS);
+    TEST_CHECK(update.max_ns == 2 * MS);
+
+    FrameTimeSummary render = tracker.summarize(FramePhase::RENDER);
+    TEST_CHECK(render.sample_count == 1);
+    TEST_CHECK(render.p50_ns == 3 * MS);
+    TEST_CHECK(render.p99_ns == 3 * MS);
+    TEST_CHECK(tracker.summarize(FramePhase::IDLE).sample_count == 0);
+
+    tracker.reset();
+    TEST_CHECK(tracker.summarize(FramePhase::UPDATE).sample_count == 0);
+    TEST_CHECK(tracker.summarize(FramePhase::RENDER).last_ns == 0);
+}
+
+// Steps per frame, with the rest carried over into the alpha
+static void test_timestep_steps() {
+    FixedTimestep timestep(10 * MS, 4);
+
+    TEST_CHECK(timestep.advance(25 * MS) == 2);
+    TEST_CHECK(near(timestep.get_alpha(), 0.5));
+
+    TEST_CHECK(timestep.advance(5 * MS) == 1);
+    TEST_CHECK(near(timestep.get_alpha(), 0.0));
+
+    TEST_CHECK(timestep.advance(3 * MS) == 0);
+    TEST_CHECK(near(timestep.get_alpha(), 0.3));
+
+    timestep.reset();
+    TEST_CHECK(near(timestep.get_alpha(), 0.0));
+    TEST_CHECK(timestep.advance(9 * MS) == 0);
+}
+
+// Frames faster than the step: over many frames every nanosecond is
+// either simulated or left in the accumulator, and alpha stays below 1
+static void test_timestep_fast_frames() {
+    const u64 step_ns = 1000000000ull / 60;
+    const u64 frame_ns = 1000000000ull / 144;
+    FixedTimestep timestep(step_ns, 8);
+
+    u64 steps = 0;
+    for (u32 frame = 1; frame <= 1440; frame++) {
+        u32 frame_steps = timestep.advance(frame_ns);
+        TEST_CHECK(frame_steps <= 1);
+        TEST_CHECK(timestep.get_alpha() >= 0.0 && timestep.get_alpha() < 1.0);
+
+        steps += frame_steps;
+        u64 total_ns = frame * frame_ns;
+        TEST_CHECK(steps == total_ns / step_ns);
+        TEST_CHECK(near(timestep.get_alpha(), static_cast<f64>(total_ns % step_ns) / static_cast<f64>(step_ns)));
+    }
+}
+
+// A long frame runs at most max_steps, and the whole steps beyond that
+// are dropped instead of being run on later frames
+static void test_timestep_clamp() {
+    FixedTimestep timestep(10 * MS, 4);
+
+    TEST_CHECK(timestep.advance(40 * MS) == 4);
+    TEST_CHECK(near(timestep.get_alpha(), 0.0));
+
+    TEST_CHECK(timestep.advance(45 * MS) == 4);
+    TEST_CHECK(near(timestep.get_alpha(), 0.5));
+
+    timestep.reset();
+    TEST_CHECK(timestep.advance(1000 * MS + 5 * MS) == 4);
+    TEST_CHECK(near(timestep.get_alpha(), 0.5));
+    TEST_CHECK(timestep.advance(0) == 0);
+    TEST_CHECK(timestep.advance(5 * MS) == 1);
+    TEST_CHECK(near(timestep.get_alpha(), 0.0));
+}
+
+int main() {
+    TEST_RUN(test_percentiles);
+    TEST_RUN(test_single_hitch);
+    TEST_RUN(test_history_and_phases);
+    TEST_RUN(test_timestep_steps);
+    TEST_RUN(test_timestep_fast_frames);
+    TEST_RUN(test_timestep_clamp);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+#include "test.h"
+
+#include <core/application.h>
+#include <core/input.h>
+#include <core/input_record.h>
+#include <core/window.h>
+
+#include <climits>
+#include <filesystem>
+#include <vector>
+
+using namespace bifrost::core;
+namespace fs = std::filesystem;
+
+static fs::path g_root;
+
+static bool same_event(const InputEvent& a, const InputEvent& b) {
+    return a.type == b.type && a.pressed == b.pressed && a.code == b.code && a.x == b.x && a.y == b.y;
+}
+
+static std::vector<std::vector<InputEvent>> g_recorded_frames;
+
+static void end_frame(InputHandler* input) {
+    input->update(0.0);
+    std::span<const InputEvent> events = input->frame_events();
+    g_recorded_frames.emplace_back(events.begin(), events.end());
+}
+
+// Every input comes back in the frame it was recorded in. The values
+// cover multi-byte varints and zigzag deltas of both signs, up to moves
+// across the whole i32 range.
+static void test_round_trip() {
+    InputHandler* input = InputHandler::get_reference();
+    std::string path = (g_root / "round_trip.bfir").string();
+
+    InputRecorder recorder;
+    TEST_CHECK(recorder.open(path.c_str()));
+    input->set_recorder(&recorder);
+    g_recorded_frames.clear();
+
+    input->process_key(bifrost::KEY_A, true);
+    input->process_mouse_move(100, 200);
+    input->process_window_resize(7680, 4320);
+    end_frame(input);
+
+    input->process_mouse_move(INT_MAX, INT_MIN);
+    input->process_mouse_move(INT_MIN, INT_MAX);
+    input->process_mouse_wheel(-120);
+    input->process_buttons(bifrost::RIGHT, true);
+    input->process_key(bifrost::KEY_A, false);
+    input->process_key(static_cast<bifrost::Keys>(bifrost::KEYS_MAX_KEY - 1), true);
+    end_frame(input);
+
+    end_frame(input);
+
+    input->process_buttons(bifrost::RIGHT, false);
+    input->process_mouse_move(0, 0);
+    input->process_mouse_wheel(1);
+    input->process_key(static_cast<bifrost::Keys>(bifrost::KEYS_MAX_KEY - 1), false);
+    end_frame(input);
+
+    input->set_recorder(nullptr);
+    recorder.close();
+
+    InputReplayer replayer;
+    TEST_CHECK(replayer.open(path.c_str()));
+    for (const std::vector<InputEvent>& recorded : g_recorded_frames) {
+        TEST_CHECK(replayer.replay_frame(input, ReplayTiming::AS_FAST_AS_POSSIBLE));
+        input->update(0.0);
+
+        std::span<const InputEvent> replayed = input->frame_events();
+        TEST_CHECK(replayed.size() == recorded.size());
+        for (usize i = 0; i < recorded.size(); i++) {
+            TEST_CHECK(same_event(replayed[i], recorded[i]));
+        }
+    }
+    TEST_CHECK(replayer.is_finished());
+    TEST_CHECK(!replayer.replay_frame(input, ReplayTiming::AS_FAST_AS_POSSIBLE));
+}
+
+// What the application saw at the end of a frame's update
+struct FrameSnapshot {
+    bool key_down;
+    bool button_down;
+    i32 mouse_x, mouse_y;
+    u32 width, height;
+};
+
+// Events a headless session gets, by frame. It ends with the input back
+// where it started, as the input handler outlives the application.
+struct ScheduledEvent {
+    u64 frame;
+    WindowEvent event;
+};
+
+static const ScheduledEvent SESSION[] = {
+    { 0, { WindowEventType::KEY, true, bifrost::KEY_A, 0, 0 } },
+    { 1, { WindowEventType::MOUSE_MOVE, false, 0, 10, 20 } },
+    { 1, { WindowEventType::BUTTON, true, bifrost::LEFT, 0, 0 } },
+    { 2, { WindowEventType::RESIZE, false, 0, 800, 600 } },
+    { 3, { WindowEventType::MOUSE_MOVE, false, 0, 0, 0 } },
+    { 3, { WindowEventType::BUTTON, false, bifrost::LEFT, 0, 0 } },
+    { 3, { WindowEventType::KEY, false, bifrost::KEY_A, 0, 0 } },
+    { 5, { WindowEventType::CLOSE, false, 0, 0, 0 } },
+};
+
+class SessionApp : public Application {
+public:
+    std::vector<FrameSnapshot> snapshots;
+
+    SessionApp(const ApplicationConfig& config, bool live)
+        : Application(config)
+    {
+        if (live) {
+            get_window().set_event_source(window_event_source::bind<&SessionApp::next_event>(this));
+        }
+    }
+
+private:
+    u64 m_frame = 0;
+    usize m_next = 0;
+
+    bool next_event(WindowEvent& event) {
+        if (m_next == sizeof(SESSION) / sizeof(SESSION[0]) || SESSION[m_next].frame != m_frame) {
+            return false;
+        }
+        event = SESSION[m_next++].event;
+        return true;
+    }
+
+    void on_update(f64 delta_time) override {
+        (void)delta_time;
+        InputHandler* input = InputHandler::get_reference();
+        auto [x, y] = input->get_mouse_position();
+
+        FrameSnapshot snapshot = {};
+        snapshot.key_down = input->is_key_down(bifrost::KEY_A);
+        snapshot.button_down = input->is_button_down(bifrost::LEFT);
+        snapshot.mouse_x = x;
+        snapshot.mouse_y = y;
+        snapshot.width = get_window().get_width();
+        snapshot.height = get_window().get_height();
+        snapshots.push_back(snapshot);
+        m_frame++;
+    }
+};
+
+// A session recorded through the application's switch replays on a
+// headless window frame for frame, and the replay ends the main loop
+static void test_application_replay() {
+    ApplicationConfig config;
+    config.backend = WindowBackend::HEADLESS;
+    config.target_frame_time = 0.0;
+    config.worker_count = 1;
+    config.input_record_path = (g_root / "session.bfir").string();
+
+    SessionApp live(config, true);
+    live.run();
+    TEST_CHECK(live.snapshots.size() == 5);
+    TEST_CHECK(live.snapshots[0].key_down);
+    TEST_CHECK(live.snapshots[1].mouse_x == 10 && live.snapshots[1].mouse_y == 20);
+    TEST_CHECK(live.snapshots[2].width == 800 && live.snapshots[2].height == 600);
+
+    ApplicationConfig replay_config;
+    replay_config.target_frame_time = 1.0;
+    replay_config.worker_count = 1;
+    replay_config.input_replay_path = config.input_record_path;
+
+    SessionApp replay(replay_config, false);
+    TEST_CHECK(replay.get_window().get_backend() == WindowBackend::HEADLESS);
+    replay.run();
+
+    TEST_CHECK(replay.snapshots.size() == live.snapshots.size());
+    for (usize i = 0; i < live.snapshots.size(); i++) {
+        const FrameSnapshot& a = live.snapshots[i];
+        const FrameSnapshot& b = replay.snapshots[i];
+        TEST_CHECK(a.key_down == b.key_down && a.button_down == b.button_down);
+        TEST_CHECK(a.mouse_x == b.mouse_x && a.mouse_y == b.mouse_y);
+        TEST_CHECK(a.width == b.width && a.height == b.height);
+    }
+}
+
+int main() {
+    g_root = fs::temp_directory_path() / "bifrost_test_input_record";
+    fs::remove_all(g_root);
+    fs::create_directories(g_root);
+
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_application_replay);
+
+    fs::remove_all(g_root);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include "test.h"
+
+#include <math/kernels.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace bifrost::math;
+
+// Item counts that cover empty input, the tails after whole registers
+// and a batch large enough to go through every loop
+static const usize g_counts[] = { 0, 1, 2, 3, 7, 8, 9, 17, 100003 };
+constexpr usize MAX_COUNT = 100003;
+
+static u32 g_random = 2463534242u;
+
+// Uniform in [low, high)
+static f32 random_range(f32 low, f32 high) {
+    g_random ^= g_random << 13;
+    g_random ^= g_random >> 17;
+    g_random ^= g_random << 5;
+    return low + (high - low) * static_cast<f32>(g_random >> 8) / static_cast<f32>(1u << 24);
+}
+
+static vec3 random_vec3(f32 range) {
+    return vec3(random_range(-range, range), random_range(-range, range), random_range(-range, range));
+}
+
+static mat4 random_transform() {
+    quat rotation = quat::from_axis_angle(normalize(random_vec3(1.0f) + vec3(0.01f)), random_range(0.0f, 6.28f));
+    vec3 scale(random_range(0.5f, 2.0f), random_range(0.5f, 2.0f), random_range(0.5f, 2.0f));
+    return mat4::trs(random_vec3(100.0f), rotation, scale);
+}
+
+// The SIMD kernels may fuse multiplies and adds, so results are compared
+// relative to their size rather than bit for bit
+static bool nearly_equal(f32 a, f32 b) {
+    return std::fabs(a - b) <= 1e-4f * std::fmax(1.0f, std::fabs(b));
+}
+
+static bool nearly_equal(const vec4& a, const vec4& b) {
+    return nearly_equal(a.x, b.x) && nearly_equal(a.y, b.y) && nearly_equal(a.z, b.z) && nearly_equal(a.w, b.w);
+}
+
+static bool nearly_equal(const vec3& a, const vec3& b) {
+    return nearly_equal(a.x, b.x) && nearly_equal(a.y, b.y) && nearly_equal(a.z, b.z) && a.pad == 0.0f;
+}
+
+static void test_transform_points() {
+    mat4 m = random_transform();
+    std::vector<vec3> in(MAX_COUNT), out(MAX_COUNT), expected(MAX_COUNT);
+    for (vec3& p : in) {
+        p = random_vec3(1000.0f);
+    }
+
+    for (usize count : g_counts) {
+        transform_points(m, in.data(), out.data(), count);
+        transform_points_scalar(m, in.data(), expected.data(), count);
+        for (usize i = 0; i < count; i++) {
+            TEST_CHECK(nearly_equal(out[i], expected[i]));
+        }
+    }
+
+    // In place
+    std::vector<vec3> points = in;
+    transform_points(m, points.data(), points.data(), MAX_COUNT);
+    for (usize i = 0; i < MAX_COUNT; i++) {
+        TEST_CHECK(nearly_equal(points[i], expected[i]));
+    }
+}
+
+static void test_transform_vectors() {
+    mat4 m = random_transform();
+    std::vector<vec4> in(MAX_COUNT), out(MAX_COUNT), expected(MAX_COUNT);
+    for (vec4& v : in) {
+        v = vec4(random_vec3(1000.0f), random_range(0.0f, 1.0f));
+    }
+
+    for (usize count : g_counts) {
+        transform_vectors(m, in.data(), out.data(), count);
+        transform_vectors_scalar(m, in.data(), expected.data(), count);
+        for (usize i = 0; i < count; i++) {
+            TEST_CHECK(nearly_equal(out[i], expected[i]));
+        }
+    }
+}
+
+static void test_multiply_matrices() {
+    std::vector<mat4> a(MAX_COUNT), b(MAX_COUNT), out(MAX_COUNT), expected(MAX_COUNT);
+    for (usize i = 0; i < MAX_COUNT; i++) {
+        a[i] = random_transform();
+        b[i] = random_transform();
+    }
+
+    for (usize count : g_counts) {
+        multiply_matrices(a.data(), b.data(), out.data(), count);
+        multiply_matrices_scalar(a.data(), b.data(), expected.data(), count);
+        for (usize i = 0; i < count; i++) {
+            for (usize column = 0; column < 4; column++) {
+                TEST_CHECK(nearly_equal(out[i][column], expected[i][column]));
+            }
+        }
+    }
+}
+
+static void test_transform_aabbs() {
+    mat4 m = random_transform();
+    std::vector<aabb> in(MAX_COUNT), out(MAX_COUNT), expected(MAX_COUNT);
+    for (aabb& box : in) {
+        box = aabb::from_center_extents(random_vec3(1000.0f), abs(random_vec3(10.0f)));
+    }
+
+    for (usize count : g_counts) {
+        transform_aabbs(m, in.data(), out.data(), count);
+        transform_aabbs_scalar(m, in.data(), expected.data(), count);
+        for (usize i = 0; i < count; i++) {
+            TEST_CHECK(nearly_equal(out[i].min, expected[i].min));
+            TEST_CHECK(nearly_equal(out[i].max, expected[i].max));
+        }
+    }
+}
+
+static frustum test_frustum() {
+    mat4 projection = mat4::perspective(1.2f, 16.0f / 9.0f, 0.1f, 500.0f);
+    mat4 view = mat4::look_at(vec3(0.0f, 20.0f, 50.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+    return frustum::from_matrix(projection * view);
+}
+
+static void test_cull_spheres() {
+    frustum view = test_frustum();
+    std::vector<f32> x(MAX_COUNT), y(MAX_COUNT), z(MAX_COUNT), radius(MAX_COUNT);
+    for (usize i = 0; i < MAX_COUNT; i++) {
+        x[i] = random_range(-300.0f, 300.0f);
+        y[i] = random_range(-300.0f, 300.0f);
+        z[i] = random_range(-300.0f, 300.0f);
+        radius[i] = random_range(0.1f, 5.0f);
+    }
+
+    std::vector<u8> visible(MAX_COUNT), expected(MAX_COUNT);
+    for (usize count : g_counts) {
+        usize found = cull_spheres(view, x.data(), y.data(), z.data(), radius.data(), visible.data(), count);
+        usize expected_found = cull_spheres_scalar(view, x.data(), y.data(), z.data(), radius.data(), expected.data(), count);
+        TEST_CHECK(found == expected_found);
+        for (usize i = 0; i < count; i++) {
+            TEST_CHECK(visible[i] == expected[i]);
+        }
+    }
+
+    // The data is spread so some spheres are in and some are out
+    TEST_CHECK(cull_spheres_scalar(view, x.data(), y.data(), z.data(), radius.data(), expected.data(), MAX_COUNT) > 0);
+    TEST_CHECK(cull_spheres_scalar(view, x.data(), y.data(), z.data(), radius.data(), expected.data(), MAX_COUNT) < MAX_COUNT);
+}
+
+static void test_cull_aabbs() {
+    frustum view = test_frustum();
+    std::vector<aabb> boxes(MAX_COUNT);
+    for (aabb& box : boxes) {
+        box = aabb::from_center_extents(random_vec3(300.0f), abs(random_vec3(5.0f)));
+    }
+
+    std::vector<u8> visible(MAX_COUNT), expected(MAX_COUNT);
+    for (usize count : g_counts) {
+        usize found = cull_aabbs(view, boxes.data(), visible.data(), count);
+        usize expected_found = cull_aabbs_scalar(view, boxes.data(), expected.data(), count);
+        TEST_CHECK(found == expected_found);
+        for (usize i = 0; i < count; i++) {
+            TEST_CHECK(visible[i] == expected[i]);
+        }
+    }
+}
+
+int main() {
+    std::printf("kernels built for %s\n", simd_isa_name());
+
+    TEST_RUN(test_transform_points);
+    TEST_RUN(test_transform_vectors);
+    TEST_RUN(test_multiply_matrices);
+    TEST_RUN(test_transform_aabbs);
+    TEST_RUN(test_cull_spheres);
+    TEST_RUN(test_cull_aabbs);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "test.h"
+
+#include <core/memory.h>
+
+using namespace bifrost::core;
+
+constexpr u32 BLOCK_COUNT = 16;
+constexpr u32 FREED_COUNT = 6;
+
+static usize block_size(u32 index) {
+    return 64 * (static_cast<usize>(index) + 1);
+}
+
+// A tagged heap counts exactly what goes through it, with or without
+// the global hooks
+static void test_tagged_heap_counts() {
+    std::pmr::memory_resource* heap = get_tagged_heap(MemoryTag::RENDER);
+    MemoryTagStats before = get_memory_stats(MemoryTag::RENDER);
+
+    void* blocks[BLOCK_COUNT];
+    usize total = 0;
+    for (u32 i = 0; i < BLOCK_COUNT; i++) {
+        blocks[i] = heap->allocate(block_size(i), 16);
+        total += block_size(i);
+    }
+
+    MemoryTagStats allocated = get_memory_stats(MemoryTag::RENDER);
+    TEST_CHECK(allocated.allocations - before.allocations == BLOCK_COUNT);
+    TEST_CHECK(allocated.frees == before.frees);
+    TEST_CHECK(allocated.live_bytes - before.live_bytes == total);
+    TEST_CHECK(allocated.peak_bytes >= before.live_bytes + total);
+
+    usize freed = 0;
+    for (u32 i = 0; i < FREED_COUNT; i++) {
+        heap->deallocate(blocks[i], block_size(i), 16);
+        freed += block_size(i);
+    }
+
+    MemoryTagStats partly_freed = get_memory_stats(MemoryTag::RENDER);
+    TEST_CHECK(partly_freed.allocations == allocated.allocations);
+    TEST_CHECK(partly_freed.frees - before.frees == FREED_COUNT);
+    TEST_CHECK(partly_freed.live_bytes - before.live_bytes == total - freed);
+    TEST_CHECK(partly_freed.peak_bytes == allocated.peak_bytes);
+
+    for (u32 i = FREED_COUNT; i < BLOCK_COUNT; i++) {
+        heap->deallocate(blocks[i], block_size(i), 16);
+    }
+
+    MemoryTagStats after = get_memory_stats(MemoryTag::RENDER);
+    TEST_CHECK(after.frees - before.frees == BLOCK_COUNT);
+    TEST_CHECK(after.live_bytes == before.live_bytes);
+}
+
+// The block of an arena is a single allocation of its tag's heap
+static void test_arena_block_counts() {
+    MemoryTagStats before = get_memory_stats(MemoryTag::FRAME);
+    {
+        LinearArena arena(4096, get_tagged_heap(MemoryTag::FRAME));
+        TEST_CHECK(arena.allocate(100, 8) != nullptr);
+        TEST_CHECK(arena.allocate(200, 8) != nullptr);
+
+        MemoryTagStats during = get_memory_stats(MemoryTag::FRAME);
+        TEST_CHECK(during.allocations - before.allocations == 1);
+        TEST_CHECK(during.live_bytes - before.live_bytes == 4096);
+    }
+
+    MemoryTagStats after = get_memory_stats(MemoryTag::FRAME);
+    TEST_CHECK(after.frees - before.frees == 1);
+    TEST_CHECK(after.live_bytes == before.live_bytes);
+}
+
+#ifdef BIFROST_TRACK_ALLOCATIONS
+
+// Global new and delete count under the tag of the scope they are called
+// in, and a free counts under the tag of its allocation wherever it is
+static void test_global_new_counts_under_scope() {
+    MemoryTagStats before = get_memory_stats(MemoryTag::INPUT);
+
+    u8* blocks[BLOCK_COUNT];
+    usize total = 0;
+    {
+        MemoryTagScope scope(MemoryTag::INPUT);
+        for (u32 i = 0; i < BLOCK_COUNT; i++) {
+            blocks[i] = new u8[block_size(i)];
+            total += block_size(i);
+        }
+    }
+    u8* untagged = new u8[1000];
+
+    MemoryTagStats allocated = get_memory_stats(MemoryTag::INPUT);
+    TEST_CHECK(allocated.allocations - before.allocations == BLOCK_COUNT);
+    TEST_CHECK(allocated.live_bytes - before.live_bytes == total);
+
+    for (u32 i = 0; i < BLOCK_COUNT; i++) {
+        delete[] blocks[i];
+    }
+    delete[] untagged;
+
+    MemoryTagStats after = get_memory_stats(MemoryTag::INPUT);
+    TEST_CHECK(after.allocations == allocated.allocations);
+    TEST_CHECK(after.frees - before.frees == BLOCK_COUNT);
+    TEST_CHECK(after.live_bytes == before.live_bytes);
+}
+
+#endif // BIFROST_TRACK_ALLOCATIONS
+
+int main() {
+    TEST_RUN(test_tagged_heap_counts);
+    TEST_RUN(test_arena_block_counts);
+#ifdef BIFROST_TRACK_ALLOCATIONS
+    TEST_RUN(test_global_new_counts_under_scope);
+#endif // BIFROST_TRACK_ALLOCATIONS
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "test.h"
+
+#include <core/events.h>
+#include <core/mpsc_queue.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace bifrost::core;
+
+constexpr u32 PRODUCER_COUNT = 8;
+constexpr u64 ITEMS_PER_PRODUCER = 50000;
+
+// Producers push their index and a sequence number while one consumer
+// pops. Every item arrives exactly once, each producer's in order.
+static void test_queue_stress() {
+    MPSCQueue<u64> queue(256);
+    std::atomic<bool> start = false;
+
+    std::vector<std::thread> producers;
+    for (u32 producer = 0; producer < PRODUCER_COUNT; producer++) {
+        producers.emplace_back([&queue, &start, producer] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (u64 sequence = 0; sequence < ITEMS_PER_PRODUCER; sequence++) {
+                while (!queue.try_push((static_cast<u64>(producer) << 32) | sequence)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    start.store(true, std::memory_order_release);
+
+    u64 next[PRODUCER_COUNT] = {};
+    u64 received = 0;
+    while (received < PRODUCER_COUNT * ITEMS_PER_PRODUCER) {
+        u64 item;
+        if (!queue.try_pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        u32 producer = static_cast<u32>(item >> 32);
+        TEST_CHECK(producer < PRODUCER_COUNT);
+        TEST_CHECK((item & 0xFFFFFFFFull) == next[producer]);
+        next[producer]++;
+        received++;
+    }
+
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    u64 item;
+    TEST_CHECK(!queue.try_pop(item));
+    TEST_CHECK(queue.pushed_count() == PRODUCER_COUNT * ITEMS_PER_PRODUCER);
+}
+
+struct PostedCounts {
+    u64 next[PRODUCER_COUNT] = {};
+    u64 received = 0;
+    bool in_order = true;
+};
+
+static bool on_key_pressed(EventCode code, void* sender, void* listener, EventData data) {
+    (void)code;
+    (void)sender;
+    PostedCounts* counts = static_cast<PostedCounts*>(listener);
+    u32 producer = data.u32[0];
+    if (producer >= PRODUCER_COUNT || data.u64[1] != counts->next[producer]) {
+        counts->in_order = false;
+        return false;
+    }
+    counts->next[producer]++;
+    counts->received++;
+    return false;
+}
+
+// Worker threads post events, the first of them racing to create the
+// handler, while the main thread flushes them to a listener
+static void test_post_event_stress() {
+    std::atomic<bool> start = false;
+    std::atomic<u32> ready = 0;
+    std::vector<std::thread> producers;
+    for (u32 producer = 0; producer < PRODUCER_COUNT; producer++) {
+        producers.emplace_back([&start, &ready, producer] {
+            ready.fetch_add(1);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            EventHandler* handler = EventHandler::get_reference();
+            for (u64 sequence = 0; sequence < ITEMS_PER_PRODUCER; sequence++) {
+                EventData data = {};
+                data.u32[0] = producer;
+                data.u64[1] = sequence;
+                while (!handler->post_event(EventCode::KEY_PRESSED, nullptr, data)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    while (ready.load() < PRODUCER_COUNT) {
+        std::this_thread::yield();
+    }
+    start.store(true, std::memory_order_release);
+
+    EventHandler* handler = EventHandler::get_reference();
+    PostedCounts counts;
+    ListenerHandle listener = handler->register_event(EventCode::KEY_PRESSED, &counts, &on_key_pressed);
+    while (counts.received < PRODUCER_COUNT * ITEMS_PER_PRODUCER) {
+        handler->flush();
+        TEST_CHECK(counts.in_order);
+        std::this_thread::yield();
+    }
+
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    handler->flush();
+    TEST_CHECK(counts.received == PRODUCER_COUNT * ITEMS_PER_PRODUCER);
+    TEST_CHECK(handler->get_post_stats().posted == PRODUCER_COUNT * ITEMS_PER_PRODUCER);
+    handler->unregister_event(listener);
+}
+
+int main() {
+    TEST_RUN(test_queue_stress);
+    TEST_RUN(test_post_event_stress);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,318 @@
+#include "test.h"
+
+#include <core/profiler.h>
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bifrost::core;
+namespace fs = std::filesystem;
+
+#ifdef BIFROST_PROFILE
+
+// Just enough JSON to read a trace back. parse fails on anything that is
+// not well formed, so a trace that parses is valid JSON.
+struct JsonValue {
+    enum class Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = Type::NUL;
+    bool boolean = false;
+    f64 number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    const JsonValue* find(const char* key) const {
+        auto it = object.find(key);
+        return it != object.end() ? &it->second : nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : m_text(text) {}
+
+    bool parse(JsonValue& value) {
+        return parse_value(value) && (skip_space(), m_at == m_text.size());
+    }
+
+private:
+    const std::string& m_text;
+    usize m_at = 0;
+
+    void skip_space() {
+        while (m_at < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_at]))) {
+            m_at++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (m_at < m_text.size() && m_text[m_at] == c) {
+            m_at++;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_word(const char* word) {
+        usize length = std::char_traits<char>::length(word);
+        if (m_text.compare(m_at, length, word) != 0) {
+            return false;
+        }
+        m_at += length;
+        return true;
+    }
+
+    bool parse_string(std::string& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        while (m_at < m_text.size() && m_text[m_at] != '"') {
+            char c = m_text[m_at++];
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return false;
+            }
+            if (c == '\\') {
+                if (m_at == m_text.size()) {
+                    return false;
+                }
+                c = m_text[m_at++];
+                if (c != '"' && c != '\\' && c != '/') {
+                    return false;
+                }
+            }
+            out.push_back(c);
+        }
+        return consume('"');
+    }
+
+    bool parse_number(f64& out) {
+        usize begin = m_at;
+        if (m_at < m_text.size() && m_text[m_at] == '-') {
+            m_at++;
+        }
+        while (m_at < m_text.size() && (std::isdigit(static_cast<unsigned char>(m_text[m_at])) || m_text[m_at] == '.' || m_text[m_at] == 'e' || m_text[m_at] == 'E' || m_text[m_at] == '+' || m_text[m_at] == '-')) {
+            m_at++;
+        }
+        std::istringstream stream(m_text.substr(begin, m_at - begin));
+        return static_cast<bool>(stream >> out) && stream.peek() == EOF;
+    }
+
+    bool parse_value(JsonValue& value) {
+        skip_space();
+        if (m_at == m_text.size()) {
+            return false;
+        }
+
+        char c = m_text[m_at];
+        if (c == '{') {
+            value.type = JsonValue::Type::OBJECT;
+            m_at++;
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                std::string key;
+                JsonValue member;
+                if (!parse_string(key) || !consume(':') || !parse_value(member)) {
+                    return false;
+                }
+                value.object[key] = std::move(member);
+            } while (consume(','));
+            return consume('}');
+        } else if (c == '[') {
+            value.type = JsonValue::Type::ARRAY;
+            m_at++;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                value.array.emplace_back();
+                if (!parse_value(value.array.back())) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        } else if (c == '"') {
+            value.type = JsonValue::Type::STRING;
+            return parse_string(value.string);
+        } else if (c == 't' || c == 'f') {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.boolean = c == 't';
+            return consume_word(value.boolean ? "true" : "false");
+        } else if (c == 'n') {
+            return consume_word("null");
+        }
+        value.type = JsonValue::Type::NUMBER;
+        return parse_number(value.number);
+    }
+};
+
+struct TraceSpan {
+    std::string name;
+    u32 tid;
+    f64 ts;
+    f64 dur;
+};
+
+static bool read_trace(const std::string& path, JsonValue& root) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return JsonParser(text.str()).parse(root);
+}
+
+static void busy_wait_us(u64 us) {
+    u64 end = platform_time_ns() + us * 1000;
+    while (platform_time_ns() < end) {
+    }
+}
+
+static void run_frame(u64 frame) {
+    PROFILE_FRAME(frame);
+    {
+        PROFILE_SCOPE("update");
+        busy_wait_us(50);
+    }
+    {
+        PROFILE_SCOPE("render");
+        busy_wait_us(20);
+        {
+            PROFILE_SCOPE("draw \"sprites\"");
+            busy_wait_us(50);
+        }
+        busy_wait_us(20);
+    }
+
+    // A second thread records during one frame of the exported range
+    if (frame == 2) {
+        std::thread worker([] {
+            PROFILE_THREAD("Worker");
+            PROFILE_SCOPE("worker job");
+            busy_wait_us(50);
+        });
+        worker.join();
+    }
+}
+
+// Frames 0 to 4 are profiled and 1 to 3 exported: the trace holds the
+// scopes of those three frames only, nested the way they ran, on the
+// thread that ran them
+static void test_export_frame_range() {
+    PROFILE_THREAD("Main");
+    for (u64 frame = 0; frame < 5; frame++) {
+        run_frame(frame);
+    }
+    PROFILE_FRAME(5);
+
+    std::string path = (fs::temp_directory_path() / "bifrost_test_profiler.json").string();
+    TEST_CHECK(profile_export_chrome_trace(path.c_str(), 1, 3));
+
+    JsonValue root;
+    TEST_CHECK(read_trace(path, root));
+    fs::remove(path);
+
+    TEST_CHECK(root.type == JsonValue::Type::OBJECT);
+    const JsonValue* events = root.find("traceEvents");
+    TEST_CHECK(events != nullptr && events->type == JsonValue::Type::ARRAY);
+
+    std::map<u32, std::string> thread_names;
+    std::vector<TraceSpan> spans;
+    for (const JsonValue& event : events->array) {
+        TEST_CHECK(event.type == JsonValue::Type::OBJECT);
+        const JsonValue* ph = event.find("ph");
+        const JsonValue* name = event.find("name");
+        const JsonValue* tid = event.find("tid");
+        TEST_CHECK(ph != nullptr && ph->type == JsonValue::Type::STRING);
+        TEST_CHECK(name != nullptr && name->type == JsonValue::Type::STRING);
+        TEST_CHECK(tid != nullptr && tid->type == JsonValue::Type::NUMBER);
+
+        if (ph->string == "M") {
+            const JsonValue* args = event.find("args");
+            TEST_CHECK(name->string == "thread_name");
+            TEST_CHECK(args != nullptr && args->find("name") != nullptr);
+            thread_names[static_cast<u32>(tid->number)] = args->find("name")->string;
+            continue;
+        }
+
+        TEST_CHECK(ph->string == "X");
+        const JsonValue* ts = event.find("ts");
+        const JsonValue* dur = event.find("dur");
+        TEST_CHECK(ts != nullptr && ts->type == JsonValue::Type::NUMBER);
+        TEST_CHECK(dur != nullptr && dur->type == JsonValue::Type::NUMBER);
+        TEST_CHECK(ts->number >= 0.0);
+        TEST_CHECK(dur->number >= 0.0);
+        spans.push_back({ name->string, static_cast<u32>(tid->number), ts->number, dur->number });
+    }
+
+    auto count = [&](const char* name) {
+        usize found = 0;
+        for (const TraceSpan& span : spans) {
+            found += span.name == name ? 1 : 0;
+        }
+        return found;
+    };
+
+    TEST_CHECK(count("update") == 3);
+    TEST_CHECK(count("render") == 3);
+    TEST_CHECK(count("draw \"sprites\"") == 3);
+    TEST_CHECK(count("worker job") == 1);
+    TEST_CHECK(count("Frame 0") == 0);
+    TEST_CHECK(count("Frame 1") == 1);
+    TEST_CHECK(count("Frame 2") == 1);
+    TEST_CHECK(count("Frame 3") == 1);
+    TEST_CHECK(count("Frame 4") == 0);
+
+    // Each span sits on the thread that recorded it
+    for (const TraceSpan& span : spans) {
+        TEST_CHECK(thread_names.count(span.tid) == 1);
+        const std::string& thread = thread_names[span.tid];
+        TEST_CHECK(thread == (span.name == "worker job" ? "Worker" : "Main"));
+    }
+
+    // Every scope of the main thread lies inside its frame, and every
+    // draw inside a render. Times are written to the nanosecond.
+    const f64 slack = 0.002;
+    auto inside = [&](const TraceSpan& inner, const TraceSpan& outer) {
+        return inner.ts + slack >= outer.ts && inner.ts + inner.dur <= outer.ts + outer.dur + slack;
+    };
+    for (const TraceSpan& span : spans) {
+        if (span.name.compare(0, 6, "Frame ") == 0) {
+            continue;
+        }
+
+        usize frames = 0;
+        usize renders = 0;
+        for (const TraceSpan& outer : spans) {
+            frames += outer.name.compare(0, 6, "Frame ") == 0 && inside(span, outer) ? 1 : 0;
+            renders += outer.name == "render" && inside(span, outer) ? 1 : 0;
+        }
+        TEST_CHECK(frames == 1);
+        TEST_CHECK(renders == (span.name == "render" || span.name == "draw \"sprites\"" ? 1u : 0u));
+    }
+}
+
+static void test_export_unknown_frames() {
+    std::string path = (fs::temp_directory_path() / "bifrost_test_profiler_empty.json").string();
+    TEST_CHECK(!profile_export_chrome_trace(path.c_str(), 1000, 2000));
+    TEST_CHECK(!fs::exists(path));
+}
+
+#endif // BIFROST_PROFILE
+
+int main() {
+#ifdef BIFROST_PROFILE
+    TEST_RUN(test_export_frame_range);
+    TEST_RUN(test_export_unknown_frames);
+#else
+    std::printf("Built without BIFROST_PROFILE, nothing to export\n");
+#endif // BIFROST_PROFILE
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include "test.h"
+
+#include <core/jobs.h>
+#include <render/rasterizer.h>
+
+#include <vector>
+
+using namespace bifrost::core;
+using namespace bifrost::math;
+using namespace bifrost::render;
+
+// Framebuffer widths, including ones whose rows are not whole groups of
+// four pixels and ones narrower than a tile
+static const u32 g_widths[] = { 128, 130, 127, 61, 333 };
+constexpr u32 HEIGHT = 97;
+constexpr u32 TRIANGLE_COUNT = 3000;
+
+struct Scene {
+    std::vector<vec3> positions;
+    std::vector<u32> colors;
+    std::vector<u32> indices;
+};
+
+// Overlapping triangles at random depths, some reaching past the edges
+static Scene make_scene() {
+    Scene scene;
+    u32 state = 12345;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<f32>(state >> 8) / static_cast<f32>(1u << 24);
+    };
+
+    for (u32 i = 0; i < TRIANGLE_COUNT; i++) {
+        f32 x = next() * 2.4f - 1.2f;
+        f32 y = next() * 2.4f - 1.2f;
+        f32 z = next() * 0.8f + 0.1f;
+        for (u32 v = 0; v < 3; v++) {
+            scene.positions.push_back(vec3(x + next() * 0.4f - 0.2f, y + next() * 0.4f - 0.2f, z));
+            scene.colors.push_back(static_cast<u32>(next() * 16777215.0f));
+            scene.indices.push_back(i * 3 + v);
+        }
+    }
+    return scene;
+}
+
+static std::vector<u32> render(const Scene& scene, u32 width) {
+    Rasterizer rasterizer(width, HEIGHT);
+    rasterizer.set_cull_mode(CullMode::NONE);
+    rasterizer.clear(0x00102030);
+    rasterizer.draw(
+        mat4(),
+        scene.positions.data(),
+        scene.colors.data(),
+        scene.positions.size(),
+        scene.indices.data(),
+        scene.indices.size()
+    );
+    rasterizer.flush();
+
+    const u32* pixels = rasterizer.get_pixels();
+    return std::vector<u32>(pixels, pixels + static_cast<usize>(width) * HEIGHT);
+}
+
+int main() {
+    Scene scene = make_scene();
+
+    // Before the job system starts every tile runs on this thread
+    std::vector<std::vector<u32>> serial;
+    for (u32 width : g_widths) {
+        serial.push_back(render(scene, width));
+    }
+
+    JobSystem* jobs = JobSystem::get_reference();
+    jobs->init(3);
+
+    // Tiles on different threads render the same pixels
+    for (u32 run = 0; run < 4; run++) {
+        for (usize i = 0; i < sizeof(g_widths) / sizeof(g_widths[0]); i++) {
+            std::printf("width %u, run %u\n", g_widths[i], run);
+            TEST_CHECK(render(scene, g_widths[i]) == serial[i]);
+        }
+    }
+
+    jobs->shutdown();
+    return EXIT_SUCCESS;
+}
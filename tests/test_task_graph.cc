@@ -0,0 +1,98 @@
+#include "test.h"
+
+#include <core/jobs.h>
+#include <core/profiler.h>
+#include <core/task_graph.h>
+
+#include <atomic>
+#include <cstring>
+
+using namespace bifrost::core;
+
+static std::atomic<u32> g_physics_runs = 0;
+static std::atomic<u32> g_animation_runs = 0;
+static std::atomic<u32> g_render_runs = 0;
+
+static void physics(u64 frame) { (void)frame; g_physics_runs++; }
+static void animation(u64 frame) { (void)frame; g_animation_runs++; }
+static void render(u64 frame) { (void)frame; g_render_runs++; }
+
+static void reset_runs() {
+    g_physics_runs = 0;
+    g_animation_runs = 0;
+    g_render_runs = 0;
+}
+
+// Every system runs once per frame, render included once all frames finished
+static void test_runs_every_frame() {
+    reset_runs();
+    TaskGraph graph;
+    ResourceMask transforms = graph.add_resource("transforms");
+    ResourceMask poses = graph.add_resource("poses");
+    graph.add_system("physics", &physics, 0, transforms);
+    graph.add_system("animation", &animation, transforms, poses);
+    graph.add_system("render", &render, transforms | poses, 0, SystemStage::RENDER);
+
+    for (u64 frame = 0; frame < 100; frame++) {
+        graph.execute(frame);
+        TEST_CHECK(g_physics_runs == frame + 1);
+        TEST_CHECK(g_animation_runs == frame + 1);
+    }
+    graph.wait_all();
+
+    TEST_CHECK(g_render_runs == 100);
+    TEST_CHECK(graph.get_last_report().frame == 99);
+}
+
+// Adding a system after frames have run used to leave the prepared next
+// frame counting the old systems, so execute waited forever
+static void test_add_system_after_execute() {
+    reset_runs();
+    TaskGraph graph;
+    ResourceMask transforms = graph.add_resource("transforms");
+    graph.add_system("physics", &physics, 0, transforms);
+    graph.add_system("render", &render, transforms, 0, SystemStage::RENDER);
+
+    for (u64 frame = 0; frame < 3; frame++) {
+        graph.execute(frame);
+    }
+
+    graph.add_system("animation", &animation, transforms, 0);
+    for (u64 frame = 3; frame < 6; frame++) {
+        graph.execute(frame);
+    }
+    graph.wait_all();
+
+    TEST_CHECK(g_physics_runs == 6);
+    TEST_CHECK(g_animation_runs == 3);
+    TEST_CHECK(g_render_runs == 6);
+}
+
+// Systems profile under an interned copy of their name, since the scopes
+// recorded for a trace outlive the graph and the string it was given
+static void test_profile_names_outlive_graph() {
+    char name[16] = "physics";
+    const char* interned = profile_intern(name);
+    {
+        TaskGraph graph;
+        graph.add_system(name, &physics, 0, 0);
+        graph.execute(0);
+        graph.wait_all();
+    }
+    std::strcpy(name, "overwritten");
+
+    TEST_CHECK(std::strcmp(interned, "physics") == 0);
+    TEST_CHECK(profile_intern("physics") == interned);
+}
+
+int main() {
+    JobSystem* jobs = JobSystem::get_reference();
+    jobs->init(3);
+
+    TEST_RUN(test_runs_every_frame);
+    TEST_RUN(test_add_system_after_execute);
+    TEST_RUN(test_profile_names_outlive_graph);
+
+    jobs->shutdown();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "test.h"
+
+#include <core/clock.h>
+#include <core/defines.h>
+#include <core/window.h>
+
+#ifdef Q_PLATFORM_LINUX
+#include <poll.h>
+#include <unistd.h>
+#endif // Q_PLATFORM_LINUX
+
+using namespace bifrost::core;
+
+// Calls of the source before it has its one event, 0 when it has none
+static u32 g_calls_until_event = 0;
+static u32 g_source_calls = 0;
+
+static bool delayed_source(WindowEvent& event) {
+    g_source_calls++;
+    if (g_calls_until_event == 0 || g_source_calls != g_calls_until_event) {
+        return false;
+    }
+
+    event.type = WindowEventType::RESIZE;
+    event.x = 320;
+    event.y = 240;
+    return true;
+}
+
+static void reset_source(u32 calls_until_event) {
+    g_calls_until_event = calls_until_event;
+    g_source_calls = 0;
+}
+
+static u64 elapsed_ms(u64 start_ns) {
+    return (platform_time_ns() - start_ns) / 1000000ull;
+}
+
+// Having a source used to count as having an event, so waiting never
+// slept. Now the wait lasts until the source has an event, which is kept
+// for the next pump.
+static void test_wait_for_source_event() {
+    Window window(640, 480, "Headless", WindowBackend::HEADLESS);
+    window.set_event_source(&delayed_source);
+
+    reset_source(5);
+    u64 start = platform_time_ns();
+    TEST_CHECK(window.wait_events(5000));
+    TEST_CHECK(elapsed_ms(start) < 1000);
+    TEST_CHECK(g_source_calls == 5);
+
+    TEST_CHECK(window.get_width() == 640);
+    window.pump_messages();
+    TEST_CHECK(window.get_width() == 320 && window.get_height() == 240);
+    window.shutdown();
+}
+
+// A source with nothing to give waits out the timeout
+static void test_wait_times_out() {
+    Window window(640, 480, "Headless", WindowBackend::HEADLESS);
+    window.set_event_source(&delayed_source);
+
+    reset_source(0);
+    u64 start = platform_time_ns();
+    TEST_CHECK(!window.wait_events(30));
+    TEST_CHECK(elapsed_ms(start) >= 30);
+    TEST_CHECK(g_source_calls > 1);
+
+    reset_source(0);
+    TEST_CHECK(!window.wait_events(0));
+    window.shutdown();
+}
+
+#ifdef Q_PLATFORM_LINUX
+// Waiting along with other descriptors also asks the source
+static void test_wait_with_descriptors() {
+    Window window(640, 480, "Headless", WindowBackend::HEADLESS);
+    window.set_event_source(&delayed_source);
+
+    int pipe_fds[2];
+    TEST_CHECK(pipe(pipe_fds) == 0);
+    pollfd extra = {};
+    extra.fd = pipe_fds[0];
+    extra.events = POLLIN;
+
+    reset_source(5);
+    u64 start = platform_time_ns();
+    TEST_CHECK(window.wait_events(5000, &extra, 1));
+    TEST_CHECK(elapsed_ms(start) < 1000);
+    window.pump_messages();
+    TEST_CHECK(window.get_width() == 320);
+
+    // A readable descriptor ends the wait without a window event
+    reset_source(0);
+    TEST_CHECK(write(pipe_fds[1], "x", 1) == 1);
+    start = platform_time_ns();
+    TEST_CHECK(!window.wait_events(5000, &extra, 1));
+    TEST_CHECK(elapsed_ms(start) < 1000);
+    TEST_CHECK((extra.revents & POLLIN) != 0);
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    window.shutdown();
+}
+#endif // Q_PLATFORM_LINUX
+
+int main() {
+    TEST_RUN(test_wait_for_source_event);
+    TEST_RUN(test_wait_times_out);
+#ifdef Q_PLATFORM_LINUX
+    TEST_RUN(test_wait_with_descriptors);
+#endif // Q_PLATFORM_LINUX
+    return EXIT_SUCCESS;
+}